@@ -0,0 +1,41 @@
+/*
+ *  dedup.h
+ *  Spotting segments that have already been drawn
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define DD_MIN_SLOTS    4096        /* slots in a new table */
+#define DD_MAX_BYTES    (64 << 20)  /* largest a table may grow to */
+
+/* a segment with its endpoints in the order they are hashed in */
+struct _segment {
+    double x0, y0;
+    double x1, y1;
+};
+typedef struct _segment Segment;
+
+/* open addressing hash table of segments, kept at most half full. once it
+   is as big as it may grow, new segments are no longer added but are still
+   looked up */
+struct _dedup {
+    Segment *segs;
+    char *used;         /* set for slots holding a segment */
+    size_t num_slots;   /* always a power of 2 */
+    size_t max_slots;
+    size_t count;       /* segments in the table */
+    long checked;       /* segments looked up */
+    long dropped;       /* segments found */
+    int full;           /* set once a segment could not be added */
+};
+typedef struct _dedup * Dedup;
+
+/* Table handling */
+Dedup dd_new(size_t max_bytes);
+void dd_clear(Dedup dd);
+void dd_free(Dedup dd);
+
+/* Lookup */
+int dd_seen(Dedup dd, double x0, double y0, double x1, double y1);
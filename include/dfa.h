@@ -0,0 +1,52 @@
+/*
+ *  dfa.h
+ *  Table driven validator for the parse tool
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+/* line classes */
+#define CLS_EMPTY       0       /* empty line */
+#define CLS_OPEN        1       /* "{" */
+#define CLS_CLOSE       2       /* "}" */
+#define CLS_BLOCK       3       /* a valid DO line, opening a block */
+#define CLS_INST        4       /* a valid FD, LT, RT or SET line */
+#define CLS_BAD         5       /* an invalid line, see DfaError */
+
+/* errors found on a CLS_BAD line, each matching a message in parser.c */
+#define DFA_E_INST      1       /* expected <INSTRUCTION> */
+#define DFA_E_OPERAND   2       /* expected <INSTRUCTION> <VARNUM> */
+#define DFA_E_VARNUM    3       /* expected number or a <VAR> (token) */
+#define DFA_E_DO        4       /* expected DO <VAR> FROM <VARNUM> TO <VARNUM> { */
+#define DFA_E_VAR       5       /* incorrect <VAR> (token) */
+#define DFA_E_SET       6       /* expected SET <VAR> := <POLISH> */
+#define DFA_E_POLISH    7       /* expected ; to end <POLISH> */
+
+struct _dfa_error {
+    int kind;               /* DFA_E_FOO */
+    const char *tok;        /* offending token, for DFA_E_VARNUM and DFA_E_VAR */
+    int tok_len;
+};
+typedef struct _dfa_error DfaError;
+
+/* a piece of the input checked on a thread of its own, see dfa_validate() */
+struct _dfa_chunk {
+    const char *start;      /* first byte of the chunk */
+    const char *end;        /* instructions starting before it are checked */
+    const char *limit;      /* end of the input, the last may run on to it */
+    const char *stop;       /* where the last instruction checked ends */
+    int newlines;           /* newlines in [start, end) */
+    int stop_line;          /* newlines in [start, stop) */
+    int main;               /* 1 if <MAIN> starts in the chunk */
+    int depth;              /* change in the "{" depth over the chunk */
+    int low;                /* lowest the change gets */
+    int bad;                /* set if an instruction is bad or too long */
+};
+typedef struct _dfa_chunk DfaChunk;
+
+/* Validation */
+void dfa_init(void);
+int dfa_line(const char *start, const char *end, DfaError *err);
+int dfa_validate(const char *buf, size_t size, int nthreads);
@@ -13,3 +13,5 @@
 #define STACK_ERR -4    /* illegal operations with stack (for interpreter.c) */
 #define ARGS_ERR  -5    /* error on arguments provided for executable */
 #define POL_ERR   -6    /* error on the polish expression (for interpreter.c) */
+#define FILE_ERR  -7    /* cannot open or write an output file */
+#define LIMIT_ERR -8    /* a run went over one of its limits (for interpreter.c) */
@@ -0,0 +1,46 @@
+/*
+ *  estimate.h
+ *  Works out what running a program costs, without running it
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define EST_UNROLL      1000    /* most times round a DO gone through one by one */
+#define EST_WORK        1000000 /* most lines looked at going through DOs one by one */
+#define EST_STACK       LINE_LENGTH /* most values on the stack of a <POLISH> */
+
+/* the values something can take, from lo to hi. they are the same when it
+   is known exactly, and hi is HUGE_VAL when there is no knowing */
+struct _range {
+    double lo;
+    double hi;
+};
+typedef struct _range Range;
+
+/* what running a program costs. instructions are counted as the limits of
+   a run count them, once for each run and once each time round a DO, so
+   an estimate can be given to --max-insts */
+struct _cost {
+    Range insts;        /* instructions run */
+    Range segs;         /* segments drawn by FD */
+    Range turns;        /* turns by LT and RT */
+};
+typedef struct _cost Cost;
+
+/* the estimator. each variable is known only as the range of values it
+   can have at the line being looked at */
+struct _estimate {
+    Logo input;
+    Range vars[VARARY_SIZE];
+    int used[VARARY_SIZE];
+    long work;          /* lines looked at going through DOs one by one */
+};
+typedef struct _estimate * Estimate;
+
+/* Estimating */
+int estimate(Logo input, Cost *cost, int *programs);
+int cost_exact(Cost *cost);
+void print_estimate(FILE *fp, char *in_filename, Cost *cost, int programs);
+int estimate_main(int argc, char *argv[]);
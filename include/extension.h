@@ -50,7 +50,7 @@ void clear_text(DInfo *dinfo);
 void new_file(DInfo *dinfo);
 int open_file(DInfo *dinfo, char *filename);
 int process_text_view(DInfo * dinfo);
-Logo read_input(char * buffer, int count);
+Logo read_input(char * buffer);
 int parse_items(InputItems input_items);
 int input_items_add(InputItems *input_items, Logo input, char *buffer);
 Logo input_items_pop(InputItems *input_items);
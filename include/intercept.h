@@ -14,8 +14,19 @@
 #endif
 
 #ifdef POSTSCRIPT
+#define ipt_backend(x,y) ps_backend(x,y)
+#define ipt_free(x) ps_free(x)
+#define ipt_report(x) ps_report(x)
+#define ipt_program(x,y) ps_program(x,y)
 #define ipt_header(x,y) ps_header(x,y)
 #define ipt_footer(x) ps_footer(x)
+#define ipt_trailer(x) ps_trailer(x)
+#define ipt_sync(x) ps_sync(x)      /* formatting may be on a thread of its own */
+#define ipt_newpage(x) ps_newpage(x)
+#define ipt_showpage(x) ps_showpage(x)
+#define ipt_loop(x,y)
+#define ipt_iteration(x)
+#define ipt_loop_end(x)
 #define ipt_fd(x,y) ps_ipt_fd(x,y)
 #define ipt_lt(x,y) ps_ipt_lt(x,y)
 #define ipt_rt(x,y) ps_ipt_rt(x,y)
@@ -24,10 +35,126 @@
 
 /* for extension. overrides interpreting functions in interpreter.c */
 #ifdef GUI
+#define ipt_backend(x,y) 0 /* gui draws everything as it comes */
+#define ipt_free(x)
+#define ipt_report(x)
+#define ipt_program(x,y)
 #define ipt_header(x,y)    /* gui does not require headers or footers in the output file */
 #define ipt_footer(x)      
+#define ipt_trailer(x)
+#define ipt_sync(x)
+#define ipt_newpage(x)
+#define ipt_showpage(x)
+#define ipt_loop(x,y)
+#define ipt_iteration(x)
+#define ipt_loop_end(x)
 #define ipt_fd(x,y) gui_ipt_fd(x,y)
 #define ipt_lt(x,y) gui_ipt_lt(x,y)
 #define ipt_rt(x,y) gui_ipt_rt(x,y)
 #include "extension.h" /* contains gui_foo() */
 #endif
+
+/* svg backend, which also hears about loops so that it can instance them */
+#ifdef SVG
+#define ipt_backend(x,y) svg_backend(x,y)
+#define ipt_free(x) svg_free(x)
+#define ipt_report(x) svg_report(x)
+#define ipt_program(x,y) (void) (y)  /* the program is not written */
+#define ipt_header(x,y) svg_header(x,y)
+#define ipt_footer(x) svg_footer(x)
+#define ipt_trailer(x) svg_trailer(x)
+#define ipt_sync(x)
+#define ipt_newpage(x)     /* an svg has one page */
+#define ipt_showpage(x)
+#define ipt_loop(x,y) svg_loop(x,y)
+#define ipt_iteration(x) svg_iteration(x)
+#define ipt_loop_end(x) svg_loop_end(x)
+#define ipt_fd(x,y) svg_ipt_fd(x,y)
+#define ipt_lt(x,y) svg_ipt_lt(x,y)
+#define ipt_rt(x,y) svg_ipt_rt(x,y)
+#include "svg.h" /* contains svg_foo() */
+#endif
+
+/* pdf backend, a page per program */
+#ifdef PDF
+#define ipt_backend(x,y) pdf_backend(x,y)
+#define ipt_free(x) pdf_free(x)
+#define ipt_report(x) pdf_report(x)
+#define ipt_program(x,y) (void) (y)  /* the program is not written */
+#define ipt_header(x,y) pdf_header(x,y)
+#define ipt_footer(x) pdf_footer(x)
+#define ipt_trailer(x) pdf_trailer(x)
+#define ipt_sync(x)
+#define ipt_newpage(x)     /* pages are started as they are drawn on */
+#define ipt_showpage(x)
+#define ipt_loop(x,y)
+#define ipt_iteration(x)
+#define ipt_loop_end(x)
+#define ipt_fd(x,y) pdf_ipt_fd(x,y)
+#define ipt_lt(x,y) pdf_ipt_lt(x,y)
+#define ipt_rt(x,y) pdf_ipt_rt(x,y)
+#include "pdf.h" /* contains pdf_foo() */
+#endif
+
+/* raster backend, drawing an image with no display */
+#ifdef RASTER
+#define ipt_backend(x,y) raster_backend(x,y)
+#define ipt_free(x) raster_free(x)
+#define ipt_report(x) raster_report(x)
+#define ipt_program(x,y) (void) (y)  /* the program is not written */
+#define ipt_header(x,y) raster_header(x,y)
+#define ipt_footer(x)      /* the image is written in the trailer */
+#define ipt_trailer(x) raster_trailer(x)
+#define ipt_sync(x)
+#define ipt_newpage(x)     /* an image has one page */
+#define ipt_showpage(x)
+#define ipt_loop(x,y)
+#define ipt_iteration(x)
+#define ipt_loop_end(x)
+#define ipt_fd(x,y) raster_ipt_fd(x,y)
+#define ipt_lt(x,y) raster_ipt_lt(x,y)
+#define ipt_rt(x,y) raster_ipt_rt(x,y)
+#include "raster.h" /* contains raster_foo() */
+#endif
+
+/* plot backend, driving a pen plotter */
+#ifdef PLOT
+#define ipt_backend(x,y) plot_backend(x,y)
+#define ipt_free(x) plot_free(x)
+#define ipt_report(x) plot_report(x)
+#define ipt_program(x,y) (void) (y)  /* the program is not written */
+#define ipt_header(x,y) plot_header(x,y)
+#define ipt_footer(x)      /* the plot is written in the trailer */
+#define ipt_trailer(x) plot_trailer(x)
+#define ipt_sync(x)
+#define ipt_newpage(x)     /* a plot has one page */
+#define ipt_showpage(x)
+#define ipt_loop(x,y)
+#define ipt_iteration(x)
+#define ipt_loop_end(x)
+#define ipt_fd(x,y) plot_ipt_fd(x,y)
+#define ipt_lt(x,y) plot_ipt_lt(x,y)
+#define ipt_rt(x,y) plot_ipt_rt(x,y)
+#include "plot.h" /* contains plot_foo() */
+#endif
+
+/* seg backend, binary segments for other programs to read */
+#ifdef SEG
+#define ipt_backend(x,y) seg_backend(x,y)
+#define ipt_free(x) seg_free(x)
+#define ipt_report(x) seg_report(x)
+#define ipt_program(x,y) (void) (y)  /* the program is not written */
+#define ipt_header(x,y) seg_header(x,y)
+#define ipt_footer(x) seg_footer(x)
+#define ipt_trailer(x) seg_trailer(x)
+#define ipt_sync(x)
+#define ipt_newpage(x)     /* pages are numbered in the blocks */
+#define ipt_showpage(x)
+#define ipt_loop(x,y)
+#define ipt_iteration(x)
+#define ipt_loop_end(x)
+#define ipt_fd(x,y) seg_ipt_fd(x,y)
+#define ipt_lt(x,y) seg_ipt_lt(x,y)
+#define ipt_rt(x,y) seg_ipt_rt(x,y)
+#include "seg.h" /* contains seg_foo() */
+#endif
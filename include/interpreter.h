@@ -8,12 +8,14 @@
  */
 
 #include "errors.h"   /* error codes */
+#include "outbuf.h"   /* buffered output */
 
 /* interpreter related */
 #define VARARY_SIZE     26      /* array size for holding variables A-Z */
 /* parsing related */
 #define FILENAME_LENGTH 128     /* input filename length */
 #define LINE_LENGTH     128     /* maximum input line length */
+#define READ_LENGTH     4096    /* initial buffer size for reading input */
 #define INSTRUCT_LENGTH 3       /* max string length of instruction */
 #define OPERAND_LENGTH  10      /* max string length for operands */
 #define VAR_LENGTH      1       /* length of <VAR> */
@@ -23,6 +25,32 @@
 #define SET             "SET"   /* string of <SET> instruction */
 #define DO              "DO"    /* string of <DO> instruction */
 #define NUM_ARGS        3       /* num args argc should have */
+#define GZIP_EXT        ".gz"   /* output files named this are gzipped */
+/* multi-program modes */
+#define MULTI_NONE      0       /* one program per input file */
+#define MULTI_PAGES     1       /* a page per program, all in one output file */
+#define MULTI_FILES     2       /* a numbered output file per program */
+#define MODE_UNROLLED   0       /* write what the program draws */
+#define MODE_PROGRAM    1       /* write the program itself, in postscript */
+#define MODE_ABSOLUTE   2       /* write what the program draws, in page coordinates */
+#define IMAGE_PNG       0       /* images drawn by the raster backend */
+#define IMAGE_PPM       1
+#define PLOT_HPGL       0       /* plots written by the plot backend */
+#define PLOT_GCODE      1
+/* options only some backends take, as given on the command line */
+#define OPT_COMPACT     0x001
+#define OPT_SIMPLIFY    0x002
+#define OPT_DEDUP       0x004
+#define OPT_PS_MODE     0x008
+#define OPT_MAX_PATH    0x010
+#define OPT_THREADS     0x020
+#define OPT_IMAGE       0x040
+#define OPT_SCALE       0x080
+#define OPT_PYRAMID     0x100
+#define OPT_PLOT        0x200
+#define OPT_POSTSCRIPT  (OPT_COMPACT | OPT_SIMPLIFY | OPT_DEDUP | OPT_PS_MODE | OPT_MAX_PATH | OPT_THREADS)
+#define OPT_RASTER      (OPT_IMAGE | OPT_SCALE | OPT_THREADS | OPT_PYRAMID)
+#define BUDGET_CLOCK    1024    /* instructions between looking at the time and memory */
 
 #define strsame(A,B) (strcmp(A, B)==0)
 
@@ -33,12 +61,63 @@ struct _varstack {
 };
 typedef struct _varstack * VarStack;
 
+/* command line options */
+struct _options {
+    int multi;      /* MULTI_FOO */
+    int compact;    /* merge drawing operators in the output */
+    double simplify;    /* tolerance for simplifying the path, or -1 for none */
+    int dedup;      /* drop segments already drawn */
+    int mode;       /* MODE_FOO */
+    long max_path;  /* segments in a path before it is stroked, or 0 for no limit */
+    int image;      /* IMAGE_FOO */
+    double scale;   /* pixels per point of an image */
+    int threads;    /* threads drawing an image, or 0 for one per core, and above 1
+                       runs the postscript pipeline */
+    int pyramid;    /* draw an image as a pyramid of tiles */
+    int plot;       /* PLOT_FOO */
+    int compress;   /* zlib level the output is gzipped at, or 0 unless it is named .gz */
+    int uring;      /* write the output through an io_uring */
+    long max_insts; /* limits on a run, as in struct _budget, or 0 for none */
+    long max_segs;
+    double max_time;
+    long max_memory;    /* in megabytes */
+    int estimate;   /* print what running the input would cost instead of running it */
+    int given;      /* OPT_FOO of the options given that only some backends take */
+};
+typedef struct _options Options;
+
+/* limits on a run, and what it has used of them. an instruction is counted
+   each time one is run and each time round a DO, so that an empty loop is
+   counted too. the time and memory are only looked at every BUDGET_CLOCK
+   instructions. a limit of 0 is none */
+struct _budget {
+    long max_insts;     /* instructions run */
+    long max_segs;      /* segments drawn by FD */
+    double max_time;    /* seconds since the run started */
+    long max_memory;    /* peak resident memory of the process, in kilobytes */
+    long insts;
+    long segs;
+    double start;       /* when the run started, in seconds */
+    int spent;          /* set once a limit has been gone over */
+};
+typedef struct _budget * Budget;
+
+/* state of the output backend, defined by the backend */
+typedef struct _backend * Backend;
+
 /* internal data structure for passing input file data, output file handler etc */
 struct logo {
     char **lines;
     int num_lines;
     int counter;
+    int *line_nums;     /* input file line number of each line, or NULL */
     FILE *ofile;    /* for fprintf */
+    char *out_filename; /* name of ofile, for backends writing files beside it */
+    OutBuf out;     /* buffered writer for ofile */
+    int compress;   /* as in Options */
+    int uring;
+    Backend backend;    /* backend state, or NULL for plain output */
+    Budget budget;  /* limits on the run, or NULL for none */
     VarStack vars;  /* for SET and VAR */
 };
 typedef struct logo * Logo;
@@ -56,6 +135,7 @@ int interp_main(int argc, char * argv[]);
 /* Parser Functions */
 int parse(Logo input);
 int mainlogo(Logo input);
+int program(Logo input);
 int instrctlst(Logo input);
 int instruction(Logo input);
 int fd(Logo input);
@@ -70,12 +150,24 @@ int operate(int oper, float a, float b, float * output);
 /* Parser Helper Functions */
 int get_var(char * var, VarStack vars, float * output);
 int set_var(char * var, VarStack vars, float num);
+int line_num(Logo input);
+int move_operand(Logo input, char *inst, float *op);
+int do_header(Logo input, char *var, float *from, float *to);
 int is_var(char * var);
 int is_op(char * op);
 char * trim_space(char *str);
 
+/* Budget Functions */
+int set_budget(Logo input, Options *opts);
+int spend(Logo input, int segs);
+
+/* Multi-program Functions */
+int parse_pages(Logo input);
+int interp_files(Logo input, char *in_filename, char *out_filename);
+
 /* Input File Handling */
 Logo scan_file(FILE * in_file);
+Logo scan_mt(FILE * in_file);
 void free_logo(Logo input);
 void free_stack(Stack stack);
 
@@ -84,4 +176,7 @@ int push(Stack *head, float value);
 int pop(Stack *head, float * value);
 
 /* Command line functions */
+int get_options(int argc, char * argv[], Options *opts);
+int backend_takes(Options *opts, int takes, char *what);
 int get_filenames(int argc, char * argv[], char *input, char *output);
+int numbered_filename(char *filename, int num, char *output);
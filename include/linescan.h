@@ -0,0 +1,22 @@
+/*
+ *  linescan.h
+ *  Vectorised line splitting and whitespace trimming
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+/* a trimmed line inside a larger buffer, not NUL terminated */
+struct _lineview {
+    const char *start;
+    int len;
+};
+typedef struct _lineview LineView;
+
+/* Scanning */
+int ls_width(void);
+char * ls_find_newline(const char *p, const char *end);
+char * ls_skip_space(const char *p, const char *end);
+char * ls_trim_end(const char *start, const char *end);
+char * ls_next_line(const char *p, const char *end, int max, LineView *view);
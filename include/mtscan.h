@@ -0,0 +1,44 @@
+/*
+ *  mtscan.h
+ *  Multi-threaded scanning of memory mapped input files
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define MT_LINE_LENGTH  128         /* must match LINE_LENGTH in parser.h and interpreter.h */
+#define MT_MAX_THREADS  16          /* upper bound on scanning threads */
+#define MT_MIN_CHUNK    (1 << 20)   /* do not split the input below 1MB per thread */
+
+/* a piece of the mapped input lexed on a thread of its own. It starts
+   where an instruction looks to start, and is only used once the chunk
+   before it is known to have ended there */
+struct _chunk {
+    const char *start;      /* first byte of the chunk */
+    const char *end;        /* instructions starting before it are read */
+    const char *limit;      /* end of the input, the last may run on to it */
+    const char *stop;       /* where the last instruction read ends */
+    int newlines;           /* newlines in [start, end) */
+    int stop_line;          /* newlines in [start, stop) */
+    int quiet;              /* 1 to leave reporting errors to the caller */
+    char **lines;           /* instructions read, one per line */
+    int *line_nums;         /* line number of each, counting from 1 at start */
+    int num_lines;
+    int cap_lines;
+    int too_long;           /* set if an instruction is too long for a line */
+    int error;              /* set if a malloc failed */
+};
+typedef struct _chunk Chunk;
+
+/* Memory mapping */
+char * map_file(FILE *file, size_t *size);
+void unmap_file(char *map, size_t size);
+
+/* Scanning */
+int mt_threads(size_t size);
+int mt_count_lines(const char *p, const char *end);
+void mt_split(const char *buf, size_t size, const char **bounds, int n);
+void mt_run(void *items, size_t item_size, int n, void *(*func)(void *));
+char ** mt_scan(const char *buf, size_t size, int nthreads, int *num_lines, int **line_nums);
+void free_lines(char **lines, int num_lines);
@@ -0,0 +1,51 @@
+/*
+ *  outbuf.h
+ *  Buffered output writer
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define OB_SIZE         (1 << 20)   /* bytes buffered before a write */
+#define OB_LEVEL        6           /* zlib level of compressed output, within 2% of level 9's size at under half its time */
+#define OB_ZCHUNK       (1 << 16)   /* bytes of compressed output written at a time */
+#define OB_RING_BUFS    4           /* buffers of an io_uring, written while the next is filled */
+#define OB_RING_BATCH   2           /* full buffers queued before they are submitted together */
+
+/* the thread writing out a buffer, compressed or not, defined in outbuf.c */
+typedef struct _obzip * ObZip;
+
+/* the io_uring writing out buffers, defined in outbuf.c */
+typedef struct _obring * ObRing;
+
+/* output buffered in large chunks, written with a single write() each */
+struct _outbuf {
+    int fd;         /* file descriptor written to */
+    char *buf;
+    size_t len;     /* bytes in buf */
+    long long done; /* bytes written before those in buf */
+    int error;      /* set once a write fails */
+    ObZip zip;      /* writing thread, or NULL to write the buffer itself */
+    ObRing ring;    /* io_uring, or NULL */
+};
+typedef struct _outbuf * OutBuf;
+
+/* Buffer handling */
+OutBuf ob_new(FILE *file);
+int ob_compress(OutBuf ob, int level);
+int ob_writer(OutBuf ob);
+int ob_uring(OutBuf ob);
+int ob_flush(OutBuf ob);
+int ob_close(OutBuf ob);
+long long ob_tell(OutBuf ob);
+
+/* Writing */
+void ob_write(OutBuf ob, const char *s, size_t n);
+void ob_puts(OutBuf ob, const char *s);
+void ob_int(OutBuf ob, int n);
+void ob_fixed2(OutBuf ob, double d);
+void ob_cents(OutBuf ob, long long cents);
+
+/* Rounding */
+int ob_to_cents(double d, long long *cents);
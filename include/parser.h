@@ -10,6 +10,7 @@
 
 #define FILENAME_LENGTH 128     /* input filename length */
 #define LINE_LENGTH     128     /* maximum input line length */
+#define READ_LENGTH     4096    /* initial buffer size for reading input */
 #define INSTRUCT_LENGTH 3       /* max string length of instruction */
 #define OPERAND_LENGTH  10      /* max string length for operands */
 #define VAR_LENGTH      1       /* length of <VAR> */
@@ -26,6 +27,7 @@ struct logo {
     char **lines;
     int num_lines;
     int counter;
+    int *line_nums;     /* input file line number of each line, or NULL */
 };
 typedef struct logo * Logo;
 
@@ -46,6 +48,7 @@ int set(Logo input);
 int polish(char * po, Logo input);
 
 /* Parser Helper Functions */
+int line_num(Logo input);
 int is_var(char * var);
 int is_op(char * op);
 char * trim_space(char *str);
@@ -0,0 +1,55 @@
+/*
+ *  pdf.h
+ *  Backend for generating PDF output
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <zlib.h>   /* for compressing content streams */
+
+#define PDF_WIDTH       612     /* a letter page, as the postscript is shown */
+#define PDF_HEIGHT      792
+#define PDF_START_X     200     /* where the turtle starts, as in postscript */
+#define PDF_START_Y     200
+#define PDF_CHUNK       65536   /* bytes of content compressed at a time */
+#define PDF_OP_LENGTH   64      /* longest operator written to the content */
+#define PDF_MIN_OBJS    64      /* object offsets in a new table */
+#define PDF_TO_RADS     (3.14159265358979323846 / 180)
+#define PDF_FULL_CIRCLE 360.0
+
+/* the pdf backend. object 1 is the catalog and object 2 the page tree,
+   which is written last, once the pages are known. page i is object
+   3 + 3i, followed by its content stream and the length of that, which
+   is only known once the stream has been compressed. the turtle is
+   followed and its path written as "x y l" from where it starts */
+struct _backend {
+    z_stream z;
+    unsigned char *text;    /* content waiting to be compressed */
+    size_t len;             /* bytes in text */
+    unsigned char *zbuf;    /* compressed content on its way out */
+    long long *offsets;     /* where each object starts, by number */
+    int max_objs;
+    int num_objs;           /* one more than the highest object written */
+    int pages;              /* pages finished */
+    int in_page;            /* a page has been started */
+    int in_path;            /* the path of the page has been started */
+    long long stream_len;   /* compressed bytes in the content stream */
+    long long raw;          /* content bytes before compressing */
+    long long packed;       /* and after */
+    double x, y, h;         /* turtle pose from where it starts, h in degrees */
+};
+
+/* Backend handling */
+int pdf_backend(Logo input, Options *opts);
+void pdf_free(Backend backend);
+void pdf_report(Logo input);
+
+/* PDF interpretation */
+void pdf_header(Logo input, char *in_filename);
+void pdf_footer(Logo input);
+void pdf_trailer(Logo input);
+void pdf_ipt_fd(Logo input, float op);
+void pdf_ipt_lt(Logo input, float op);
+void pdf_ipt_rt(Logo input, float op);
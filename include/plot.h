@@ -0,0 +1,78 @@
+/*
+ *  plot.h
+ *  Backend for driving a pen plotter, in HPGL or G-code
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include "dedup.h"  /* for plotting each segment once */
+
+#define PLOT_START_X    200     /* where the turtle starts, as in postscript */
+#define PLOT_START_Y    200
+#define PLOT_HPGL_UNIT  (1016.0 / 72)   /* plotter units of 0.025mm in a point */
+#define PLOT_GCODE_UNIT (2540.0 / 72)   /* hundredths of a mm in a point */
+#define PLOT_MAX_COORD  1e9     /* units either side of the origin a point is held to */
+#define PLOT_MIN_POINTS 1024    /* points in a new list */
+#define PLOT_MIN_LINES  256     /* polylines in a new list */
+#define PLOT_WINDOW     64      /* polylines a reversal by 2-opt may span */
+#define PLOT_MAX_PASSES 16      /* passes of 2-opt over the whole order */
+#define PLOT_HPGL_POINTS 32     /* points given to one PD instruction */
+#define PLOT_Z_UP       "5"     /* pen heights in G-code, in mm */
+#define PLOT_Z_DOWN     "0"
+#define PLOT_FEED       "3000"  /* drawing speed in G-code, in mm a minute */
+#define PLOT_OP_LENGTH  64      /* longest instruction written */
+#define PLOT_TO_RADS    (3.14159265358979323846 / 180)
+#define PLOT_FULL_CIRCLE 360.0
+
+/* a point of the plot, in plotter units from the corner of the page */
+struct _plotpoint {
+    long long x, y;
+};
+typedef struct _plotpoint PlotPoint;
+
+/* the plot backend. the turtle is followed and each point it reaches is
+   rounded to the units of the plotter. a segment that has been drawn
+   before is not plotted again, so the path breaks into polylines where
+   the turtle goes back over its lines. the polylines are kept until the
+   trailer, then put in an order that keeps the pen up for as short a
+   distance as it can: each polyline is the nearest free end to where the
+   last one finished, found in a grid of the ends, and runs of them are
+   then reversed by 2-opt wherever that shortens the travel between them.
+   a polyline can be plotted from either end */
+struct _backend {
+    int format;             /* PLOT_FOO */
+    double unit;            /* plotter units in a point */
+    Dedup dedup;            /* segments plotted */
+    PlotPoint *pts;         /* points of the polylines, one after another */
+    long num_pts;
+    long max_pts;
+    long *first;            /* first point of each polyline, and one past the last */
+    long num_lines;
+    long max_lines;
+    long *order;            /* polylines in the order they are plotted */
+    char *rev;              /* set for a polyline plotted from its end */
+    int pen_down;           /* the last polyline ends where the turtle is */
+    double x, y, h;         /* turtle pose from where it starts, h in degrees */
+    PlotPoint cur;          /* where the turtle is, rounded */
+    long segments;          /* lines drawn */
+    long plotted;           /* segments plotted */
+    long polylines;         /* polylines plotted */
+    double before;          /* pen up travel in the order drawn, in units */
+    double after;           /* and in the order plotted */
+    double order_time;      /* seconds spent ordering */
+    int plots;              /* plots written */
+};
+
+/* Backend handling */
+int plot_backend(Logo input, Options *opts);
+void plot_free(Backend backend);
+void plot_report(Logo input);
+
+/* Plot interpretation */
+void plot_header(Logo input, char *in_filename);
+void plot_trailer(Logo input);
+void plot_ipt_fd(Logo input, float op);
+void plot_ipt_lt(Logo input, float op);
+void plot_ipt_rt(Logo input, float op);
@@ -7,13 +7,83 @@
  *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
  */
 
+#include "simplify.h" /* for simplifying the path */
+#include "dedup.h"    /* for dropping segments drawn before */
+#include "ring.h"     /* for formatting on a thread of its own */
+
 #define LOGO2PS_FACTOR  1.0     /* conversion factor between LOGO and postscript */
 #define PS_MOVETO_X     200     /* postscript moveto in x coord */
 #define PS_MOVETO_Y     200     /* postscript moveto in y coord */
+#define PS_FULL_TURN    36000   /* 360 degrees in hundredths */
+#define PS_MERGE_MAX    1000000000000000000LL   /* largest merged rlineto in hundredths */
+#define PS_FULL_CIRCLE  360.0   /* degrees in a turn */
+#define PS_TO_RADS      (3.14159265358979323846 / 180)
+#define PS_NUM_LENGTH   32      /* longest number written in a program */
+#define PS_BBOX_PAD     5       /* furthest a mitred corner of a 1 wide line
+                                   sticks out past its vertex */
+
+/* puts the initial value, increment and limit of a postscript for loop
+   on the stack in place of the FROM and TO values of a DO loop */
+#define PS_RANGE        "/range { 2 copy lt { exch cvi 1 3 -1 roll } " \
+                        "{ exch cvi -1 3 -1 roll } ifelse } bind def\n"
+
+/* draws a segment like rlineto, then strokes the path and carries on from
+   the same point once it has the number of segments on the stack. it
+   counts in pts, which is defined with it */
+#define PS_SEG_1        "/pts 0 def\n/seg { rlineto /pts pts 1 add def pts "
+#define PS_SEG_2        " ge { currentpoint stroke moveto /pts 0 def } if } bind def\n"
+
+/* the postscript backend. when compacting, rlineto and rotate are held back
+   in hundredths, as they would be printed, and merged with the next ones.
+   when simplifying or dropping duplicates, the turtle is followed instead
+   and the vertices of its path are written as "dx dy rlineto", with a
+   "dx dy rmoveto" over segments already drawn. in MODE_ABSOLUTE the
+   turtle is always followed and "x y lineto" is written in page
+   coordinates, while the bounding box of the lines is worked out. with a
+   max_path, the path is stroked and started again from the current point
+   every max_path segments, so that it does not grow without bound. with a
+   ring, the drawing operators are formatted on a thread of their own and
+   written out on another, and everything else waits for the ring to empty
+   before it touches the output */
+struct _backend {
+    int mode;           /* MODE_FOO */
+    int unrolled;       /* MODE_PROGRAM asked for, but a DO may go round no times */
+    long lines;         /* lines of program written in MODE_PROGRAM */
+    int compact;        /* merge drawing operators */
+    long long fd;       /* pending rlineto, 0 if none */
+    long long rot;      /* pending rotate, 0 if none */
+    long ops_in;        /* rlineto and rotate operators interpreted */
+    long ops_out;       /* rlineto and rotate operators written */
+    int follow;         /* follow the turtle */
+    Simplify simplify;  /* simplifier, or NULL if not simplifying */
+    Dedup dedup;        /* segments drawn, or NULL if not dropping them */
+    double x, y;        /* turtle position from the start of the page */
+    double heading;     /* degrees anticlockwise from the x axis */
+    double cur_x;       /* last vertex, in hundredths */
+    double cur_y;
+    double last_x;      /* last vertex written, in hundredths */
+    double last_y;
+    int drawn;          /* set once a line is in the bounding box */
+    double min_x, min_y;    /* bounding box in page coordinates, in hundredths */
+    double max_x, max_y;
+    long max_path;      /* segments in a path before it is stroked, or 0 */
+    long segments;      /* segments in the path so far */
+    Ring ring;          /* formatting thread, or NULL to format as the program runs */
+};
+
+/* Backend handling */
+int ps_backend(Logo input, Options *opts);
+void ps_free(Backend backend);
+void ps_report(Logo input);
+void ps_program(Logo input, int start);
 
 /* Postscript interpretation */
-void ps_header(FILE *in_file, char *in_filename);
-void ps_footer(FILE *in_file);
+void ps_header(Logo input, char *in_filename);
+void ps_footer(Logo input);
+void ps_trailer(Logo input);
+void ps_sync(Logo input);
+void ps_newpage(OutBuf out);
+void ps_showpage(OutBuf out);
 void ps_ipt_fd(Logo input, float op);
 void ps_ipt_lt(Logo input, float op);
 void ps_ipt_rt(Logo input, float op);
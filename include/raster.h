@@ -0,0 +1,111 @@
+/*
+ *  raster.h
+ *  Backend for drawing into an image without a display
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <pthread.h>
+#include <zlib.h>   /* for compressing png image data */
+
+#define RASTER_WIDTH    612     /* a letter page at 72 dpi, as the postscript is shown */
+#define RASTER_HEIGHT   792
+#define RASTER_START_X  200     /* where the turtle starts, as in postscript */
+#define RASTER_START_Y  200
+#define RASTER_MAX_SCALE 64     /* pixels per point, about 40000 pixels across */
+#define RASTER_TILE     256     /* pixels along a side of a tile, whose 64KB of
+                                   coverage stays in L2 while it is drawn */
+#define RASTER_MARGIN   2       /* pixels a line can ink either side of it */
+#define RASTER_MAX_THREADS 64   /* upper bound on drawing threads */
+#define RASTER_MIN_SEGS 1024    /* segments in a new list */
+#define RASTER_CHUNK_LINES 1024 /* lines of a pyramid read from disk at a time */
+#define RASTER_SHIFT    16      /* fraction bits of the fixed point line stepper */
+#define RASTER_ONE      (1LL << RASTER_SHIFT)
+#define RASTER_BIAS     2048    /* pixels added so that the stepper stays positive,
+                                   more than a tile is big */
+#define RASTER_MAX_ZOOM 24      /* deepest level of a pyramid, 2^24 tiles across */
+#define RASTER_PATH_LENGTH (FILENAME_LENGTH + 64)   /* a tile of a pyramid */
+#define RASTER_CHUNK    65536   /* bytes of png image data compressed at a time */
+#define RASTER_TO_RADS  (3.14159265358979323846 / 180)
+#define RASTER_FULL_CIRCLE 360.0
+
+/* a line to draw, in pixels with y down the image */
+struct _rasterseg {
+    double x0, y0, x1, y1;
+};
+typedef struct _rasterseg RasterSeg;
+
+/* a line of a pyramid on disk, with its number in the order drawn */
+struct _rasterline {
+    RasterSeg seg;
+    long id;
+};
+typedef struct _rasterline RasterLine;
+
+/* the raster backend. the turtle is followed and each line it draws is
+   kept until the trailer. the lines are then binned into square tiles of
+   the image, by the tiles each can ink, and the tiles are drawn by a pool
+   of threads. each thread anti-aliases the lines of a tile into coverage
+   of its own, a byte per pixel, and copies the tile into the image, which
+   no other tile touches. the image is written as a ppm or a png.
+
+   a pyramid is drawn a tile at a time instead, from one tile over the
+   whole drawing down to a level with at least a pixel per pixel of the
+   image. its lines go to a temporary file as they are drawn, rather than
+   memory, and each tile is drawn from a file of the lines that can ink
+   it, read a chunk at a time and split into files for the tiles below
+   it, with runs of lines smaller than a pixel joined into one. the memory
+   used is that of a tile and a chunk, however many lines there are. only
+   tiles with ink are written, into a directory beside the output, which
+   gets a manifest of them */
+struct _backend {
+    int width, height;      /* of the image, in pixels */
+    double scale;           /* pixels per point */
+    int threads;            /* threads drawing tiles */
+    RasterSeg *segs;        /* lines of the image being drawn */
+    long num_segs;          /* and how many, or how many spilled for a pyramid */
+    long max_segs;
+    int tiles_x, tiles_y;   /* tiles across and down the image */
+    long *first;            /* where the lines of each tile start in list */
+    long *list;             /* lines by tile */
+    int next_tile;          /* next tile for a thread to draw */
+    pthread_mutex_t lock;   /* for next_tile */
+    unsigned char *cov;     /* coverage of each pixel, 255 for fully inked */
+    unsigned char *row;     /* a row of the image on its way out */
+    unsigned char *zbuf;    /* compressed image data on its way out */
+    z_stream z;
+    int image;              /* IMAGE_FOO */
+    double x, y, h;         /* turtle pose from where it starts, h in degrees */
+    long segments;          /* lines drawn */
+    int images;             /* images written */
+    double bin_time;        /* seconds spent binning lines into tiles */
+    double draw_time;       /* and drawing the tiles */
+    int pyramid;            /* draw a pyramid of tiles rather than an image */
+    unsigned char *tile;    /* coverage of the tile of the pyramid being drawn */
+    FILE *spill;            /* lines of the pyramid, as they are drawn */
+    RasterLine *chunk;      /* lines of a tile of the pyramid read from disk */
+    double lx, ly, hx, hy;  /* bounds of the lines spilled, in pixels of the image */
+    double min_x, min_y;    /* top left of the square of the pyramid, in pixels of the image */
+    double size;            /* side of that square */
+    int max_zoom;           /* deepest level */
+    long written[RASTER_MAX_ZOOM + 1];  /* tiles written at each level */
+    long tiles;             /* tiles written in all */
+    char dir[FILENAME_LENGTH];          /* where the tiles go */
+};
+
+/* Backend handling */
+int raster_backend(Logo input, Options *opts);
+void raster_free(Backend backend);
+void raster_report(Logo input);
+
+/* Drawing */
+int raster_draw(Backend b);
+
+/* Raster interpretation */
+void raster_header(Logo input, char *in_filename);
+void raster_trailer(Logo input);
+void raster_ipt_fd(Logo input, float op);
+void raster_ipt_lt(Logo input, float op);
+void raster_ipt_rt(Logo input, float op);
@@ -0,0 +1,55 @@
+/*
+ *  ring.h
+ *  Lock-free ring of drawing operations, handed from one thread to another
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <pthread.h>
+
+#define RG_SIZE         4096    /* operations in a ring, a power of 2 */
+#define RG_BATCH        64      /* operations taken before the space is given back */
+#define RG_SPINS        1000    /* yields while waiting before sleeping */
+#define RG_NAP          50000   /* nanoseconds slept at a time while waiting */
+#define RG_FD           0       /* kinds of operation */
+#define RG_LT           1
+#define RG_RT           2
+
+/* an operation handed over */
+struct _rgop {
+    int op;             /* RG_FOO */
+    float arg;
+};
+typedef struct _rgop RgOp;
+
+/* runs an operation taken from the ring */
+typedef void (*RgStage)(void *data, int op, float arg);
+
+/* a single producer, single consumer ring, with the consumer on a thread
+   of its own running stage on each operation in turn. head is only
+   written by the producer and tail only by the consumer, each published
+   with a release store, so neither takes a lock. the producer waits while
+   the ring is full */
+struct _ring {
+    RgOp ops[RG_SIZE];
+    unsigned long head;         /* operations put in */
+    char pad1[64];              /* keeps head and tail on lines of their own */
+    unsigned long tail;         /* operations run */
+    char pad2[64];
+    unsigned long free_to;      /* head may go up to here, as last seen by the producer */
+    int stop;                   /* set once nothing more is coming */
+    RgStage stage;
+    void *data;
+    pthread_t thread;
+};
+typedef struct _ring * Ring;
+
+/* Ring handling */
+Ring rg_new(RgStage stage, void *data);
+void rg_free(Ring rg);
+
+/* Producing */
+void rg_push(Ring rg, int op, float arg);
+void rg_sync(Ring rg);
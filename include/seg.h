@@ -0,0 +1,52 @@
+/*
+ *  seg.h
+ *  Backend for writing binary segment files
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include "segfile.h" /* the format */
+
+#define SEG_START_X     200     /* where the turtle starts, as in postscript */
+#define SEG_START_Y     200
+#define SEG_TO_RADS     (3.14159265358979323846 / 180)
+#define SEG_FULL_CIRCLE 360.0
+
+/* the seg backend. the turtle is followed and each point it reaches is
+   rounded to hundredths of a point, as the postscript is, so that nothing
+   drifts. each segment is written as a record of the block being filled,
+   and the block is written out once it is full or the page ends. where
+   each block went is kept for the index at the end of the file */
+struct _backend {
+    unsigned char *records; /* of the block being filled */
+    size_t len;             /* bytes in records */
+    long block_segs;        /* segments in the block */
+    long long bx, by;       /* where its first segment starts, in units */
+    long first_line;        /* source line of its first segment */
+    long line;              /* source line of the last segment */
+    long long qx, qy;       /* where the turtle is, in units */
+    double x, y, h;         /* turtle pose from where it starts, h in degrees */
+    long page;              /* pages finished */
+    SfEntry *index;         /* blocks written */
+    long num_blocks;
+    long max_blocks;
+    long long num_segs;     /* segments in the file */
+    long long segments;     /* segments in all the files */
+    long long bytes;        /* bytes of all the files */
+    int files;              /* files written */
+};
+
+/* Backend handling */
+int seg_backend(Logo input, Options *opts);
+void seg_free(Backend backend);
+void seg_report(Logo input);
+
+/* Seg interpretation */
+void seg_header(Logo input, char *in_filename);
+void seg_footer(Logo input);
+void seg_trailer(Logo input);
+void seg_ipt_fd(Logo input, float op);
+void seg_ipt_lt(Logo input, float op);
+void seg_ipt_rt(Logo input, float op);
@@ -0,0 +1,91 @@
+/*
+ *  segfile.h
+ *  Binary segment files, and reading them back
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <stdio.h>
+
+#define SF_MAGIC        "LOGOSEG1"  /* first bytes of a segment file */
+#define SF_VERSION      1
+#define SF_HEADER_SIZE  32
+#define SF_BLOCK_MAGIC  "SBLK"
+#define SF_BLOCK_HEADER 40
+#define SF_INDEX_MAGIC  "SIDX"
+#define SF_INDEX_ENTRY  16
+#define SF_END_MAGIC    "SEGINDEX"  /* last bytes of a finished file */
+#define SF_TRAILER_SIZE 16
+#define SF_UNITS        100     /* units in a point, as the postscript is rounded */
+#define SF_BLOCK_SEGS   4096    /* segments in a full block */
+#define SF_MAX_VARINT   10      /* bytes in the longest varint */
+#define SF_MAX_RECORD   (3 * SF_MAX_VARINT)
+#define SF_MAX_COORD    1e15    /* units either side of the corner a point is held to */
+#define SF_MIN_BLOCKS   64      /* blocks in a new index */
+
+/* a segment file is little endian throughout.
+
+   header       "LOGOSEG1", u16 version, u16 flags (0), u32 units in a point,
+                i32 x and y where the turtle starts, u32 segments in a full
+                block, u32 reserved (0)
+   blocks       each a header then its records. the header is "SBLK", u32
+                bytes of records, u32 segments, u32 page, u32 source line of
+                the first segment, u32 crc32 of the header without it and of
+                the records, then i64 x and y of where the first segment
+                starts. a record is three zigzag varints: the change in
+                source line from the segment before, then the change in x
+                and in y from its start to its end, in units
+   index        "SIDX", u32 blocks, then for each block u64 offset in the
+                file and u64 segments before it
+   trailer      u64 offset of the index, "SEGINDEX"
+
+   segments follow on from each other within a block, which starts from
+   absolute coordinates, so any block can be decoded on its own. the index
+   and trailer are written last, so a file cut short, or still being
+   written, can still be read up to its last whole block */
+
+/* a segment read back, in points from the corner of the page */
+struct _sfseg {
+    double x0, y0;
+    double x1, y1;
+    long line;          /* source line of the FD that drew it */
+};
+typedef struct _sfseg SfSeg;
+
+/* where a block is in the file */
+struct _sfentry {
+    long long offset;
+    long long first_seg;    /* segments in the blocks before it */
+};
+typedef struct _sfentry SfEntry;
+
+/* a segment file open for reading */
+struct _segreader {
+    FILE *fp;
+    long units;             /* in a point */
+    long block_segs;        /* segments in a full block */
+    SfEntry *index;
+    long num_blocks;
+    long long num_segs;     /* in all the blocks */
+    int finished;           /* the index was read from the end of the file */
+    unsigned char *records; /* of the block being decoded */
+    size_t max_records;
+};
+typedef struct _segreader * SegReader;
+
+/* Encoding */
+unsigned long long sf_zigzag(long long v);
+long long sf_unzigzag(unsigned long long u);
+size_t sf_put_varint(unsigned char *p, unsigned long long v);
+void sf_put_u32(unsigned char *p, unsigned long v);
+void sf_put_u64(unsigned char *p, unsigned long long v);
+unsigned long sf_get_u32(const unsigned char *p);
+unsigned long long sf_get_u64(const unsigned char *p);
+unsigned long sf_block_crc(const unsigned char *header, const unsigned char *records, size_t n);
+
+/* Reading */
+SegReader sf_open(const char *filename);
+void sf_close(SegReader sr);
+long sf_read_block(SegReader sr, long n, SfSeg *segs, long *page);
@@ -0,0 +1,37 @@
+/*
+ *  simplify.h
+ *  Streaming polyline simplification
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define SP_WINDOW       4096    /* points simplified at a time */
+
+/* receives each vertex kept, after the first of a polyline */
+typedef void (*PointSink)(void *data, double x, double y);
+
+/* a polyline being simplified. points are collected in a window, which is
+   simplified with Douglas-Peucker when full and starts again from the last
+   vertex kept, so memory does not grow with the polyline */
+struct _simplify {
+    double tol;         /* largest distance of a dropped point from the line */
+    double *xs;
+    double *ys;
+    char *keep;         /* set for points to keep in the window */
+    int *stack;         /* ranges still to look at */
+    int n;              /* points in the window */
+    long in;            /* vertices given */
+    long out;           /* vertices kept */
+    PointSink sink;
+    void *data;         /* passed to sink */
+};
+typedef struct _simplify * Simplify;
+
+/* Simplifying */
+Simplify sp_new(double tol, PointSink sink, void *data);
+void sp_start(Simplify sp, double x, double y);
+void sp_add(Simplify sp, double x, double y);
+void sp_end(Simplify sp);
+void sp_free(Simplify sp);
@@ -0,0 +1,96 @@
+/*
+ *  svg.h
+ *  Backend for generating SVG output
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define SVG_WIDTH       612     /* a letter page, as the postscript is shown */
+#define SVG_HEIGHT      792
+#define SVG_START_X     200     /* where the turtle starts, as in postscript */
+#define SVG_START_Y     200
+#define SVG_MAX_LOOPS   256     /* loops nested deeper are not instanced */
+#define SVG_MIN_DEFS    16      /* definitions in a new table */
+#define SVG_MIN_BODY    4       /* FD in a body worth a definition, a loop
+                                   inside counting as enough on its own */
+#define SVG_FAR         1e15    /* points this far are not rounded into hundredths */
+#define SVG_TO_RADS     (3.14159265358979323846 / 180)
+#define SVG_FULL_CIRCLE 360.0
+
+/* what a loop body uses, worked out once per body from its lines */
+struct _svgbody {
+    int known;          /* set once worked out */
+    int invariant;      /* draws the same on every iteration */
+    long vars;          /* bit per variable it reads from outside itself */
+    int size;           /* FD in it, up to SVG_MIN_BODY for a loop */
+};
+typedef struct _svgbody SvgBody;
+
+/* a loop body written in <defs>, for the values of the variables it reads */
+struct _svgdef {
+    int pos;            /* first line of the body */
+    float vals[VARARY_SIZE];
+};
+typedef struct _svgdef SvgDef;
+
+/* a loop being run */
+struct _svgloop {
+    int inst;           /* iterations are drawn by <use> of a definition */
+    int def;            /* index of the definition */
+    int fresh;          /* the definition is still to be written */
+    int recording;      /* the iteration is being written into the definition */
+    long iter;          /* iterations started */
+    double x, y, h;     /* pose at the start of the iteration */
+};
+typedef struct _svgloop SvgLoop;
+
+/* a coordinate frame, in page coordinates, that a definition is written in */
+struct _svgframe {
+    double x, y, h;
+};
+typedef struct _svgframe SvgFrame;
+
+/* the svg backend. the turtle is followed and what it draws is written as
+   relative path data, in the frame of the definition being written. a loop
+   body that draws the same on every iteration, because it reads no
+   variable that changes inside the loop, is written into <defs> on its
+   first iteration and every iteration is then drawn by a <use> of it. the
+   body still runs, to move the turtle, but writes nothing */
+struct _backend {
+    SvgBody *bodies;    /* by first line of the body */
+    SvgDef *defs;
+    int num_defs;
+    int max_defs;
+    SvgLoop loops[SVG_MAX_LOOPS];
+    SvgFrame frames[SVG_MAX_LOOPS + 1];
+    int depth;          /* loops being run */
+    int num_frames;     /* frames[0] is the page */
+    int hidden;         /* depth of the loop drawn by <use>, 0 if none */
+    double x, y, h;     /* turtle pose from where it starts, h in degrees */
+    int in_path;        /* a <path> is open */
+    long long cur_x;    /* last point of the path in the frame, in hundredths */
+    long long cur_y;
+    int far;            /* the last point was too far for cur_x and cur_y */
+    char cmd;           /* the path command the numbers written go to */
+    int sep;            /* a number written last, so the next needs a space */
+    long segments;      /* segments written */
+    long uses;          /* <use> written */
+};
+
+/* Backend handling */
+int svg_backend(Logo input, Options *opts);
+void svg_free(Backend backend);
+void svg_report(Logo input);
+
+/* SVG interpretation */
+void svg_header(Logo input, char *in_filename);
+void svg_footer(Logo input);
+void svg_trailer(Logo input);
+void svg_loop(Logo input, int pos);
+void svg_iteration(Logo input);
+void svg_loop_end(Logo input);
+void svg_ipt_fd(Logo input, float op);
+void svg_ipt_lt(Logo input, float op);
+void svg_ipt_rt(Logo input, float op);
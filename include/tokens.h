@@ -0,0 +1,31 @@
+/*
+ *  tokens.h
+ *  Free-form tokenising of LOGO programs
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define TOK_LINE_LENGTH 128     /* must match LINE_LENGTH in parser.h and interpreter.h */
+#define TOK_TOO_LONG    -2      /* an instruction does not fit in a line */
+
+/* reads a program one instruction at a time, see tok_next() */
+struct _tokreader {
+    const char *p;          /* where reading carries on */
+    const char *end;
+    int line;               /* line number p is on */
+    int tail;               /* 1 if the last line has no newline */
+    int quiet;              /* 1 to leave reporting errors to the caller */
+    const char *inst;       /* the instruction read, in the input or in text */
+    int len;
+    int first;              /* line number the instruction starts on */
+    char text[TOK_LINE_LENGTH];
+};
+typedef struct _tokreader TokReader;
+
+/* Tokenising */
+void tok_start(TokReader *r, const char *buf, size_t size);
+int tok_next(TokReader *r);
+char * tok_normalise(const char *buf, size_t size, size_t *out_size,
+                     int **line_nums, int *num_lines);
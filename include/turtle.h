@@ -0,0 +1,57 @@
+/*
+ *  turtle.h
+ *  Runs a program a few segments at a time, for whoever wants them
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define TT_START_X      200     /* where the turtle starts, as in postscript */
+#define TT_START_Y      200
+#define TT_TO_RADS      (3.14159265358979323846 / 180)
+#define TT_FULL_CIRCLE  360.0
+#define TT_FRAMES       8       /* initial number of DO frames */
+#define TT_MAX_STEPS    100000  /* lines run by a turtle_next() that draws nothing */
+
+/* a segment drawn by FD, in page coordinates, with the input file line of
+   the FD that drew it */
+struct _ttseg {
+    double x0, y0, x1, y1;
+    long line;
+};
+typedef struct _ttseg TurtleSeg;
+
+/* a DO being run. pos is the first line of its body, and loop the value
+   its <VAR> has on this time round */
+struct _ttframe {
+    char var[VAR_LENGTH+1];
+    int loop;
+    float to;
+    int step;           /* 1 counting up, -1 counting down */
+    int pos;
+};
+typedef struct _ttframe TtFrame;
+
+/* a program suspended between two calls of turtle_next(). where the
+   parser of interpreter.c recurses into each DO, the loops being run are
+   kept here as a stack of frames, so the program can stop after any line
+   and carry on from it later. input->counter is the next line to run */
+struct _turtle {
+    Logo input;
+    TtFrame *frames;
+    int num_frames;
+    int max_frames;
+    double x, y, h;     /* turtle pose from where it starts, h in degrees */
+    int done;           /* the closing bracket of the program has been run */
+    int error;          /* error code it stopped on, or 0 */
+};
+typedef struct _turtle * TurtleCtx;
+
+/* Turtle handling */
+TurtleCtx turtle_new(Logo input);
+void turtle_free(TurtleCtx ctx);
+
+/* Running */
+int turtle_next(TurtleCtx ctx, TurtleSeg *buf, int max);
+int turtle_done(TurtleCtx ctx);
@@ -1,6 +1,6 @@
 #!/bin/bash
 
-tests=("test_parser" "test_interpreter" "test_psr_malloc" "test_int_malloc")
+tests=("test_parser" "test_interpreter" "test_psr_malloc" "test_int_malloc" "test_svg" "test_pdf" "test_raster" "test_plot" "test_seg" "test_turtle" "test_estimate")
 quit=0
 
 echo "Options: -v   verbose with error messages"
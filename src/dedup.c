@@ -0,0 +1,180 @@
+/*
+ *  dedup.c
+ *  Spotting segments that have already been drawn
+ *
+ *  Segments are given with their endpoints already rounded to the output
+ *  precision, so the same edge drawn twice has exactly the same numbers.
+ *  A segment and its reverse are the same, so the endpoints are put in
+ *  order before hashing.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dedup.h"
+
+#define SLOT_BYTES      (sizeof(Segment) + 1)
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Mixes the bits of a double into h
+ */
+static unsigned long long mix(unsigned long long h, double d) {
+    unsigned long long bits;
+    d = d + 0.0;    /* -0.0 is 0.0 */
+    memcpy(&bits, &d, sizeof(bits));
+    h = (h ^ bits) * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+}
+
+/**
+ *  Returns the slot of seg in the table, or of the empty slot where it
+ *  would go
+ */
+static size_t find_slot(Dedup dd, Segment *seg) {
+    unsigned long long h = 0;
+    size_t i;
+    h = mix(h, seg->x0);
+    h = mix(h, seg->y0);
+    h = mix(h, seg->x1);
+    h = mix(h, seg->y1);
+    i = h & (dd->num_slots - 1);
+    while (dd->used[i] && memcmp(&dd->segs[i], seg, sizeof(*seg)) != 0) {
+        i = (i + 1) & (dd->num_slots - 1);
+    }
+    return i;
+}
+
+/**
+ *  Allocates an empty table of n slots. Returns -1 when out of memory.
+ */
+static int alloc_slots(Dedup dd, size_t n) {
+    dd->segs = (Segment *) malloc (n * sizeof(Segment));
+    dd->used = (char *) calloc (n, 1);
+    if (dd->segs == NULL || dd->used == NULL) {
+        free(dd->segs);
+        free(dd->used);
+        return -1;
+    }
+    dd->num_slots = n;
+    return 0;
+}
+
+/**
+ *  Doubles the table. Returns -1 if it may not grow or is out of memory,
+ *  leaving the table as it was.
+ */
+static int grow(Dedup dd) {
+    Segment *segs = dd->segs;
+    char *used = dd->used;
+    size_t n = dd->num_slots, i, j;
+    if (n * 2 > dd->max_slots || alloc_slots(dd, n * 2) < 0) {
+        dd->segs = segs;
+        dd->used = used;
+        return -1;
+    }
+    for (i=0; i<n; i++) {
+        if (used[i]) {
+            j = find_slot(dd, &segs[i]);
+            dd->segs[j] = segs[i];
+            dd->used[j] = 1;
+        }
+    }
+    free(segs);
+    free(used);
+    return 0;
+}
+
+/********************************************
+ Table Handling
+ ********************************************/
+
+/**
+ *  Creates an empty table that will not grow beyond max_bytes. Returns NULL
+ *  when out of memory.
+ */
+Dedup dd_new(size_t max_bytes) {
+    Dedup dd = (Dedup) malloc (sizeof(*dd));
+    if (dd == NULL) {
+        return NULL;
+    }
+    if (alloc_slots(dd, DD_MIN_SLOTS) < 0) {
+        free(dd);
+        return NULL;
+    }
+    dd->max_slots = DD_MIN_SLOTS;
+    while (dd->max_slots * 2 * SLOT_BYTES <= max_bytes) {
+        dd->max_slots = dd->max_slots * 2;
+    }
+    dd->count = 0;
+    dd->checked = 0;
+    dd->dropped = 0;
+    dd->full = 0;
+    return dd;
+}
+
+/**
+ *  Empties the table, for a new page. It keeps its size.
+ */
+void dd_clear(Dedup dd) {
+    memset(dd->used, 0, dd->num_slots);
+    dd->count = 0;
+}
+
+/**
+ *  Frees the table
+ */
+void dd_free(Dedup dd) {
+    free(dd->segs);
+    free(dd->used);
+    free(dd);
+}
+
+/********************************************
+ Lookup
+ ********************************************/
+
+/**
+ *  Returns 1 if the segment between the two points, either way round, is
+ *  in the table. Otherwise adds it if there is room and returns 0.
+ */
+int dd_seen(Dedup dd, double x0, double y0, double x1, double y1) {
+    Segment seg;
+    size_t i;
+    if (x0 < x1 || (x0 == x1 && y0 <= y1)) {
+        seg.x0 = x0 + 0.0;
+        seg.y0 = y0 + 0.0;
+        seg.x1 = x1 + 0.0;
+        seg.y1 = y1 + 0.0;
+    } else {
+        seg.x0 = x1 + 0.0;
+        seg.y0 = y1 + 0.0;
+        seg.x1 = x0 + 0.0;
+        seg.y1 = y0 + 0.0;
+    }
+    dd->checked = dd->checked + 1;
+    i = find_slot(dd, &seg);
+    if (dd->used[i]) {
+        dd->dropped = dd->dropped + 1;
+        return 1;
+    }
+    /* keep at most half full, so that probes stay short */
+    if ((dd->count + 1) * 2 > dd->num_slots) {
+        if (grow(dd) < 0) {
+            dd->full = 1;
+            return 0;
+        }
+        i = find_slot(dd, &seg);
+    }
+    dd->segs[i] = seg;
+    dd->used[i] = 1;
+    dd->count = dd->count + 1;
+    return 0;
+}
@@ -0,0 +1,504 @@
+/*
+ *  dfa.c
+ *  Table driven validator for the parse tool
+ *
+ *  The input is read an instruction at a time with tok_next(), and each
+ *  instruction is checked by a byte level state machine that recognises the
+ *  tokens of the BNF while a brace depth counter checks the "{" and "}"
+ *  structure. An instruction written on one line with single spaces is
+ *  checked where it is in the input, so nothing is allocated or copied for
+ *  a program laid out as usual.
+ *
+ *  The input is split into chunks as mt_scan() splits it, and each chunk
+ *  checked on a thread of its own, keeping only whether it is good and how
+ *  it changes the depth. A sequential pass then stitches the chunks
+ *  together in order. From the first chunk that cannot be trusted, holds
+ *  an error or takes the depth to 0, the rest of the input is checked again
+ *  on the calling thread, which finds and reports the first error with
+ *  exactly the same messages as the functions in parser.c.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "errors.h"   /* error codes */
+#include "linescan.h" /* for trimming lines */
+#include "mtscan.h"   /* for checking chunks in parallel */
+#include "tokens.h"   /* for reading free-form programs */
+#include "dfa.h"
+
+/* character classes */
+enum {
+    CC_WS, CC_DIGIT, CC_MINUS, CC_DOT, CC_OP, CC_SEMI, CC_COLON, CC_EQ,
+    CC_LBRACE, CC_RBRACE, CC_D, CC_E, CC_F, CC_L, CC_M, CC_O, CC_R, CC_S,
+    CC_T, CC_UPPER, CC_OTHER, CC_COUNT
+};
+
+/* token states, named after what has been read so far */
+enum {
+    TS_START, TS_OTHER, TS_NUM, TS_MINUS, TS_OP, TS_SEMI, TS_COLON, TS_ASSIGN,
+    TS_LBRACE, TS_LBRACE_X, TS_RBRACE, TS_UPPER, TS_F, TS_FD, TS_FR, TS_FRO,
+    TS_FROM, TS_L, TS_LT, TS_R, TS_RT, TS_D, TS_DO, TS_S, TS_SE, TS_SET,
+    TS_SETX, TS_T, TS_TO, TS_COUNT
+};
+
+/* token kinds, what a token is when it ends in a state */
+enum {
+    K_EMPTY, K_OTHER, K_NUM, K_MINUS, K_OP, K_SEMI, K_ASSIGN, K_LBRACE,
+    K_LBRACE_X, K_RBRACE, K_VAR, K_FD, K_LT, K_RT, K_DO, K_SET, K_SETX,
+    K_FROM, K_TO
+};
+
+static const unsigned char accept[TS_COUNT] = {
+    K_EMPTY, K_OTHER, K_NUM, K_MINUS, K_OP, K_SEMI, K_OTHER, K_ASSIGN,
+    K_LBRACE, K_LBRACE_X, K_RBRACE, K_VAR, K_VAR, K_FD, K_OTHER, K_OTHER,
+    K_FROM, K_VAR, K_LT, K_VAR, K_RT, K_VAR, K_DO, K_VAR, K_OTHER, K_SET,
+    K_SETX, K_VAR, K_TO
+};
+
+/* messages for each DFA_E_FOO, see parser.c */
+static const char *messages[] = {
+    NULL,
+    "Error: expected <INSTRUCTION> but got '%.*s' on line %d\n",
+    "Error: expected <INSTRUCTION> <VARNUM> but got '%.*s' on line %d\n",
+    "Error: expected number or a <VAR> but got '%.*s' on line %d\n",
+    "Error: expected DO <VAR> FROM <VARNUM> TO <VARNUM> { but got '%.*s' on line %d\n",
+    "Error: incorrect <VAR> '%.*s' on line %d\n",
+    "Error: expected SET <VAR> := <POLISH> but got '%.*s' on line %d\n",
+    "Error: expected ; to end <POLISH> but got '%.*s' on line %d\n"
+};
+
+#define MSG_LENGTH      256     /* an error message with an instruction in it */
+
+/* a <VARNUM> is a <VAR> or anything made of [-0-9.] */
+#define is_varnum(K)    ((K) == K_VAR || (K) == K_NUM || (K) == K_MINUS)
+
+static unsigned char cc_main[256];      /* classes for sscanf() style tokens */
+static unsigned char cc_polish[256];    /* classes for <POLISH> tokens */
+static unsigned char trans[TS_COUNT][CC_COUNT];
+static int ready = 0;
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Runs the token state machine from p up to the next whitespace, as given
+ *  by the class table cc. Returns the end of the token, and its kind in *kind.
+ */
+static const char * lex(const char *p, const char *end, const unsigned char *cc, int *kind) {
+    int state = TS_START, c;
+    while (p < end && (c = cc[(unsigned char) *p]) != CC_WS) {
+        state = trans[state][c];
+        p = p + 1;
+    }
+    *kind = accept[state];
+    return p;
+}
+
+/**
+ *  Skips whitespace
+ */
+static const char * skip_space(const char *p, const char *end) {
+    while (p < end && cc_main[(unsigned char) *p] == CC_WS) {
+        p = p + 1;
+    }
+    return p;
+}
+
+/**
+ *  Records an error and returns CLS_BAD
+ */
+static int bad(DfaError *err, int kind, const char *tok, int tok_len) {
+    err->kind = kind;
+    err->tok = tok;
+    err->tok_len = tok_len;
+    return CLS_BAD;
+}
+
+/**
+ *  Checks a <POLISH> expression the way polish() in parser.c does, ie. tokens
+ *  are separated by single spaces and the expression ends with a lone ";"
+ */
+static int dfa_polish(const char *p, const char *end, DfaError *err) {
+    const char *tok;
+    int kind;
+    while (!(end - p == 1 && *p == ';')) {
+        tok = p;
+        p = lex(p, end, cc_polish, &kind);
+        if (kind != K_EMPTY && kind != K_OP && !is_varnum(kind)) {
+            return bad(err, DFA_E_VARNUM, tok, p - tok);
+        }
+        if (p == end) {
+            return bad(err, DFA_E_POLISH, NULL, 0);
+        }
+        /* skip the space */
+        p = p + 1;
+    }
+    return CLS_INST;
+}
+
+/**
+ *  Keeps the error message in msg, to be printed once the rest of the input
+ *  has been read. Returns PARSE_ERR
+ */
+static int keep(char *msg, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg, MSG_LENGTH, format, args);
+    va_end(args);
+    return PARSE_ERR;
+}
+
+/**
+ *  Keeps the error on the instruction just read, of class cls, in msg.
+ *  Returns PARSE_ERR
+ */
+static int report(const TokReader *r, int cls, DfaError *err, char *msg) {
+    if (cls != CLS_BAD) {
+        /* a stray "{", which is not an <INSTRUCTION> */
+        err->kind = DFA_E_INST;
+        err->tok = NULL;
+    }
+    if (err->tok == NULL) {
+        return keep(msg, messages[err->kind], r->len, r->inst, r->first);
+    }
+    return keep(msg, messages[err->kind], err->tok_len, err->tok, r->first);
+}
+
+/**
+ *  Checks the instructions read by r and their "{" and "}" structure, from
+ *  the given depth, keeping the first error in msg. A depth of 0 is before
+ *  <MAIN>. Returns 0 on success, PARSE_ERR on error, or TOK_TOO_LONG if an
+ *  instruction is too long for a line.
+ */
+static int check(TokReader *r, int depth, char *msg) {
+    DfaError err;
+    int cls, ret = 0;
+    /* <MAIN> ::= "{" <INSTRCTLST> */
+    if (depth == 0) {
+        if ((ret = tok_next(r)) < 0) {
+            return ret;
+        } else if (ret == 0 || dfa_line(r->inst, r->inst + r->len, &err) != CLS_OPEN) {
+            return keep(msg, "Error: expected '{' but got '%.*s' on line %d\n", r->len, r->inst, r->first);
+        }
+        depth = 1;
+    }
+    while (depth > 0 && (ret = tok_next(r)) > 0) {
+        switch (cls = dfa_line(r->inst, r->inst + r->len, &err)) {
+            case CLS_CLOSE:
+                depth = depth - 1;
+                break;
+            case CLS_BLOCK:
+                depth = depth + 1;
+                break;
+            case CLS_INST:
+                break;
+            default:
+                return report(r, cls, &err, msg);
+        }
+    }
+    if (ret < 0) {
+        return ret;
+    } else if (depth > 0) {
+        /* the empty line at the end is not an <INSTRUCTION> either */
+        return keep(msg, messages[DFA_E_INST], 0, "", r->first);
+    }
+    /* everything after the closing bracket must be empty */
+    if ((ret = tok_next(r)) > 0) {
+        return keep(msg, "Error: %.*s found after closing bracket on line %d\n", r->len, r->inst, r->first);
+    }
+    return ret;
+}
+
+/**
+ *  Thread function checking the instructions starting in a chunk, without
+ *  reporting anything
+ */
+static void * check_chunk(void *arg) {
+    DfaChunk *chunk = (DfaChunk *) arg;
+    DfaError err;
+    TokReader r;
+    int cls;
+    tok_start(&r, chunk->start, chunk->limit - chunk->start);
+    r.quiet = 1;
+    chunk->newlines = mt_count_lines(chunk->start, chunk->end);
+    while (!chunk->bad && ls_skip_space(r.p, r.end) < chunk->end) {
+        if (tok_next(&r) < 0) {
+            chunk->bad = 1;
+            break;
+        }
+        cls = dfa_line(r.inst, r.inst + r.len, &err);
+        if (chunk->main) {
+            /* <MAIN> ::= "{" <INSTRCTLST> */
+            chunk->main = 0;
+            chunk->bad = (cls != CLS_OPEN);
+            chunk->depth = 1;
+            chunk->low = 1;
+            continue;
+        }
+        if (cls == CLS_CLOSE) {
+            chunk->depth = chunk->depth - 1;
+        } else if (cls == CLS_BLOCK) {
+            chunk->depth = chunk->depth + 1;
+        } else if (cls != CLS_INST) {
+            chunk->bad = 1;
+        }
+        if (chunk->depth < chunk->low) {
+            chunk->low = chunk->depth;
+        }
+    }
+    /* a chunk that should have started <MAIN> but is empty */
+    chunk->bad = chunk->bad || chunk->main;
+    chunk->stop = r.p;
+    chunk->stop_line = r.line - 1;
+    return NULL;
+}
+
+/********************************************
+ Validation
+ ********************************************/
+
+/**
+ *  Builds the character class and transition tables. Must be called before
+ *  dfa_line() is used.
+ */
+void dfa_init(void) {
+    const char *upper = "ABCGHIJKNPQUVWXYZ";
+    int i, j;
+    if (ready) {
+        return;
+    }
+    /* character classes */
+    for (i=0; i<256; i++) {
+        cc_main[i] = CC_OTHER;
+    }
+    for (i='0'; i<='9'; i++) {
+        cc_main[i] = CC_DIGIT;
+    }
+    for (i=0; upper[i] != '\0'; i++) {
+        cc_main[(unsigned char) upper[i]] = CC_UPPER;
+    }
+    cc_main['-'] = CC_MINUS;
+    cc_main['.'] = CC_DOT;
+    cc_main['+'] = CC_OP;
+    cc_main['*'] = CC_OP;
+    cc_main['/'] = CC_OP;
+    cc_main[';'] = CC_SEMI;
+    cc_main[':'] = CC_COLON;
+    cc_main['='] = CC_EQ;
+    cc_main['{'] = CC_LBRACE;
+    cc_main['}'] = CC_RBRACE;
+    cc_main['D'] = CC_D;
+    cc_main['E'] = CC_E;
+    cc_main['F'] = CC_F;
+    cc_main['L'] = CC_L;
+    cc_main['M'] = CC_M;
+    cc_main['O'] = CC_O;
+    cc_main['R'] = CC_R;
+    cc_main['S'] = CC_S;
+    cc_main['T'] = CC_T;
+    /* <POLISH> tokens are only separated by spaces, anything else is junk */
+    memcpy(cc_polish, cc_main, sizeof(cc_main));
+    for (i=0; i<256; i++) {
+        if (isspace(i)) {
+            cc_main[i] = CC_WS;
+            cc_polish[i] = CC_OTHER;
+        }
+    }
+    cc_polish[' '] = CC_WS;
+
+    /* anything unexpected is junk */
+    for (i=0; i<TS_COUNT; i++) {
+        for (j=0; j<CC_COUNT; j++) {
+            trans[i][j] = TS_OTHER;
+        }
+    }
+    trans[TS_START][CC_DIGIT] = TS_NUM;
+    trans[TS_START][CC_DOT] = TS_NUM;
+    trans[TS_START][CC_MINUS] = TS_MINUS;
+    trans[TS_START][CC_OP] = TS_OP;
+    trans[TS_START][CC_SEMI] = TS_SEMI;
+    trans[TS_START][CC_COLON] = TS_COLON;
+    trans[TS_START][CC_LBRACE] = TS_LBRACE;
+    trans[TS_START][CC_RBRACE] = TS_RBRACE;
+    trans[TS_START][CC_UPPER] = TS_UPPER;
+    trans[TS_START][CC_E] = TS_UPPER;
+    trans[TS_START][CC_M] = TS_UPPER;
+    trans[TS_START][CC_O] = TS_UPPER;
+    trans[TS_START][CC_D] = TS_D;
+    trans[TS_START][CC_F] = TS_F;
+    trans[TS_START][CC_L] = TS_L;
+    trans[TS_START][CC_R] = TS_R;
+    trans[TS_START][CC_S] = TS_S;
+    trans[TS_START][CC_T] = TS_T;
+    /* numbers */
+    trans[TS_NUM][CC_DIGIT] = TS_NUM;
+    trans[TS_NUM][CC_DOT] = TS_NUM;
+    trans[TS_NUM][CC_MINUS] = TS_NUM;
+    trans[TS_MINUS][CC_DIGIT] = TS_NUM;
+    trans[TS_MINUS][CC_DOT] = TS_NUM;
+    trans[TS_MINUS][CC_MINUS] = TS_NUM;
+    /* := */
+    trans[TS_COLON][CC_EQ] = TS_ASSIGN;
+    /* keywords */
+    trans[TS_F][CC_D] = TS_FD;
+    trans[TS_F][CC_R] = TS_FR;
+    trans[TS_FR][CC_O] = TS_FRO;
+    trans[TS_FRO][CC_M] = TS_FROM;
+    trans[TS_L][CC_T] = TS_LT;
+    trans[TS_R][CC_T] = TS_RT;
+    trans[TS_D][CC_O] = TS_DO;
+    trans[TS_S][CC_E] = TS_SE;
+    trans[TS_SE][CC_T] = TS_SET;
+    trans[TS_T][CC_O] = TS_TO;
+    for (j=0; j<CC_COUNT; j++) {
+        /* "{" followed by anything still opens a DO block */
+        trans[TS_LBRACE][j] = TS_LBRACE_X;
+        trans[TS_LBRACE_X][j] = TS_LBRACE_X;
+        /* instruction() only looks at the first 3 chars for SET */
+        trans[TS_SET][j] = TS_SETX;
+        trans[TS_SETX][j] = TS_SETX;
+    }
+    ready = 1;
+}
+
+/**
+ *  Classifies the line [start, end) as one of CLS_FOO without copying it.
+ *  For a CLS_BAD line *err tells what parser.c would have complained about.
+ */
+int dfa_line(const char *start, const char *end, DfaError *err) {
+    const char *tok[6], *p;
+    int kind[6], len[6], n;
+
+    err->kind = 0;
+    err->tok = NULL;
+    err->tok_len = 0;
+    /* trim the line */
+    start = ls_skip_space(start, end);
+    end = ls_trim_end(start, end);
+    if (start == end) {
+        return CLS_EMPTY;
+    } else if (end - start == 1 && *start == '{') {
+        return CLS_OPEN;
+    } else if (end - start == 1 && *start == '}') {
+        return CLS_CLOSE;
+    }
+    /* read up to six tokens, that is all a DO needs before its "{" */
+    p = start;
+    for (n=0; n<6; n++) {
+        p = skip_space(p, end);
+        if (p == end) {
+            break;
+        }
+        tok[n] = p;
+        p = lex(p, end, cc_main, &kind[n]);
+        len[n] = p - tok[n];
+    }
+    switch (kind[0]) {
+        case K_FD:
+        case K_LT:
+        case K_RT:
+            /* <INSTRUCTION> <VARNUM> */
+            if (n < 2) {
+                return bad(err, DFA_E_OPERAND, NULL, 0);
+            } else if (!is_varnum(kind[1])) {
+                return bad(err, DFA_E_VARNUM, tok[1], len[1]);
+            }
+            return CLS_INST;
+        case K_DO:
+            /* DO <VAR> FROM <VARNUM> TO <VARNUM> { */
+            p = skip_space(p, end);
+            if (n < 6 || p == end || *p != '{') {
+                return bad(err, DFA_E_DO, NULL, 0);
+            } else if (kind[1] != K_VAR) {
+                return bad(err, DFA_E_VAR, tok[1], len[1]);
+            } else if (kind[2] != K_FROM || kind[4] != K_TO) {
+                return bad(err, DFA_E_DO, NULL, 0);
+            } else if (!is_varnum(kind[3])) {
+                return bad(err, DFA_E_VARNUM, tok[3], len[3]);
+            } else if (!is_varnum(kind[5])) {
+                return bad(err, DFA_E_VARNUM, tok[5], len[5]);
+            }
+            return CLS_BLOCK;
+        case K_SET:
+        case K_SETX:
+            /* SET <VAR> := <POLISH> */
+            if (n < 4) {
+                return bad(err, DFA_E_SET, NULL, 0);
+            } else if (kind[1] != K_VAR) {
+                return bad(err, DFA_E_VAR, tok[1], len[1]);
+            } else if (kind[0] != K_SET || kind[2] != K_ASSIGN) {
+                return bad(err, DFA_E_SET, NULL, 0);
+            }
+            /* the <POLISH> starts 2 chars after the '=' */
+            return dfa_polish(tok[2] + 3, end, err);
+        default:
+            return bad(err, DFA_E_INST, NULL, 0);
+    }
+}
+
+/**
+ *  Validates a whole input in memory, checking chunks of it on nthreads
+ *  threads. Errors are reported like parse() would, an instruction too long
+ *  for a line anywhere in the input winning over any other error.
+ *  Returns 0 on success, PARSE_ERR on error.
+ */
+int dfa_validate(const char *buf, size_t size, int nthreads) {
+    const char *bounds[MT_MAX_THREADS + 1];
+    DfaChunk chunks[MT_MAX_THREADS];
+    const char *stop = buf;
+    char msg[MSG_LENGTH];
+    TokReader r;
+    int i, n, ret, depth = 0, line = 1, stop_line = 1;
+
+    dfa_init();
+    n = (nthreads > MT_MAX_THREADS) ? MT_MAX_THREADS : (nthreads < 1) ? 1 : nthreads;
+    if (n > 1) {
+        mt_split(buf, size, bounds, n);
+        memset(chunks, 0, sizeof(chunks));
+        for (i=0; i<n; i++) {
+            chunks[i].start = bounds[i];
+            chunks[i].end = bounds[i+1];
+            chunks[i].limit = buf + size;
+        }
+        chunks[0].main = 1;
+        mt_run(chunks, sizeof(DfaChunk), n, check_chunk);
+    }
+
+    /* stitch the chunks that start where the one before ended, are good and
+       leave <MAIN> open. a single chunk is only ever checked once, below */
+    for (i=0; i<n && n > 1; i++) {
+        if (stop > chunks[i].start || chunks[i].bad || depth + chunks[i].low <= 0) {
+            break;
+        }
+        depth = depth + chunks[i].depth;
+        stop = chunks[i].stop;
+        stop_line = line + chunks[i].stop_line;
+        line = line + chunks[i].newlines;
+    }
+    /* and check the rest again, finding the first error */
+    if (n > 1 && i < n && stop <= chunks[i].start) {
+        stop = chunks[i].start;
+        stop_line = line;
+    }
+    tok_start(&r, stop, buf + size - stop);
+    r.line = stop_line;
+    r.tail = (size > 0 && buf[size-1] != '\n') ? 1 : 0;
+    ret = check(&r, depth, msg);
+    if (ret == PARSE_ERR) {
+        /* parse() reads the whole input before checking it */
+        while ((ret = tok_next(&r)) > 0);
+        if (ret == 0) {
+            fputs(msg, stderr);
+        }
+        return PARSE_ERR;
+    }
+    return (ret < 0) ? PARSE_ERR : 0;
+}
@@ -0,0 +1,566 @@
+/*
+ *  estimate.c
+ *  Works out what running a program costs, without running it
+ *
+ *  The program is gone through once, as the parser would, but a DO is
+ *  not gone round. Its body is looked at once, with the loop variable
+ *  and anything set in the body only known as the range of values it can
+ *  take, and what it costs is multiplied by the times the DO goes round.
+ *  Where that leaves the cost exact it is done, so a DO going round a
+ *  hundred million times costs no more to estimate than one going round
+ *  twice. Where it does not, because what the body does depends on the
+ *  loop variable, a DO going round at most EST_UNROLL times is gone
+ *  through one by one, and otherwise the cost is given as a range.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interpreter.h"
+#include "estimate.h"
+
+#define DEBUG_DATA  input->lines[input->counter], line_num(input)
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+static int es_list(Estimate e, Cost *cost);
+
+/**
+ *  Returns the range holding just v
+ */
+static Range exactly(double v) {
+    Range r;
+    r.lo = v;
+    r.hi = v;
+    return r;
+}
+
+/**
+ *  Returns the range of a value with no knowing what it is
+ */
+static Range unknown(void) {
+    Range r;
+    r.lo = -HUGE_VAL;
+    r.hi = HUGE_VAL;
+    return r;
+}
+
+/**
+ *  Returns a times b, for counts where nothing times 0 is anything but 0
+ */
+static double times(double a, double b) {
+    return (a == 0 || b == 0) ? 0 : a * b;
+}
+
+/**
+ *  Sets the cost to nothing
+ */
+static void zero_cost(Cost *cost) {
+    cost->insts = exactly(0);
+    cost->segs = exactly(0);
+    cost->turns = exactly(0);
+}
+
+/**
+ *  Adds n times what c costs to cost
+ */
+static void add_cost(Cost *cost, Cost *c, Range n) {
+    cost->insts.lo = cost->insts.lo + times(n.lo, c->insts.lo);
+    cost->insts.hi = cost->insts.hi + times(n.hi, c->insts.hi);
+    cost->segs.lo = cost->segs.lo + times(n.lo, c->segs.lo);
+    cost->segs.hi = cost->segs.hi + times(n.hi, c->segs.hi);
+    cost->turns.lo = cost->turns.lo + times(n.lo, c->turns.lo);
+    cost->turns.hi = cost->turns.hi + times(n.hi, c->turns.hi);
+}
+
+/**
+ *  Works out a oper b over the ranges a and b, exactly as operate() does
+ *  when both are known. Returns 0 on success, POL_ERR on a division by 0
+ */
+static int operate_range(int oper, Range a, Range b, Range *output) {
+    double p[4];
+    float v;
+    int i;
+    if (a.lo == a.hi && b.lo == b.hi) {
+        if (operate(oper, a.lo, b.lo, &v) < 0) {
+            return POL_ERR;
+        }
+        *output = exactly(v);
+        return 0;
+    }
+    if (oper == '+') {
+        output->lo = a.lo + b.lo;
+        output->hi = a.hi + b.hi;
+    } else if (oper == '-') {
+        output->lo = a.lo - b.hi;
+        output->hi = a.hi - b.lo;
+    } else if (oper == '/' && b.lo <= 0 && b.hi >= 0) {
+        /* it might be a division by 0, which only running it can tell */
+        *output = unknown();
+    } else {
+        p[0] = (oper == '*') ? a.lo * b.lo : a.lo / b.lo;
+        p[1] = (oper == '*') ? a.lo * b.hi : a.lo / b.hi;
+        p[2] = (oper == '*') ? a.hi * b.lo : a.hi / b.lo;
+        p[3] = (oper == '*') ? a.hi * b.hi : a.hi / b.hi;
+        *output = exactly(p[0]);
+        for (i=1; i<4; i++) {
+            output->lo = (p[i] < output->lo) ? p[i] : output->lo;
+            output->hi = (p[i] > output->hi) ? p[i] : output->hi;
+        }
+    }
+    /* infinity take infinity, or 0 times infinity */
+    if (isnan(output->lo) || isnan(output->hi)) {
+        *output = unknown();
+    }
+    return 0;
+}
+
+/**
+ *  Gives the range of the <VARNUM> operand. Returns 0 on success,
+ *  PARSE_ERR or VAR_ERR on error
+ */
+static int es_varnum(Estimate e, char *operand, Range *r) {
+    Logo input = e->input;
+    float op;
+    if (is_var(operand)) {
+        if (!e->used[operand[0] - 'A']) {
+            fprintf(stderr, "Error: unknown variable '%s' on line %d\n", operand, line_num(input));
+            return VAR_ERR;
+        }
+        *r = e->vars[operand[0] - 'A'];
+        return 0;
+    }
+    /* a number, which varnum() checks without looking at the variables */
+    if (varnum(operand, input, &op) < 0) {
+        return PARSE_ERR;
+    }
+    *r = exactly(op);
+    return 0;
+}
+
+/**
+ *  Checks the <VARNUM> of the FD, LT or RT on the current line. Returns 0
+ *  on success, or an error code
+ */
+static int es_move(Estimate e) {
+    Logo input = e->input;
+    char operand[OPERAND_LENGTH+1];
+    Range r;
+    if (sscanf(input->lines[input->counter], "%*s %10s", operand) != 1) {
+        fprintf(stderr, "Error: expected <INSTRUCTION> <VARNUM> but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    return es_varnum(e, operand, &r);
+}
+
+/**
+ *  Gives the range of the <POLISH> starting at po. Returns 0 on success,
+ *  or an error code
+ */
+static int es_polish(Estimate e, char *po, Range *output) {
+    Logo input = e->input;
+    char copy[LINE_LENGTH], *tok;
+    Range stack[EST_STACK];
+    int n = 0, ret;
+    strncpy(copy, po, LINE_LENGTH - 1);
+    copy[LINE_LENGTH - 1] = '\0';
+    for (tok=strtok(copy, " "); tok!=NULL; tok=strtok(NULL, " ")) {
+        if (strsame(tok, ";")) {
+            if (n != 1) {
+                fprintf(stderr, "Error: malformed polish expression '%s' on line %d\n", DEBUG_DATA);
+                return POL_ERR;
+            }
+            *output = stack[0];
+            return 0;
+        }
+        if (is_op(tok)) {
+            if (n < 2) {
+                fprintf(stderr, "Error: malformed polish expression '%s' on line %d\n", DEBUG_DATA);
+                return POL_ERR;
+            }
+            if (operate_range(tok[0], stack[n - 2], stack[n - 1], &stack[n - 2]) < 0) {
+                fprintf(stderr, "Error: division by zero in polish expression '%s' on line %d\n", DEBUG_DATA);
+                return POL_ERR;
+            }
+            n = n - 1;
+        } else if (n == EST_STACK) {
+            fprintf(stderr, "Error: malformed polish expression '%s' on line %d\n", DEBUG_DATA);
+            return POL_ERR;
+        } else if ((ret = es_varnum(e, tok, &stack[n])) < 0) {
+            return ret;
+        } else {
+            n = n + 1;
+        }
+    }
+    fprintf(stderr, "Error: expected ; to end <POLISH> but got '%s' on line %d\n", DEBUG_DATA);
+    return PARSE_ERR;
+}
+
+/**
+ *  Runs the <SET> on the current line on the ranges of the variables.
+ *  Returns 0 on success, or an error code
+ */
+static int es_set(Estimate e) {
+    Logo input = e->input;
+    char inst[OPERAND_LENGTH+1], var[OPERAND_LENGTH+1], equal[OPERAND_LENGTH+1], sink[LINE_LENGTH];
+    Range value;
+    int ret;
+    if (sscanf(input->lines[input->counter], "%10s %10s %10s %127s", inst, var, equal, sink) < 4) {
+        fprintf(stderr, "Error: expected SET <VAR> := <POLISH> but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    if (is_var(var) != 1) {
+        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, line_num(input));
+        return PARSE_ERR;
+    }
+    if (strsame(inst, SET) != 1 || strsame(equal, ":=") != 1) {
+        fprintf(stderr, "Error: expected SET <VAR> := <POLISH> but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    /* the polish starts 2 chars after the '=', as in set() */
+    ret = es_polish(e, input->lines[input->counter] + strcspn(input->lines[input->counter], "=") + 2, &value);
+    if (ret < 0) {
+        return ret;
+    }
+    e->vars[var[0] - 'A'] = value;
+    e->used[var[0] - 'A'] = 1;
+    return 0;
+}
+
+/**
+ *  Gives the range of times a DO from from to to goes round. When both are
+ *  known, *first is the first value of its <VAR> and *step what is added
+ *  to it each time round, counted as dologo() counts
+ */
+static Range es_trips(Range from, Range to, double *first, double *step) {
+    Range trips;
+    double up, down;
+    if (from.lo == from.hi && to.lo == to.hi) {
+        *first = trunc(from.lo);
+        *step = (from.lo < to.lo) ? 1 : -1;
+        up = (*step > 0) ? floor(to.lo) - *first + 1 : *first - ceil(to.lo) + 1;
+        return exactly((up > 0) ? up : 0);
+    }
+    /* the most it can go round counting up, and counting down */
+    up = (from.lo < to.hi) ? floor(to.hi) - trunc(from.lo) + 1 : 0;
+    down = (from.hi >= to.lo) ? trunc(from.hi) - ceil(to.lo) + 1 : 0;
+    trips.hi = (up > down) ? up : down;
+    /* and the least, if it is known which way it counts */
+    if (from.hi < to.lo) {
+        trips.lo = floor(to.lo) - trunc(from.hi) + 1;
+    } else if (from.lo >= to.hi) {
+        trips.lo = trunc(from.lo) - ceil(to.hi) + 1;
+    } else {
+        trips.lo = 0;
+    }
+    trips.lo = (trips.lo > 0) ? trips.lo : 0;
+    trips.hi = (trips.hi > 0) ? trips.hi : 0;
+    if (isnan(trips.lo) || isnan(trips.hi)) {
+        trips.lo = 0;
+        trips.hi = HUGE_VAL;
+    }
+    return trips;
+}
+
+/**
+ *  Makes every variable the body of a DO starting on line pos sets, with
+ *  a SET or a DO of its own, unknown. Returns 1 if one of them is the
+ *  variable v, else 0
+ */
+static int forget_body(Estimate e, int pos, int v) {
+    Logo input = e->input;
+    char inst[INSTRUCT_LENGTH+1], var[OPERAND_LENGTH+1];
+    int i, depth = 0, sets_v = 0;
+    for (i=pos; i<input->num_lines; i++) {
+        if (strsame(input->lines[i], "}")) {
+            if (depth == 0) {
+                return sets_v;
+            }
+            depth = depth - 1;
+        } else if (sscanf(input->lines[i], "%3s %10s", inst, var) == 2 && is_var(var) &&
+                   (strsame(inst, SET) || strsame(inst, DO))) {
+            e->vars[var[0] - 'A'] = unknown();
+            e->used[var[0] - 'A'] = 1;
+            sets_v = sets_v || var[0] - 'A' == v;
+            depth = strsame(inst, DO) ? depth + 1 : depth;
+        }
+    }
+    return sets_v;
+}
+
+/**
+ *  Estimates the DO on the current line, adding what it costs to cost and
+ *  leaving the counter on its closing bracket, or on the line after the DO
+ *  if it never goes round as dologo() does. Returns 0 on success, or an
+ *  error code
+ */
+static int es_do(Estimate e, Cost *cost) {
+    Logo input = e->input;
+    char inst[OPERAND_LENGTH+1], var[OPERAND_LENGTH+1], fromchar[OPERAND_LENGTH+1], tochar[OPERAND_LENGTH+1];
+    char from_str[LINE_LENGTH], to_str[LINE_LENGTH], curly[VAR_LENGTH+1];
+    Range from, to, trips, saved[VARARY_SIZE];
+    int used[VARARY_SIZE], pos, v, known, sets_v, ret;
+    double first = 0, step = 0, k;
+    Cost body;
+    if (sscanf(input->lines[input->counter], "%10s %10s %10s %127s %10s %127s %1[{]",
+               inst, var, fromchar, from_str, tochar, to_str, curly) < 7) {
+        fprintf(stderr, "Error: expected DO <VAR> FROM <VARNUM> TO <VARNUM> { but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    if (is_var(var) != 1) {
+        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, line_num(input));
+        return PARSE_ERR;
+    }
+    if (strsame(inst, DO) != 1 || strsame(fromchar, "FROM") != 1 || strsame(tochar, "TO") != 1) {
+        fprintf(stderr, "Error: expected DO <VAR> FROM <VARNUM> TO <VARNUM> { but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    if ((ret = es_varnum(e, from_str, &from)) < 0 || (ret = es_varnum(e, to_str, &to)) < 0) {
+        return ret;
+    }
+    input->counter = input->counter + 1;
+    if (input->counter > input->num_lines-1) {
+        fprintf(stderr, "Error: expected '}' on line %d\n", line_num(input));
+        return PARSE_ERR;
+    }
+    pos = input->counter;
+    v = var[0] - 'A';
+    trips = es_trips(from, to, &first, &step);
+    known = from.lo == from.hi && to.lo == to.hi;
+    if (trips.hi == 0) {
+        return 0;
+    }
+    memcpy(saved, e->vars, sizeof(saved));
+    memcpy(used, e->used, sizeof(used));
+
+    /* once through, with the loop variable anywhere from from to to */
+    sets_v = forget_body(e, pos, v);
+    e->vars[v].lo = (trunc(from.lo) < to.lo) ? trunc(from.lo) : to.lo;
+    e->vars[v].hi = (trunc(from.hi) > to.hi) ? trunc(from.hi) : to.hi;
+    e->used[v] = 1;
+    zero_cost(&body);
+    if ((ret = es_list(e, &body)) < 0) {
+        return ret;
+    }
+    if (cost_exact(&body) || !known || trips.hi > EST_UNROLL ||
+        e->work + trips.hi * (input->counter - pos + 1) > EST_WORK) {
+        add_cost(cost, &body, trips);
+        /* a body setting the loop variable leaves it as the body did, else
+           it is left at its last value */
+        if (known && !sets_v) {
+            e->vars[v] = exactly(first + (trips.hi - 1) * step);
+        } else if (!known && used[v]) {
+            e->vars[v].lo = (saved[v].lo < e->vars[v].lo) ? saved[v].lo : e->vars[v].lo;
+            e->vars[v].hi = (saved[v].hi > e->vars[v].hi) ? saved[v].hi : e->vars[v].hi;
+        }
+    } else {
+        /* what it does depends on where it is, go round one by one */
+        memcpy(e->vars, saved, sizeof(saved));
+        memcpy(e->used, used, sizeof(used));
+        zero_cost(&body);
+        for (k=0; k<trips.hi; k++) {
+            e->vars[v] = exactly(first + k * step);
+            e->used[v] = 1;
+            input->counter = pos;
+            if ((ret = es_list(e, &body)) < 0) {
+                return ret;
+            }
+        }
+        add_cost(cost, &body, exactly(1));
+    }
+    /* counted once each time round, as a run counts it */
+    cost->insts.lo = cost->insts.lo + trips.lo;
+    cost->insts.hi = cost->insts.hi + trips.hi;
+    return 0;
+}
+
+/**
+ *  Estimates the instruction on the current line, adding what it costs to
+ *  cost. Returns 0 on success, or an error code
+ */
+static int es_instruction(Estimate e, Cost *cost) {
+    Logo input = e->input;
+    char inst[INSTRUCT_LENGTH+1];
+    int ret;
+    if (sscanf(input->lines[input->counter], "%3s", inst) != 1) {
+        fprintf(stderr, "Error: expected <INSTRUCTION> but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    cost->insts.lo = cost->insts.lo + 1;
+    cost->insts.hi = cost->insts.hi + 1;
+    if (strsame(inst, FD)) {
+        ret = es_move(e);
+        cost->segs.lo = cost->segs.lo + 1;
+        cost->segs.hi = cost->segs.hi + 1;
+    } else if (strsame(inst, LT) || strsame(inst, RT)) {
+        ret = es_move(e);
+        cost->turns.lo = cost->turns.lo + 1;
+        cost->turns.hi = cost->turns.hi + 1;
+    } else if (strsame(inst, SET)) {
+        ret = es_set(e);
+    } else if (strsame(inst, DO)) {
+        ret = es_do(e, cost);
+    } else {
+        fprintf(stderr, "Error: expected <INSTRUCTION> but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    return ret;
+}
+
+/**
+ *  Estimates the <INSTRCTLST> from the current line up to its closing
+ *  bracket, as instrctlst() goes through it, adding what it costs to cost.
+ *  Returns 0 on success, or an error code
+ */
+static int es_list(Estimate e, Cost *cost) {
+    Logo input = e->input;
+    int ret;
+    while (strsame(input->lines[input->counter], "}") != 1) {
+        e->work = e->work + 1;
+        if ((ret = es_instruction(e, cost)) < 0) {
+            return ret;
+        }
+        input->counter = input->counter + 1;
+        if (input->counter > input->num_lines-1) {
+            fprintf(stderr, "Error: expected '}' on line %d\n", line_num(input));
+            return PARSE_ERR;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Prints the count as a JSON number, or null if there is no telling
+ */
+static void print_count(FILE *fp, double count) {
+    if (count == HUGE_VAL) {
+        fprintf(fp, "null");
+    } else {
+        fprintf(fp, "%.0f", count);
+    }
+}
+
+/**
+ *  Prints the range as a JSON object
+ */
+static void print_range(FILE *fp, char *name, Range r) {
+    fprintf(fp, "  \"%s\": { \"min\": ", name);
+    print_count(fp, r.lo);
+    fprintf(fp, ", \"max\": ");
+    print_count(fp, r.hi);
+    fprintf(fp, " }");
+}
+
+/********************************************
+ Estimating
+ ********************************************/
+
+/**
+ *  Estimates what running each of the programs of input, from its current
+ *  line, costs in all, as --multi runs them. Returns 0 on success and the
+ *  number of programs in *programs, or the error the program would fail
+ *  on if it is certain to.
+ */
+int estimate(Logo input, Cost *cost, int *programs) {
+    struct _estimate e;
+    int i, ret;
+    e.input = input;
+    e.work = 0;
+    zero_cost(cost);
+    *programs = 0;
+    do {
+        for (i=0; i<VARARY_SIZE; i++) {
+            e.vars[i] = exactly(0);
+            e.used[i] = 0;
+        }
+        if (input->counter > input->num_lines-2 || strsame(input->lines[input->counter], "{") != 1) {
+            fprintf(stderr, "Error: expected '{' but got '%s' on line %d\n", DEBUG_DATA);
+            return PARSE_ERR;
+        }
+        input->counter = input->counter + 1;
+        if ((ret = es_list(&e, cost)) < 0) {
+            return ret;
+        }
+        input->counter = input->counter + 1;
+        *programs = *programs + 1;
+        while (input->counter < input->num_lines && strlen(input->lines[input->counter]) == 0) {
+            input->counter = input->counter + 1;
+        }
+    } while (input->counter < input->num_lines);
+    return 0;
+}
+
+/**
+ *  Returns 1 if the cost is known exactly, else 0
+ */
+int cost_exact(Cost *cost) {
+    return cost->insts.lo == cost->insts.hi &&
+           cost->segs.lo == cost->segs.hi &&
+           cost->turns.lo == cost->turns.hi;
+}
+
+/**
+ *  Prints the estimate as JSON
+ */
+void print_estimate(FILE *fp, char *in_filename, Cost *cost, int programs) {
+    char *c;
+    fprintf(fp, "{\n  \"input\": \"");
+    for (c=in_filename; *c!='\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', fp);
+        }
+        fputc(*c, fp);
+    }
+    fprintf(fp, "\",\n  \"programs\": %d,\n", programs);
+    fprintf(fp, "  \"exact\": %s,\n", cost_exact(cost) ? "true" : "false");
+    print_range(fp, "instructions", cost->insts);
+    fprintf(fp, ",\n");
+    print_range(fp, "segments", cost->segs);
+    fprintf(fp, ",\n");
+    print_range(fp, "turns", cost->turns);
+    fprintf(fp, "\n}\n");
+}
+
+/**
+ *  Prints the estimate of the input file named in argv[1] on stdout, with
+ *  argv[0] the last option as for get_filenames()
+ */
+int estimate_main(int argc, char *argv[]) {
+    FILE *in_file;
+    Logo input;
+    Cost cost;
+    int programs;
+    if (argc != 2) {
+        fprintf(stderr, "Error: Requires one argument.\n");
+        fprintf(stderr, "Usage: interp --estimate <input>\n");
+        return EXIT_FAILURE;
+    }
+    in_file = fopen(argv[1], "r");
+    if (in_file == NULL) {
+        fprintf(stderr, "Error: failed to open %s\n", argv[1]);
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+    input = scan_mt(in_file);
+    fclose(in_file);
+    if (input == NULL) {
+        /* out of memory, or an instruction too long, which is reported */
+        fprintf(stderr, "Error: failed to read %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (estimate(input, &cost, &programs) < 0) {
+        fprintf(stderr, "Error: failed to estimate %s\n", argv[1]);
+        free_logo(input);
+        return EXIT_FAILURE;
+    }
+    print_estimate(stdout, argv[1], &cost, programs);
+    free_logo(input);
+    return EXIT_SUCCESS;
+}
@@ -37,6 +37,7 @@
 #include <math.h>
 #include <gtk/gtk.h>
 #include "interpreter.h"
+#include "tokens.h"
 #include "extension.h"
 
 /* for interpreting functions to draw on surface */
@@ -647,7 +648,7 @@ int process_text_view(DInfo *dinfo) {
     /* Get the entire buffer text. */
     text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
     /* load it onto input */
-    input_items_add(&(dinfo->input_items), read_input(text, gtk_text_buffer_get_line_count(buffer)), text);
+    input_items_add(&(dinfo->input_items), read_input(text), text);
     if (draw(dinfo) != 0) {
         // set error message
         gtk_statusbar_push(
@@ -820,20 +821,14 @@ int open_file(DInfo *dinfo, char *filename) {
 /**
  *  Read text from text_view and put it into a Logo struct.
  */
-Logo read_input(char *buffer, int count) {
+Logo read_input(char *buffer) {
     Logo input;
-    char *copy;
-    char *tok;
+    char *text, *p, *next;
+    size_t size;
     int i;
 
     if (strlen(buffer) == 0) {
         return NULL;
-    } else {
-        copy = (char *) calloc(strlen(buffer) + 1, sizeof(char));
-        if (copy == NULL) {
-            fprintf(stderr, "Error: cannot allocate memory to buffer\n");
-            return NULL;
-        }
     }
     
     /* malloc the data structure */
@@ -841,45 +836,45 @@ Logo read_input(char *buffer, int count) {
     if (input == NULL) {
         return NULL;
     }
-    input->lines = (char **) malloc(count * sizeof(char *));
+    input->vars = NULL;
+    input->out = NULL;
+    input->out_filename = NULL;
+    input->compress = 0;
+    input->uring = 0;
+    input->backend = NULL;
+    input->budget = NULL;
+    /* one instruction per line, the text view is free-form */
+    text = tok_normalise(buffer, strlen(buffer), &size, &(input->line_nums), &(input->num_lines));
+    if (text == NULL) {
+        free(input);
+        return NULL;
+    }
+    input->lines = (char **) malloc(input->num_lines * sizeof(char *));
     if (input->lines == NULL) {
         /* free input */
+        free(text);
+        free(input->line_nums);
         free(input);
         return NULL;
     }
-    for (i=0; i<count; i++) {
+    p = text;
+    for (i=0; i<input->num_lines; i++) {
         input->lines[i] = (char *) malloc(LINE_LENGTH * sizeof(char));
         if (input->lines[i] == NULL) {
             /* free input and lines */
-            free(input->lines);
-            free(input);
+            input->num_lines = i;
+            free(text);
+            free_logo(input);
             return NULL;
         }
         /* input made properly, memset it */
         memset(input->lines[i], '\0', LINE_LENGTH);
+        next = memchr(p, '\n', text + size - p);
+        memcpy(input->lines[i], p, next - p);
+        p = next + 1;
     }
-    
-    strncpy(copy, buffer, strlen(buffer));
-    copy[strlen(buffer) + 1] = '\0';
-
-    count = 0;
-    tok = strtok(copy, "\n");
-    while(tok != NULL) {
-        // take away the \n in tok
-        if (tok[strlen(tok)-1] == '\n') {
-            tok[strlen(tok)-1] = '\0';
-        }
-        tok = trim_space(tok);
-        // be a bit lenient here, if not whitespace...
-        if (strlen(tok) > 0) {
-            strcpy(input->lines[count], tok);
-            count = count + 1;
-        }
-        tok = strtok(NULL, "\n");
-    }
-    input->num_lines = count;
+    free(text);
     input->counter = 0;
-    free(copy);
     return input;
 }
 
@@ -7,14 +7,24 @@
  *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
  */
 
+#define _POSIX_C_SOURCE 200809L /* for clock_gettime */
+
 #include <ctype.h> /* for isdigit */
 #include <stdio.h>
 #include <stdlib.h> /* malloc and EXIT_FOO */
 #include <string.h> /* strcmp, strcpy, etc */
+#include <time.h>   /* clock_gettime */
+#include <sys/resource.h> /* getrusage */
 #include "interpreter.h"
+#include "estimate.h" /* for --estimate */
+#include "mtscan.h"   /* for scanning large inputs in parallel */
+#include "linescan.h" /* for trimming lines */
+#include "tokens.h"   /* for free-form programs */
 #include "intercept.h" /* for intercepting malloc and testing */
 
-#define DEBUG_DATA  input->lines[input->counter], input->counter+1
+#define DEBUG_DATA  input->lines[input->counter], line_num(input)
+
+static OutBuf new_output(FILE * out_file, char *filename, int compress, int uring);
 
 /********************************************
  Interpreter Main Function
@@ -24,10 +34,18 @@ int interp_main(int argc, char * argv[]) {
     char in_filename[FILENAME_LENGTH], out_filename[FILENAME_LENGTH];
     FILE *in_file;  /* input file handle */
     FILE *out_file; /* output file handle */
+    OutBuf out;     /* buffered writer for out_file */
     Logo input;     /* data structure to store input lines */ 
+    Options opts;   /* command line options */
+    int n, ret;
     
-    /* get and open the file */
-    if (get_filenames(argc, argv, in_filename, out_filename) < 0) {
+    /* get the options, then the filenames after them */
+    n = get_options(argc, argv, &opts);
+    if (n >= 0 && opts.estimate) {
+        /* nothing is run or written, so there is only the input */
+        return estimate_main(argc - n, argv + n);
+    }
+    if (n < 0 || get_filenames(argc - n, argv + n, in_filename, out_filename) < 0) {
         return EXIT_FAILURE;
     }
     
@@ -39,48 +57,128 @@ int interp_main(int argc, char * argv[]) {
         return EXIT_FAILURE;
     }
     
-    /* open output file */
-    out_file = fopen(out_filename, "w");
-    if (out_file == NULL) {
-        fprintf(stderr, "Error: failed to open %s\n", out_filename);
-        perror("fopen");
-        return EXIT_FAILURE;
+    /* open output file, unless there is one per program */
+    out_file = NULL;
+    out = NULL;
+    if (opts.multi != MULTI_FILES) {
+        out_file = fopen(out_filename, "w");
+        if (out_file == NULL) {
+            fprintf(stderr, "Error: failed to open %s\n", out_filename);
+            perror("fopen");
+            return EXIT_FAILURE;
+        }
+        out = new_output(out_file, out_filename, opts.compress, opts.uring);
+        if (out == NULL) {
+            fprintf(stderr, "Error: cannot allocate memory for output buffer\n");
+            fclose(out_file);
+            remove(out_filename);
+            return EXIT_FAILURE;
+        }
     }
     
-    /* hook for writing headers of the outfile
-       this function is replaced by a #define in intercept.h depending on 
-       preprocessor conditions set by the Makefile at compile time */
-    ipt_header(out_file, in_filename);
-    
     /* populate input */
-    input = scan_file(in_file);
+    input = scan_mt(in_file);
     fclose(in_file);
     if (input == NULL) {
-        /* out of memory */
-        fprintf(stderr, "Error: cannot allocate memory for reading input file\n");
+        /* out of memory, or an instruction too long, which is reported */
+        fprintf(stderr, "Error: failed to read %s\n", in_filename);
+        if (out_file != NULL) {
+            ob_close(out);
+            fclose(out_file);
+            remove(out_filename);
+        }
         return EXIT_FAILURE;
     }
-    /* put the output file handle into input */
+    
+    /* hook for setting up the backend with the options */
+    if ((ret = ipt_backend(input, &opts)) < 0) {
+        if (ret == MEM_ERR) {
+            fprintf(stderr, "Error: cannot allocate memory for output backend\n");
+        }
+        if (out_file != NULL) {
+            ob_close(out);
+            fclose(out_file);
+            remove(out_filename);
+        }
+        free_logo(input);
+        return EXIT_FAILURE;
+    }
+    
+    /* the limits on the run, which starts now */
+    if (set_budget(input, &opts) < 0) {
+        fprintf(stderr, "Error: cannot allocate memory for limits\n");
+        if (out_file != NULL) {
+            ob_close(out);
+            fclose(out_file);
+            remove(out_filename);
+        }
+        free_logo(input);
+        return EXIT_FAILURE;
+    }
+    
+    if (opts.multi == MULTI_FILES) {
+        /* writes and reports its own output files */
+        input->compress = opts.compress;
+        input->uring = opts.uring;
+        ret = interp_files(input, in_filename, out_filename);
+        if (ret < 0) {
+            fprintf(stderr, "Error: failed to parse and interpret %s\n", in_filename);
+            free_logo(input);
+            return EXIT_FAILURE;
+        }
+        printf("Successfully parsed and interpreted %s\n", in_filename);
+        ipt_report(input);
+        free_logo(input);
+        return EXIT_SUCCESS;
+    }
+    
+    /* put the output file handle and its buffer into input */
     input->ofile = out_file;
+    input->out = out;
+    input->out_filename = out_filename;
     
-    if (parse(input) < 0) {
+    /* hook for writing headers of the outfile
+       this function is replaced by a #define in intercept.h depending on 
+       preprocessor conditions set by the Makefile at compile time */
+    ipt_header(input, in_filename);
+    
+    if (opts.multi == MULTI_PAGES) {
+        ret = parse_pages(input);
+    } else {
+        ret = parse(input);
+    }
+    if (ret < 0) {
         fprintf(stderr, "Error: failed to parse and interpret %s\n", in_filename);
-        /* close the out_file and remove it */
+        /* close the out_file, once the backend has finished with it, and remove it */
+        ipt_sync(input);
+        ob_close(out);
         fclose(out_file);
         remove(out_filename);
         free_logo(input);
         return EXIT_FAILURE;
     }
     
-    /* hook for writing footers of the outfile */
-    ipt_footer(out_file);
+    /* hook for writing footers of the outfile, pages have their own */
+    if (opts.multi != MULTI_PAGES) {
+        ipt_footer(input);
+    }
+    ipt_trailer(input);
     
-    /* close the output file handle */
+    /* write out what is left, then close the output file handle */
+    if (ob_close(out) < 0) {
+        fprintf(stderr, "Error: failed to write %s\n", out_filename);
+        perror("write");
+        fclose(out_file);
+        remove(out_filename);
+        free_logo(input);
+        return EXIT_FAILURE;
+    }
     fclose(out_file);
     
     /* friendly messages */
     printf("Successfully parsed and interpreted %s\n", in_filename);
     printf("Output: %s\n", out_filename);
+    ipt_report(input);
     
     /* free the input structure */
     free_logo(input);
@@ -109,31 +207,121 @@ static int chk_inst(Logo input, float * op) {
     return 0;
 }
 
+/**
+ *  Sets all variables to 0 and unused
+ */
+static void clear_vars(VarStack vars) {
+    int i;
+    for (i=0; i<VARARY_SIZE; i++) {
+        vars[i].data = 0;
+        vars[i].used = 0;
+    }
+}
+
+/**
+ *  Moves the counter past empty lines. Returns 1 if there is anything left,
+ *  else 0.
+ */
+static int skip_empty(Logo input) {
+    while (input->counter < input->num_lines && 
+           strlen(input->lines[input->counter]) == 0) {
+        input->counter = input->counter + 1;
+    }
+    return input->counter < input->num_lines;
+}
+
+/**
+ *  Returns the error a failed run gives, LIMIT_ERR if it went over one of
+ *  its limits, else PARSE_ERR
+ */
+static int run_error(Logo input) {
+    if (input->budget != NULL && input->budget->spent) {
+        return LIMIT_ERR;
+    }
+    return PARSE_ERR;
+}
+
+/**
+ *  Returns the time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *  Starts the buffered writer of an output file, gzipped at level compress,
+ *  or at OB_LEVEL if it is 0 and the file is named .gz. Otherwise it is
+ *  written through an io_uring if uring is set, where the file allows it.
+ *  Returns NULL when out of memory.
+ */
+static OutBuf new_output(FILE * out_file, char *filename, int compress, int uring) {
+    OutBuf out = ob_new(out_file);
+    size_t n = strlen(filename), ext = strlen(GZIP_EXT);
+    if (compress == 0 && n > ext && strsame(filename + n - ext, GZIP_EXT)) {
+        compress = OB_LEVEL;
+    }
+    if (out != NULL && compress > 0 && ob_compress(out, compress) < 0) {
+        ob_close(out);
+        return NULL;
+    }
+    if (out != NULL && compress == 0 && uring) {
+        /* written as before if it cannot be */
+        ob_uring(out);
+    }
+    return out;
+}
+
+/**
+ *  Reads everything left in in_file into memory. Returns the buffer and its
+ *  size in *size, or NULL when out of memory.
+ */
+static char * read_all(FILE * in_file, size_t *size) {
+    char *buffer, *bigger;
+    size_t cap = READ_LENGTH, n;
+    buffer = (char *) malloc (cap * sizeof(char));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    *size = 0;
+    while ((n = fread(buffer + *size, sizeof(char), cap - *size, in_file)) > 0) {
+        *size = *size + n;
+        if (*size == cap) {
+            cap = cap * 2;
+            bigger = (char *) realloc (buffer, cap * sizeof(char));
+            if (bigger == NULL) {
+                free(buffer);
+                return NULL;
+            }
+            buffer = bigger;
+        }
+    }
+    return buffer;
+}
+
 /********************************************
  Parser Functions
  ********************************************/
 
 /**
- *  Parses the input and returns 0 on success, PARSE_ERR on error
+ *  Parses the input and returns 0 on success, PARSE_ERR or LIMIT_ERR on
+ *  error
  */
 int parse(Logo input) {
     /* prepare input for parsing */
     /* set the varstack in input first */
-    int i;
     input->vars = (VarStack) malloc (VARARY_SIZE * sizeof(*(input->vars)));
     if (input->vars == NULL) {
         fprintf(stderr, "Error: cannot allocate memory for variable stack\n");
         return MEM_ERR;
     }
-    for (i=0; i<VARARY_SIZE; i++) {
-        /* set all values to 0 and used to 0 */
-        input->vars[i].data = 0;
-        input->vars[i].used = 0;
-    }
+    /* set all values to 0 and used to 0 */
+    clear_vars(input->vars);
     /* now move on to logo */
     if (mainlogo(input) < 0) {
         /* something went wrong */
-        return PARSE_ERR;
+        return run_error(input);
     }
     return 0;
 }
@@ -144,6 +332,27 @@ int parse(Logo input) {
  */
 int mainlogo(Logo input) {
     int i;
+    if (program(input) < 0) {
+        /* something went wrong */
+        return PARSE_ERR;
+    }
+    /* check that everything that follows is empty */
+    for (i=input->counter; i<input->num_lines; i++) {
+        /* these lines must now be empty */
+        if (strlen(input->lines[i]) > 0) {
+            fprintf(stderr, "Error: %s found after closing bracket on line %d\n", DEBUG_DATA);
+            return PARSE_ERR;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Parses the "{" <INSTRCTLST> of <MAIN>, leaving the counter on the line
+ *  after the closing bracket. Returns 0 on success, PARSE_ERR on error
+ */
+int program(Logo input) {
+    int start = input->counter;
     /* starts with a curly bracket */
     if (strsame(input->lines[input->counter], "{") != 1) {
         /* does not start with a curly bracket */
@@ -157,14 +366,9 @@ int mainlogo(Logo input) {
         return PARSE_ERR;
     }
     input->counter = input->counter + 1;
-    /* check that everything that follows is empty */
-    for (i=input->counter; i<input->num_lines; i++) {
-        /* these lines must now be empty */
-        if (strlen(input->lines[i]) > 0) {
-            fprintf(stderr, "Error: %s found after closing bracket on line %d\n", DEBUG_DATA);
-            return PARSE_ERR;
-        }
-    }
+    /* hook for backends that write out the program, now that it is known
+       to run, rather than what it draws */
+    ipt_program(input, start);
     return 0;
 }
 
@@ -182,7 +386,7 @@ int instrctlst(Logo input) {
     }
     input->counter = input->counter + 1;
     if (input->counter > input->num_lines-1) {
-        fprintf(stderr, "Error: expected '}' on line %d\n", input->counter+1);
+        fprintf(stderr, "Error: expected '}' on line %d\n", line_num(input));
         return PARSE_ERR;
     }
     return instrctlst(input);
@@ -205,6 +409,9 @@ int instruction(Logo input) {
         fprintf(stderr, "Error: expected <INSTRUCTION> but got '%s' on line %d\n", DEBUG_DATA);
         return PARSE_ERR;
     }
+    if (spend(input, strsame(inst, FD)) < 0) {
+        return LIMIT_ERR;
+    }
     /* what is the instruction? */
     if (strsame(inst, FD)) {
         ret = fd(input);
@@ -229,17 +436,8 @@ int instruction(Logo input) {
  *  <FD>        ::= FD <VARNUM>
  */
 int fd(Logo input) {
-    char inst[INSTRUCT_LENGTH+1];
     float op;
-    if (chk_inst(input, &op) < 0) {
-        return PARSE_ERR;
-    }
-    /* check the instruction again for completeness sake, even though 
-     instruction() has checked for it once
-     */
-    sscanf(input->lines[input->counter], "%s", inst);
-    if (strsame(inst, FD) != 1) {
-        fprintf(stderr, "Error: expected '%s' but got '%s' on line %d\n", FD, DEBUG_DATA);
+    if (move_operand(input, FD, &op) < 0) {
         return PARSE_ERR;
     }
     /* everything checks out fine, interpret */
@@ -252,14 +450,8 @@ int fd(Logo input) {
  *  <LT>        ::= LT <VARNUM>
  */
 int lt(Logo input) {
-    char inst[INSTRUCT_LENGTH+1];
     float op;
-    if (chk_inst(input, &op) < 0) {
-        return PARSE_ERR;
-    }
-    sscanf(input->lines[input->counter], "%s", inst);
-    if (strsame(inst, LT) != 1) {
-        fprintf(stderr, "Error: expected '%s' but got '%s' on line %d\n", LT, DEBUG_DATA);
+    if (move_operand(input, LT, &op) < 0) {
         return PARSE_ERR;
     }
     ipt_lt(input, op);
@@ -271,14 +463,8 @@ int lt(Logo input) {
  *  <RT>        ::= RT <VARNUM>
  */
 int rt(Logo input) {
-    char inst[INSTRUCT_LENGTH+1];
     float op;
-    if (chk_inst(input, &op) < 0) {
-        return PARSE_ERR;
-    }
-    sscanf(input->lines[input->counter], "%s", inst);
-    if (strsame(inst, RT) != 1) {
-        fprintf(stderr, "Error: expected '%s' but got '%s' on line %d\n", RT, DEBUG_DATA);
+    if (move_operand(input, RT, &op) < 0) {
         return PARSE_ERR;
     }
     ipt_rt(input, op);
@@ -290,34 +476,12 @@ int rt(Logo input) {
  *  <DO>        ::= <VAR> "FROM" <VARNUM> "TO" <VARNUM> { <INSTRCTLST>
  */
 int dologo(Logo input) {
-    char inst[INSTRUCT_LENGTH+1], fromchar[OPERAND_LENGTH], tochar[OPERAND_LENGTH], curly[VAR_LENGTH+1];
-    char var[VAR_LENGTH+1], from[LINE_LENGTH], to[LINE_LENGTH];
+    char var[VAR_LENGTH+1];
     float n_from, /* for storing from and to values */
           n_to; 
     int   loop,   /* for using it in a for loop */
           pos;    /* for remembering the counter position */
-    /* no need to check DO as it has already been checked in instruciton */
-    if (sscanf(input->lines[input->counter], "%s %s %s %s %s %s %[{]", inst, var, fromchar, from, tochar, to, curly) < 7) {
-        fprintf(stderr, "Error: expected DO <VAR> FROM <VARNUM> TO <VARNUM> { but got '%s' on line %d\n", DEBUG_DATA);
-        return PARSE_ERR;
-    }
-    /* check the <VAR> token */
-    if (is_var(var) != 1) {
-        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, input->counter+1);
-        return PARSE_ERR;
-    }
-    /* check syntax for DO, FROM and TO */
-    if (strsame(inst, DO) != 1 ||
-        strsame(fromchar, "FROM") != 1 ||
-        strsame(tochar, "TO") != 1) {
-        fprintf(stderr, "Error: expected DO <VAR> FROM <VARNUM> TO <VARNUM> { but got '%s' on line %d\n", DEBUG_DATA);
-        return PARSE_ERR;
-    }
-    /* check the 2 varnums */
-    if (varnum(from, input, &n_from)) {
-        return PARSE_ERR;
-    }
-    if (varnum(to, input, &n_to)) {
+    if (do_header(input, var, &n_from, &n_to) < 0) {
         return PARSE_ERR;
     }
     
@@ -325,11 +489,17 @@ int dologo(Logo input) {
     input->counter = input->counter + 1;
     /* remember the position */
     pos = input->counter;
+    /* hook for backends that draw loops differently */
+    ipt_loop(input, pos);
     /* is from smaller than to? */
     if (n_from < n_to) {
         for (loop=n_from; loop<=n_to; loop++) {
             /* set the VAR */
             set_var(var, input->vars, loop);
+            if (spend(input, 0) < 0) {
+                return LIMIT_ERR;
+            }
+            ipt_iteration(input);
             /* set the counter to point at the start of the loop */
             input->counter = pos;
             if (instrctlst(input) < 0) {
@@ -341,6 +511,10 @@ int dologo(Logo input) {
         for (loop=n_from; loop>=n_to; loop--) {
             /* set the VAR */
             set_var(var, input->vars, loop);
+            if (spend(input, 0) < 0) {
+                return LIMIT_ERR;
+            }
+            ipt_iteration(input);
             /* set the counter to point at the start of the loop */
             input->counter = pos;
             if (instrctlst(input) < 0) {
@@ -348,6 +522,41 @@ int dologo(Logo input) {
             }
         }
     }
+    ipt_loop_end(input);
+    return 0;
+}
+
+/**
+ *  Parses the first line of a <DO>, giving its <VAR> and the values it
+ *  goes FROM and TO. Returns 0 on success, PARSE_ERR on error
+ */
+int do_header(Logo input, char *var, float *from, float *to) {
+    char inst[INSTRUCT_LENGTH+1], fromchar[OPERAND_LENGTH], tochar[OPERAND_LENGTH], curly[VAR_LENGTH+1];
+    char from_str[LINE_LENGTH], to_str[LINE_LENGTH];
+    /* no need to check DO as it has already been checked in instruciton */
+    if (sscanf(input->lines[input->counter], "%s %s %s %s %s %s %[{]", inst, var, fromchar, from_str, tochar, to_str, curly) < 7) {
+        fprintf(stderr, "Error: expected DO <VAR> FROM <VARNUM> TO <VARNUM> { but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    /* check the <VAR> token */
+    if (is_var(var) != 1) {
+        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, line_num(input));
+        return PARSE_ERR;
+    }
+    /* check syntax for DO, FROM and TO */
+    if (strsame(inst, DO) != 1 ||
+        strsame(fromchar, "FROM") != 1 ||
+        strsame(tochar, "TO") != 1) {
+        fprintf(stderr, "Error: expected DO <VAR> FROM <VARNUM> TO <VARNUM> { but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    /* check the 2 varnums */
+    if (varnum(from_str, input, from)) {
+        return PARSE_ERR;
+    }
+    if (varnum(to_str, input, to)) {
+        return PARSE_ERR;
+    }
     return 0;
 }
 
@@ -360,7 +569,7 @@ int varnum(char * operand, Logo input, float * op) {
     /* it could be a <VAR> */
     if (is_var(operand)) {
         if ((ret = get_var(operand, input->vars, op)) < 0) {
-            fprintf(stderr, "Error: unknown variable '%s' on line %d\n", operand, input->counter+1);
+            fprintf(stderr, "Error: unknown variable '%s' on line %d\n", operand, line_num(input));
         }
         return ret;
     } else {
@@ -369,12 +578,12 @@ int varnum(char * operand, Logo input, float * op) {
             if (i == 0) {
                 if (isdigit(operand[i]) < 1 &&
                 operand[i] != '-') {
-                    fprintf(stderr, "Error: expected number or a <VAR> but got '%s' on line %d\n", operand, input->counter+1);
+                    fprintf(stderr, "Error: expected number or a <VAR> but got '%s' on line %d\n", operand, line_num(input));
                     return PARSE_ERR;
                 }
             } else if (isdigit(operand[i]) < 1 &&
                 operand[i] != '.') {
-                fprintf(stderr, "Error: expected number or a <VAR> but got '%s' on line %d\n", operand, input->counter+1);
+                fprintf(stderr, "Error: expected number or a <VAR> but got '%s' on line %d\n", operand, line_num(input));
                 return PARSE_ERR;
             }
         }
@@ -405,7 +614,7 @@ int set(Logo input) {
     }
     /* check that var is correct */
     if (is_var(var) != 1) {
-        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, input->counter+1);
+        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, line_num(input));
         return PARSE_ERR;
     }
     /* check the syntax */
@@ -550,6 +759,40 @@ int set_var(char * var, VarStack vars, float num) {
     return 0;
 }
 
+/**
+ *  Checks the current line is the instruction inst, an FD, LT or RT, and
+ *  gives the value of its <VARNUM>. Returns 0 on success, PARSE_ERR on
+ *  error
+ */
+int move_operand(Logo input, char *inst, float *op) {
+    char name[INSTRUCT_LENGTH+1];
+    if (chk_inst(input, op) < 0) {
+        return PARSE_ERR;
+    }
+    /* check the instruction again for completeness sake, even though 
+     instruction() has checked for it once
+     */
+    sscanf(input->lines[input->counter], "%3s", name);
+    if (strsame(name, inst) != 1) {
+        fprintf(stderr, "Error: expected '%s' but got '%s' on line %d\n", inst, DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    return 0;
+}
+
+/**
+ *  Returns the line number in the input file of the current line
+ */
+int line_num(Logo input) {
+    if (input->line_nums == NULL) {
+        return input->counter + 1;
+    } else if (input->counter >= input->num_lines) {
+        /* past the end */
+        return input->line_nums[input->num_lines - 1] + 1;
+    }
+    return input->line_nums[input->counter];
+}
+
 /**
  *  Returns 1 if the string var is a correct <VAR> ([A-Z]), else 0
  */
@@ -581,19 +824,165 @@ int is_op(char * op) {
  *  Removes leading and trailing whitespace from a string
  */
 char * trim_space(char *str) {
-    char *end;
-    /* skip leading whitespace */
-    while (isspace(*str)) {
-        str = str + 1;
+    char *end = str + strlen(str);
+    str = ls_skip_space(str, end);
+    /* write null character after the last non whitespace */
+    *ls_trim_end(str, end) = '\0';
+    return str;
+}
+
+/********************************************
+ Budget Functions
+ ********************************************/
+
+/**
+ *  Gives input the limits in opts, starting its clock, or no limits if
+ *  none are set. Returns 0 on success, MEM_ERR when out of memory
+ */
+int set_budget(Logo input, Options *opts) {
+    Budget b;
+    free(input->budget);
+    input->budget = NULL;
+    if (opts->max_insts == 0 && opts->max_segs == 0 &&
+        opts->max_time == 0 && opts->max_memory == 0) {
+        return 0;
     }
-    /* remove trailing whitespace */
-    end = str + strlen(str) - 1;
-    while (end > str && isspace(*end)) {
-        end = end - 1;
+    b = (Budget) malloc (sizeof(*b));
+    if (b == NULL) {
+        return MEM_ERR;
     }
-    /* write null character */
-    *(end+1) = '\0';
-    return str;
+    b->max_insts = opts->max_insts;
+    b->max_segs = opts->max_segs;
+    b->max_time = opts->max_time;
+    b->max_memory = opts->max_memory * 1024;
+    b->insts = 0;
+    b->segs = 0;
+    b->start = now();
+    b->spent = 0;
+    input->budget = b;
+    return 0;
+}
+
+/**
+ *  Counts an instruction drawing segs segments against the limits of the
+ *  run. Returns 0 if it is within them, LIMIT_ERR if not
+ */
+int spend(Logo input, int segs) {
+    Budget b = input->budget;
+    struct rusage ru;
+    if (b == NULL) {
+        return 0;
+    }
+    b->insts = b->insts + 1;
+    b->segs = b->segs + segs;
+    if (b->max_insts > 0 && b->insts > b->max_insts) {
+        fprintf(stderr, "Error: more than %ld instructions run on line %d\n", b->max_insts, line_num(input));
+        b->spent = 1;
+    } else if (b->max_segs > 0 && b->segs > b->max_segs) {
+        fprintf(stderr, "Error: more than %ld segments drawn on line %d\n", b->max_segs, line_num(input));
+        b->spent = 1;
+    } else if (b->insts % BUDGET_CLOCK == 0) {
+        if (b->max_time > 0 && now() - b->start > b->max_time) {
+            fprintf(stderr, "Error: more than %g seconds taken on line %d\n", b->max_time, line_num(input));
+            b->spent = 1;
+        } else if (b->max_memory > 0 && getrusage(RUSAGE_SELF, &ru) == 0 &&
+                   ru.ru_maxrss > b->max_memory) {
+            fprintf(stderr, "Error: more than %ldMB of memory used on line %d\n", b->max_memory / 1024, line_num(input));
+            b->spent = 1;
+        }
+    }
+    return b->spent ? LIMIT_ERR : 0;
+}
+
+/********************************************
+ Multi-program Functions
+ ********************************************/
+
+/**
+ *  Interprets a stream of programs, each a <MAIN>, into input->out with a
+ *  page per program. Variables are reset before every program, like parse()
+ *  does. The header of the first page must already be written. Returns 0 on
+ *  success, PARSE_ERR or MEM_ERR on error
+ */
+int parse_pages(Logo input) {
+    input->vars = (VarStack) malloc (VARARY_SIZE * sizeof(*(input->vars)));
+    if (input->vars == NULL) {
+        fprintf(stderr, "Error: cannot allocate memory for variable stack\n");
+        return MEM_ERR;
+    }
+    do {
+        if (input->counter > 0) {
+            ipt_newpage(input->out);
+        }
+        clear_vars(input->vars);
+        if (program(input) < 0) {
+            return run_error(input);
+        }
+        ipt_footer(input);
+        ipt_showpage(input->out);
+    } while (skip_empty(input));
+    return 0;
+}
+
+/**
+ *  Interprets a stream of programs, each a <MAIN>, into numbered output
+ *  files named after out_filename. Variables are reset before every program.
+ *  The output of a program that fails is removed, earlier ones are kept.
+ *  Returns 0 on success, PARSE_ERR, LIMIT_ERR, MEM_ERR or FILE_ERR on error
+ */
+int interp_files(Logo input, char *in_filename, char *out_filename) {
+    char filename[FILENAME_LENGTH];
+    int num = 0;
+    
+    input->vars = (VarStack) malloc (VARARY_SIZE * sizeof(*(input->vars)));
+    if (input->vars == NULL) {
+        fprintf(stderr, "Error: cannot allocate memory for variable stack\n");
+        return MEM_ERR;
+    }
+    do {
+        num = num + 1;
+        if (numbered_filename(out_filename, num, filename) < 0) {
+            return FILE_ERR;
+        }
+        input->ofile = fopen(filename, "w");
+        if (input->ofile == NULL) {
+            fprintf(stderr, "Error: failed to open %s\n", filename);
+            perror("fopen");
+            return FILE_ERR;
+        }
+        input->out = new_output(input->ofile, filename, input->compress, input->uring);
+        input->out_filename = filename;
+        if (input->out == NULL) {
+            fprintf(stderr, "Error: cannot allocate memory for output buffer\n");
+            fclose(input->ofile);
+            remove(filename);
+            return MEM_ERR;
+        }
+        ipt_header(input, in_filename);
+        clear_vars(input->vars);
+        if (program(input) < 0) {
+            ipt_sync(input);
+            ob_close(input->out);
+            fclose(input->ofile);
+            remove(filename);
+            return run_error(input);
+        }
+        ipt_footer(input);
+        ipt_trailer(input);
+        if (ob_close(input->out) < 0) {
+            fprintf(stderr, "Error: failed to write %s\n", filename);
+            perror("write");
+            fclose(input->ofile);
+            remove(filename);
+            return FILE_ERR;
+        }
+        fclose(input->ofile);
+        printf("Output: %s\n", filename);
+    } while (skip_empty(input));
+    input->ofile = NULL;
+    input->out = NULL;
+    input->out_filename = NULL;
+    return 0;
 }
 
 /********************************************
@@ -604,62 +993,107 @@ char * trim_space(char *str) {
  *  Scans the input file and creates a data structure to store its content
  */
 Logo scan_file(FILE * in_file) {
-    int i, count;
-    char line[LINE_LENGTH];
-    char *trimmed;
+    int i;
+    char *buffer, *text, *p, *next;
+    size_t size, text_size;
     Logo input;
     
-    /* count the number of lines */
-    count = 0;
-    while (fgets(line, sizeof(line), in_file) != NULL) {
-        count = count + 1;
-    }
-    count = count + 1; /* count is offset by 1 */
-    
     /* malloc the data structure */
     input = (Logo) malloc (sizeof(*input));
     if (input == NULL) {
         return NULL;
     }
-    input->lines = (char **) malloc (count * sizeof(char *));
+    input->vars = NULL;
+    input->out = NULL;
+    input->out_filename = NULL;
+    input->compress = 0;
+    input->uring = 0;
+    input->backend = NULL;
+    input->budget = NULL;
+    /* read it all, the lines of a free-form program mean nothing yet */
+    buffer = read_all(in_file, &size);
+    if (buffer == NULL) {
+        free(input);
+        return NULL;
+    }
+    /* rewrite it with one instruction per line */
+    text = tok_normalise(buffer, size, &text_size, &(input->line_nums), &(input->num_lines));
+    free(buffer);
+    if (text == NULL) {
+        free(input);
+        return NULL;
+    }
+    /* there is always an empty line at the end */
+    input->num_lines = input->num_lines + 1;
+    input->lines = (char **) malloc (input->num_lines * sizeof(char *));
     if (input->lines == NULL) {
         /* free input */
+        free(text);
+        free(input->line_nums);
         free(input);
         return NULL;
     }
-    for (i=0; i<count; i++) {
+    p = text;
+    for (i=0; i<input->num_lines; i++) {
         /* could call calloc here but more test code will be needed */
         input->lines[i] = (char *) malloc (LINE_LENGTH * sizeof(char));
         if (input->lines[i] == NULL) {
             /* free input and lines */
-            free(input->lines);
-            free(input);
+            input->num_lines = i;
+            free(text);
+            free_logo(input);
             return NULL;
         }
         /* input made properly, memset it */
         memset(input->lines[i], '\0', LINE_LENGTH);
+        if (i < input->num_lines - 1) {
+            next = memchr(p, '\n', text + text_size - p);
+            memcpy(input->lines[i], p, next - p);
+            p = next + 1;
+        }
     }
-    
-    /* populate input */
-    rewind(in_file);
-    count = 0;
-    while (fgets(line, sizeof(line), in_file) != NULL) {
-        /* trim leading and trailing whitespace */
-        trimmed = trim_space(line);
-        /* remove trailing newline */
-        if (trimmed[strlen(trimmed) - 1] == '\n') {
-            trimmed[strlen(trimmed) - 1] = '\0';
-        }
-        strcpy(input->lines[count], trimmed);
-        count = count + 1;
-    }
-    /* tell the struct how big the 2D char array is */
-    input->num_lines = count + 1;
+    free(text);
     /* and set the counter to 0 */
     input->counter = 0;
     return input;
 }
 
+/**
+ *  Scans the input file like scan_file(), but memory maps it and reads its
+ *  instructions on several threads. Falls back to scan_file() if the file
+ *  cannot be mapped.
+ */
+Logo scan_mt(FILE * in_file) {
+    char *map;
+    size_t size;
+    Logo input;
+    
+    map = map_file(in_file, &size);
+    if (map == NULL) {
+        return scan_file(in_file);
+    }
+    input = (Logo) malloc (sizeof(*input));
+    if (input == NULL) {
+        unmap_file(map, size);
+        return NULL;
+    }
+    input->vars = NULL;
+    input->out = NULL;
+    input->out_filename = NULL;
+    input->compress = 0;
+    input->uring = 0;
+    input->backend = NULL;
+    input->budget = NULL;
+    input->lines = mt_scan(map, size, mt_threads(size), &(input->num_lines), &(input->line_nums));
+    unmap_file(map, size);
+    if (input->lines == NULL) {
+        free(input);
+        return NULL;
+    }
+    input->counter = 0;
+    return input;
+}
+
 /**
  *  Frees the input
  */
@@ -669,6 +1103,9 @@ void free_logo(Logo input) {
         free(input->lines[i]);
     }
     free(input->vars);
+    free(input->line_nums);
+    free(input->budget);
+    ipt_free(input->backend);
     free(input->lines);
     free(input);
 }
@@ -732,6 +1169,167 @@ int pop(Stack *head, float * value) {
  Command Line Functions
  ********************************************/
 
+/**
+ *  Reads the options given before the filenames into opts. Returns the
+ *  number of options, or ARGS_ERR on an unknown option
+ */
+int get_options(int argc, char * argv[], Options *opts) {
+    char *end;
+    int i;
+    /* defaults */
+    opts->multi = MULTI_NONE;
+    opts->compact = 0;
+    opts->simplify = -1;
+    opts->dedup = 0;
+    opts->mode = MODE_UNROLLED;
+    opts->max_path = 0;
+    opts->image = IMAGE_PNG;
+    opts->scale = 1;
+    opts->threads = 0;
+    opts->pyramid = 0;
+    opts->plot = PLOT_HPGL;
+    opts->compress = 0;
+    opts->uring = 0;
+    opts->max_insts = 0;
+    opts->max_segs = 0;
+    opts->max_time = 0;
+    opts->max_memory = 0;
+    opts->estimate = 0;
+    opts->given = 0;
+    /* options come before the filenames */
+    for (i=1; i<argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strsame(argv[i], "--multi") || strsame(argv[i], "--multi=pages")) {
+            opts->multi = MULTI_PAGES;
+        } else if (strsame(argv[i], "--multi=files")) {
+            opts->multi = MULTI_FILES;
+        } else if (strsame(argv[i], "--compact")) {
+            opts->compact = 1;
+            opts->given = opts->given | OPT_COMPACT;
+        } else if (strsame(argv[i], "--ps-mode=unrolled")) {
+            opts->mode = MODE_UNROLLED;
+            opts->given = opts->given | OPT_PS_MODE;
+        } else if (strsame(argv[i], "--ps-mode=program")) {
+            opts->mode = MODE_PROGRAM;
+            opts->given = opts->given | OPT_PS_MODE;
+        } else if (strsame(argv[i], "--ps-mode=absolute")) {
+            opts->mode = MODE_ABSOLUTE;
+            opts->given = opts->given | OPT_PS_MODE;
+        } else if (strsame(argv[i], "--image=png")) {
+            opts->image = IMAGE_PNG;
+            opts->given = opts->given | OPT_IMAGE;
+        } else if (strsame(argv[i], "--image=ppm")) {
+            opts->image = IMAGE_PPM;
+            opts->given = opts->given | OPT_IMAGE;
+        } else if (strsame(argv[i], "--pyramid")) {
+            opts->pyramid = 1;
+            opts->given = opts->given | OPT_PYRAMID;
+        } else if (strsame(argv[i], "--plot=hpgl")) {
+            opts->plot = PLOT_HPGL;
+            opts->given = opts->given | OPT_PLOT;
+        } else if (strsame(argv[i], "--plot=gcode")) {
+            opts->plot = PLOT_GCODE;
+            opts->given = opts->given | OPT_PLOT;
+        } else if (strsame(argv[i], "--compress")) {
+            opts->compress = OB_LEVEL;
+        } else if (strncmp(argv[i], "--compress=", 11) == 0) {
+            opts->compress = (int) strtol(argv[i] + 11, &end, 10);
+            if (end == argv[i] + 11 || *end != '\0' || opts->compress < 1 || opts->compress > 9) {
+                fprintf(stderr, "Error: bad compression level in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else if (strsame(argv[i], "--uring")) {
+            opts->uring = 1;
+        } else if (strsame(argv[i], "--estimate")) {
+            opts->estimate = 1;
+        } else if (strsame(argv[i], "--dedup")) {
+            opts->dedup = 1;
+            opts->given = opts->given | OPT_DEDUP;
+        } else if (strncmp(argv[i], "--simplify=", 11) == 0) {
+            opts->simplify = strtod(argv[i] + 11, &end);
+            opts->given = opts->given | OPT_SIMPLIFY;
+            if (end == argv[i] + 11 || *end != '\0' || !(opts->simplify >= 0)) {
+                fprintf(stderr, "Error: bad tolerance in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else if (strncmp(argv[i], "--max-path=", 11) == 0) {
+            opts->max_path = strtol(argv[i] + 11, &end, 10);
+            opts->given = opts->given | OPT_MAX_PATH;
+            if (end == argv[i] + 11 || *end != '\0' || opts->max_path <= 0) {
+                fprintf(stderr, "Error: bad segment count in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else if (strncmp(argv[i], "--max-insts=", 12) == 0) {
+            opts->max_insts = strtol(argv[i] + 12, &end, 10);
+            if (end == argv[i] + 12 || *end != '\0' || opts->max_insts <= 0) {
+                fprintf(stderr, "Error: bad instruction count in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else if (strncmp(argv[i], "--max-segments=", 15) == 0) {
+            opts->max_segs = strtol(argv[i] + 15, &end, 10);
+            if (end == argv[i] + 15 || *end != '\0' || opts->max_segs <= 0) {
+                fprintf(stderr, "Error: bad segment count in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else if (strncmp(argv[i], "--max-time=", 11) == 0) {
+            opts->max_time = strtod(argv[i] + 11, &end);
+            if (end == argv[i] + 11 || *end != '\0' || !(opts->max_time > 0)) {
+                fprintf(stderr, "Error: bad time in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else if (strncmp(argv[i], "--max-memory=", 13) == 0) {
+            opts->max_memory = strtol(argv[i] + 13, &end, 10);
+            if (end == argv[i] + 13 || *end != '\0' || opts->max_memory <= 0) {
+                fprintf(stderr, "Error: bad memory size in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else if (strncmp(argv[i], "--scale=", 8) == 0) {
+            opts->scale = strtod(argv[i] + 8, &end);
+            opts->given = opts->given | OPT_SCALE;
+            if (end == argv[i] + 8 || *end != '\0' || !(opts->scale > 0)) {
+                fprintf(stderr, "Error: bad scale in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            opts->threads = (int) strtol(argv[i] + 10, &end, 10);
+            opts->given = opts->given | OPT_THREADS;
+            if (end == argv[i] + 10 || *end != '\0' || opts->threads <= 0) {
+                fprintf(stderr, "Error: bad thread count in %s\n", argv[i]);
+                return ARGS_ERR;
+            }
+        } else {
+            fprintf(stderr, "Error: unknown option %s\n", argv[i]);
+            fprintf(stderr, "Usage: interp [--multi[=pages|files]] [--compact] "
+                            "[--simplify=<tolerance>] [--dedup] [--ps-mode=unrolled|program|absolute] "
+                            "[--max-path=<segments>] [--image=png|ppm] "
+                            "[--scale=<pixels per point>] [--threads=<n>] [--pyramid] [--plot=hpgl|gcode] "
+                            "[--compress[=<1-9>]] [--uring] [--max-insts=<n>] [--max-segments=<n>] "
+                            "[--max-time=<seconds>] [--max-memory=<MB>] <input> <output>\n"
+                            "       interp --estimate <input>\n");
+            return ARGS_ERR;
+        }
+    }
+    /* the number of options */
+    return i - 1;
+}
+
+/**
+ *  Checks that every option given that only some backends take is one of
+ *  takes, the OPT_FOO of the backend writing what output. Returns 0 if so,
+ *  else reports the first that is not and returns ARGS_ERR.
+ */
+int backend_takes(Options *opts, int takes, char *what) {
+    char *names[] = { "--compact", "--simplify", "--dedup", "--ps-mode", "--max-path",
+                      "--threads", "--image", "--scale", "--pyramid", "--plot" };
+    int i;
+    for (i=0; i<(int)(sizeof(names)/sizeof(*names)); i++) {
+        if ((opts->given & ~takes) & (1 << i)) {
+            fprintf(stderr, "Error: %s is not an option for %s output\n", names[i], what);
+            return ARGS_ERR;
+        }
+    }
+    return 0;
+}
+
 /**
  *  Verifies command line arguments and returns the input and output
  *  filenames as a string
@@ -740,7 +1338,7 @@ int get_filenames(int argc, char * argv[], char *input, char *output) {
     /* check for input */
     if (argc != NUM_ARGS) {
         fprintf(stderr, "Error: Requires two arguments.\n");
-        fprintf(stderr, "Usage: interp <input> <output>\n");
+        fprintf(stderr, "Usage: interp [options] <input> <output>\n");
         return ARGS_ERR;
     }
     
@@ -753,3 +1351,26 @@ int get_filenames(int argc, char * argv[], char *input, char *output) {
     }
     return 0;
 }
+
+/**
+ *  Numbers filename for program num, "out.ps" becoming "out-2.ps" for the
+ *  second program. Returns 0 on success, ARGS_ERR if it is too long
+ */
+int numbered_filename(char *filename, int num, char *output) {
+    char *dot, *slash;
+    int base, len;
+    dot = strrchr(filename, '.');
+    slash = strrchr(filename, '/');
+    /* the extension is after the last dot in the last part of the path */
+    if (dot == NULL || (slash != NULL && dot < slash) || dot == filename) {
+        base = strlen(filename);
+    } else {
+        base = dot - filename;
+    }
+    len = snprintf(output, FILENAME_LENGTH, "%.*s-%d%s", base, filename, num, filename + base);
+    if (len < 0 || len >= FILENAME_LENGTH) {
+        fprintf(stderr, "Error: output filename %s is too long\n", filename);
+        return ARGS_ERR;
+    }
+    return 0;
+}
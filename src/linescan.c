@@ -0,0 +1,165 @@
+/*
+ *  linescan.c
+ *  Vectorised line splitting and whitespace trimming
+ *
+ *  Newlines and whitespace are looked for a whole vector at a time, 32
+ *  bytes with AVX2 or 16 bytes with SSE2, depending on what the compiler
+ *  targets. Build with -mavx2 for the AVX2 version, or -DLS_SCALAR for the
+ *  plain byte at a time version used on other machines.
+ *
+ *  Whitespace is what isspace() accepts in the C locale.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include "linescan.h"
+
+#if !defined(LS_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define LS_WIDTH        32
+#define LS_ALL          0xffffffffu
+#define VEC             __m256i
+#define vload(P)        _mm256_loadu_si256((const __m256i *) (P))
+#define vset(C)         _mm256_set1_epi8(C)
+#define veq(A,B)        _mm256_cmpeq_epi8(A, B)
+#define vor(A,B)        _mm256_or_si256(A, B)
+#define vsub(A,B)       _mm256_sub_epi8(A, B)
+#define vmin(A,B)       _mm256_min_epu8(A, B)
+#define vmask(A)        ((unsigned) _mm256_movemask_epi8(A))
+#elif !defined(LS_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define LS_WIDTH        16
+#define LS_ALL          0xffffu
+#define VEC             __m128i
+#define vload(P)        _mm_loadu_si128((const __m128i *) (P))
+#define vset(C)         _mm_set1_epi8(C)
+#define veq(A,B)        _mm_cmpeq_epi8(A, B)
+#define vor(A,B)        _mm_or_si128(A, B)
+#define vsub(A,B)       _mm_sub_epi8(A, B)
+#define vmin(A,B)       _mm_min_epu8(A, B)
+#define vmask(A)        ((unsigned) _mm_movemask_epi8(A))
+#else
+#define LS_WIDTH        1
+#endif
+
+/* ' ', or '\t' to '\r' */
+#define is_space(C)     ((C) == ' ' || (unsigned char) ((C) - '\t') <= '\r' - '\t')
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+#if LS_WIDTH > 1
+/**
+ *  Returns a bit mask of the newlines in the vector at p
+ */
+static unsigned newline_mask(const char *p) {
+    return vmask(veq(vload(p), vset('\n')));
+}
+
+/**
+ *  Returns a bit mask of the whitespace in the vector at p
+ */
+static unsigned space_mask(const char *p) {
+    VEC v = vload(p);
+    VEC ctrl = vsub(v, vset('\t'));
+    /* '\t' to '\r' are the bytes where v - '\t' <= 4 as unsigned */
+    ctrl = veq(vmin(ctrl, vset('\r' - '\t')), ctrl);
+    return vmask(vor(veq(v, vset(' ')), ctrl));
+}
+#endif
+
+/********************************************
+ Scanning
+ ********************************************/
+
+/**
+ *  Returns the number of bytes looked at in one go, 1 for the scalar version
+ */
+int ls_width(void) {
+    return LS_WIDTH;
+}
+
+/**
+ *  Returns the first newline in [p, end), or end if there is none
+ */
+char * ls_find_newline(const char *p, const char *end) {
+#if LS_WIDTH > 1
+    unsigned m;
+    while (end - p >= LS_WIDTH) {
+        m = newline_mask(p);
+        if (m != 0) {
+            return (char *) p + __builtin_ctz(m);
+        }
+        p = p + LS_WIDTH;
+    }
+#endif
+    while (p < end && *p != '\n') {
+        p = p + 1;
+    }
+    return (char *) p;
+}
+
+/**
+ *  Returns the first non whitespace byte in [p, end), or end if there is none
+ */
+char * ls_skip_space(const char *p, const char *end) {
+#if LS_WIDTH > 1
+    unsigned m;
+    while (end - p >= LS_WIDTH) {
+        m = ~space_mask(p) & LS_ALL;
+        if (m != 0) {
+            return (char *) p + __builtin_ctz(m);
+        }
+        p = p + LS_WIDTH;
+    }
+#endif
+    while (p < end && is_space(*p)) {
+        p = p + 1;
+    }
+    return (char *) p;
+}
+
+/**
+ *  Returns one past the last non whitespace byte in [start, end), or start
+ *  if there is none
+ */
+char * ls_trim_end(const char *start, const char *end) {
+#if LS_WIDTH > 1
+    unsigned m;
+    while (end - start >= LS_WIDTH) {
+        m = ~space_mask(end - LS_WIDTH) & LS_ALL;
+        if (m != 0) {
+            return (char *) end - LS_WIDTH + (32 - __builtin_clz(m));
+        }
+        end = end - LS_WIDTH;
+    }
+#endif
+    while (end > start && is_space(*(end-1))) {
+        end = end - 1;
+    }
+    return (char *) end;
+}
+
+/**
+ *  Splits off the line starting at p, which is at most max bytes long
+ *  including its newline, like fgets() with a max+1 buffer. The trimmed line
+ *  is put in *view. Returns the start of the next line.
+ */
+char * ls_next_line(const char *p, const char *end, int max, LineView *view) {
+    const char *next, *start;
+    if (end - p > max) {
+        end = p + max;
+    }
+    next = ls_find_newline(p, end);
+    if (next < end) {
+        /* include the newline */
+        next = next + 1;
+    }
+    start = ls_skip_space(p, next);
+    view->start = start;
+    view->len = ls_trim_end(start, next) - start;
+    return (char *) next;
+}
@@ -0,0 +1,329 @@
+/*
+ *  mtscan.c
+ *  Multi-threaded scanning of memory mapped input files
+ *
+ *  A free-form instruction may run over several lines, so there is no
+ *  telling where one starts without reading everything before it. The
+ *  input is split anyway at lines starting with what looks like an
+ *  instruction, and each chunk read with tok_next() on a thread of its
+ *  own. The chunks are then stitched together in order, each trusted only
+ *  if the one before it ended where it started. From the first that
+ *  cannot be trusted the rest of the input is read again on the calling
+ *  thread, which is also where errors are reported.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for fileno, mmap and sysconf */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mtscan.h"
+#include "linescan.h" /* for finding newlines */
+#include "tokens.h"   /* for reading instructions */
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Returns 1 if the token at p looks like the start of an instruction, that
+ *  is a "}" or a keyword that is not an operand of DO
+ */
+static int instruction_start(const char *p, const char *end) {
+    int len = (end - p > 3) ? 3 : end - p;
+    if (*p == '}') {
+        return 1;
+    } else if (len >= 2 && (memcmp(p, "FD", 2) == 0 || memcmp(p, "LT", 2) == 0 ||
+                            memcmp(p, "RT", 2) == 0 || memcmp(p, "DO", 2) == 0)) {
+        return len == 2 || ls_skip_space(p + 2, end) > p + 2;
+    } else if (len == 3 && memcmp(p, "SET", 3) == 0) {
+        return end - p == 3 || ls_skip_space(p + 3, end) > p + 3;
+    }
+    return 0;
+}
+
+/**
+ *  Adds the instruction just read by r to the lines of the chunk, as a line
+ *  of scan_file(). Returns -1 when out of memory.
+ */
+static int add_line(Chunk *chunk, TokReader *r) {
+    char **lines;
+    int *nums;
+    if (chunk->num_lines == chunk->cap_lines) {
+        chunk->cap_lines = (chunk->cap_lines == 0) ? 64 : chunk->cap_lines * 2;
+        lines = (char **) realloc (chunk->lines, chunk->cap_lines * sizeof(char *));
+        if (lines == NULL) {
+            return -1;
+        }
+        chunk->lines = lines;
+        nums = (int *) realloc (chunk->line_nums, chunk->cap_lines * sizeof(int));
+        if (nums == NULL) {
+            return -1;
+        }
+        chunk->line_nums = nums;
+    }
+    chunk->lines[chunk->num_lines] = (char *) calloc (MT_LINE_LENGTH, sizeof(char));
+    if (chunk->lines[chunk->num_lines] == NULL) {
+        return -1;
+    }
+    memcpy(chunk->lines[chunk->num_lines], r->inst, r->len);
+    chunk->line_nums[chunk->num_lines] = r->first;
+    chunk->num_lines = chunk->num_lines + 1;
+    return 0;
+}
+
+/**
+ *  Thread function reading the instructions starting in a chunk
+ */
+static void * lex_chunk(void *arg) {
+    Chunk *chunk = (Chunk *) arg;
+    TokReader r;
+    int ret;
+    tok_start(&r, chunk->start, chunk->limit - chunk->start);
+    r.quiet = chunk->quiet;
+    chunk->newlines = mt_count_lines(chunk->start, chunk->end);
+    while (ls_skip_space(r.p, r.end) < chunk->end) {
+        if ((ret = tok_next(&r)) < 0) {
+            chunk->too_long = 1;
+            break;
+        }
+        if (add_line(chunk, &r) < 0) {
+            chunk->error = 1;
+            break;
+        }
+    }
+    chunk->stop = r.p;
+    chunk->stop_line = r.line - 1;
+    return NULL;
+}
+
+/**
+ *  Frees the lines of a chunk
+ */
+static void free_chunk(Chunk *chunk) {
+    free_lines(chunk->lines, chunk->num_lines);
+    free(chunk->line_nums);
+}
+
+/********************************************
+ Memory Mapping
+ ********************************************/
+
+/**
+ *  Maps an open file into memory. Returns NULL if the file cannot be mapped,
+ *  for example when it is empty or not a regular file.
+ */
+char * map_file(FILE *file, size_t *size) {
+    struct stat st;
+    void *map;
+    if (fstat(fileno(file), &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return NULL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    *size = st.st_size;
+    return (char *) map;
+}
+
+/**
+ *  Unmaps a file mapped with map_file()
+ */
+void unmap_file(char *map, size_t size) {
+    munmap(map, size);
+}
+
+/********************************************
+ Scanning
+ ********************************************/
+
+/**
+ *  Returns the number of threads worth using for an input of the given size
+ */
+int mt_threads(size_t size) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n = size / MT_MIN_CHUNK;
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    if (n > (size_t) cpus) {
+        n = cpus;
+    }
+    if (n > MT_MAX_THREADS) {
+        n = MT_MAX_THREADS;
+    }
+    return (n < 1) ? 1 : (int) n;
+}
+
+/**
+ *  Returns the number of newlines in [p, end)
+ */
+int mt_count_lines(const char *p, const char *end) {
+    int count = 0;
+    while ((p = ls_find_newline(p, end)) < end) {
+        count = count + 1;
+        p = p + 1;
+    }
+    return count;
+}
+
+/**
+ *  Splits buf into n chunks of roughly the same size, the i-th being
+ *  [bounds[i], bounds[i+1]). Every chunk apart from the first starts on
+ *  the first token of a line that looks like the start of an instruction,
+ *  or is empty at the end of buf.
+ */
+void mt_split(const char *buf, size_t size, const char **bounds, int n) {
+    const char *end = buf + size, *p = buf, *nl;
+    int i;
+    bounds[0] = buf;
+    for (i=1; i<n; i++) {
+        if (p < buf + size / n * i) {
+            p = buf + size / n * i;
+        }
+        /* move the boundary on to the next line starting an instruction */
+        do {
+            nl = ls_find_newline(p, end);
+            p = (nl == end) ? end : ls_skip_space(nl + 1, end);
+        } while (p < end && !instruction_start(p, end));
+        bounds[i] = p;
+    }
+    bounds[n] = end;
+}
+
+/**
+ *  Runs func on each of the n items of item_size bytes, one thread per
+ *  item. Items that no thread could be started for are run on the calling
+ *  thread.
+ */
+void mt_run(void *items, size_t item_size, int n, void *(*func)(void *)) {
+    pthread_t threads[MT_MAX_THREADS];
+    char *item = (char *) items;
+    int i, started;
+    if (n == 1) {
+        /* no point spawning a thread for a single item */
+        func(item);
+        return;
+    }
+    for (started=0; started<n; started++) {
+        if (pthread_create(&threads[started], NULL, func, item + started * item_size) != 0) {
+            break;
+        }
+    }
+    for (i=0; i<started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    /* do whatever could not be threaded on this thread */
+    for (i=started; i<n; i++) {
+        func(item + i * item_size);
+    }
+}
+
+/**
+ *  Reads the program in buf into an array of lines, one instruction per
+ *  line, exactly like scan_file() does, using nthreads threads. Returns the
+ *  lines, *num_lines of them counting the empty line at the end, and in
+ *  *line_nums the line number in buf of each. Returns NULL when out of
+ *  memory, or when an instruction is too long for a line, which is
+ *  reported and *num_lines set to TOK_TOO_LONG.
+ */
+char ** mt_scan(const char *buf, size_t size, int nthreads, int *num_lines, int **line_nums) {
+    const char *bounds[MT_MAX_THREADS + 1];
+    Chunk chunks[MT_MAX_THREADS + 1];
+    const char *stop = buf;
+    char **lines = NULL;
+    int *nums = NULL;
+    int i, j, k, n, count, line = 0, stop_line = 0, offsets[MT_MAX_THREADS + 1];
+
+    n = (nthreads > MT_MAX_THREADS) ? MT_MAX_THREADS : (nthreads < 1) ? 1 : nthreads;
+    mt_split(buf, size, bounds, n);
+    memset(chunks, 0, sizeof(chunks));
+    for (i=0; i<n; i++) {
+        chunks[i].start = bounds[i];
+        chunks[i].end = bounds[i+1];
+        chunks[i].limit = buf + size;
+        chunks[i].quiet = 1;
+    }
+    mt_run(chunks, sizeof(Chunk), n, lex_chunk);
+
+    /* stitch, trusting each chunk that starts where the one before ended */
+    for (k=0; k<n; k++) {
+        if (stop > chunks[k].start || chunks[k].too_long || chunks[k].error) {
+            break;
+        }
+        offsets[k] = line;
+        stop = chunks[k].stop;
+        stop_line = line + chunks[k].stop_line;
+        line = line + chunks[k].newlines;
+    }
+    if (k < n) {
+        /* read the rest again from where the last trusted chunk ended */
+        if (stop <= chunks[k].start) {
+            stop = chunks[k].start;
+            stop_line = line;
+        }
+        for (i=k; i<n; i++) {
+            free_chunk(&chunks[i]);
+        }
+        memset(&chunks[k], 0, sizeof(Chunk));
+        chunks[k].start = stop;
+        chunks[k].end = buf + size;
+        chunks[k].limit = buf + size;
+        lex_chunk(&chunks[k]);
+        offsets[k] = stop_line;
+        line = stop_line + chunks[k].newlines;
+        n = k + 1;
+    }
+    for (i=0, count=0; i<n; i++) {
+        count = count + chunks[i].num_lines;
+    }
+    if (!chunks[n-1].too_long && !chunks[n-1].error) {
+        /* scan_file() always has an empty line at the end */
+        lines = (char **) calloc (count + 1, sizeof(char *));
+        nums = (int *) malloc ((count + 1) * sizeof(int));
+    }
+    if (lines == NULL || nums == NULL ||
+        (lines[count] = (char *) calloc (MT_LINE_LENGTH, sizeof(char))) == NULL) {
+        *num_lines = chunks[n-1].too_long ? TOK_TOO_LONG : 0;
+        for (i=0; i<n; i++) {
+            free_chunk(&chunks[i]);
+        }
+        free(lines);
+        free(nums);
+        return NULL;
+    }
+    for (i=0, count=0; i<n; i++) {
+        for (j=0; j<chunks[i].num_lines; j++) {
+            lines[count] = chunks[i].lines[j];
+            nums[count] = offsets[i] + chunks[i].line_nums[j];
+            count = count + 1;
+        }
+        free(chunks[i].lines);
+        free(chunks[i].line_nums);
+    }
+    /* the empty line at the end is one after the last line */
+    nums[count] = line + 1 + ((size > 0 && buf[size-1] != '\n') ? 1 : 0);
+    *num_lines = count + 1;
+    *line_nums = nums;
+    return lines;
+}
+
+/**
+ *  Frees a lines array, some of which may not have been allocated
+ */
+void free_lines(char **lines, int num_lines) {
+    int i;
+    for (i=0; i<num_lines; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+}
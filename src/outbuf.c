@@ -0,0 +1,729 @@
+/*
+ *  outbuf.c
+ *  Buffered output writer
+ *
+ *  Output is collected in one large buffer and written with a single
+ *  write() when it fills up, instead of going through fprintf() for every
+ *  drawing operation. Numbers are formatted by hand.
+ *
+ *  Compressed output is gzipped by a thread of its own. A full buffer is
+ *  handed to the thread, which deflates and writes it while the other
+ *  buffer is filled, so the interpreter only waits if it gets a whole
+ *  buffer ahead. Output that is not compressed can be handed to a thread
+ *  in the same way, to be written while the next buffer is formatted.
+ *
+ *  Or the buffers can be written through an io_uring, set up with raw
+ *  system calls. A few buffers are registered with the kernel, and each
+ *  one filled is queued as a write at its offset in the file, submitted
+ *  a batch at a time, while the next is filled. Where there is no
+ *  io_uring, the buffer is written with pwrite() instead.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for fileno and write */
+#define _DEFAULT_SOURCE         /* for syscall */
+
+#include <errno.h>
+#include <float.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>   /* for compressed output */
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+#include "outbuf.h"
+
+#define FIXED2_MAX      1e15    /* larger numbers go to snprintf() */
+#define NUM_LENGTH      32      /* enough for any int, or a fixed2 number below FIXED2_MAX */
+#define FIXED2_LENGTH   (DBL_MAX_10_EXP + 6)    /* enough for any double as "%.2f" */
+#define GZIP_BITS       (15 + 16)   /* the largest window, with a gzip wrapper */
+#define OB_ALIGN        4096        /* buffers of an io_uring start on a page */
+
+/* the thread writing out a buffer. full is the buffer handed to it,
+   which it sets back to NULL once the buffer is written out. spare is
+   the buffer not being filled, which is full while the thread has it */
+struct _obzip {
+    int level;              /* zlib level, or 0 to write the bytes as they are */
+    z_stream z;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* full has been handed over or given back */
+    char *full;
+    size_t full_len;
+    int finish;             /* full is the last of the output */
+    char *spare;
+    unsigned char *zbuf;    /* compressed output on its way out */
+    int error;              /* set once a write fails */
+};
+
+/* an io_uring writing out buffers, or pwrite() if fd is -1. the rings are
+   shared with the kernel: it moves the sq head and cq tail, we move the
+   sq tail and cq head. the buffers are written at base + their offset in
+   the output, and a write cut short is queued again for the rest */
+struct _obring {
+    int fd;
+    long long base;         /* file offset the output starts at */
+    char *bufs;             /* OB_RING_BUFS buffers of OB_SIZE */
+    int cur;                /* buffer being filled */
+    int busy[OB_RING_BUFS]; /* set while a buffer is queued or being written */
+    size_t left[OB_RING_BUFS];      /* bytes of it still to write */
+    long long off[OB_RING_BUFS];    /* where they go */
+    size_t sent[OB_RING_BUFS];      /* bytes of it written */
+    int fixed;              /* the buffers are registered with the kernel */
+    unsigned queued;        /* writes not yet submitted */
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    void *sq_ring, *cq_ring, *sqes_map;
+    size_t sq_size, cq_size, sqes_size;
+#ifdef __linux__
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+#endif
+    int error;              /* set once a write fails */
+};
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Writes the digits of n backwards from end. Returns the first digit.
+ */
+static char * digits(char *end, unsigned long long n) {
+    do {
+        end = end - 1;
+        *end = '0' + n % 10;
+        n = n / 10;
+    } while (n > 0);
+    return end;
+}
+
+/**
+ *  Writes n bytes of p to fd. Returns -1 if the write fails.
+ */
+static int write_all(int fd, const char *p, size_t n) {
+    size_t done = 0;
+    ssize_t ret;
+    while (done < n) {
+        ret = write(fd, p + done, n - done);
+        if (ret < 0 && errno != EINTR) {
+            return -1;
+        } else if (ret > 0) {
+            done = done + ret;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Compresses each buffer handed over to it, unless at level 0, and writes
+ *  it out, until the last. Runs on a thread of its own.
+ */
+static void * deflate_buffers(void *arg) {
+    OutBuf ob = (OutBuf) arg;
+    ObZip zip = ob->zip;
+    size_t have;
+    int finish, error = 0;
+    do {
+        pthread_mutex_lock(&zip->lock);
+        while (zip->full == NULL) {
+            pthread_cond_wait(&zip->cond, &zip->lock);
+        }
+        finish = zip->finish;
+        pthread_mutex_unlock(&zip->lock);
+        zip->z.next_in = (unsigned char *) zip->full;
+        zip->z.avail_in = zip->full_len;
+        if (zip->level == 0 && !error && write_all(ob->fd, zip->full, zip->full_len) < 0) {
+            error = 1;
+        }
+        while (zip->level > 0) {
+            zip->z.next_out = zip->zbuf;
+            zip->z.avail_out = OB_ZCHUNK;
+            deflate(&zip->z, finish ? Z_FINISH : Z_NO_FLUSH);
+            have = OB_ZCHUNK - zip->z.avail_out;
+            if (!error && have > 0 && write_all(ob->fd, (char *) zip->zbuf, have) < 0) {
+                error = 1;
+            }
+            if (zip->z.avail_out != 0) {
+                break;
+            }
+        }
+        pthread_mutex_lock(&zip->lock);
+        zip->full = NULL;
+        zip->error = error;
+        pthread_cond_signal(&zip->cond);
+        pthread_mutex_unlock(&zip->lock);
+    } while (!finish);
+    return NULL;
+}
+
+/**
+ *  Hands the buffer to the thread once it has finished with the last,
+ *  and takes the spare to fill instead. Returns -1 if a write has failed.
+ */
+static int hand_over(OutBuf ob, int finish) {
+    ObZip zip = ob->zip;
+    char *buf = ob->buf;
+    pthread_mutex_lock(&zip->lock);
+    while (zip->full != NULL) {
+        pthread_cond_wait(&zip->cond, &zip->lock);
+    }
+    ob->error = ob->error || zip->error;
+    ob->buf = zip->spare;
+    zip->spare = buf;
+    zip->full = buf;
+    zip->full_len = ob->len;
+    zip->finish = finish;
+    pthread_cond_signal(&zip->cond);
+    pthread_mutex_unlock(&zip->lock);
+    return ob->error ? -1 : 0;
+}
+
+/**
+ *  Frees the writer of ob, once its thread has stopped or if it never
+ *  started
+ */
+static void free_zip(OutBuf ob) {
+    ObZip zip = ob->zip;
+    if (zip->level > 0) {
+        deflateEnd(&zip->z);
+    }
+    pthread_mutex_destroy(&zip->lock);
+    pthread_cond_destroy(&zip->cond);
+    free(zip->spare);
+    free(zip->zbuf);
+    free(zip);
+    ob->zip = NULL;
+}
+
+/********************************************
+ io_uring
+ ********************************************/
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+
+#define RING_ENTRIES    (2 * OB_RING_BUFS)
+
+/**
+ *  Submits the writes queued, waiting for at least wait of them to finish.
+ *  Returns -1 on error.
+ */
+static int ring_enter(ObRing r, unsigned wait) {
+    long ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, r->fd, r->queued, wait,
+                      wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        return -1;
+    }
+    r->queued = r->queued - (unsigned) ret;
+    return 0;
+}
+
+/**
+ *  Queues the write of the rest of buffer i, submitting it with the others
+ *  queued once there are OB_RING_BATCH
+ */
+static void ring_queue(OutBuf ob, int i) {
+    ObRing r = ob->ring;
+    unsigned tail = *r->sq_tail, index = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = r->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = ob->fd;
+    sqe->addr = (unsigned long) (r->bufs + (size_t) i * OB_SIZE + r->sent[i]);
+    sqe->len = (unsigned) r->left[i];
+    sqe->off = (unsigned long long) (r->off[i] + r->sent[i]);
+    sqe->buf_index = (unsigned short) i;
+    sqe->user_data = (unsigned long long) i;
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->queued = r->queued + 1;
+    if (r->queued >= OB_RING_BATCH && ring_enter(r, 0) < 0) {
+        r->error = 1;
+    }
+}
+
+/**
+ *  Takes the writes that have finished off the completion ring, queueing
+ *  again any cut short. Returns the number finished.
+ */
+static int ring_reap(OutBuf ob) {
+    ObRing r = ob->ring;
+    unsigned head = *r->cq_head;
+    struct io_uring_cqe *cqe;
+    int i, n = 0;
+    while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+        cqe = &r->cqes[head & *r->cq_mask];
+        i = (int) cqe->user_data;
+        if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+            ring_queue(ob, i);
+        } else if (cqe->res <= 0) {
+            r->error = 1;
+            r->busy[i] = 0;
+        } else if ((size_t) cqe->res < r->left[i]) {
+            r->sent[i] = r->sent[i] + cqe->res;
+            r->left[i] = r->left[i] - cqe->res;
+            ring_queue(ob, i);
+        } else {
+            r->busy[i] = 0;
+        }
+        head = head + 1;
+        n = n + 1;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+/**
+ *  Waits until buffer i has been written
+ */
+static void ring_wait(OutBuf ob, int i) {
+    ObRing r = ob->ring;
+    while (r->busy[i] && !r->error) {
+        if (ring_reap(ob) == 0 && ring_enter(r, 1) < 0) {
+            r->error = 1;
+        }
+    }
+}
+
+/**
+ *  Sets up an io_uring for r, with its buffers registered if the kernel
+ *  lets them be. Returns -1 if there is no io_uring to be had.
+ */
+static int ring_setup(ObRing r) {
+    struct io_uring_params p;
+    struct iovec iov[OB_RING_BUFS];
+    int i;
+    memset(&p, 0, sizeof(p));
+    r->fd = (int) syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+    if (r->fd < 0) {
+        return -1;
+    }
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sq_ring = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      r->fd, IORING_OFF_SQ_RING);
+    r->cq_ring = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      r->fd, IORING_OFF_CQ_RING);
+    r->sqes_map = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       r->fd, IORING_OFF_SQES);
+    if (r->sq_ring == MAP_FAILED || r->cq_ring == MAP_FAILED || r->sqes_map == MAP_FAILED) {
+        return -1;
+    }
+    r->sq_tail = (unsigned *) ((char *) r->sq_ring + p.sq_off.tail);
+    r->sq_mask = (unsigned *) ((char *) r->sq_ring + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *) ((char *) r->sq_ring + p.sq_off.array);
+    r->cq_head = (unsigned *) ((char *) r->cq_ring + p.cq_off.head);
+    r->cq_tail = (unsigned *) ((char *) r->cq_ring + p.cq_off.tail);
+    r->cq_mask = (unsigned *) ((char *) r->cq_ring + p.cq_off.ring_mask);
+    r->sqes = (struct io_uring_sqe *) r->sqes_map;
+    r->cqes = (struct io_uring_cqe *) ((char *) r->cq_ring + p.cq_off.cqes);
+    for (i=0; i<OB_RING_BUFS; i++) {
+        iov[i].iov_base = r->bufs + (size_t) i * OB_SIZE;
+        iov[i].iov_len = OB_SIZE;
+    }
+    /* pinning the buffers may be over the locked memory limit */
+    r->fixed = (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS,
+                        iov, OB_RING_BUFS) == 0);
+    return 0;
+}
+
+/**
+ *  Unmaps and closes the io_uring of r, which may be partly set up
+ */
+static void ring_teardown(ObRing r) {
+    if (r->sq_ring != NULL && r->sq_ring != MAP_FAILED) {
+        munmap(r->sq_ring, r->sq_size);
+    }
+    if (r->cq_ring != NULL && r->cq_ring != MAP_FAILED) {
+        munmap(r->cq_ring, r->cq_size);
+    }
+    if (r->sqes_map != NULL && r->sqes_map != MAP_FAILED) {
+        munmap(r->sqes_map, r->sqes_size);
+    }
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+}
+
+#else
+
+/* no io_uring here, everything is written with pwrite() */
+static int ring_setup(ObRing r) { r->fd = -1; return -1; }
+static void ring_teardown(ObRing r) { }
+static void ring_queue(OutBuf ob, int i) { }
+static void ring_wait(OutBuf ob, int i) { }
+
+#endif
+
+/**
+ *  Writes n bytes of p at offset off of fd. Returns -1 if the write fails.
+ */
+static int pwrite_all(int fd, const char *p, size_t n, long long off) {
+    size_t done = 0;
+    ssize_t ret;
+    while (done < n) {
+        ret = pwrite(fd, p + done, n - done, (off_t) (off + done));
+        if (ret < 0 && errno != EINTR) {
+            return -1;
+        } else if (ret > 0) {
+            done = done + ret;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Queues the buffer to be written through the io_uring and moves on to
+ *  the next, once it has been written, or writes it with pwrite(). Returns
+ *  -1 if a write has failed.
+ */
+static int ring_flush(OutBuf ob) {
+    ObRing r = ob->ring;
+    int i = r->cur;
+    if (r->fd < 0) {
+        if (!ob->error && pwrite_all(ob->fd, ob->buf, ob->len, r->base + ob->done) < 0) {
+            r->error = 1;
+        }
+    } else if (ob->len > 0) {
+        r->busy[i] = 1;
+        r->left[i] = ob->len;
+        r->off[i] = r->base + ob->done;
+        r->sent[i] = 0;
+        ring_queue(ob, i);
+        r->cur = (i + 1) % OB_RING_BUFS;
+        ring_wait(ob, r->cur);
+        ob->buf = r->bufs + (size_t) r->cur * OB_SIZE;
+    }
+    ob->error = ob->error || r->error;
+    return ob->error ? -1 : 0;
+}
+
+/**
+ *  Waits for every write to finish and frees the io_uring of ob, leaving
+ *  the file where write() would have left it
+ */
+static void ring_close(OutBuf ob) {
+    ObRing r = ob->ring;
+    int i;
+    for (i=0; i<OB_RING_BUFS && r->fd >= 0; i++) {
+        ring_wait(ob, i);
+    }
+    ob->error = ob->error || r->error;
+    lseek(ob->fd, (off_t) (r->base + ob->done), SEEK_SET);
+    ring_teardown(r);
+    free(r->bufs);
+    free(r);
+    ob->ring = NULL;
+    ob->buf = NULL;
+}
+
+/********************************************
+ Buffer Handling
+ ********************************************/
+
+/**
+ *  Creates a buffer writing to file, which is flushed first. Returns NULL
+ *  when out of memory.
+ */
+OutBuf ob_new(FILE *file) {
+    OutBuf ob = (OutBuf) malloc (sizeof(*ob));
+    if (ob == NULL) {
+        return NULL;
+    }
+    ob->buf = (char *) malloc (OB_SIZE);
+    if (ob->buf == NULL) {
+        free(ob);
+        return NULL;
+    }
+    fflush(file);
+    ob->fd = fileno(file);
+    ob->len = 0;
+    ob->done = 0;
+    ob->error = 0;
+    ob->zip = NULL;
+    ob->ring = NULL;
+    return ob;
+}
+
+/**
+ *  Starts the thread writing out the buffer, compressing at the zlib level
+ *  given or not at level 0. Returns 0 on success, -1 when out of memory or
+ *  no thread can be started.
+ */
+static int start_writer(OutBuf ob, int level) {
+    ObZip zip = (ObZip) malloc (sizeof(*zip));
+    if (zip == NULL) {
+        return -1;
+    }
+    zip->level = level;
+    zip->spare = (char *) malloc (OB_SIZE);
+    zip->zbuf = (unsigned char *) malloc (OB_ZCHUNK);
+    zip->z.zalloc = Z_NULL;
+    zip->z.zfree = Z_NULL;
+    zip->z.opaque = Z_NULL;
+    if (zip->spare == NULL || zip->zbuf == NULL || (level > 0 &&
+        deflateInit2(&zip->z, level, Z_DEFLATED, GZIP_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)) {
+        free(zip->spare);
+        free(zip->zbuf);
+        free(zip);
+        return -1;
+    }
+    pthread_mutex_init(&zip->lock, NULL);
+    pthread_cond_init(&zip->cond, NULL);
+    zip->full = NULL;
+    zip->error = 0;
+    ob->zip = zip;
+    if (pthread_create(&zip->thread, NULL, deflate_buffers, ob) != 0) {
+        free_zip(ob);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *  Gzips everything written to the buffer from now on at the zlib level
+ *  given, from 1 to 9, on a thread of its own. Nothing should have been
+ *  written yet. Returns 0 on success, -1 when out of memory or no thread
+ *  can be started.
+ */
+int ob_compress(OutBuf ob, int level) {
+    return start_writer(ob, level);
+}
+
+/**
+ *  Writes out each full buffer on a thread of its own while the next is
+ *  filled, unless the buffer already has one. Returns 0 on success, -1
+ *  when out of memory or no thread can be started, when the buffer writes
+ *  itself as before.
+ */
+int ob_writer(OutBuf ob) {
+    if (ob->zip != NULL || ob->ring != NULL) {
+        return 0;
+    }
+    return start_writer(ob, 0);
+}
+
+/**
+ *  Writes out the buffers through an io_uring from now on, or with pwrite()
+ *  if there is no io_uring, unless it is compressed or has a writing thread
+ *  already. Returns 0 with an io_uring, 1 with pwrite(), or -1 if the file
+ *  cannot be written at an offset, as a pipe cannot, or when out of memory,
+ *  when the buffer writes itself as before.
+ */
+int ob_uring(OutBuf ob) {
+    ObRing r;
+    off_t base = lseek(ob->fd, 0, SEEK_CUR);
+    void *bufs;
+    if (ob->zip != NULL || ob->ring != NULL || base < 0) {
+        return -1;
+    }
+    r = (ObRing) calloc (1, sizeof(*r));
+    if (r == NULL || posix_memalign(&bufs, OB_ALIGN, (size_t) OB_RING_BUFS * OB_SIZE) != 0) {
+        free(r);
+        return -1;
+    }
+    r->bufs = (char *) bufs;
+    r->base = (long long) base;
+    if (ring_setup(r) < 0) {
+        /* pwrite() instead */
+        ring_teardown(r);
+        r->fd = -1;
+    }
+    memcpy(r->bufs, ob->buf, ob->len);
+    free(ob->buf);
+    ob->buf = r->bufs;
+    ob->ring = r;
+    return (r->fd < 0) ? 1 : 0;
+}
+
+/**
+ *  Writes out everything in the buffer. Returns 0 on success, -1 if this or
+ *  any earlier write failed.
+ */
+int ob_flush(OutBuf ob) {
+    if (ob->zip != NULL) {
+        /* written out by the thread */
+        hand_over(ob, 0);
+    } else if (ob->ring != NULL) {
+        ring_flush(ob);
+    } else if (!ob->error && write_all(ob->fd, ob->buf, ob->len) < 0) {
+        ob->error = 1;
+    }
+    ob->done = ob->done + ob->len;
+    ob->len = 0;
+    return ob->error ? -1 : 0;
+}
+
+/**
+ *  Flushes and frees the buffer, leaving the file open. Compressed output
+ *  is finished and its thread waited for. Returns 0 on success, -1 if any
+ *  write failed.
+ */
+int ob_close(OutBuf ob) {
+    int ret;
+    if (ob->zip != NULL) {
+        hand_over(ob, 1);
+        pthread_join(ob->zip->thread, NULL);
+        ob->error = ob->error || ob->zip->error;
+        free_zip(ob);
+        ob->len = 0;
+    }
+    if (ob->ring != NULL) {
+        ob_flush(ob);
+        ring_close(ob);
+    }
+    ret = ob_flush(ob);
+    free(ob->buf);
+    free(ob);
+    return ret;
+}
+
+/**
+ *  Returns the number of bytes written so far, including those still in
+ *  the buffer
+ */
+long long ob_tell(OutBuf ob) {
+    return ob->done + (long long) ob->len;
+}
+
+/********************************************
+ Writing
+ ********************************************/
+
+/**
+ *  Writes n bytes of s
+ */
+void ob_write(OutBuf ob, const char *s, size_t n) {
+    size_t len;
+    while (n > 0) {
+        if (ob->len == OB_SIZE) {
+            ob_flush(ob);
+        }
+        len = OB_SIZE - ob->len;
+        if (len > n) {
+            len = n;
+        }
+        memcpy(ob->buf + ob->len, s, len);
+        ob->len = ob->len + len;
+        s = s + len;
+        n = n - len;
+    }
+}
+
+/**
+ *  Writes the string s
+ */
+void ob_puts(OutBuf ob, const char *s) {
+    ob_write(ob, s, strlen(s));
+}
+
+/**
+ *  Writes n like "%d"
+ */
+void ob_int(OutBuf ob, int n) {
+    char num[NUM_LENGTH];
+    char *end = num + NUM_LENGTH, *p;
+    unsigned long long u = (n < 0) ? -(unsigned long long) n : (unsigned long long) n;
+    p = digits(end, u);
+    if (n < 0) {
+        p = p - 1;
+        *p = '-';
+    }
+    ob_write(ob, p, end - p);
+}
+
+/**
+ *  Writes n hundredths as a number with two decimals, with a "-" if neg
+ */
+static void put_cents(OutBuf ob, unsigned long long n, int neg) {
+    char num[NUM_LENGTH];
+    char *end = num + NUM_LENGTH, *p;
+    p = digits(end, n % 100);
+    if (n % 100 < 10) {
+        p = p - 1;
+        *p = '0';
+    }
+    p = p - 1;
+    *p = '.';
+    p = digits(p, n / 100);
+    if (neg) {
+        p = p - 1;
+        *p = '-';
+    }
+    ob_write(ob, p, end - p);
+}
+
+/**
+ *  Rounds mag, which is positive and a float times 100, to a whole number
+ *  the way printf() does, which is half to even
+ */
+static unsigned long long round_half_even(double mag) {
+    unsigned long long n = (unsigned long long) mag;
+    double frac = mag - (double) n;
+    if (frac > 0.5 || (frac == 0.5 && n % 2 == 1)) {
+        n = n + 1;
+    }
+    return n;
+}
+
+/**
+ *  Writes d exactly like "%.2f". This is done with integers when d is a
+ *  float, as every float times 100 is exact in a double, so the rounding is
+ *  exact too. Anything else goes to snprintf().
+ */
+void ob_fixed2(OutBuf ob, double d) {
+    char num[FIXED2_LENGTH];
+    int n;
+
+    if (!(d > -FIXED2_MAX && d < FIXED2_MAX) || (double) (float) d != d) {
+        n = snprintf(num, FIXED2_LENGTH, "%.2f", d);
+        ob_write(ob, num, n);
+        return;
+    }
+    /* printf() keeps the sign of -0.0 and of anything rounding to it */
+    if (d < 0 || (d == 0 && 1 / d < 0)) {
+        put_cents(ob, round_half_even(-d * 100), 1);
+    } else {
+        put_cents(ob, round_half_even(d * 100), 0);
+    }
+}
+
+/**
+ *  Writes cents hundredths like ob_fixed2() would write cents / 100
+ */
+void ob_cents(OutBuf ob, long long cents) {
+    if (cents < 0) {
+        put_cents(ob, -(unsigned long long) cents, 1);
+    } else {
+        put_cents(ob, cents, 0);
+    }
+}
+
+/**
+ *  Puts d in hundredths into *cents, rounded like ob_fixed2() prints it.
+ *  Returns -1 if d is not a float that can be rounded exactly.
+ */
+int ob_to_cents(double d, long long *cents) {
+    if (!(d > -FIXED2_MAX && d < FIXED2_MAX) || (double) (float) d != d) {
+        return -1;
+    }
+    if (d < 0) {
+        *cents = -(long long) round_half_even(-d * 100);
+    } else {
+        *cents = round_half_even(d * 100);
+    }
+    return 0;
+}
@@ -12,9 +12,13 @@
 #include <stdlib.h> /* malloc and EXIT_FOO */
 #include <string.h> /* strcmp, strcpy, etc */
 #include "parser.h"
+#include "mtscan.h"   /* for mapping the input file */
+#include "dfa.h"      /* for validating the mapped input */
+#include "linescan.h" /* for trimming lines */
+#include "tokens.h"   /* for free-form programs */
 #include "intercept.h" /* for intercepting malloc and testing */
 
-#define DEBUG_DATA  input->lines[input->counter], input->counter+1
+#define DEBUG_DATA  input->lines[input->counter], line_num(input)
 
 /********************************************
  Parser Main Function
@@ -24,6 +28,9 @@ int parse_main(int argc, char * argv[]) {
     char filename[FILENAME_LENGTH];
     FILE *in_file; /* input file handle */
     Logo input;    /* data structure to store input lines */ 
+    char *map;     /* the mapped input file */
+    size_t size;
+    int ret;
     
     /* get and open the file */
     if (get_filename(argc, argv, filename) < 0) {
@@ -38,25 +45,33 @@ int parse_main(int argc, char * argv[]) {
         return EXIT_FAILURE;
     }
     
-    /* populate input */
-    input = scan_file(in_file);
-    fclose(in_file);
-    if (input == NULL) {
-        /* out of memory */
-        fprintf(stderr, "Error: cannot allocate memory for reading input file\n");
-        return EXIT_FAILURE;
+    /* validate a mapped file in one pass, otherwise fall back to parse() */
+    map = map_file(in_file, &size);
+    if (map != NULL) {
+        ret = dfa_validate(map, size, mt_threads(size));
+        unmap_file(map, size);
+        fclose(in_file);
+    } else {
+        /* populate input */
+        input = scan_file(in_file);
+        fclose(in_file);
+        if (input == NULL) {
+            /* out of memory, or an instruction too long, which is reported */
+            fprintf(stderr, "Error: failed to read %s\n", filename);
+            return EXIT_FAILURE;
+        }
+        ret = parse(input);
+        /* free the input structure */
+        free_logo(input);
     }
     
-    if (parse(input) < 0) {
+    if (ret == MEM_ERR) {
+        return EXIT_FAILURE;
+    } else if (ret < 0) {
         fprintf(stderr, "Error: failed to parse %s\n", filename);
-        /* free the input structure */
-        free_logo(input);
         return EXIT_FAILURE;
     }
     printf("Successfully parsed %s\n", filename);
-
-    /* free the input structure */
-    free_logo(input);
     return EXIT_SUCCESS;
 }
 
@@ -82,6 +97,33 @@ static int chk_inst(Logo input) {
     return 0;
 }
 
+/**
+ *  Reads everything left in in_file into memory. Returns the buffer and its
+ *  size in *size, or NULL when out of memory.
+ */
+static char * read_all(FILE * in_file, size_t *size) {
+    char *buffer, *bigger;
+    size_t cap = READ_LENGTH, n;
+    buffer = (char *) malloc (cap * sizeof(char));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    *size = 0;
+    while ((n = fread(buffer + *size, sizeof(char), cap - *size, in_file)) > 0) {
+        *size = *size + n;
+        if (*size == cap) {
+            cap = cap * 2;
+            bigger = (char *) realloc (buffer, cap * sizeof(char));
+            if (bigger == NULL) {
+                free(buffer);
+                return NULL;
+            }
+            buffer = bigger;
+        }
+    }
+    return buffer;
+}
+
 /********************************************
  Parser Functions
  ********************************************/
@@ -141,7 +183,7 @@ int instrctlst(Logo input) {
     }
     input->counter = input->counter + 1;
     if (input->counter > input->num_lines-1) {
-        fprintf(stderr, "Error: expected '}' on line %d\n", input->counter+1);
+        fprintf(stderr, "Error: expected '}' on line %d\n", line_num(input));
         return PARSE_ERR;
     }
     return instrctlst(input);
@@ -251,7 +293,7 @@ int dologo(Logo input) {
     }
     /* check the <VAR> token */
     if (is_var(var) != 1) {
-        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, input->counter+1);
+        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, line_num(input));
         return PARSE_ERR;
     }
     /* check syntax for DO, FROM and TO */
@@ -289,7 +331,7 @@ int varnum(char * operand, Logo input) {
             if (isdigit(operand[i]) < 1 &&
                 operand[i] != '.' &&
                 operand[i] != '-') {
-                fprintf(stderr, "Error: expected number or a <VAR> but got '%s' on line %d\n", operand, input->counter+1);
+                fprintf(stderr, "Error: expected number or a <VAR> but got '%s' on line %d\n", operand, line_num(input));
                 return PARSE_ERR;
             }
         }
@@ -310,7 +352,7 @@ int set(Logo input) {
     }
     /* check that var is correct */
     if (is_var(var) != 1) {
-        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, input->counter+1);
+        fprintf(stderr, "Error: incorrect <VAR> '%s' on line %d\n", var, line_num(input));
         return PARSE_ERR;
     }
     /* check the syntax */
@@ -363,6 +405,19 @@ int polish(char * po, Logo input) {
  Parser Helper Functions
  ********************************************/
 
+/**
+ *  Returns the line number in the input file of the current line
+ */
+int line_num(Logo input) {
+    if (input->line_nums == NULL) {
+        return input->counter + 1;
+    } else if (input->counter >= input->num_lines) {
+        /* past the end */
+        return input->line_nums[input->num_lines - 1] + 1;
+    }
+    return input->line_nums[input->counter];
+}
+
 /**
  *  Returns 1 if the string var is a correct <VAR> ([A-Z]), else 0
  */
@@ -394,18 +449,10 @@ int is_op(char * op) {
  *  Removes leading and trailing whitespace from a string
  */
 char * trim_space(char *str) {
-    char *end;
-    /* skip leading whitespace */
-    while (isspace(*str)) {
-        str = str + 1;
-    }
-    /* remove trailing whitespace */
-    end = str + strlen(str) - 1;
-    while (end > str && isspace(*end)) {
-        end = end - 1;
-    }
-    /* write null character */
-    *(end+1) = '\0';
+    char *end = str + strlen(str);
+    str = ls_skip_space(str, end);
+    /* write null character after the last non whitespace */
+    *ls_trim_end(str, end) = '\0';
     return str;
 }
 
@@ -417,57 +464,59 @@ char * trim_space(char *str) {
  *  Scans the input file and creates a data structure to store its content
  */
 Logo scan_file(FILE * in_file) {
-    int i, count;
-    char line[LINE_LENGTH];
-    char *trimmed;
+    int i;
+    char *buffer, *text, *p, *next;
+    size_t size, text_size;
     Logo input;
     
-    /* count the number of lines */
-    count = 0;
-    while (fgets(line, sizeof(line), in_file) != NULL) {
-        count = count + 1;
-    }
-    count = count + 1; /* count is offset by 1 */
-    
     /* malloc the data structure */
     input = (Logo) malloc (sizeof(*input));
     if (input == NULL) {
         return NULL;
     }
-    input->lines = (char **) malloc (count * sizeof(char *));
+    /* read it all, the lines of a free-form program mean nothing yet */
+    buffer = read_all(in_file, &size);
+    if (buffer == NULL) {
+        free(input);
+        return NULL;
+    }
+    /* rewrite it with one instruction per line */
+    text = tok_normalise(buffer, size, &text_size, &(input->line_nums), &(input->num_lines));
+    free(buffer);
+    if (text == NULL) {
+        free(input);
+        return NULL;
+    }
+    /* there is always an empty line at the end */
+    input->num_lines = input->num_lines + 1;
+    input->lines = (char **) malloc (input->num_lines * sizeof(char *));
     if (input->lines == NULL) {
         /* free input */
+        free(text);
+        free(input->line_nums);
         free(input);
         return NULL;
     }
-    for (i=0; i<count; i++) {
+    p = text;
+    for (i=0; i<input->num_lines; i++) {
         /* could call calloc here but more test code will be needed */
         input->lines[i] = (char *) malloc (LINE_LENGTH * sizeof(char));
         if (input->lines[i] == NULL) {
             /* free input and lines */
-            free(input->lines);
-            free(input);
+            input->num_lines = i;
+            free(text);
+            free_logo(input);
             return NULL;
         }
         /* input made properly, memset it */
         memset(input->lines[i], '\0', LINE_LENGTH);
-    }
-    
-    /* populate input */
-    rewind(in_file);
-    count = 0;
-    while (fgets(line, sizeof(line), in_file) != NULL) {
-        /* trim leading and trailing whitespace */
-        trimmed = trim_space(line);
-        /* remove trailing newline */
-        if (trimmed[strlen(trimmed) - 1] == '\n') {
-            trimmed[strlen(trimmed) - 1] = '\0';
+        if (i < input->num_lines - 1) {
+            next = memchr(p, '\n', text + text_size - p);
+            memcpy(input->lines[i], p, next - p);
+            p = next + 1;
         }
-        strcpy(input->lines[count], trimmed);
-        count = count + 1;
     }
-    /* tell the struct how big the 2D char array is */
-    input->num_lines = count + 1;
+    free(text);
     /* and set the counter to 0 */
     input->counter = 0;
     return input;
@@ -481,6 +530,7 @@ void free_logo(Logo input) {
     for (i=0; i<input->num_lines; i++) {
         free(input->lines[i]);
     }
+    free(input->line_nums);
     free(input->lines);
     free(input);
 }
@@ -0,0 +1,328 @@
+/*
+ *  pdf.c
+ *  Backend for generating PDF output
+ *
+ *  Writes the PDF in one pass. The content stream of each page is
+ *  compressed with zlib as the turtle draws, and its length is written as
+ *  an object of its own after it. The page tree and the cross-reference
+ *  table come last, when the pages and the offsets of all the objects are
+ *  known. Each program of a multi-program input is a page.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <float.h>  /* DBL_MAX_10_EXP */
+#include <math.h>   /* for following the turtle */
+#include <stdio.h>
+#include <stdlib.h> /* malloc */
+#include <string.h>
+#include <interpreter.h>
+#include "pdf.h"
+
+#define FAR_LENGTH      (DBL_MAX_10_EXP + 7)    /* enough for any double as "%.2f " */
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Writes v hundredths into p with no trailing zeros. Returns the number of
+ *  characters written.
+ */
+static int fmt_cents(char *p, long long v) {
+    unsigned long long u = (v < 0) ? -(unsigned long long) v : (unsigned long long) v;
+    if (u % 100 == 0) {
+        return sprintf(p, "%s%llu", (v < 0) ? "-" : "", u / 100);
+    } else if (u % 10 == 0) {
+        return sprintf(p, "%s%llu.%llu", (v < 0) ? "-" : "", u / 100, u % 100 / 10);
+    }
+    return sprintf(p, "%s%llu.%02llu", (v < 0) ? "-" : "", u / 100, u % 100);
+}
+
+/**
+ *  Notes that object obj starts here. The output is failed if there is no
+ *  memory to note it, so that it is reported and removed.
+ */
+static void start_obj(Logo input, int obj) {
+    Backend b = input->backend;
+    long long *offsets;
+    if (obj >= b->max_objs) {
+        offsets = (long long *) realloc (b->offsets, 2 * b->max_objs * sizeof(long long));
+        if (offsets == NULL) {
+            input->out->error = 1;
+            return;
+        }
+        b->offsets = offsets;
+        b->max_objs = 2 * b->max_objs;
+    }
+    b->offsets[obj] = ob_tell(input->out);
+    if (obj >= b->num_objs) {
+        b->num_objs = obj + 1;
+    }
+}
+
+/**
+ *  Compresses the content waiting in text into the content stream, and
+ *  ends the stream if flush is Z_FINISH
+ */
+static void deflate_text(Logo input, int flush) {
+    Backend b = input->backend;
+    size_t have;
+    b->z.next_in = b->text;
+    b->z.avail_in = b->len;
+    b->raw = b->raw + b->len;
+    do {
+        b->z.next_out = b->zbuf;
+        b->z.avail_out = PDF_CHUNK;
+        deflate(&b->z, flush);
+        have = PDF_CHUNK - b->z.avail_out;
+        ob_write(input->out, (char *) b->zbuf, have);
+        b->stream_len = b->stream_len + have;
+    } while (b->z.avail_out == 0);
+    b->len = 0;
+}
+
+/**
+ *  Adds the string s to the content
+ */
+static void put_text(Logo input, const char *s) {
+    Backend b = input->backend;
+    size_t n = strlen(s);
+    if (b->len + n > PDF_CHUNK) {
+        deflate_text(input, Z_NO_FLUSH);
+    }
+    memcpy(b->text + b->len, s, n);
+    b->len = b->len + n;
+}
+
+/**
+ *  Adds "x y op" to the content, for the page point (x, y) from where the
+ *  turtle starts
+ */
+static void put_point(Logo input, double x, double y, const char *op) {
+    char buf[PDF_OP_LENGTH], far[FAR_LENGTH];
+    int n;
+    if (!(fabs(x) < 1e15 && fabs(y) < 1e15)) {
+        /* too far to round into hundredths, each part written on its own
+           as together they need not fit */
+        snprintf(far, FAR_LENGTH, "%.2f ", x);
+        put_text(input, far);
+        snprintf(far, FAR_LENGTH, "%.2f ", y);
+        put_text(input, far);
+        snprintf(buf, PDF_OP_LENGTH, "%s\n", op);
+        put_text(input, buf);
+        return;
+    }
+    n = fmt_cents(buf, (long long) floor(x * 100 + 0.5));
+    buf[n++] = ' ';
+    n = n + fmt_cents(buf + n, (long long) floor(y * 100 + 0.5));
+    snprintf(buf + n, PDF_OP_LENGTH - n, " %s\n", op);
+    put_text(input, buf);
+}
+
+/**
+ *  Writes the page object and starts its content stream, with the origin
+ *  moved to where the turtle starts
+ */
+static void begin_page(Logo input) {
+    Backend b = input->backend;
+    char buf[PDF_OP_LENGTH * 2];
+    int obj = 3 + 3 * b->pages;
+    start_obj(input, obj);
+    snprintf(buf, sizeof(buf), "%d 0 obj\n<< /Type /Page /Parent 2 0 R "
+             "/MediaBox [0 0 %d %d] /Contents %d 0 R >>\nendobj\n",
+             obj, PDF_WIDTH, PDF_HEIGHT, obj + 1);
+    ob_puts(input->out, buf);
+    start_obj(input, obj + 1);
+    snprintf(buf, sizeof(buf), "%d 0 obj\n<< /Length %d 0 R /Filter /FlateDecode >>\nstream\n",
+             obj + 1, obj + 2);
+    ob_puts(input->out, buf);
+    deflateReset(&b->z);
+    b->stream_len = 0;
+    b->in_page = 1;
+    snprintf(buf, sizeof(buf), "1 0 0 1 %d %d cm\n", PDF_START_X, PDF_START_Y);
+    put_text(input, buf);
+}
+
+/**
+ *  Strokes the path, ends the content stream and writes its length
+ */
+static void end_page(Logo input) {
+    Backend b = input->backend;
+    char buf[PDF_OP_LENGTH];
+    int obj = 3 + 3 * b->pages;
+    if (!b->in_page) {
+        begin_page(input);
+    }
+    if (b->in_path) {
+        put_text(input, "S\n");
+    }
+    deflate_text(input, Z_FINISH);
+    b->packed = b->packed + b->stream_len;
+    ob_puts(input->out, "\nendstream\nendobj\n");
+    start_obj(input, obj + 2);
+    snprintf(buf, PDF_OP_LENGTH, "%d 0 obj\n%lld\nendobj\n", obj + 2, b->stream_len);
+    ob_puts(input->out, buf);
+    b->pages = b->pages + 1;
+    b->in_page = 0;
+    b->in_path = 0;
+    b->x = 0;
+    b->y = 0;
+    b->h = 0;
+}
+
+/********************************************
+ Backend Handling
+ ********************************************/
+
+/**
+ *  Sets up the backend in input. Returns 0 on success, MEM_ERR when out of
+ *  memory, ARGS_ERR for an option of another backend.
+ */
+int pdf_backend(Logo input, Options *opts) {
+    Backend b;
+    if (backend_takes(opts, 0, "pdf") < 0) {
+        return ARGS_ERR;
+    }
+    b = (Backend) malloc (sizeof(*b));
+    if (b == NULL) {
+        return MEM_ERR;
+    }
+    b->text = (unsigned char *) malloc (PDF_CHUNK);
+    b->zbuf = (unsigned char *) malloc (PDF_CHUNK);
+    b->offsets = (long long *) malloc (PDF_MIN_OBJS * sizeof(long long));
+    b->z.zalloc = Z_NULL;
+    b->z.zfree = Z_NULL;
+    b->z.opaque = Z_NULL;
+    if (b->text == NULL || b->zbuf == NULL || b->offsets == NULL ||
+        deflateInit(&b->z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        free(b->text);
+        free(b->zbuf);
+        free(b->offsets);
+        free(b);
+        return MEM_ERR;
+    }
+    b->max_objs = PDF_MIN_OBJS;
+    b->raw = 0;
+    b->packed = 0;
+    input->backend = b;
+    return 0;
+}
+
+/**
+ *  Frees the backend, which may be NULL
+ */
+void pdf_free(Backend backend) {
+    if (backend == NULL) {
+        return;
+    }
+    deflateEnd(&backend->z);
+    free(backend->text);
+    free(backend->zbuf);
+    free(backend->offsets);
+    free(backend);
+}
+
+/**
+ *  Reports how much compressing saved
+ */
+void pdf_report(Logo input) {
+    Backend b = input->backend;
+    if (b == NULL) {
+        return;
+    }
+    printf("Compressed %lld bytes of content to %lld\n", b->raw, b->packed);
+}
+
+/********************************************
+ Interpreting Functions
+ ********************************************/
+
+/**
+ *  Writes the PDF header and the catalog
+ */
+void pdf_header(Logo input, char *in_filename) {
+    Backend b = input->backend;
+    /* the second line marks the file as binary */
+    ob_puts(input->out, "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n");
+    b->num_objs = 1;
+    b->pages = 0;
+    b->in_page = 0;
+    b->in_path = 0;
+    b->len = 0;
+    b->x = 0;
+    b->y = 0;
+    b->h = 0;
+    start_obj(input, 1);
+    ob_puts(input->out, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+}
+
+/**
+ *  Ends the page
+ */
+void pdf_footer(Logo input) {
+    end_page(input);
+}
+
+/**
+ *  Writes the page tree, the cross-reference table and the trailer
+ */
+void pdf_trailer(Logo input) {
+    Backend b = input->backend;
+    char buf[PDF_OP_LENGTH];
+    long long xref;
+    int i;
+    start_obj(input, 2);
+    ob_puts(input->out, "2 0 obj\n<< /Type /Pages /Kids [");
+    for (i=0; i<b->pages; i++) {
+        snprintf(buf, PDF_OP_LENGTH, (i == 0) ? "%d 0 R" : " %d 0 R", 3 + 3 * i);
+        ob_puts(input->out, buf);
+    }
+    snprintf(buf, PDF_OP_LENGTH, "] /Count %d >>\nendobj\n", b->pages);
+    ob_puts(input->out, buf);
+    /* every entry is exactly 20 bytes */
+    xref = ob_tell(input->out);
+    snprintf(buf, PDF_OP_LENGTH, "xref\n0 %d\n0000000000 65535 f \n", b->num_objs);
+    ob_puts(input->out, buf);
+    for (i=1; i<b->num_objs; i++) {
+        snprintf(buf, PDF_OP_LENGTH, "%010lld 00000 n \n", b->offsets[i]);
+        ob_puts(input->out, buf);
+    }
+    snprintf(buf, PDF_OP_LENGTH, "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%lld\n%%%%EOF\n",
+             b->num_objs, xref);
+    ob_puts(input->out, buf);
+}
+
+/**
+ *  Moves the turtle op forward, drawing a line to where it ends up
+ */
+void pdf_ipt_fd(Logo input, float op) {
+    Backend b = input->backend;
+    double rad = b->h * PDF_TO_RADS;
+    if (!b->in_page) {
+        begin_page(input);
+    }
+    if (!b->in_path) {
+        put_point(input, b->x, b->y, "m");
+        b->in_path = 1;
+    }
+    b->x = b->x + op * cos(rad);
+    b->y = b->y + op * sin(rad);
+    put_point(input, b->x, b->y, "l");
+}
+
+/**
+ *  Turns the turtle op degrees anticlockwise
+ */
+void pdf_ipt_lt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h + op, PDF_FULL_CIRCLE);
+}
+
+/**
+ *  Turns the turtle op degrees clockwise
+ */
+void pdf_ipt_rt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h - op, PDF_FULL_CIRCLE);
+}
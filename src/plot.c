@@ -0,0 +1,640 @@
+/*
+ *  plot.c
+ *  Backend for driving a pen plotter, in HPGL or G-code
+ *
+ *  A plotter spends much of its time on a dense drawing moving the pen
+ *  between lines rather than drawing them. The turtle is followed into
+ *  polylines of plotter units, leaving out segments it has drawn before,
+ *  and in the trailer the polylines are put in a new order with less pen up
+ *  travel: greedily to the nearest free end, then improved by 2-opt. The
+ *  travel in the order drawn and in the order plotted are both reported.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for clock_gettime */
+
+#include <math.h>   /* for following the turtle */
+#include <stdio.h>
+#include <stdlib.h> /* malloc */
+#include <string.h>
+#include <time.h>   /* for timing the ordering */
+#include <interpreter.h>
+#include "plot.h"
+
+#define MIN_GAIN        0.5     /* units a reversal must save, so that
+                                   rounding cannot make 2-opt go round */
+#define MM_PER_POINT    (25.4 / 72)
+
+/* the free ends of the polylines, by the cell of a square grid they are
+   in. end 2k is the start of polyline k and end 2k + 1 is its end */
+struct _plotgrid {
+    long long min_x, min_y;
+    long long cell;         /* side of a cell, in units */
+    long cols, rows;
+    long *first;            /* where the ends of each cell start in list */
+    long *count;            /* free ends in each cell */
+    long *list;             /* ends by cell */
+    long *pos;              /* where each end is in list */
+};
+typedef struct _plotgrid PlotGrid;
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Returns the time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *  Rounds v to a whole number of units, held within PLOT_MAX_COORD
+ */
+static long long to_units(double v) {
+    v = floor(v + 0.5);
+    if (!(v < PLOT_MAX_COORD)) {
+        return (long long) PLOT_MAX_COORD;
+    } else if (v < -PLOT_MAX_COORD) {
+        return (long long) -PLOT_MAX_COORD;
+    }
+    return (long long) v;
+}
+
+/**
+ *  Returns the distance between p and q
+ */
+static double dist(PlotPoint p, PlotPoint q) {
+    double dx = (double) (p.x - q.x), dy = (double) (p.y - q.y);
+    return sqrt(dx * dx + dy * dy);
+}
+
+/**
+ *  Returns the point polyline k is plotted from
+ */
+static PlotPoint head(Backend b, long k) {
+    return b->rev[k] ? b->pts[b->first[k + 1] - 1] : b->pts[b->first[k]];
+}
+
+/**
+ *  Returns the point polyline k is plotted to
+ */
+static PlotPoint tail(Backend b, long k) {
+    return b->rev[k] ? b->pts[b->first[k]] : b->pts[b->first[k + 1] - 1];
+}
+
+/**
+ *  Returns end e of the polylines
+ */
+static PlotPoint end_point(Backend b, long e) {
+    return (e & 1) ? b->pts[b->first[e / 2 + 1] - 1] : b->pts[b->first[e / 2]];
+}
+
+/**
+ *  Returns the pen up travel from the corner of the page through the
+ *  polylines in the order they are plotted
+ */
+static double travel(Backend b) {
+    PlotPoint at = { 0, 0 };
+    double d = 0;
+    long i;
+    for (i=0; i<b->num_lines; i++) {
+        d = d + dist(at, head(b, b->order[i]));
+        at = tail(b, b->order[i]);
+    }
+    return d;
+}
+
+/**
+ *  Puts the polylines back in the order they were drawn, and returns the
+ *  pen up travel through them
+ */
+static double travel_drawn(Backend b) {
+    long i;
+    for (i=0; i<b->num_lines; i++) {
+        b->order[i] = i;
+        b->rev[i] = 0;
+    }
+    return travel(b);
+}
+
+/**
+ *  Plots the segment from where the turtle is to p, starting a polyline
+ *  if the pen is up. Returns MEM_ERR when out of memory.
+ */
+static int add_segment(Backend b, PlotPoint p) {
+    PlotPoint *pts;
+    long *first;
+    if (b->num_pts + 2 > b->max_pts) {
+        pts = (PlotPoint *) realloc (b->pts, 2 * b->max_pts * sizeof(PlotPoint));
+        if (pts == NULL) {
+            return MEM_ERR;
+        }
+        b->pts = pts;
+        b->max_pts = 2 * b->max_pts;
+    }
+    if (!b->pen_down) {
+        if (b->num_lines == b->max_lines) {
+            first = (long *) realloc (b->first, (2 * b->max_lines + 1) * sizeof(long));
+            if (first == NULL) {
+                return MEM_ERR;
+            }
+            b->first = first;
+            b->max_lines = 2 * b->max_lines;
+        }
+        b->pts[b->num_pts] = b->cur;
+        b->num_pts = b->num_pts + 1;
+        b->num_lines = b->num_lines + 1;
+        b->pen_down = 1;
+    }
+    b->pts[b->num_pts] = p;
+    b->num_pts = b->num_pts + 1;
+    b->first[b->num_lines] = b->num_pts;
+    return 0;
+}
+
+/**
+ *  Returns the cell of the grid that p is in, or the nearest cell to it
+ *  along each axis if it is outside the grid
+ */
+static void grid_cell(PlotGrid *g, PlotPoint p, long *cx, long *cy) {
+    long long x = (p.x - g->min_x) / g->cell, y = (p.y - g->min_y) / g->cell;
+    *cx = (p.x < g->min_x) ? 0 : (x >= g->cols) ? g->cols - 1 : (long) x;
+    *cy = (p.y < g->min_y) ? 0 : (y >= g->rows) ? g->rows - 1 : (long) y;
+}
+
+/**
+ *  Frees the grid
+ */
+static void grid_free(PlotGrid *g) {
+    free(g->first);
+    free(g->count);
+    free(g->list);
+    free(g->pos);
+}
+
+/**
+ *  Puts the ends of all the polylines into a grid of about as many cells
+ *  as there are polylines. Returns MEM_ERR when out of memory.
+ */
+static int grid_new(Backend b, PlotGrid *g) {
+    long n = 2 * b->num_lines, side, cells, e, c, cx, cy;
+    long long max_x, max_y, span;
+    PlotPoint p = end_point(b, 0);
+    g->min_x = max_x = p.x;
+    g->min_y = max_y = p.y;
+    for (e=1; e<n; e++) {
+        p = end_point(b, e);
+        g->min_x = (p.x < g->min_x) ? p.x : g->min_x;
+        g->min_y = (p.y < g->min_y) ? p.y : g->min_y;
+        max_x = (p.x > max_x) ? p.x : max_x;
+        max_y = (p.y > max_y) ? p.y : max_y;
+    }
+    side = (long) ceil(sqrt((double) b->num_lines));
+    span = (max_x - g->min_x > max_y - g->min_y) ? max_x - g->min_x : max_y - g->min_y;
+    g->cell = span / side + 1;
+    g->cols = (long) ((max_x - g->min_x) / g->cell + 1);
+    g->rows = (long) ((max_y - g->min_y) / g->cell + 1);
+    cells = g->cols * g->rows;
+    g->first = (long *) malloc ((cells + 1) * sizeof(long));
+    g->count = (long *) calloc (cells, sizeof(long));
+    g->list = (long *) malloc (n * sizeof(long));
+    g->pos = (long *) malloc (n * sizeof(long));
+    if (g->first == NULL || g->count == NULL || g->list == NULL || g->pos == NULL) {
+        grid_free(g);
+        return MEM_ERR;
+    }
+    for (e=0; e<n; e++) {
+        grid_cell(g, end_point(b, e), &cx, &cy);
+        g->count[cy * g->cols + cx] = g->count[cy * g->cols + cx] + 1;
+    }
+    g->first[0] = 0;
+    for (c=0; c<cells; c++) {
+        g->first[c + 1] = g->first[c] + g->count[c];
+        g->count[c] = 0;
+    }
+    for (e=0; e<n; e++) {
+        grid_cell(g, end_point(b, e), &cx, &cy);
+        c = cy * g->cols + cx;
+        g->pos[e] = g->first[c] + g->count[c];
+        g->list[g->pos[e]] = e;
+        g->count[c] = g->count[c] + 1;
+    }
+    return 0;
+}
+
+/**
+ *  Takes end e out of the grid, moving the last free end of its cell into
+ *  its place
+ */
+static void grid_remove(Backend b, PlotGrid *g, long e) {
+    long cx, cy, c, last;
+    grid_cell(g, end_point(b, e), &cx, &cy);
+    c = cy * g->cols + cx;
+    g->count[c] = g->count[c] - 1;
+    last = g->list[g->first[c] + g->count[c]];
+    g->list[g->pos[e]] = last;
+    g->pos[last] = g->pos[e];
+}
+
+/**
+ *  Returns the free end in the grid nearest to at. The cells are searched
+ *  in square rings outwards from the cell of at, until the ring is further
+ *  away than the nearest end found. There must be a free end.
+ */
+static long grid_nearest(Backend b, PlotGrid *g, PlotPoint at) {
+    long cx, cy, r, reach, x, y, step, i, c, best = -1;
+    double d, best_d = HUGE_VAL;
+    grid_cell(g, at, &cx, &cy);
+    reach = cx;
+    reach = (g->cols - 1 - cx > reach) ? g->cols - 1 - cx : reach;
+    reach = (cy > reach) ? cy : reach;
+    reach = (g->rows - 1 - cy > reach) ? g->rows - 1 - cy : reach;
+    /* an end in ring r is more than r - 1 cells away */
+    for (r=0; r<=reach && !(best >= 0 && best_d <= (double) (r - 1) * g->cell); r++) {
+        for (y=(cy-r < 0) ? 0 : cy-r; y<=cy+r && y<g->rows; y++) {
+            /* the whole row along the top and bottom, the two ends between */
+            step = (y == cy - r || y == cy + r) ? 1 : 2 * r;
+            for (x=cx-r; x<=cx+r; x=x+step) {
+                if (x < 0 || x >= g->cols) {
+                    continue;
+                }
+                c = y * g->cols + x;
+                for (i=g->first[c]; i<g->first[c]+g->count[c]; i++) {
+                    d = dist(at, end_point(b, g->list[i]));
+                    if (d < best_d) {
+                        best_d = d;
+                        best = g->list[i];
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ *  Orders the polylines by going from the corner of the page to the
+ *  nearest free end each time, plotting a polyline from its end if that is
+ *  nearer. Returns MEM_ERR when out of memory.
+ */
+static int order_nearest(Backend b) {
+    PlotGrid g;
+    PlotPoint at = { 0, 0 };
+    long i, e, k;
+    if (grid_new(b, &g) < 0) {
+        return MEM_ERR;
+    }
+    for (i=0; i<b->num_lines; i++) {
+        e = grid_nearest(b, &g, at);
+        k = e / 2;
+        grid_remove(b, &g, 2 * k);
+        grid_remove(b, &g, 2 * k + 1);
+        b->order[i] = k;
+        b->rev[k] = (char) (e & 1);
+        at = tail(b, k);
+    }
+    grid_free(&g);
+    return 0;
+}
+
+/**
+ *  Reverses the polylines plotted i to j, each of which is then plotted the
+ *  other way
+ */
+static void reverse(Backend b, long i, long j) {
+    long k;
+    for (; i<j; i++, j--) {
+        k = b->order[i];
+        b->order[i] = b->order[j];
+        b->order[j] = k;
+        b->rev[b->order[i]] = !b->rev[b->order[i]];
+        b->rev[b->order[j]] = !b->rev[b->order[j]];
+    }
+    if (i == j) {
+        b->rev[b->order[i]] = !b->rev[b->order[i]];
+    }
+}
+
+/**
+ *  Improves the order by 2-opt. Reversing the polylines plotted i to j
+ *  changes only the two moves into and out of them, so it is done wherever
+ *  that makes those shorter. Runs of up to PLOT_WINDOW polylines are tried,
+ *  which keeps a pass linear, until a pass finds nothing to reverse.
+ */
+static void improve_2opt(Backend b) {
+    PlotPoint origin = { 0, 0 }, from, first, last, to;
+    long n = b->num_lines, i, j;
+    int pass, better = 1;
+    double delta;
+    for (pass=0; pass<PLOT_MAX_PASSES && better; pass++) {
+        better = 0;
+        for (i=0; i<n; i++) {
+            from = (i == 0) ? origin : tail(b, b->order[i - 1]);
+            first = head(b, b->order[i]);
+            for (j=i; j<n && j<i+PLOT_WINDOW; j++) {
+                last = tail(b, b->order[j]);
+                delta = dist(from, last) - dist(from, first);
+                /* nothing is plotted after the last polyline */
+                if (j + 1 < n) {
+                    to = head(b, b->order[j + 1]);
+                    delta = delta + dist(first, to) - dist(last, to);
+                }
+                if (delta < -MIN_GAIN) {
+                    reverse(b, i, j);
+                    first = head(b, b->order[i]);
+                    better = 1;
+                }
+            }
+        }
+    }
+}
+
+/**
+ *  Writes p into buf as the plotter takes a point
+ */
+static void put_point(Backend b, PlotPoint p, char *buf) {
+    unsigned long long ux = (p.x < 0) ? -(unsigned long long) p.x : (unsigned long long) p.x;
+    unsigned long long uy = (p.y < 0) ? -(unsigned long long) p.y : (unsigned long long) p.y;
+    if (b->format == PLOT_HPGL) {
+        sprintf(buf, "%lld,%lld", p.x, p.y);
+    } else {
+        /* hundredths of a mm */
+        sprintf(buf, "X%s%llu.%02llu Y%s%llu.%02llu", (p.x < 0) ? "-" : "", ux / 100, ux % 100,
+                (p.y < 0) ? "-" : "", uy / 100, uy % 100);
+    }
+}
+
+/**
+ *  Returns point m of polyline k, counting from where it is plotted from
+ */
+static PlotPoint nth_point(Backend b, long k, long m) {
+    return b->rev[k] ? b->pts[b->first[k + 1] - 1 - m] : b->pts[b->first[k] + m];
+}
+
+/**
+ *  Writes the polylines in order as HPGL. The points of a polyline are
+ *  given PLOT_HPGL_POINTS to a PD, as plotters have little room for them,
+ *  and the pen is not lifted between polylines that meet.
+ */
+static void write_hpgl(Logo input) {
+    Backend b = input->backend;
+    char buf[PLOT_OP_LENGTH];
+    PlotPoint at = { 0, 0 }, p;
+    long i, k, m, n, pd = 0;
+    ob_puts(input->out, "IN;SP1;\n");
+    for (i=0; i<b->num_lines; i++) {
+        k = b->order[i];
+        p = head(b, k);
+        if (i == 0 || p.x != at.x || p.y != at.y) {
+            if (pd > 0) {
+                ob_puts(input->out, ";\n");
+                pd = 0;
+            }
+            put_point(b, p, buf);
+            ob_puts(input->out, "PU");
+            ob_puts(input->out, buf);
+            ob_puts(input->out, ";\n");
+        }
+        n = b->first[k + 1] - b->first[k];
+        for (m=1; m<n; m++) {
+            put_point(b, nth_point(b, k, m), buf);
+            ob_puts(input->out, (pd == 0) ? "PD" : ",");
+            ob_puts(input->out, buf);
+            pd = pd + 1;
+            if (pd == PLOT_HPGL_POINTS) {
+                ob_puts(input->out, ";\n");
+                pd = 0;
+            }
+        }
+        at = tail(b, k);
+    }
+    if (pd > 0) {
+        ob_puts(input->out, ";\n");
+    }
+    ob_puts(input->out, "PU;SP0;\n");
+}
+
+/**
+ *  Writes the polylines in order as G-code, in mm, raising and lowering
+ *  the pen along z. The pen is not lifted between polylines that meet.
+ */
+static void write_gcode(Logo input) {
+    Backend b = input->backend;
+    char buf[PLOT_OP_LENGTH];
+    PlotPoint at = { 0, 0 }, p;
+    long i, k, m, n;
+    int down = 0;
+    ob_puts(input->out, "G21\nG90\nG0 Z" PLOT_Z_UP "\n");
+    for (i=0; i<b->num_lines; i++) {
+        k = b->order[i];
+        p = head(b, k);
+        if (!down || p.x != at.x || p.y != at.y) {
+            if (down) {
+                ob_puts(input->out, "G0 Z" PLOT_Z_UP "\n");
+            }
+            put_point(b, p, buf);
+            ob_puts(input->out, "G0 ");
+            ob_puts(input->out, buf);
+            ob_puts(input->out, "\nG1 Z" PLOT_Z_DOWN " F" PLOT_FEED "\n");
+            down = 1;
+        }
+        n = b->first[k + 1] - b->first[k];
+        for (m=1; m<n; m++) {
+            put_point(b, nth_point(b, k, m), buf);
+            ob_puts(input->out, "G1 ");
+            ob_puts(input->out, buf);
+            ob_puts(input->out, "\n");
+        }
+        at = tail(b, k);
+    }
+    if (down) {
+        ob_puts(input->out, "G0 Z" PLOT_Z_UP "\n");
+    }
+    ob_puts(input->out, "M2\n");
+}
+
+/********************************************
+ Backend Handling
+ ********************************************/
+
+/**
+ *  Sets up the backend in input. Returns 0 on success, MEM_ERR when out of
+ *  memory or ARGS_ERR when the options cannot be plotted.
+ */
+int plot_backend(Logo input, Options *opts) {
+    Backend b;
+    if (backend_takes(opts, OPT_PLOT, "plot") < 0) {
+        return ARGS_ERR;
+    }
+    if (opts->multi == MULTI_PAGES) {
+        fprintf(stderr, "Error: a plot has one page, use --multi=files\n");
+        return ARGS_ERR;
+    }
+    b = (Backend) calloc (1, sizeof(*b));
+    if (b == NULL) {
+        return MEM_ERR;
+    }
+    b->format = opts->plot;
+    b->unit = (b->format == PLOT_HPGL) ? PLOT_HPGL_UNIT : PLOT_GCODE_UNIT;
+    b->dedup = dd_new(DD_MAX_BYTES);
+    b->pts = (PlotPoint *) malloc (PLOT_MIN_POINTS * sizeof(PlotPoint));
+    b->first = (long *) malloc ((PLOT_MIN_LINES + 1) * sizeof(long));
+    if (b->dedup == NULL || b->pts == NULL || b->first == NULL) {
+        if (b->dedup != NULL) {
+            dd_free(b->dedup);
+        }
+        free(b->pts);
+        free(b->first);
+        free(b);
+        return MEM_ERR;
+    }
+    b->max_pts = PLOT_MIN_POINTS;
+    b->max_lines = PLOT_MIN_LINES;
+    input->backend = b;
+    return 0;
+}
+
+/**
+ *  Frees the backend, which may be NULL
+ */
+void plot_free(Backend backend) {
+    if (backend == NULL) {
+        return;
+    }
+    dd_free(backend->dedup);
+    free(backend->pts);
+    free(backend->first);
+    free(backend->order);
+    free(backend->rev);
+    free(backend);
+}
+
+/**
+ *  Reports what was plotted, and the pen up travel before and after it was
+ *  ordered
+ */
+void plot_report(Logo input) {
+    Backend b = input->backend;
+    if (b == NULL) {
+        return;
+    }
+    printf("Plotted %ld of %ld lines as %ld polylines in %d %s, dropping %ld drawn before\n",
+           b->plotted, b->segments, b->polylines, b->plots,
+           (b->format == PLOT_HPGL) ? "hpgl" : "gcode", b->dedup->dropped);
+    printf("Pen up travel %.1fmm in the order drawn, %.1fmm once ordered in %.3fs\n",
+           b->before / b->unit * MM_PER_POINT, b->after / b->unit * MM_PER_POINT, b->order_time);
+}
+
+/********************************************
+ Interpreting Functions
+ ********************************************/
+
+/**
+ *  Starts a plot, with the turtle where it starts and nothing plotted
+ */
+void plot_header(Logo input, char *in_filename) {
+    Backend b = input->backend;
+    dd_clear(b->dedup);
+    b->num_pts = 0;
+    b->num_lines = 0;
+    b->first[0] = 0;
+    b->pen_down = 0;
+    b->x = 0;
+    b->y = 0;
+    b->h = 0;
+    b->cur.x = to_units(PLOT_START_X * b->unit);
+    b->cur.y = to_units(PLOT_START_Y * b->unit);
+}
+
+/**
+ *  Orders the polylines and writes them. The output is failed if there is
+ *  no memory to order them, so that it is reported and removed.
+ */
+void plot_trailer(Logo input) {
+    Backend b = input->backend;
+    double start = now(), drawn;
+    long n = (b->num_lines > 0) ? b->num_lines : 1;
+    free(b->order);
+    free(b->rev);
+    b->order = (long *) malloc (n * sizeof(long));
+    b->rev = (char *) calloc (n, 1);
+    if (b->order == NULL || b->rev == NULL) {
+        input->out->error = 1;
+        return;
+    }
+    drawn = travel_drawn(b);
+    b->before = b->before + drawn;
+    if (b->num_lines > 0) {
+        if (order_nearest(b) < 0) {
+            input->out->error = 1;
+            return;
+        }
+        /* going to the nearest end can leave long moves at the end */
+        if (travel(b) > drawn) {
+            travel_drawn(b);
+        }
+        improve_2opt(b);
+    }
+    b->after = b->after + travel(b);
+    b->order_time = b->order_time + now() - start;
+    if (b->format == PLOT_HPGL) {
+        write_hpgl(input);
+    } else {
+        write_gcode(input);
+    }
+    b->polylines = b->polylines + b->num_lines;
+    b->plots = b->plots + 1;
+}
+
+/**
+ *  Moves the turtle op forward, plotting the segment to where it ends up
+ *  unless it has been plotted before or rounds to nothing. The output is
+ *  failed if there is no memory to keep it, and the polylines kept so far
+ *  are dropped to make room.
+ */
+void plot_ipt_fd(Logo input, float op) {
+    Backend b = input->backend;
+    double rad = b->h * PLOT_TO_RADS;
+    PlotPoint p;
+    b->segments = b->segments + 1;
+    b->x = b->x + op * cos(rad);
+    b->y = b->y + op * sin(rad);
+    p.x = to_units((PLOT_START_X + b->x) * b->unit);
+    p.y = to_units((PLOT_START_Y + b->y) * b->unit);
+    if (p.x == b->cur.x && p.y == b->cur.y) {
+        return;
+    }
+    if (dd_seen(b->dedup, (double) b->cur.x, (double) b->cur.y, (double) p.x, (double) p.y)) {
+        /* lift the pen over it */
+        b->pen_down = 0;
+    } else if (add_segment(b, p) < 0) {
+        input->out->error = 1;
+        b->num_pts = 0;
+        b->num_lines = 0;
+        b->pen_down = 0;
+    } else {
+        b->plotted = b->plotted + 1;
+    }
+    b->cur = p;
+}
+
+/**
+ *  Turns the turtle op degrees anticlockwise
+ */
+void plot_ipt_lt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h + op, PLOT_FULL_CIRCLE);
+}
+
+/**
+ *  Turns the turtle op degrees clockwise
+ */
+void plot_ipt_rt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h - op, PLOT_FULL_CIRCLE);
+}
@@ -7,48 +7,787 @@
  *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
  */
 
+#include <limits.h> /* INT_MAX */
+#include <math.h>   /* for following the turtle */
 #include <stdio.h>
+#include <stdlib.h> /* malloc and llabs */
+#include <string.h> /* for reading lines of the program */
 #include <interpreter.h>
 #include "postscript.h"
 
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Counts a segment just written to the path, stroking the path and
+ *  starting a new one at the same point when it is max_path long. The
+ *  current point is kept in user space, so the rotation carries on too.
+ */
+static void add_segment(Logo input) {
+    Backend b = input->backend;
+    b->segments = b->segments + 1;
+    if (b->max_path > 0 && b->segments >= b->max_path) {
+        ob_puts(input->out, "currentpoint stroke moveto\n");
+        b->segments = 0;
+    }
+}
+
+/**
+ *  Writes the pending rlineto, if any
+ */
+static void flush_fd(Logo input) {
+    Backend b = input->backend;
+    if (b->fd != 0) {
+        ob_cents(input->out, b->fd);
+        ob_puts(input->out, " 0 rlineto\n");
+        b->ops_out = b->ops_out + 1;
+        b->fd = 0;
+        add_segment(input);
+    }
+}
+
+/**
+ *  Writes the pending rlineto and then the pending rotate, if any
+ */
+static void flush_all(Logo input) {
+    Backend b = input->backend;
+    flush_fd(input);
+    if (b->rot != 0) {
+        ob_cents(input->out, b->rot);
+        ob_puts(input->out, " rotate\n");
+        b->ops_out = b->ops_out + 1;
+        b->rot = 0;
+    }
+}
+
+/**
+ *  Writes "x y op" for a point or move given in hundredths
+ */
+static void write_pair(OutBuf out, double x, double y, const char *op) {
+    if (fabs(x) < PS_MERGE_MAX && fabs(y) < PS_MERGE_MAX) {
+        ob_cents(out, (long long) x);
+        ob_puts(out, " ");
+        ob_cents(out, (long long) y);
+    } else {
+        ob_fixed2(out, x / 100);
+        ob_puts(out, " ");
+        ob_fixed2(out, y / 100);
+    }
+    ob_puts(out, op);
+}
+
+/**
+ *  Grows the bounding box to take in the point (x, y) in hundredths
+ */
+static void add_bbox(Backend b, double x, double y) {
+    if (!b->drawn) {
+        b->min_x = b->max_x = x;
+        b->min_y = b->max_y = y;
+        b->drawn = 1;
+        return;
+    }
+    b->min_x = (x < b->min_x) ? x : b->min_x;
+    b->max_x = (x > b->max_x) ? x : b->max_x;
+    b->min_y = (y < b->min_y) ? y : b->min_y;
+    b->max_y = (y > b->max_y) ? y : b->max_y;
+}
+
+/**
+ *  Writes the segment from the last vertex to (x, y), relative to the last
+ *  vertex, which is remembered rounded so that rounding errors do not add
+ *  up, or in page coordinates in MODE_ABSOLUTE. When dropping duplicates, a
+ *  segment drawn before is skipped and the next one drawn starts with a
+ *  move.
+ */
+static void write_vertex(void *data, double x, double y) {
+    Logo input = (Logo) data;
+    Backend b = input->backend;
+    double cx = floor(x * 100 + 0.5), cy = floor(y * 100 + 0.5);
+    double ox = PS_MOVETO_X * 100.0, oy = PS_MOVETO_Y * 100.0;
+    if (b->dedup != NULL) {
+        if ((cx == b->cur_x && cy == b->cur_y) ||
+            dd_seen(b->dedup, b->cur_x, b->cur_y, cx, cy)) {
+            b->cur_x = cx;
+            b->cur_y = cy;
+            return;
+        }
+        if (b->cur_x == b->last_x && b->cur_y == b->last_y) {
+            /* carries on from the last vertex written */
+        } else if (b->mode == MODE_ABSOLUTE) {
+            write_pair(input->out, b->cur_x + ox, b->cur_y + oy, " moveto\n");
+        } else {
+            write_pair(input->out, b->cur_x - b->last_x, b->cur_y - b->last_y, " rmoveto\n");
+        }
+    }
+    if (b->mode == MODE_ABSOLUTE) {
+        write_pair(input->out, cx + ox, cy + oy, " lineto\n");
+        add_bbox(b, b->cur_x + ox, b->cur_y + oy);
+        add_bbox(b, cx + ox, cy + oy);
+    } else {
+        write_pair(input->out, cx - b->cur_x, cy - b->cur_y, " rlineto\n");
+    }
+    add_segment(input);
+    b->cur_x = cx;
+    b->cur_y = cy;
+    b->last_x = cx;
+    b->last_y = cy;
+}
+
+/**
+ *  Returns v rounded to hundredths, as it is printed without simplifying,
+ *  so that the path followed is the one drawn by the plain output
+ */
+static double printed(double v) {
+    long long cents;
+    if (ob_to_cents(v, &cents) < 0) {
+        return v;
+    }
+    return cents / 100.0;
+}
+
+/**
+ *  Moves the turtle d forward and gives the simplifier the new vertex, or
+ *  writes it if not simplifying
+ */
+static void follow_fd(Logo input, double d) {
+    Backend b = input->backend;
+    double rad = b->heading * PS_TO_RADS;
+    if (b->simplify != NULL && b->simplify->n == 0) {
+        sp_start(b->simplify, b->x, b->y);
+    }
+    d = printed(d);
+    b->x = b->x + d * cos(rad);
+    b->y = b->y + d * sin(rad);
+    if (b->simplify != NULL) {
+        sp_add(b->simplify, b->x, b->y);
+    } else {
+        write_vertex(input, b->x, b->y);
+    }
+}
+
+/**
+ *  Puts the turtle back at the start for a new page
+ */
+static void follow_reset(Backend b) {
+    b->x = 0;
+    b->y = 0;
+    b->heading = 0;
+    b->cur_x = 0;
+    b->cur_y = 0;
+    b->last_x = 0;
+    b->last_y = 0;
+}
+
+/**
+ *  Turns the turtle op degrees anticlockwise
+ */
+static void follow_turn(Backend b, double op) {
+    b->heading = fmod(b->heading + op, PS_FULL_CIRCLE);
+}
+
+/**
+ *  Adds op degrees to the pending rotate, to the left for sign 1 and to the
+ *  right for -1, or writes it straight out if it is too big to merge
+ */
+static void add_rotate(Logo input, float op, int sign) {
+    Backend b = input->backend;
+    long long cents;
+    b->ops_in = b->ops_in + 1;
+    if (ob_to_cents(op, &cents) < 0) {
+        flush_all(input);
+        ob_fixed2(input->out, sign * op);
+        ob_puts(input->out, " rotate\n");
+        b->ops_out = b->ops_out + 1;
+        return;
+    }
+    /* whole turns change nothing */
+    b->rot = (b->rot + sign * cents) % PS_FULL_TURN;
+    if (b->rot > PS_FULL_TURN / 2) {
+        b->rot = b->rot - PS_FULL_TURN;
+    } else if (b->rot <= -PS_FULL_TURN / 2) {
+        b->rot = b->rot + PS_FULL_TURN;
+    }
+}
+
+/**
+ *  Writes the number in the string num, read as the interpreter reads it
+ */
+static void put_number(OutBuf out, const char *num, int negate) {
+    char buf[PS_NUM_LENGTH];
+    float value = 0;
+    sscanf(num, "%f", &value);
+    if (negate) {
+        value = -value;
+    }
+    if (value == (int) value) {
+        ob_int(out, (int) value);
+    } else {
+        snprintf(buf, PS_NUM_LENGTH, "%.9g", value);
+        ob_puts(out, buf);
+    }
+}
+
+/**
+ *  Writes the <VARNUM> in the string tok, negated if negate is set
+ */
+static void put_varnum(OutBuf out, const char *tok, int negate) {
+    if (is_var((char *) tok)) {
+        ob_puts(out, tok);
+        if (negate) {
+            ob_puts(out, " neg");
+        }
+    } else {
+        put_number(out, tok, negate);
+    }
+}
+
+/**
+ *  Writes the postscript of a DO line. A loop between two numbers goes the
+ *  way it does in dologo(), otherwise the way is worked out by PS_RANGE,
+ *  which is defined first if *range is not set yet. Returns the number of
+ *  lines written.
+ */
+static int put_do(OutBuf out, const char *line, int *range) {
+    char var[LINE_LENGTH], from[LINE_LENGTH], to[LINE_LENGTH];
+    float n_from = 0, n_to = 0;
+    int lines = 2;
+    sscanf(line, "%*s %s %*s %s %*s %s", var, from, to);
+    if (is_var(from) || is_var(to)) {
+        if (*range == 0) {
+            ob_puts(out, PS_RANGE);
+            *range = 1;
+            lines = lines + 1;
+        }
+        put_varnum(out, from, 0);
+        ob_puts(out, " ");
+        put_varnum(out, to, 0);
+        ob_puts(out, " range");
+    } else {
+        sscanf(from, "%f", &n_from);
+        sscanf(to, "%f", &n_to);
+        ob_int(out, (int) n_from);
+        ob_puts(out, (n_from < n_to) ? " 1 " : " -1 ");
+        put_number(out, to, 0);
+    }
+    ob_puts(out, " {\n/");
+    ob_puts(out, var);
+    ob_puts(out, " exch def\n");
+    return lines;
+}
+
+/**
+ *  Returns 1 if the <VARNUM> in the string tok may not be a whole number,
+ *  going by the variables in frac that may not be, else 0
+ */
+static int may_be_fraction(const char *tok, const int *frac) {
+    float value = 0;
+    if (is_var((char *) tok)) {
+        return frac[tok[0] - 'A'];
+    }
+    sscanf(tok, "%f", &value);
+    return value != (int) value;
+}
+
+/**
+ *  Works out which variables of the program may hold fractions, putting 1
+ *  for those in frac. A DO only sets whole numbers, so it is the SETs with
+ *  a "/", a fraction, or a variable that may hold one
+ */
+static void find_fractions(Logo input, int *frac) {
+    char inst[INSTRUCT_LENGTH+1], var[LINE_LENGTH], tok[LINE_LENGTH];
+    const char *p;
+    int i, n, changed = 1, found;
+    for (i=0; i<VARARY_SIZE; i++) {
+        frac[i] = 0;
+    }
+    /* each time round at least one more variable is found, or none */
+    while (changed) {
+        changed = 0;
+        for (i=0; i<input->num_lines; i++) {
+            if (sscanf(input->lines[i], "%3s %s", inst, var) != 2 || strsame(inst, SET) != 1 ||
+                is_var(var) != 1 || frac[var[0] - 'A'] || (p = strstr(input->lines[i], ":=")) == NULL) {
+                continue;
+            }
+            found = 0;
+            for (p=p+2; !found && sscanf(p, "%s%n", tok, &n) == 1 && strsame(tok, ";") != 1; p=p+n) {
+                found = is_op(tok) ? tok[0] == '/' : may_be_fraction(tok, frac);
+            }
+            if (found) {
+                frac[var[0] - 'A'] = 1;
+                changed = 1;
+            }
+        }
+    }
+}
+
+/**
+ *  Returns 1 if a DO of the program may go round no times, else 0. dologo()
+ *  then carries on into its body, which a postscript for loop cannot do. It
+ *  counts from FROM with the fraction dropped, so this can only happen when
+ *  both FROM and TO are fractions
+ */
+static int may_not_go_round(Logo input) {
+    char inst[INSTRUCT_LENGTH+1], from[LINE_LENGTH], to[LINE_LENGTH];
+    int frac[VARARY_SIZE], i;
+    float n_from = 0, n_to = 0;
+    find_fractions(input, frac);
+    for (i=0; i<input->num_lines; i++) {
+        if (sscanf(input->lines[i], "%3s %*s %*s %s %*s %s", inst, from, to) != 3 ||
+            strsame(inst, DO) != 1) {
+            continue;
+        }
+        if (is_var(from) || is_var(to)) {
+            if (may_be_fraction(from, frac) && may_be_fraction(to, frac)) {
+                return 1;
+            }
+            continue;
+        }
+        /* known, so counted as dologo() counts */
+        sscanf(from, "%f", &n_from);
+        sscanf(to, "%f", &n_to);
+        if ((n_from < n_to) ? (int) n_from > n_to : (int) n_from < n_to) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Writes the postscript of a SET line, the <POLISH> being in postfix
+ *  already
+ */
+static void put_set(OutBuf out, const char *line) {
+    char var[LINE_LENGTH], tok[LINE_LENGTH];
+    const char *p = strstr(line, ":=") + 2;
+    int n;
+    sscanf(line, "%*s %s", var);
+    ob_puts(out, "/");
+    ob_puts(out, var);
+    while (sscanf(p, "%s%n", tok, &n) == 1 && strsame(tok, ";") != 1) {
+        ob_puts(out, " ");
+        if (is_op(tok)) {
+            ob_puts(out, (tok[0] == '+') ? "add" : (tok[0] == '-') ? "sub" :
+                         (tok[0] == '*') ? "mul" : "div");
+        } else {
+            put_varnum(out, tok, 0);
+        }
+        p = p + n;
+    }
+    ob_puts(out, " def\n");
+}
+
+/**
+ *  Maps fd() to rlineto. When compacting,
+ *  a rlineto of 0.00 is dropped, and one in the same direction as the
+ *  pending one with no turn in between is added to it.
+ */
+static void format_fd(Logo input, float op) {
+    Backend b = input->backend;
+    long long cents;
+    if (b != NULL && b->mode == MODE_PROGRAM) {
+        /* the program is written once it has run */
+        b->ops_in = b->ops_in + 1;
+        return;
+    }
+    if (b != NULL && b->follow) {
+        follow_fd(input, op * LOGO2PS_FACTOR);
+        return;
+    }
+    if (b == NULL || !b->compact) {
+        ob_fixed2(input->out, op * LOGO2PS_FACTOR);
+        ob_puts(input->out, " 0 rlineto\n");
+        if (b != NULL) {
+            add_segment(input);
+        }
+        return;
+    }
+    b->ops_in = b->ops_in + 1;
+    if (ob_to_cents(op * LOGO2PS_FACTOR, &cents) < 0) {
+        flush_all(input);
+        ob_fixed2(input->out, op * LOGO2PS_FACTOR);
+        ob_puts(input->out, " 0 rlineto\n");
+        b->ops_out = b->ops_out + 1;
+        add_segment(input);
+        return;
+    }
+    if (cents == 0) {
+        return;
+    }
+    if (b->rot != 0) {
+        flush_all(input);
+    } else if (b->fd != 0 && ((b->fd > 0) != (cents > 0) || llabs(b->fd) > PS_MERGE_MAX)) {
+        /* going back over the line is not the same as a shorter one */
+        flush_fd(input);
+    }
+    b->fd = b->fd + cents;
+}
+
+/**
+ *  Maps lt() to rotate. When compacting,
+ *  turns are summed until the next rlineto.
+ */
+static void format_lt(Logo input, float op) {
+    if (input->backend != NULL && input->backend->mode == MODE_PROGRAM) {
+        input->backend->ops_in = input->backend->ops_in + 1;
+        return;
+    }
+    if (input->backend != NULL && input->backend->follow) {
+        follow_turn(input->backend, printed(op));
+        return;
+    }
+    if (input->backend == NULL || !input->backend->compact) {
+        ob_fixed2(input->out, op);
+        ob_puts(input->out, " rotate\n");
+        return;
+    }
+    add_rotate(input, op, 1);
+}
+
+/**
+ *  Maps rt() to rotate
+ */
+static void format_rt(Logo input, float op) {
+    if (input->backend != NULL && input->backend->mode == MODE_PROGRAM) {
+        input->backend->ops_in = input->backend->ops_in + 1;
+        return;
+    }
+    if (input->backend != NULL && input->backend->follow) {
+        follow_turn(input->backend, -printed(op));
+        return;
+    }
+    if (input->backend == NULL || !input->backend->compact) {
+        ob_puts(input->out, "-");
+        ob_fixed2(input->out, op);
+        ob_puts(input->out, " rotate\n");
+        return;
+    }
+    add_rotate(input, op, -1);
+}
+
+/**
+ *  Runs an operation taken from the ring, on the formatting thread
+ */
+static void format_op(void *data, int op, float arg) {
+    Logo input = (Logo) data;
+    if (op == RG_FD) {
+        format_fd(input, arg);
+    } else if (op == RG_LT) {
+        format_lt(input, arg);
+    } else {
+        format_rt(input, arg);
+    }
+}
+
+/**
+ *  Returns 1 if opts ask for the postscript to be formatted and written on
+ *  a thread of its own while the program runs. Only --threads with more
+ *  than one does, as the pipeline is yet to be measured on many cores.
+ */
+static int use_ring(Options *opts) {
+    if (opts->mode == MODE_PROGRAM) {
+        /* nothing is written until the program has run */
+        return 0;
+    }
+    return opts->threads > 1;
+}
+
+/********************************************
+ Backend Handling
+ ********************************************/
+
+/**
+ *  Sets up the backend in input for opts. Returns 0 on success, MEM_ERR
+ *  when out of memory, ARGS_ERR for an option of another backend
+ */
+int ps_backend(Logo input, Options *opts) {
+    Backend b;
+    if (backend_takes(opts, OPT_POSTSCRIPT, "postscript") < 0) {
+        return ARGS_ERR;
+    }
+    b = (Backend) malloc (sizeof(*b));
+    if (b == NULL) {
+        return MEM_ERR;
+    }
+    b->mode = opts->mode;
+    b->unrolled = 0;
+    if (b->mode == MODE_PROGRAM && may_not_go_round(input)) {
+        /* written as it runs instead, which draws the same */
+        b->mode = MODE_UNROLLED;
+        b->unrolled = 1;
+    }
+    b->lines = 0;
+    b->compact = (b->mode == MODE_UNROLLED && opts->compact);
+    b->fd = 0;
+    b->rot = 0;
+    b->ops_in = 0;
+    b->ops_out = 0;
+    follow_reset(b);
+    b->drawn = 0;
+    b->max_path = opts->max_path;
+    b->segments = 0;
+    b->follow = (b->mode == MODE_ABSOLUTE ||
+                 (b->mode == MODE_UNROLLED && (opts->simplify >= 0 || opts->dedup)));
+    b->simplify = NULL;
+    b->dedup = NULL;
+    b->ring = NULL;
+    if (b->follow && opts->simplify >= 0) {
+        b->simplify = sp_new(opts->simplify, write_vertex, input);
+    }
+    if (b->follow && opts->dedup) {
+        b->dedup = dd_new(DD_MAX_BYTES);
+    }
+    if ((b->follow && opts->simplify >= 0 && b->simplify == NULL) ||
+        (b->follow && opts->dedup && b->dedup == NULL)) {
+        ps_free(b);
+        return MEM_ERR;
+    }
+    if (use_ring(opts)) {
+        /* without a ring the operators are formatted as they come */
+        b->ring = rg_new(format_op, input);
+    }
+    input->backend = b;
+    return 0;
+}
+
+/**
+ *  Frees the backend, which may be NULL
+ */
+void ps_free(Backend backend) {
+    if (backend == NULL) {
+        return;
+    }
+    rg_free(backend->ring);
+    if (backend->simplify != NULL) {
+        sp_free(backend->simplify);
+    }
+    if (backend->dedup != NULL) {
+        dd_free(backend->dedup);
+    }
+    free(backend);
+}
+
+/**
+ *  Reports how much smaller simplifying, dropping duplicates or compacting
+ *  made the output
+ */
+void ps_report(Logo input) {
+    Backend b = input->backend;
+    if (b == NULL) {
+        return;
+    }
+    ps_sync(input);
+    if (b->unrolled) {
+        printf("Wrote the program unrolled, as a DO in it may go round no times\n");
+    }
+    if (b->mode == MODE_PROGRAM) {
+        printf("Wrote %ld lines of program for %ld drawing operators\n", b->lines, b->ops_in);
+        return;
+    }
+    if (b->simplify != NULL) {
+        printf("Simplified %ld vertices to %ld\n", b->simplify->in, b->simplify->out);
+    }
+    if (b->dedup != NULL) {
+        printf("Dropped %ld of %ld segments as drawn before", b->dedup->dropped,
+               b->dedup->checked);
+        if (b->dedup->full) {
+            printf(" (table full, some duplicates kept)");
+        }
+        printf("\n");
+    }
+    if (b->follow || !b->compact) {
+        return;
+    }
+    printf("Compacted %ld drawing operators to %ld", b->ops_in, b->ops_out);
+    if (b->ops_in > 0) {
+        printf(" (%.1f%% fewer)", 100.0 * (b->ops_in - b->ops_out) / b->ops_in);
+    }
+    printf("\n");
+}
+
+/**
+ *  Writes the program between the line start and the current line, which
+ *  has just been interpreted, as a postscript program that draws the same
+ *  with loops and variables of its own. Does nothing in other modes.
+ */
+void ps_program(Logo input, int start) {
+    Backend b = input->backend;
+    char inst[INSTRUCT_LENGTH+1], operand[LINE_LENGTH];
+    char *line;
+    int i, range = 0;
+    if (b == NULL || b->mode != MODE_PROGRAM) {
+        return;
+    }
+    ps_sync(input);
+    if (b->max_path > 0) {
+        ob_puts(input->out, PS_SEG_1);
+        ob_int(input->out, (int) ((b->max_path < INT_MAX) ? b->max_path : INT_MAX));
+        ob_puts(input->out, PS_SEG_2);
+        b->lines = b->lines + 2;
+    }
+    /* the lines between the brackets of <MAIN> */
+    for (i=start+1; i<input->counter-1; i++) {
+        line = input->lines[i];
+        if (sscanf(line, "%3s %s", inst, operand) < 1) {
+            continue;
+        }
+        if (strsame(inst, "}")) {
+            ob_puts(input->out, "} for\n");
+        } else if (strsame(inst, FD)) {
+            put_varnum(input->out, operand, 0);
+            ob_puts(input->out, (b->max_path > 0) ? " 0 seg\n" : " 0 rlineto\n");
+        } else if (strsame(inst, LT)) {
+            put_varnum(input->out, operand, 0);
+            ob_puts(input->out, " rotate\n");
+        } else if (strsame(inst, RT)) {
+            put_varnum(input->out, operand, 1);
+            ob_puts(input->out, " rotate\n");
+        } else if (strsame(inst, SET)) {
+            put_set(input->out, line);
+        } else if (strsame(inst, DO)) {
+            b->lines = b->lines + put_do(input->out, line, &range) - 1;
+        }
+        b->lines = b->lines + 1;
+    }
+}
+
 /********************************************
  Interpreting Functions
  ********************************************/
 
 /**
- *  Postscript headers for output file before interpreting 
+ *  Postscript headers for output file before interpreting. In MODE_ABSOLUTE
+ *  the bounding box is only known at the end, so it is deferred to the
+ *  trailer.
  */
-void ps_header(FILE *out_file, char *in_filename) {
+void ps_header(Logo input, char *in_filename) {
+    ps_sync(input);
+    if (input->backend != NULL && input->backend->ring != NULL) {
+        /* the last of the pipeline, or the output is written as before */
+        ob_writer(input->out);
+    }
     /* postscript header */
-    fprintf(out_file, "%%!PS-%s\n", in_filename);
-    fprintf(out_file, "newpath\n");
-    fprintf(out_file, "%d %d moveto\n", PS_MOVETO_X, PS_MOVETO_Y);
+    ob_puts(input->out, "%!PS-");
+    ob_puts(input->out, in_filename);
+    ob_puts(input->out, "\n");
+    if (input->backend != NULL && input->backend->mode == MODE_ABSOLUTE) {
+        ob_puts(input->out, "%%BoundingBox: (atend)\n");
+        input->backend->drawn = 0;
+    }
+    ps_newpage(input->out);
+}
+
+/**
+ *  Postscript footers for output file after interpreting. A pending rotate
+ *  is dropped, as it would not change the path.
+ */
+void ps_footer(Logo input) {
+    Backend b = input->backend;
+    ps_sync(input);
+    if (b != NULL && b->mode == MODE_PROGRAM) {
+        /* nothing held back */
+    } else if (b != NULL && b->follow) {
+        /* the next page starts from the beginning */
+        if (b->simplify != NULL) {
+            sp_end(b->simplify);
+        }
+        if (b->dedup != NULL) {
+            dd_clear(b->dedup);
+        }
+        follow_reset(b);
+    } else if (b != NULL && b->compact) {
+        flush_fd(input);
+        input->backend->rot = 0;
+    }
+    if (b != NULL) {
+        b->segments = 0;
+    }
+    ob_puts(input->out, "stroke\n");
+}
+
+/**
+ *  Postscript trailer for output file after the last footer. In
+ *  MODE_ABSOLUTE this gives the bounding box of everything drawn, widened
+ *  by PS_BBOX_PAD for the width of the line.
+ */
+void ps_trailer(Logo input) {
+    Backend b = input->backend;
+    ps_sync(input);
+    if (b == NULL || b->mode != MODE_ABSOLUTE) {
+        return;
+    }
+    ob_puts(input->out, "%%Trailer\n%%BoundingBox: ");
+    if (!b->drawn) {
+        ob_puts(input->out, "0 0 0 0\n");
+        return;
+    }
+    ob_int(input->out, (int) floor(b->min_x / 100 - PS_BBOX_PAD));
+    ob_puts(input->out, " ");
+    ob_int(input->out, (int) floor(b->min_y / 100 - PS_BBOX_PAD));
+    ob_puts(input->out, " ");
+    ob_int(input->out, (int) ceil(b->max_x / 100 + PS_BBOX_PAD));
+    ob_puts(input->out, " ");
+    ob_int(input->out, (int) ceil(b->max_y / 100 + PS_BBOX_PAD));
+    ob_puts(input->out, "\n");
+}
+
+/**
+ *  Waits for the operators handed to the formatting thread to be written
+ *  to the output, so that it can be written to or closed
+ */
+void ps_sync(Logo input) {
+    if (input->backend != NULL && input->backend->ring != NULL) {
+        rg_sync(input->backend->ring);
+    }
+}
+
+/**
+ *  Starts the path of a new page, for the second program onwards
+ */
+void ps_newpage(OutBuf out) {
+    ob_puts(out, "newpath\n");
+    ob_int(out, PS_MOVETO_X);
+    ob_puts(out, " ");
+    ob_int(out, PS_MOVETO_Y);
+    ob_puts(out, " moveto\n");
 }
 
 /**
- *  Postscript footers for output file after interpreting
+ *  Ends a page, after the footer
  */
-void ps_footer(FILE *out_file) {
-    fprintf(out_file, "stroke\n");
+void ps_showpage(OutBuf out) {
+    ob_puts(out, "showpage\n");
 }
 
 /**
  *  Postscript implementation for mapping fd() to rlineto
  */
 void ps_ipt_fd(Logo input, float op) {
-    fprintf(input->ofile, "%.2f 0 rlineto\n", op * LOGO2PS_FACTOR);
+    if (input->backend != NULL && input->backend->ring != NULL) {
+        rg_push(input->backend->ring, RG_FD, op);
+        return;
+    }
+    format_fd(input, op);
 }
 
 /**
  *  Postscript implementation for mapping lt() to rotate
  */
 void ps_ipt_lt(Logo input, float op) {
-    fprintf(input->ofile, "%.2f rotate\n", op);
+    if (input->backend != NULL && input->backend->ring != NULL) {
+        rg_push(input->backend->ring, RG_LT, op);
+        return;
+    }
+    format_lt(input, op);
 }
 
 /**
  *  Postscript implementation for mapping rt() to rotate
  */
 void ps_ipt_rt(Logo input, float op) {
-    fprintf(input->ofile, "-%.2f rotate\n", op);
+    if (input->backend != NULL && input->backend->ring != NULL) {
+        rg_push(input->backend->ring, RG_RT, op);
+        return;
+    }
+    format_rt(input, op);
 }
@@ -0,0 +1,887 @@
+/*
+ *  raster.c
+ *  Backend for drawing into an image without a display
+ *
+ *  Draws the same page as the postscript backend into a buffer of coverage,
+ *  a byte per pixel, with no GTK and no display. Lines are anti-aliased by
+ *  stepping along their longer axis in fixed point and sharing each step
+ *  between the two pixels across it. The lines are kept until the image is
+ *  written, then binned into tiles small enough to stay in cache, and the
+ *  tiles are drawn on as many threads as there are cores. The image is
+ *  written as a binary ppm, or a greyscale png compressed with zlib.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for clock_gettime and sysconf */
+
+#include <math.h>   /* for following the turtle */
+#include <stdio.h>
+#include <stdlib.h> /* malloc */
+#include <string.h> /* memset */
+#include <time.h>   /* for timing the drawing */
+#include <unistd.h> /* sysconf */
+#include <sys/stat.h> /* mkdir */
+#include <interpreter.h>
+#include "raster.h"
+
+#define HEADER_LENGTH   64      /* enough for a ppm header */
+#define NUM_LENGTH      64      /* enough for any number written */
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Inks the pixels along a line from (a0, b0) to (a1, b1), where a is the
+ *  longer axis. alen and blen are the image size along each axis, astride
+ *  and bstride the distance between pixels along them in cov. A pixel is
+ *  drawn for each centre along a from a0 up to but not including a1, so
+ *  lines that meet do not ink the pixel they share twice.
+ */
+static void draw_span(unsigned char *cov, double a0, double b0, double a1, double b1,
+                      int alen, int blen, int astride, int bstride) {
+    double g, t, te, first, last;
+    long long v, step;
+    unsigned char *p, *q;
+    int a, end, m, c;
+    if (a1 < a0) {
+        t = a0; a0 = a1; a1 = t;
+        t = b0; b0 = b1; b1 = t;
+    }
+    if (!(a1 - a0 > 0)) {
+        return;
+    }
+    /* the pixels whose centres the line passes, clipped to the image */
+    first = ceil(a0 - 0.5);
+    last = ceil(a1 - 0.5);
+    if (first < 0) {
+        first = 0;
+    }
+    if (last > alen) {
+        last = alen;
+    }
+    if (!(first < last)) {
+        return;
+    }
+    /* b less half a pixel at the first and last centres */
+    g = (b1 - b0) / (a1 - a0);
+    t = b0 + (first + 0.5 - a0) * g - 0.5;
+    te = t + (last - 1 - first) * g;
+    if ((t < -1 && te < -1) || (t >= blen && te >= blen) ||
+        !(t > -RASTER_BIAS && t < RASTER_BIAS && te > -RASTER_BIAS && te < RASTER_BIAS)) {
+        return;
+    }
+    a = (int) first;
+    end = (int) last;
+    v = (long long) floor((t + RASTER_BIAS) * RASTER_ONE + 0.5);
+    step = (long long) floor(g * RASTER_ONE + 0.5);
+    p = cov + (long) a * astride;
+    for (; a < end; a++, v += step, p += astride) {
+        m = (int) (v >> RASTER_SHIFT) - RASTER_BIAS;
+        c = (int) (v >> (RASTER_SHIFT - 8)) & 0xff;
+        if (m >= 0 && m < blen) {
+            q = p + (long) m * bstride;
+            if (255 - c > *q) {
+                *q = 255 - c;
+            }
+        }
+        if (m + 1 >= 0 && m + 1 < blen) {
+            q = p + (long) (m + 1) * bstride;
+            if (c > *q) {
+                *q = c;
+            }
+        }
+    }
+}
+
+/**
+ *  Draws a line from (x0, y0) to (x1, y1) into a w by h block of coverage,
+ *  whose rows are stride apart
+ */
+static void draw_line(unsigned char *cov, int w, int h, int stride,
+                      double x0, double y0, double x1, double y1) {
+    if (fabs(x1 - x0) >= fabs(y1 - y0)) {
+        draw_span(cov, x0, y0, x1, y1, w, h, 1, stride);
+    } else {
+        draw_span(cov, y0, x0, y1, x1, h, w, stride, 1);
+    }
+}
+
+/**
+ *  Returns the time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *  Visits the tiles of a width by height image, tiles_x across, that the
+ *  line s can ink. It steps along the longer axis of the line from one
+ *  column of tiles to the next, taking the tiles across that the line
+ *  spans in each. If list is NULL the line is counted in slot[tile], else
+ *  idx is put into list before slot[tile], which is moved back.
+ */
+static void bin_segment(const RasterSeg *s, int width, int height, int tiles_x,
+                        long idx, long *slot, long *list) {
+    double a0, b0, a1, b1, g, lo, hi, clo, chi, blo, bhi, t;
+    int alen, blen, ta, ta_end, tb, tb_end, tile;
+    int along_x = fabs(s->x1 - s->x0) >= fabs(s->y1 - s->y0);
+    if (along_x) {
+        a0 = s->x0; b0 = s->y0; a1 = s->x1; b1 = s->y1;
+        alen = width;
+        blen = height;
+    } else {
+        a0 = s->y0; b0 = s->x0; a1 = s->y1; b1 = s->x1;
+        alen = height;
+        blen = width;
+    }
+    if (a1 < a0) {
+        t = a0; a0 = a1; a1 = t;
+        t = b0; b0 = b1; b1 = t;
+    }
+    if (!(a1 - a0 > 0)) {
+        return;
+    }
+    g = (b1 - b0) / (a1 - a0);
+    /* the pixels along that the line can ink, clipped to the image */
+    lo = (a0 - RASTER_MARGIN > 0) ? a0 - RASTER_MARGIN : 0;
+    hi = (a1 + RASTER_MARGIN < alen - 1) ? a1 + RASTER_MARGIN : alen - 1;
+    if (!(lo <= hi)) {
+        return;
+    }
+    ta_end = (int) (hi / RASTER_TILE);
+    for (ta = (int) (lo / RASTER_TILE); ta <= ta_end; ta++) {
+        /* the line over this column of tiles, and the pixels across it can ink */
+        clo = (ta * RASTER_TILE > lo) ? ta * RASTER_TILE : lo;
+        chi = ((ta + 1) * RASTER_TILE < hi) ? (ta + 1) * RASTER_TILE : hi;
+        clo = (clo < a0) ? a0 : (clo > a1) ? a1 : clo;
+        chi = (chi < a0) ? a0 : (chi > a1) ? a1 : chi;
+        blo = b0 + (clo - a0) * g;
+        bhi = b0 + (chi - a0) * g;
+        if (blo > bhi) {
+            t = blo; blo = bhi; bhi = t;
+        }
+        blo = (blo - RASTER_MARGIN > 0) ? blo - RASTER_MARGIN : 0;
+        bhi = (bhi + RASTER_MARGIN < blen - 1) ? bhi + RASTER_MARGIN : blen - 1;
+        if (!(blo <= bhi)) {
+            continue;
+        }
+        tb_end = (int) (bhi / RASTER_TILE);
+        for (tb = (int) (blo / RASTER_TILE); tb <= tb_end; tb++) {
+            tile = along_x ? tb * tiles_x + ta : ta * tiles_x + tb;
+            if (list == NULL) {
+                slot[tile] = slot[tile] + 1;
+            } else {
+                slot[tile] = slot[tile] - 1;
+                list[slot[tile]] = idx;
+            }
+        }
+    }
+}
+
+/**
+ *  Thread function drawing tiles until there are none left. Each tile is
+ *  drawn into coverage of the thread's own and copied into the image.
+ */
+static void * draw_tiles(void *arg) {
+    Backend b = (Backend) arg;
+    unsigned char *tile = (unsigned char *) malloc (RASTER_TILE * RASTER_TILE);
+    RasterSeg *s;
+    long k;
+    int t, ox, oy, w, h, r;
+    if (tile == NULL) {
+        /* leave the tiles to the other threads */
+        return NULL;
+    }
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        t = b->next_tile;
+        if (t < b->tiles_x * b->tiles_y) {
+            b->next_tile = t + 1;
+        }
+        pthread_mutex_unlock(&b->lock);
+        if (t >= b->tiles_x * b->tiles_y) {
+            break;
+        }
+        ox = (t % b->tiles_x) * RASTER_TILE;
+        oy = (t / b->tiles_x) * RASTER_TILE;
+        w = (b->width - ox < RASTER_TILE) ? b->width - ox : RASTER_TILE;
+        h = (b->height - oy < RASTER_TILE) ? b->height - oy : RASTER_TILE;
+        memset(tile, 0, RASTER_TILE * h);
+        for (k=b->first[t]; k<b->first[t + 1]; k++) {
+            s = &b->segs[b->list[k]];
+            draw_line(tile, w, h, RASTER_TILE, s->x0 - ox, s->y0 - oy, s->x1 - ox, s->y1 - oy);
+        }
+        /* no other tile has these pixels, so they are copied without a lock */
+        for (r=0; r<h; r++) {
+            memcpy(b->cov + (size_t) (oy + r) * b->width + ox, tile + r * RASTER_TILE, w);
+        }
+    }
+    free(tile);
+    return NULL;
+}
+
+/**
+ *  Writes a png chunk of n bytes of data, with its length and checksum
+ */
+static void put_chunk(OutBuf out, const char *type, const unsigned char *data, size_t n) {
+    unsigned char word[4];
+    uLong crc;
+    word[0] = (n >> 24) & 0xff;
+    word[1] = (n >> 16) & 0xff;
+    word[2] = (n >> 8) & 0xff;
+    word[3] = n & 0xff;
+    ob_write(out, (char *) word, 4);
+    ob_write(out, type, 4);
+    crc = crc32(0L, (const Bytef *) type, 4);
+    /* crc32() of no data would start again */
+    if (n > 0) {
+        ob_write(out, (const char *) data, n);
+        crc = crc32(crc, (const Bytef *) data, n);
+    }
+    word[0] = (crc >> 24) & 0xff;
+    word[1] = (crc >> 16) & 0xff;
+    word[2] = (crc >> 8) & 0xff;
+    word[3] = crc & 0xff;
+    ob_write(out, (char *) word, 4);
+}
+
+/**
+ *  Compresses n bytes of image data, writing an IDAT chunk each time the
+ *  compressed buffer fills, and the rest if flush is Z_FINISH
+ */
+static void deflate_data(Backend b, OutBuf out, unsigned char *data, size_t n, int flush) {
+    int ret;
+    b->z.next_in = data;
+    b->z.avail_in = n;
+    do {
+        ret = deflate(&b->z, flush);
+        if (b->z.avail_out == 0 || ret == Z_STREAM_END) {
+            put_chunk(out, "IDAT", b->zbuf, RASTER_CHUNK - b->z.avail_out);
+            b->z.next_out = b->zbuf;
+            b->z.avail_out = RASTER_CHUNK;
+        }
+    } while (b->z.avail_in > 0 || (flush == Z_FINISH && ret == Z_OK));
+}
+
+/**
+ *  Writes w by h pixels of coverage, whose rows are stride apart, as a
+ *  greyscale png, a row at a time with no filter
+ */
+static void write_png(Backend b, OutBuf out, const unsigned char *cov, int w, int h, int stride) {
+    static const unsigned char sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    unsigned char ihdr[13] = {
+        (w >> 24) & 0xff, (w >> 16) & 0xff, (w >> 8) & 0xff, w & 0xff,
+        (h >> 24) & 0xff, (h >> 16) & 0xff, (h >> 8) & 0xff, h & 0xff,
+        8, 0, 0, 0, 0   /* 8 bit grey, deflate, adaptive filters, no interlace */
+    };
+    int i, j;
+    ob_write(out, (const char *) sig, 8);
+    put_chunk(out, "IHDR", ihdr, 13);
+    deflateReset(&b->z);
+    b->z.next_out = b->zbuf;
+    b->z.avail_out = RASTER_CHUNK;
+    for (i=0; i<h; i++) {
+        b->row[0] = 0;
+        for (j=0; j<w; j++) {
+            b->row[j + 1] = 255 - cov[j];
+        }
+        cov = cov + stride;
+        deflate_data(b, out, b->row, w + 1, Z_NO_FLUSH);
+    }
+    deflate_data(b, out, NULL, 0, Z_FINISH);
+    put_chunk(out, "IEND", NULL, 0);
+}
+
+/**
+ *  Writes w by h pixels of coverage, whose rows are stride apart, as a
+ *  binary ppm
+ */
+static void write_ppm(Backend b, OutBuf out, const unsigned char *cov, int w, int h, int stride) {
+    char header[HEADER_LENGTH];
+    int i, j, n;
+    n = snprintf(header, HEADER_LENGTH, "P6\n%d %d\n255\n", w, h);
+    ob_write(out, header, n);
+    for (i=0; i<h; i++) {
+        for (j=0; j<w; j++) {
+            b->row[3 * j] = 255 - cov[j];
+            b->row[3 * j + 1] = 255 - cov[j];
+            b->row[3 * j + 2] = 255 - cov[j];
+        }
+        cov = cov + stride;
+        ob_write(out, (char *) b->row, 3 * w);
+    }
+}
+
+/**
+ *  Puts the line s, in pixels of the image, into the pixels of a level of
+ *  the pyramid with f of them to a pixel of the image, from (ox, oy)
+ */
+static void to_level(Backend b, const RasterSeg *s, double f, double ox, double oy, RasterSeg *out) {
+    out->x0 = (s->x0 - b->min_x) * f - ox;
+    out->y0 = (s->y0 - b->min_y) * f - oy;
+    out->x1 = (s->x1 - b->min_x) * f - ox;
+    out->y1 = (s->y1 - b->min_y) * f - oy;
+}
+
+/**
+ *  Reads the next chunk of the lines in the file into b->chunk. Returns how
+ *  many were read, 0 at the end, FILE_ERR if they cannot be read
+ */
+static long read_chunk(Backend b, FILE *lines) {
+    long n = (long) fread(b->chunk, sizeof(RasterLine), RASTER_CHUNK_LINES, lines);
+    return ferror(lines) ? FILE_ERR : n;
+}
+
+/**
+ *  Draws the lines in the file into the tile of the pyramid at (ox, oy) of
+ *  a level with f pixels to a pixel of the image. Runs of lines drawn one
+ *  after the other that fit inside a pixel are drawn as one line across
+ *  it. Returns whether anything was inked, or FILE_ERR if the lines cannot
+ *  be read.
+ */
+static int draw_decimated(Backend b, FILE *lines, double f, double ox, double oy) {
+    RasterSeg s, run;
+    double lx = 0, ly = 0, hx = 0, hy = 0;
+    long k, n, last = -1;
+    int i, any = 0;
+    memset(b->tile, 0, RASTER_TILE * RASTER_TILE);
+    rewind(lines);
+    while ((n = read_chunk(b, lines)) > 0) {
+        for (k=0; k<n; k++) {
+            to_level(b, &b->chunk[k].seg, f, ox, oy, &s);
+            if (any && b->chunk[k].id == last + 1 && s.x0 == run.x1 && s.y0 == run.y1 &&
+                fmax(hx, s.x1) - fmin(lx, s.x1) < 1 && fmax(hy, s.y1) - fmin(ly, s.y1) < 1) {
+                /* still inside a pixel, so the run goes on */
+                run.x1 = s.x1;
+                run.y1 = s.y1;
+                lx = fmin(lx, s.x1);
+                hx = fmax(hx, s.x1);
+                ly = fmin(ly, s.y1);
+                hy = fmax(hy, s.y1);
+                last = b->chunk[k].id;
+                continue;
+            }
+            if (any) {
+                draw_line(b->tile, RASTER_TILE, RASTER_TILE, RASTER_TILE, run.x0, run.y0, run.x1, run.y1);
+            }
+            run = s;
+            lx = fmin(s.x0, s.x1);
+            hx = fmax(s.x0, s.x1);
+            ly = fmin(s.y0, s.y1);
+            hy = fmax(s.y0, s.y1);
+            last = b->chunk[k].id;
+            any = 1;
+        }
+    }
+    if (n < 0) {
+        return FILE_ERR;
+    }
+    if (any) {
+        draw_line(b->tile, RASTER_TILE, RASTER_TILE, RASTER_TILE, run.x0, run.y0, run.x1, run.y1);
+    }
+    for (i=0; i<RASTER_TILE * RASTER_TILE && b->tile[i] == 0; i++);
+    return i < RASTER_TILE * RASTER_TILE;
+}
+
+/**
+ *  Writes the tile drawn as z/x/y in the directory of the pyramid, making
+ *  the directories it goes in. The output is failed if it cannot be written.
+ */
+static void write_tile(Logo input, int z, long x, long y) {
+    Backend b = input->backend;
+    char path[RASTER_PATH_LENGTH];
+    FILE *file;
+    OutBuf out;
+    int ret;
+    snprintf(path, RASTER_PATH_LENGTH, "%s/%d", b->dir, z);
+    mkdir(path, 0777);
+    snprintf(path, RASTER_PATH_LENGTH, "%s/%d/%ld", b->dir, z, x);
+    mkdir(path, 0777);
+    ret = snprintf(path, RASTER_PATH_LENGTH, "%s/%d/%ld/%ld.%s", b->dir, z, x, y,
+                   (b->image == IMAGE_PNG) ? "png" : "ppm");
+    file = (ret < RASTER_PATH_LENGTH) ? fopen(path, "wb") : NULL;
+    if (file == NULL) {
+        fprintf(stderr, "Error: failed to open %s\n", path);
+        input->out->error = 1;
+        return;
+    }
+    out = ob_new(file);
+    if (out == NULL) {
+        fclose(file);
+        remove(path);
+        input->out->error = 1;
+        return;
+    }
+    if (b->image == IMAGE_PNG) {
+        write_png(b, out, b->tile, RASTER_TILE, RASTER_TILE, RASTER_TILE);
+    } else {
+        write_ppm(b, out, b->tile, RASTER_TILE, RASTER_TILE, RASTER_TILE);
+    }
+    ret = ob_close(out);
+    fclose(file);
+    if (ret < 0) {
+        fprintf(stderr, "Error: failed to write %s\n", path);
+        remove(path);
+        input->out->error = 1;
+        return;
+    }
+    b->written[z] = b->written[z] + 1;
+    b->tiles = b->tiles + 1;
+}
+
+/**
+ *  Draws and writes the tile z/x/y of the pyramid from the file of the
+ *  lines that can ink it, then the four tiles below it from files of those
+ *  of its lines that can ink them. The tiles below are binned as a 2 by 2
+ *  image, each line kept in order. A file is only made for a tile with
+ *  lines, and is gone once that tile and those below it are drawn.
+ *  Returns 0 on success, FILE_ERR if the lines cannot be read or spilled.
+ */
+static int draw_node(Logo input, int z, long x, long y, FILE *lines) {
+    Backend b = input->backend;
+    double f = ldexp(RASTER_TILE, z) / b->size;
+    FILE *below[4] = { NULL, NULL, NULL, NULL };
+    long slot[4], k, n;
+    RasterSeg s;
+    int c, ret;
+    if ((ret = draw_decimated(b, lines, f, (double) x * RASTER_TILE, (double) y * RASTER_TILE)) < 0) {
+        return ret;
+    }
+    if (ret) {
+        write_tile(input, z, x, y);
+    }
+    if (z == b->max_zoom || input->out->error) {
+        return 0;
+    }
+    ret = 0;
+    rewind(lines);
+    while (ret == 0 && (n = read_chunk(b, lines)) > 0) {
+        for (k=0; k<n && ret == 0; k++) {
+            to_level(b, &b->chunk[k].seg, 2 * f, 2.0 * x * RASTER_TILE, 2.0 * y * RASTER_TILE, &s);
+            memset(slot, 0, sizeof(slot));
+            bin_segment(&s, 2 * RASTER_TILE, 2 * RASTER_TILE, 2, 0, slot, NULL);
+            for (c=0; c<4 && ret == 0; c++) {
+                if (slot[c] > 0 && below[c] == NULL) {
+                    below[c] = tmpfile();
+                }
+                if (slot[c] > 0 && (below[c] == NULL ||
+                                    fwrite(&b->chunk[k], sizeof(RasterLine), 1, below[c]) != 1)) {
+                    ret = FILE_ERR;
+                }
+            }
+        }
+    }
+    ret = (ret == 0 && n < 0) ? FILE_ERR : ret;
+    for (c=0; c<4; c++) {
+        if (ret == 0 && below[c] != NULL) {
+            ret = draw_node(input, z + 1, 2 * x + c % 2, 2 * y + c / 2, below[c]);
+        }
+        if (below[c] != NULL) {
+            fclose(below[c]);
+        }
+    }
+    return ret;
+}
+
+/**
+ *  Puts the directory for the tiles of the pyramid into b->dir, the output
+ *  filename without its extension and with "_files" after it. Returns 0 on
+ *  success, FILE_ERR if it is too long.
+ */
+static int tiles_dir(Logo input) {
+    char *name = input->out_filename, *dot, *slash;
+    int base, len;
+    dot = strrchr(name, '.');
+    slash = strrchr(name, '/');
+    if (dot == NULL || (slash != NULL && dot < slash) || dot == name) {
+        base = strlen(name);
+    } else {
+        base = dot - name;
+    }
+    len = snprintf(input->backend->dir, FILENAME_LENGTH, "%.*s_files", base, name);
+    return (len < 0 || len >= FILENAME_LENGTH) ? FILE_ERR : 0;
+}
+
+/**
+ *  Writes name, then the number v in points
+ */
+static void put_number(OutBuf out, const char *name, double v) {
+    char num[NUM_LENGTH];
+    snprintf(num, NUM_LENGTH, "%.10g", v);
+    ob_puts(out, name);
+    ob_puts(out, num);
+}
+
+/**
+ *  Writes the manifest of the pyramid to the output, with the bounds of the
+ *  drawing in pixels of the image. Points are those of the postscript page.
+ */
+static void write_manifest(Logo input, double lx, double ly, double hx, double hy) {
+    Backend b = input->backend;
+    OutBuf out = input->out;
+    char *slash = strrchr(b->dir, '/');
+    int z;
+    ob_puts(out, "{\n  \"format\": \"");
+    ob_puts(out, (b->image == IMAGE_PNG) ? "png" : "ppm");
+    ob_puts(out, "\",\n  \"tile_size\": ");
+    ob_int(out, RASTER_TILE);
+    ob_puts(out, ",\n  \"min_zoom\": 0,\n  \"max_zoom\": ");
+    ob_int(out, b->max_zoom);
+    ob_puts(out, ",\n  \"tiles\": \"");
+    ob_puts(out, (slash != NULL) ? slash + 1 : b->dir);
+    ob_puts(out, (b->image == IMAGE_PNG) ? "/{z}/{x}/{y}.png" : "/{z}/{x}/{y}.ppm");
+    /* the top left of the tile of level 0, and how far it goes */
+    put_number(out, "\",\n  \"origin\": [", b->min_x / b->scale);
+    put_number(out, ", ", RASTER_HEIGHT - b->min_y / b->scale);
+    put_number(out, "],\n  \"size\": ", b->size / b->scale);
+    put_number(out, ",\n  \"bounds\": [", lx / b->scale);
+    put_number(out, ", ", RASTER_HEIGHT - hy / b->scale);
+    put_number(out, ", ", hx / b->scale);
+    put_number(out, ", ", RASTER_HEIGHT - ly / b->scale);
+    ob_puts(out, "],\n  \"written\": [");
+    for (z=0; z<=b->max_zoom; z++) {
+        if (z > 0) {
+            ob_puts(out, ", ");
+        }
+        ob_int(out, (int) b->written[z]);
+    }
+    ob_puts(out, "]\n}\n");
+}
+
+/**
+ *  Draws the lines kept as a pyramid of tiles over a square around them,
+ *  as deep as it takes for a pixel of the deepest level to be no more than
+ *  a pixel of the image, and writes its manifest. The output is failed if
+ *  the tiles cannot be drawn or written.
+ */
+static void write_pyramid(Logo input) {
+    Backend b = input->backend;
+    double lx = b->lx, ly = b->ly, hx = b->hx, hy = b->hy;
+    int z;
+    if (b->spill == NULL || fflush(b->spill) != 0) {
+        fprintf(stderr, "Error: failed to keep the lines of the pyramid\n");
+        input->out->error = 1;
+        return;
+    }
+    if (lx > hx) {
+        /* nothing to draw */
+        lx = hx = RASTER_START_X * b->scale;
+        ly = hy = (RASTER_HEIGHT - RASTER_START_Y) * b->scale;
+    }
+    b->size = fmax(fmax(hx - lx, hy - ly) + 2 * RASTER_MARGIN, RASTER_TILE);
+    b->min_x = (lx + hx - b->size) / 2;
+    b->min_y = (ly + hy - b->size) / 2;
+    for (z=0; z<RASTER_MAX_ZOOM && ldexp(RASTER_TILE, z) < b->size; z++);
+    b->max_zoom = z;
+    memset(b->written, 0, sizeof(b->written));
+    if (input->out_filename == NULL || tiles_dir(input) < 0) {
+        fprintf(stderr, "Error: no directory for the tiles\n");
+        input->out->error = 1;
+        return;
+    }
+    mkdir(b->dir, 0777);
+    if (draw_node(input, 0, 0, 0, b->spill) < 0) {
+        fprintf(stderr, "Error: failed to keep the lines of the pyramid\n");
+        input->out->error = 1;
+    }
+    write_manifest(input, lx, ly, hx, hy);
+}
+
+/********************************************
+ Backend Handling
+ ********************************************/
+
+/**
+ *  Sets up the backend in input. Returns 0 on success, MEM_ERR when out of
+ *  memory, ARGS_ERR for more than one page or an option of another
+ *  backend.
+ */
+int raster_backend(Logo input, Options *opts) {
+    Backend b;
+    long cpus;
+    if (backend_takes(opts, OPT_RASTER, "raster") < 0) {
+        return ARGS_ERR;
+    }
+    if (opts->multi == MULTI_PAGES) {
+        fprintf(stderr, "Error: an image has one page, use --multi=files\n");
+        return ARGS_ERR;
+    }
+    if (opts->scale > RASTER_MAX_SCALE) {
+        fprintf(stderr, "Error: scale %g is more than %d\n", opts->scale, RASTER_MAX_SCALE);
+        return ARGS_ERR;
+    }
+    b = (Backend) calloc (1, sizeof(*b));
+    if (b == NULL) {
+        return MEM_ERR;
+    }
+    b->scale = opts->scale;
+    b->width = (int) floor(RASTER_WIDTH * b->scale + 0.5);
+    b->height = (int) floor(RASTER_HEIGHT * b->scale + 0.5);
+    b->width = (b->width < 1) ? 1 : b->width;
+    b->height = (b->height < 1) ? 1 : b->height;
+    b->tiles_x = (b->width + RASTER_TILE - 1) / RASTER_TILE;
+    b->tiles_y = (b->height + RASTER_TILE - 1) / RASTER_TILE;
+    /* a thread per core unless told otherwise */
+    cpus = (opts->threads > 0) ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+    b->threads = (cpus < 1) ? 1 : (cpus > RASTER_MAX_THREADS) ? RASTER_MAX_THREADS : (int) cpus;
+    b->pyramid = opts->pyramid;
+    if (b->pyramid) {
+        /* a pyramid is drawn a tile at a time from disk, however big the
+           image and however many lines */
+        b->tile = (unsigned char *) malloc (RASTER_TILE * RASTER_TILE);
+        b->chunk = (RasterLine *) malloc (RASTER_CHUNK_LINES * sizeof(RasterLine));
+    } else {
+        b->segs = (RasterSeg *) malloc (RASTER_MIN_SEGS * sizeof(RasterSeg));
+        b->first = (long *) malloc ((b->tiles_x * b->tiles_y + 1) * sizeof(long));
+        b->cov = (unsigned char *) malloc ((size_t) b->width * b->height);
+    }
+    /* big enough for a row of either format, of the image or a tile */
+    b->row = (unsigned char *) malloc (3 * (size_t) (b->pyramid ? RASTER_TILE : b->width));
+    b->zbuf = (unsigned char *) malloc (RASTER_CHUNK);
+    b->z.zalloc = Z_NULL;
+    b->z.zfree = Z_NULL;
+    b->z.opaque = Z_NULL;
+    /* the lines leave long runs of white, which a search for matches is
+       slow over and run length encoding packs as well */
+    if ((b->pyramid ? (b->tile == NULL || b->chunk == NULL) :
+                      (b->segs == NULL || b->first == NULL || b->cov == NULL)) ||
+        b->row == NULL || b->zbuf == NULL ||
+        deflateInit2(&b->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15, 8, Z_RLE) != Z_OK) {
+        free(b->segs);
+        free(b->tile);
+        free(b->chunk);
+        free(b->first);
+        free(b->cov);
+        free(b->row);
+        free(b->zbuf);
+        free(b);
+        return MEM_ERR;
+    }
+    pthread_mutex_init(&b->lock, NULL);
+    b->max_segs = RASTER_MIN_SEGS;
+    b->image = opts->image;
+    input->backend = b;
+    return 0;
+}
+
+/**
+ *  Frees the backend, which may be NULL
+ */
+void raster_free(Backend backend) {
+    if (backend == NULL) {
+        return;
+    }
+    deflateEnd(&backend->z);
+    pthread_mutex_destroy(&backend->lock);
+    free(backend->segs);
+    free(backend->first);
+    free(backend->list);
+    free(backend->cov);
+    free(backend->tile);
+    free(backend->chunk);
+    if (backend->spill != NULL) {
+        fclose(backend->spill);
+    }
+    free(backend->row);
+    free(backend->zbuf);
+    free(backend);
+}
+
+/**
+ *  Reports what was drawn, and how long the drawing took
+ */
+void raster_report(Logo input) {
+    Backend b = input->backend;
+    if (b == NULL) {
+        return;
+    }
+    if (b->pyramid) {
+        printf("Drew %ld lines into %ld tiles of %d pyramids, %d levels deep\n",
+               b->segments, b->tiles, b->images, b->max_zoom + 1);
+        return;
+    }
+    printf("Drew %ld lines into %d %dx%d %s\n", b->segments, b->images,
+           b->width, b->height, (b->image == IMAGE_PNG) ? "png" : "ppm");
+    printf("Binned into %d tiles in %.3fs, drawn on %d threads in %.3fs\n",
+           b->tiles_x * b->tiles_y, b->bin_time, b->threads, b->draw_time);
+}
+
+/********************************************
+ Drawing
+ ********************************************/
+
+/**
+ *  Draws the lines kept into the image. They are binned into the tiles
+ *  each can ink, counting them first so that the lists of every tile fit
+ *  in one array, then the tiles are drawn on b->threads threads, the
+ *  calling thread being one of them. Returns 0 on success, MEM_ERR when
+ *  out of memory.
+ */
+int raster_draw(Backend b) {
+    pthread_t threads[RASTER_MAX_THREADS];
+    int n = b->tiles_x * b->tiles_y, i, started;
+    long k, total;
+    double start = now();
+    memset(b->first, 0, (n + 1) * sizeof(long));
+    for (k=0; k<b->num_segs; k++) {
+        bin_segment(&b->segs[k], b->width, b->height, b->tiles_x, k, b->first, NULL);
+    }
+    /* each tile's slot is the end of its list, and moves back to the start */
+    for (i=1; i<n; i++) {
+        b->first[i] = b->first[i] + b->first[i - 1];
+    }
+    total = b->first[n - 1];
+    b->first[n] = total;
+    free(b->list);
+    b->list = (long *) malloc ((total > 0 ? total : 1) * sizeof(long));
+    if (b->list == NULL) {
+        return MEM_ERR;
+    }
+    /* backwards, so that each tile has its lines in the order drawn */
+    for (k=b->num_segs-1; k>=0; k--) {
+        bin_segment(&b->segs[k], b->width, b->height, b->tiles_x, k, b->first, b->list);
+    }
+    b->bin_time = b->bin_time + now() - start;
+    
+    start = now();
+    b->next_tile = 0;
+    for (started=0; started<b->threads-1 && started<n-1; started++) {
+        if (pthread_create(&threads[started], NULL, draw_tiles, b) != 0) {
+            break;
+        }
+    }
+    draw_tiles(b);
+    for (i=0; i<started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    b->draw_time = b->draw_time + now() - start;
+    /* tiles are only taken by threads that could draw them */
+    return (b->next_tile < n) ? MEM_ERR : 0;
+}
+
+/********************************************
+ Interpreting Functions
+ ********************************************/
+
+/**
+ *  Starts an image, with the turtle where it starts
+ */
+void raster_header(Logo input, char *in_filename) {
+    Backend b = input->backend;
+    b->num_segs = 0;
+    b->x = 0;
+    b->y = 0;
+    b->h = 0;
+    if (b->pyramid) {
+        /* a file for the lines of this pyramid, gone once it is closed */
+        if (b->spill != NULL) {
+            fclose(b->spill);
+        }
+        b->spill = tmpfile();
+        b->lx = HUGE_VAL;
+        b->ly = HUGE_VAL;
+        b->hx = -HUGE_VAL;
+        b->hy = -HUGE_VAL;
+    }
+}
+
+/**
+ *  Draws the image, or the pyramid, and writes it. The output is failed if
+ *  there is no memory to draw it, so that it is reported and removed.
+ */
+void raster_trailer(Logo input) {
+    Backend b = input->backend;
+    if (b->pyramid) {
+        write_pyramid(input);
+        b->images = b->images + 1;
+        return;
+    }
+    if (raster_draw(b) < 0) {
+        input->out->error = 1;
+        return;
+    }
+    if (b->image == IMAGE_PNG) {
+        write_png(b, input->out, b->cov, b->width, b->height, b->width);
+    } else {
+        write_ppm(b, input->out, b->cov, b->width, b->height, b->width);
+    }
+    b->images = b->images + 1;
+}
+
+/**
+ *  Adds the line to those of the pyramid on disk, and to their bounds. The
+ *  output is failed if it cannot be written.
+ */
+static void spill_line(Logo input, const RasterSeg *seg) {
+    Backend b = input->backend;
+    RasterLine line;
+    line.seg = *seg;
+    line.id = b->num_segs;
+    if (b->spill == NULL || fwrite(&line, sizeof(line), 1, b->spill) != 1) {
+        input->out->error = 1;
+        return;
+    }
+    b->num_segs = b->num_segs + 1;
+    if (isfinite(seg->x0) && isfinite(seg->y0) && isfinite(seg->x1) && isfinite(seg->y1)) {
+        b->lx = fmin(b->lx, fmin(seg->x0, seg->x1));
+        b->hx = fmax(b->hx, fmax(seg->x0, seg->x1));
+        b->ly = fmin(b->ly, fmin(seg->y0, seg->y1));
+        b->hy = fmax(b->hy, fmax(seg->y0, seg->y1));
+    }
+}
+
+/**
+ *  Moves the turtle op forward, keeping the line to where it ends up, on
+ *  disk for a pyramid. The output is failed if there is no memory to keep
+ *  it, and the lines kept so far are dropped to make room.
+ */
+void raster_ipt_fd(Logo input, float op) {
+    Backend b = input->backend;
+    double rad = b->h * RASTER_TO_RADS;
+    double x = b->x + op * cos(rad), y = b->y + op * sin(rad);
+    RasterSeg *seg, line;
+    b->segments = b->segments + 1;
+    /* rows go down the image */
+    line.x0 = (b->x + RASTER_START_X) * b->scale;
+    line.y0 = (RASTER_HEIGHT - RASTER_START_Y - b->y) * b->scale;
+    line.x1 = (x + RASTER_START_X) * b->scale;
+    line.y1 = (RASTER_HEIGHT - RASTER_START_Y - y) * b->scale;
+    b->x = x;
+    b->y = y;
+    if (b->pyramid) {
+        spill_line(input, &line);
+        return;
+    }
+    if (b->num_segs == b->max_segs) {
+        seg = (RasterSeg *) realloc (b->segs, 2 * b->max_segs * sizeof(RasterSeg));
+        if (seg == NULL) {
+            input->out->error = 1;
+            b->num_segs = 0;
+        } else {
+            b->segs = seg;
+            b->max_segs = 2 * b->max_segs;
+        }
+    }
+    b->segs[b->num_segs] = line;
+    b->num_segs = b->num_segs + 1;
+}
+
+/**
+ *  Turns the turtle op degrees anticlockwise
+ */
+void raster_ipt_lt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h + op, RASTER_FULL_CIRCLE);
+}
+
+/**
+ *  Turns the turtle op degrees clockwise
+ */
+void raster_ipt_rt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h - op, RASTER_FULL_CIRCLE);
+}
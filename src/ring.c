@@ -0,0 +1,142 @@
+/*
+ *  ring.c
+ *  Lock-free ring of drawing operations, handed from one thread to another
+ *
+ *  Lets a backend run its formatting on a thread of its own while the
+ *  interpreter carries on. The interpreter puts each operation in the ring
+ *  and the consumer thread takes them out in order, so what is written is
+ *  the same as if the backend had been called directly. The two sides only
+ *  share the head and tail counters, read and written with the atomic
+ *  builtins of gcc. See postscript.c for the pipeline.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for nanosleep */
+
+#include <sched.h>  /* sched_yield */
+#include <stdlib.h> /* malloc */
+#include <time.h>   /* nanosleep */
+#include "ring.h"
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Waits a little, yielding at first and then sleeping, so that a side
+ *  waiting for long does not hold on to a core
+ */
+static void backoff(int *spins) {
+    struct timespec nap = { 0, RG_NAP };
+    if (*spins < RG_SPINS) {
+        *spins = *spins + 1;
+        sched_yield();
+    } else {
+        nanosleep(&nap, NULL);
+    }
+}
+
+/**
+ *  Takes operations out of the ring and runs them, until stopped with the
+ *  ring empty. Runs on a thread of its own.
+ */
+static void * consume(void *arg) {
+    Ring rg = (Ring) arg;
+    unsigned long tail = rg->tail, head, end;
+    int spins = 0;
+    while (1) {
+        head = __atomic_load_n(&rg->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            /* stop is only set once the last head is published */
+            if (__atomic_load_n(&rg->stop, __ATOMIC_ACQUIRE) &&
+                __atomic_load_n(&rg->head, __ATOMIC_ACQUIRE) == tail) {
+                return NULL;
+            }
+            backoff(&spins);
+            continue;
+        }
+        spins = 0;
+        while (tail != head) {
+            end = (head - tail > RG_BATCH) ? tail + RG_BATCH : head;
+            for (; tail!=end; tail++) {
+                rg->stage(rg->data, rg->ops[tail % RG_SIZE].op, rg->ops[tail % RG_SIZE].arg);
+            }
+            __atomic_store_n(&rg->tail, tail, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+/********************************************
+ Ring Handling
+ ********************************************/
+
+/**
+ *  Creates a ring running stage on each operation, with data, on a thread
+ *  of its own. Returns NULL when out of memory or no thread can be started.
+ */
+Ring rg_new(RgStage stage, void *data) {
+    Ring rg = (Ring) malloc (sizeof(*rg));
+    if (rg == NULL) {
+        return NULL;
+    }
+    rg->head = 0;
+    rg->tail = 0;
+    rg->free_to = RG_SIZE;
+    rg->stop = 0;
+    rg->stage = stage;
+    rg->data = data;
+    if (pthread_create(&rg->thread, NULL, consume, rg) != 0) {
+        free(rg);
+        return NULL;
+    }
+    return rg;
+}
+
+/**
+ *  Runs everything left in the ring, stops its thread and frees it. The
+ *  ring may be NULL.
+ */
+void rg_free(Ring rg) {
+    if (rg == NULL) {
+        return;
+    }
+    __atomic_store_n(&rg->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(rg->thread, NULL);
+    free(rg);
+}
+
+/********************************************
+ Producing
+ ********************************************/
+
+/**
+ *  Puts an operation in the ring, waiting while it is full
+ */
+void rg_push(Ring rg, int op, float arg) {
+    unsigned long head = rg->head;
+    int spins = 0;
+    while (head == rg->free_to) {
+        rg->free_to = __atomic_load_n(&rg->tail, __ATOMIC_ACQUIRE) + RG_SIZE;
+        if (head == rg->free_to) {
+            backoff(&spins);
+        }
+    }
+    rg->ops[head % RG_SIZE].op = op;
+    rg->ops[head % RG_SIZE].arg = arg;
+    __atomic_store_n(&rg->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  Waits until every operation put in the ring has been run, after which
+ *  whatever the stage wrote can be read and written to by the producer
+ *  until the next rg_push()
+ */
+void rg_sync(Ring rg) {
+    int spins = 0;
+    while (__atomic_load_n(&rg->tail, __ATOMIC_ACQUIRE) != rg->head) {
+        backoff(&spins);
+    }
+}
@@ -0,0 +1,253 @@
+/*
+ *  seg.c
+ *  Backend for writing binary segment files
+ *
+ *  Writes what the turtle draws as segments for other programs to read,
+ *  with no postscript to parse. Each point is rounded to hundredths of a
+ *  point and each segment written as the change from its start to its
+ *  end, zigzag varint encoded, with the source line that drew it. The
+ *  segments go out in blocks as they are drawn, and an index of the
+ *  blocks is written at the end. See segfile.h for the format and
+ *  segfile.c for reading it.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <math.h>   /* for following the turtle */
+#include <stdio.h>
+#include <stdlib.h> /* malloc */
+#include <string.h>
+#include <interpreter.h>
+#include "seg.h"
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Rounds v points to a whole number of units, held within SF_MAX_COORD
+ */
+static long long to_units(double v) {
+    v = floor(v * SF_UNITS + 0.5);
+    if (!(v < SF_MAX_COORD)) {
+        return (long long) SF_MAX_COORD;
+    } else if (v < -SF_MAX_COORD) {
+        return (long long) -SF_MAX_COORD;
+    }
+    return (long long) v;
+}
+
+/**
+ *  Puts the turtle back at the start, for a new page
+ */
+static void reset_turtle(Backend b) {
+    b->x = 0;
+    b->y = 0;
+    b->h = 0;
+    b->qx = to_units(SEG_START_X);
+    b->qy = to_units(SEG_START_Y);
+}
+
+/**
+ *  Writes out the block being filled, if it has any segments, and notes
+ *  where it went in the index. The output is failed if there is no memory
+ *  to note it, so that it is reported and removed.
+ */
+static void flush_block(Logo input) {
+    Backend b = input->backend;
+    unsigned char head[SF_BLOCK_HEADER];
+    SfEntry *index;
+    if (b->block_segs == 0) {
+        return;
+    }
+    if (b->num_blocks == b->max_blocks) {
+        index = (SfEntry *) realloc (b->index, 2 * b->max_blocks * sizeof(SfEntry));
+        if (index == NULL) {
+            input->out->error = 1;
+            b->block_segs = 0;
+            b->len = 0;
+            return;
+        }
+        b->index = index;
+        b->max_blocks = 2 * b->max_blocks;
+    }
+    b->index[b->num_blocks].offset = ob_tell(input->out);
+    b->index[b->num_blocks].first_seg = b->num_segs;
+    b->num_blocks = b->num_blocks + 1;
+    memcpy(head, SF_BLOCK_MAGIC, 4);
+    sf_put_u32(head + 4, (unsigned long) b->len);
+    sf_put_u32(head + 8, (unsigned long) b->block_segs);
+    sf_put_u32(head + 12, (unsigned long) b->page);
+    sf_put_u32(head + 16, (unsigned long) b->first_line);
+    sf_put_u64(head + 24, (unsigned long long) b->bx);
+    sf_put_u64(head + 32, (unsigned long long) b->by);
+    sf_put_u32(head + 20, sf_block_crc(head, b->records, b->len));
+    ob_write(input->out, (char *) head, SF_BLOCK_HEADER);
+    ob_write(input->out, (char *) b->records, b->len);
+    b->num_segs = b->num_segs + b->block_segs;
+    b->block_segs = 0;
+    b->len = 0;
+}
+
+/********************************************
+ Backend Handling
+ ********************************************/
+
+/**
+ *  Sets up the backend in input. Returns 0 on success, MEM_ERR when out of
+ *  memory, ARGS_ERR for an option of another backend.
+ */
+int seg_backend(Logo input, Options *opts) {
+    Backend b;
+    if (backend_takes(opts, 0, "segment") < 0) {
+        return ARGS_ERR;
+    }
+    b = (Backend) calloc (1, sizeof(*b));
+    if (b == NULL) {
+        return MEM_ERR;
+    }
+    b->records = (unsigned char *) malloc (SF_BLOCK_SEGS * SF_MAX_RECORD);
+    b->index = (SfEntry *) malloc (SF_MIN_BLOCKS * sizeof(SfEntry));
+    if (b->records == NULL || b->index == NULL) {
+        free(b->records);
+        free(b->index);
+        free(b);
+        return MEM_ERR;
+    }
+    b->max_blocks = SF_MIN_BLOCKS;
+    input->backend = b;
+    return 0;
+}
+
+/**
+ *  Frees the backend, which may be NULL
+ */
+void seg_free(Backend backend) {
+    if (backend == NULL) {
+        return;
+    }
+    free(backend->records);
+    free(backend->index);
+    free(backend);
+}
+
+/**
+ *  Reports how small the segments were written
+ */
+void seg_report(Logo input) {
+    Backend b = input->backend;
+    if (b == NULL) {
+        return;
+    }
+    printf("Wrote %lld segments in %d files of %lld bytes, %.2f bytes a segment\n",
+           b->segments, b->files, b->bytes,
+           (b->segments > 0) ? (double) b->bytes / b->segments : 0.0);
+}
+
+/********************************************
+ Interpreting Functions
+ ********************************************/
+
+/**
+ *  Writes the file header, with the turtle where it starts
+ */
+void seg_header(Logo input, char *in_filename) {
+    Backend b = input->backend;
+    unsigned char head[SF_HEADER_SIZE];
+    memset(head, 0, SF_HEADER_SIZE);
+    memcpy(head, SF_MAGIC, 8);
+    head[8] = SF_VERSION;
+    sf_put_u32(head + 12, SF_UNITS);
+    sf_put_u32(head + 16, (unsigned long) to_units(SEG_START_X));
+    sf_put_u32(head + 20, (unsigned long) to_units(SEG_START_Y));
+    sf_put_u32(head + 24, SF_BLOCK_SEGS);
+    ob_write(input->out, (char *) head, SF_HEADER_SIZE);
+    b->block_segs = 0;
+    b->len = 0;
+    b->page = 0;
+    b->num_blocks = 0;
+    b->num_segs = 0;
+    reset_turtle(b);
+}
+
+/**
+ *  Ends the page, so that the next starts a block of its own
+ */
+void seg_footer(Logo input) {
+    Backend b = input->backend;
+    flush_block(input);
+    b->page = b->page + 1;
+    reset_turtle(b);
+}
+
+/**
+ *  Writes the index of the blocks and the trailer pointing at it
+ */
+void seg_trailer(Logo input) {
+    Backend b = input->backend;
+    unsigned char buf[SF_TRAILER_SIZE];
+    long long offset;
+    long i;
+    flush_block(input);
+    offset = ob_tell(input->out);
+    memcpy(buf, SF_INDEX_MAGIC, 4);
+    sf_put_u32(buf + 4, (unsigned long) b->num_blocks);
+    ob_write(input->out, (char *) buf, 8);
+    for (i=0; i<b->num_blocks; i++) {
+        sf_put_u64(buf, (unsigned long long) b->index[i].offset);
+        sf_put_u64(buf + 8, (unsigned long long) b->index[i].first_seg);
+        ob_write(input->out, (char *) buf, SF_INDEX_ENTRY);
+    }
+    sf_put_u64(buf, (unsigned long long) offset);
+    memcpy(buf + 8, SF_END_MAGIC, 8);
+    ob_write(input->out, (char *) buf, SF_TRAILER_SIZE);
+    b->segments = b->segments + b->num_segs;
+    b->bytes = b->bytes + ob_tell(input->out);
+    b->files = b->files + 1;
+}
+
+/**
+ *  Moves the turtle op forward, writing the segment to where it ends up
+ */
+void seg_ipt_fd(Logo input, float op) {
+    Backend b = input->backend;
+    double rad = b->h * SEG_TO_RADS;
+    long long qx, qy;
+    long line = line_num(input);
+    if (b->block_segs == SF_BLOCK_SEGS) {
+        flush_block(input);
+    }
+    if (b->block_segs == 0) {
+        b->bx = b->qx;
+        b->by = b->qy;
+        b->first_line = line;
+        b->line = line;
+    }
+    b->x = b->x + op * cos(rad);
+    b->y = b->y + op * sin(rad);
+    qx = to_units(SEG_START_X + b->x);
+    qy = to_units(SEG_START_Y + b->y);
+    b->len = b->len + sf_put_varint(b->records + b->len, sf_zigzag(line - b->line));
+    b->len = b->len + sf_put_varint(b->records + b->len, sf_zigzag(qx - b->qx));
+    b->len = b->len + sf_put_varint(b->records + b->len, sf_zigzag(qy - b->qy));
+    b->block_segs = b->block_segs + 1;
+    b->line = line;
+    b->qx = qx;
+    b->qy = qy;
+}
+
+/**
+ *  Turns the turtle op degrees anticlockwise
+ */
+void seg_ipt_lt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h + op, SEG_FULL_CIRCLE);
+}
+
+/**
+ *  Turns the turtle op degrees clockwise
+ */
+void seg_ipt_rt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h - op, SEG_FULL_CIRCLE);
+}
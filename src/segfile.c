@@ -0,0 +1,347 @@
+/*
+ *  segfile.c
+ *  Binary segment files, and reading them back
+ *
+ *  The encoding shared with the seg backend that writes the files, and a
+ *  small library for reading them, by block, in any order. A file is
+ *  opened by reading its index from the end, or, if it was never finished,
+ *  by walking the block headers from the start. Each block is checked
+ *  against its crc before it is decoded. See segfile.h for the format.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <stdio.h>
+#include <stdlib.h> /* malloc */
+#include <string.h>
+#include <zlib.h>   /* for crc32 */
+#include "errors.h"
+#include "segfile.h"
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Reads a varint at *p, no further than end, into v and moves *p past it.
+ *  Returns -1 if it runs past end or is too long.
+ */
+static int get_varint(const unsigned char **p, const unsigned char *end, unsigned long long *v) {
+    const unsigned char *q = *p;
+    int shift;
+    *v = 0;
+    for (shift=0; q<end && shift<7*SF_MAX_VARINT; shift=shift+7) {
+        *v = *v | ((unsigned long long) (*q & 0x7f) << shift);
+        if ((*q++ & 0x80) == 0) {
+            *p = q;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ *  Adds the block starting at offset, with segs segments, to the index.
+ *  Returns MEM_ERR when out of memory.
+ */
+static int add_entry(SegReader sr, long *max, long long offset, long segs) {
+    SfEntry *index;
+    if (sr->num_blocks == *max) {
+        index = (SfEntry *) realloc (sr->index, 2 * *max * sizeof(SfEntry));
+        if (index == NULL) {
+            return MEM_ERR;
+        }
+        sr->index = index;
+        *max = 2 * *max;
+    }
+    sr->index[sr->num_blocks].offset = offset;
+    sr->index[sr->num_blocks].first_seg = sr->num_segs;
+    sr->num_blocks = sr->num_blocks + 1;
+    sr->num_segs = sr->num_segs + segs;
+    return 0;
+}
+
+/**
+ *  Reads the index from the end of a finished file of size bytes. Returns
+ *  -1 if the file was not finished or the index is not whole, MEM_ERR when
+ *  out of memory.
+ */
+static int read_index(SegReader sr, long long size) {
+    unsigned char buf[SF_TRAILER_SIZE];
+    long long offset;
+    long i, n, max;
+    if (size < SF_HEADER_SIZE + SF_TRAILER_SIZE ||
+        fseek(sr->fp, (long) (size - SF_TRAILER_SIZE), SEEK_SET) != 0 ||
+        fread(buf, 1, SF_TRAILER_SIZE, sr->fp) != SF_TRAILER_SIZE ||
+        memcmp(buf + 8, SF_END_MAGIC, 8) != 0) {
+        return -1;
+    }
+    offset = (long long) sf_get_u64(buf);
+    if (offset < SF_HEADER_SIZE || offset + 8 > size - SF_TRAILER_SIZE ||
+        fseek(sr->fp, (long) offset, SEEK_SET) != 0 || fread(buf, 1, 8, sr->fp) != 8 ||
+        memcmp(buf, SF_INDEX_MAGIC, 4) != 0) {
+        return -1;
+    }
+    n = (long) sf_get_u32(buf + 4);
+    if (offset + 8 + (long long) n * SF_INDEX_ENTRY > size - SF_TRAILER_SIZE) {
+        return -1;
+    }
+    max = (n > SF_MIN_BLOCKS) ? n : SF_MIN_BLOCKS;
+    sr->index = (SfEntry *) malloc (max * sizeof(SfEntry));
+    if (sr->index == NULL) {
+        return MEM_ERR;
+    }
+    for (i=0; i<n; i++) {
+        if (fread(buf, 1, SF_INDEX_ENTRY, sr->fp) != SF_INDEX_ENTRY) {
+            return -1;
+        }
+        sr->index[i].offset = (long long) sf_get_u64(buf);
+        sr->index[i].first_seg = (long long) sf_get_u64(buf + 8);
+    }
+    sr->num_blocks = n;
+    sr->num_segs = 0;
+    if (n > 0) {
+        /* the segments of the last block are in its header */
+        if (fseek(sr->fp, (long) sr->index[n - 1].offset, SEEK_SET) != 0 ||
+            fread(buf, 1, 12, sr->fp) != 12) {
+            return -1;
+        }
+        sr->num_segs = sr->index[n - 1].first_seg + sf_get_u32(buf + 8);
+    }
+    return 0;
+}
+
+/**
+ *  Builds the index of a file of size bytes by walking its block headers,
+ *  up to the last whole block. Returns MEM_ERR when out of memory.
+ */
+static int walk_blocks(SegReader sr, long long size) {
+    unsigned char buf[SF_BLOCK_HEADER];
+    long long offset = SF_HEADER_SIZE, n;
+    long max = SF_MIN_BLOCKS;
+    free(sr->index);
+    sr->index = (SfEntry *) malloc (max * sizeof(SfEntry));
+    if (sr->index == NULL) {
+        return MEM_ERR;
+    }
+    sr->num_blocks = 0;
+    sr->num_segs = 0;
+    while (fseek(sr->fp, (long) offset, SEEK_SET) == 0 &&
+           fread(buf, 1, SF_BLOCK_HEADER, sr->fp) == SF_BLOCK_HEADER &&
+           memcmp(buf, SF_BLOCK_MAGIC, 4) == 0) {
+        n = sf_get_u32(buf + 4);
+        if (offset + SF_BLOCK_HEADER + n > size) {
+            break;
+        }
+        if (add_entry(sr, &max, offset, (long) sf_get_u32(buf + 8)) < 0) {
+            return MEM_ERR;
+        }
+        offset = offset + SF_BLOCK_HEADER + n;
+    }
+    return 0;
+}
+
+/********************************************
+ Encoding
+ ********************************************/
+
+/**
+ *  Returns v with its sign in the lowest bit, so that small numbers either
+ *  side of 0 are small
+ */
+unsigned long long sf_zigzag(long long v) {
+    return ((unsigned long long) v << 1) ^ (unsigned long long) -(v < 0);
+}
+
+/**
+ *  Returns the number zigzagged into u
+ */
+long long sf_unzigzag(unsigned long long u) {
+    return (long long) (u >> 1) ^ -(long long) (u & 1);
+}
+
+/**
+ *  Writes v into p as a varint, seven bits to a byte with the top bit set
+ *  on all but the last. Returns the bytes written.
+ */
+size_t sf_put_varint(unsigned char *p, unsigned long long v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char) (v | 0x80);
+        v = v >> 7;
+    }
+    p[n++] = (unsigned char) v;
+    return n;
+}
+
+/**
+ *  Writes v into the 4 bytes at p
+ */
+void sf_put_u32(unsigned char *p, unsigned long v) {
+    int i;
+    for (i=0; i<4; i++) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+/**
+ *  Writes v into the 8 bytes at p
+ */
+void sf_put_u64(unsigned char *p, unsigned long long v) {
+    int i;
+    for (i=0; i<8; i++) {
+        p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+/**
+ *  Returns the 4 bytes at p
+ */
+unsigned long sf_get_u32(const unsigned char *p) {
+    return (unsigned long) p[0] | (unsigned long) p[1] << 8 |
+           (unsigned long) p[2] << 16 | (unsigned long) p[3] << 24;
+}
+
+/**
+ *  Returns the 8 bytes at p
+ */
+unsigned long long sf_get_u64(const unsigned char *p) {
+    return (unsigned long long) sf_get_u32(p) | (unsigned long long) sf_get_u32(p + 4) << 32;
+}
+
+/**
+ *  Returns the crc of a block, of its header but for the crc itself and of
+ *  the n bytes of its records
+ */
+unsigned long sf_block_crc(const unsigned char *header, const unsigned char *records, size_t n) {
+    unsigned long crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, header, 20);
+    crc = crc32(crc, header + 24, SF_BLOCK_HEADER - 24);
+    if (n > 0) {
+        crc = crc32(crc, records, (uInt) n);
+    }
+    return crc;
+}
+
+/********************************************
+ Reading
+ ********************************************/
+
+/**
+ *  Opens a segment file and finds its blocks. Returns NULL if it cannot be
+ *  opened, is not a segment file or there is no memory to read it.
+ */
+SegReader sf_open(const char *filename) {
+    unsigned char buf[SF_HEADER_SIZE];
+    long long size;
+    int ret;
+    SegReader sr = (SegReader) calloc (1, sizeof(*sr));
+    if (sr == NULL) {
+        return NULL;
+    }
+    sr->fp = fopen(filename, "rb");
+    if (sr->fp == NULL || fread(buf, 1, SF_HEADER_SIZE, sr->fp) != SF_HEADER_SIZE ||
+        memcmp(buf, SF_MAGIC, 8) != 0 || (buf[8] | buf[9] << 8) != SF_VERSION ||
+        fseek(sr->fp, 0, SEEK_END) != 0) {
+        sf_close(sr);
+        return NULL;
+    }
+    sr->units = (long) sf_get_u32(buf + 12);
+    sr->block_segs = (long) sf_get_u32(buf + 24);
+    if (sr->units <= 0) {
+        sf_close(sr);
+        return NULL;
+    }
+    size = ftell(sr->fp);
+    if ((ret = read_index(sr, size)) == 0) {
+        sr->finished = 1;
+    } else if (ret == MEM_ERR || walk_blocks(sr, size) < 0) {
+        sf_close(sr);
+        return NULL;
+    }
+    return sr;
+}
+
+/**
+ *  Closes the file, which may be NULL
+ */
+void sf_close(SegReader sr) {
+    if (sr == NULL) {
+        return;
+    }
+    if (sr->fp != NULL) {
+        fclose(sr->fp);
+    }
+    free(sr->index);
+    free(sr->records);
+    free(sr);
+}
+
+/**
+ *  Decodes block n into segs, which has room for sr->block_segs, and its
+ *  page into page. Returns the number of segments, ARGS_ERR if there is no
+ *  block n, FILE_ERR if it cannot be read, PARSE_ERR if it is damaged or
+ *  MEM_ERR when out of memory.
+ */
+long sf_read_block(SegReader sr, long n, SfSeg *segs, long *page) {
+    unsigned char head[SF_BLOCK_HEADER], *records;
+    const unsigned char *p, *end;
+    unsigned long long v;
+    long long x, y, line;
+    size_t bytes;
+    long count, i;
+    if (n < 0 || n >= sr->num_blocks) {
+        return ARGS_ERR;
+    }
+    if (fseek(sr->fp, (long) sr->index[n].offset, SEEK_SET) != 0 ||
+        fread(head, 1, SF_BLOCK_HEADER, sr->fp) != SF_BLOCK_HEADER) {
+        return FILE_ERR;
+    }
+    bytes = sf_get_u32(head + 4);
+    count = (long) sf_get_u32(head + 8);
+    if (memcmp(head, SF_BLOCK_MAGIC, 4) != 0 || count > sr->block_segs) {
+        return PARSE_ERR;
+    }
+    if (bytes > sr->max_records) {
+        records = (unsigned char *) realloc (sr->records, bytes);
+        if (records == NULL) {
+            return MEM_ERR;
+        }
+        sr->records = records;
+        sr->max_records = bytes;
+    }
+    if (fread(sr->records, 1, bytes, sr->fp) != bytes) {
+        return FILE_ERR;
+    }
+    if (sf_block_crc(head, sr->records, bytes) != sf_get_u32(head + 20)) {
+        return PARSE_ERR;
+    }
+    *page = (long) sf_get_u32(head + 12);
+    line = sf_get_u32(head + 16);
+    x = (long long) sf_get_u64(head + 24);
+    y = (long long) sf_get_u64(head + 32);
+    p = sr->records;
+    end = sr->records + bytes;
+    for (i=0; i<count; i++) {
+        segs[i].x0 = (double) x / sr->units;
+        segs[i].y0 = (double) y / sr->units;
+        if (get_varint(&p, end, &v) < 0) {
+            return PARSE_ERR;
+        }
+        line = line + sf_unzigzag(v);
+        if (get_varint(&p, end, &v) < 0) {
+            return PARSE_ERR;
+        }
+        x = x + sf_unzigzag(v);
+        if (get_varint(&p, end, &v) < 0) {
+            return PARSE_ERR;
+        }
+        y = y + sf_unzigzag(v);
+        segs[i].x1 = (double) x / sr->units;
+        segs[i].y1 = (double) y / sr->units;
+        segs[i].line = (long) line;
+    }
+    return count;
+}
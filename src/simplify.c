@@ -0,0 +1,169 @@
+/*
+ *  simplify.c
+ *  Streaming polyline simplification
+ *
+ *  Drops the vertices of a polyline that are within a tolerance of the line
+ *  drawn without them, using Douglas-Peucker. The polyline is taken a window
+ *  of SP_WINDOW points at a time, so it can be of any length. A vertex at a
+ *  window boundary is always kept, which costs at most one extra vertex per
+ *  window.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "simplify.h"
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Returns the distance of point i from the segment between points a and b
+ */
+static double seg_dist(Simplify sp, int i, int a, int b) {
+    double dx = sp->xs[b] - sp->xs[a], dy = sp->ys[b] - sp->ys[a];
+    double px = sp->xs[i] - sp->xs[a], py = sp->ys[i] - sp->ys[a];
+    double len2 = dx * dx + dy * dy, t;
+    if (len2 > 0) {
+        /* nearest point on the segment, not the line, so that going back
+           over the line is not lost */
+        t = (px * dx + py * dy) / len2;
+        if (t < 0) {
+            t = 0;
+        } else if (t > 1) {
+            t = 1;
+        }
+        px = px - t * dx;
+        py = py - t * dy;
+    }
+    return sqrt(px * px + py * py);
+}
+
+/**
+ *  Simplifies the window and passes on the vertices kept after the first.
+ *  The window is left with just its last point.
+ */
+static void flush_window(Simplify sp) {
+    int top = 0, a, b, i, far;
+    double d, max;
+    if (sp->n < 2) {
+        return;
+    }
+    for (i=0; i<sp->n; i++) {
+        sp->keep[i] = 0;
+    }
+    sp->keep[0] = 1;
+    sp->keep[sp->n - 1] = 1;
+    sp->stack[top++] = 0;
+    sp->stack[top++] = sp->n - 1;
+    while (top > 0) {
+        b = sp->stack[--top];
+        a = sp->stack[--top];
+        max = -1;
+        far = a;
+        for (i=a+1; i<b; i++) {
+            d = seg_dist(sp, i, a, b);
+            if (d > max) {
+                max = d;
+                far = i;
+            }
+        }
+        if (max > sp->tol) {
+            sp->keep[far] = 1;
+            sp->stack[top++] = a;
+            sp->stack[top++] = far;
+            sp->stack[top++] = far;
+            sp->stack[top++] = b;
+        }
+    }
+    for (i=1; i<sp->n; i++) {
+        if (sp->keep[i]) {
+            sp->sink(sp->data, sp->xs[i], sp->ys[i]);
+            sp->out = sp->out + 1;
+        }
+    }
+    sp->xs[0] = sp->xs[sp->n - 1];
+    sp->ys[0] = sp->ys[sp->n - 1];
+    sp->n = 1;
+}
+
+/********************************************
+ Simplifying
+ ********************************************/
+
+/**
+ *  Creates a simplifier passing the vertices it keeps to sink. Returns NULL
+ *  when out of memory.
+ */
+Simplify sp_new(double tol, PointSink sink, void *data) {
+    Simplify sp = (Simplify) malloc (sizeof(*sp));
+    if (sp == NULL) {
+        return NULL;
+    }
+    sp->xs = (double *) malloc (SP_WINDOW * sizeof(double));
+    sp->ys = (double *) malloc (SP_WINDOW * sizeof(double));
+    sp->keep = (char *) malloc (SP_WINDOW);
+    /* every range pushed is a kept point, so there are fewer than SP_WINDOW */
+    sp->stack = (int *) malloc (2 * SP_WINDOW * sizeof(int));
+    if (sp->xs == NULL || sp->ys == NULL || sp->keep == NULL || sp->stack == NULL) {
+        sp_free(sp);
+        return NULL;
+    }
+    sp->tol = tol;
+    sp->n = 0;
+    sp->in = 0;
+    sp->out = 0;
+    sp->sink = sink;
+    sp->data = data;
+    return sp;
+}
+
+/**
+ *  Starts a polyline at (x, y), ending the one before. The first vertex is
+ *  always kept and is not passed to the sink.
+ */
+void sp_start(Simplify sp, double x, double y) {
+    sp_end(sp);
+    sp->xs[0] = x;
+    sp->ys[0] = y;
+    sp->n = 1;
+    sp->in = sp->in + 1;
+    sp->out = sp->out + 1;
+}
+
+/**
+ *  Adds the next vertex of the polyline
+ */
+void sp_add(Simplify sp, double x, double y) {
+    if (sp->n == SP_WINDOW) {
+        flush_window(sp);
+    }
+    sp->xs[sp->n] = x;
+    sp->ys[sp->n] = y;
+    sp->n = sp->n + 1;
+    sp->in = sp->in + 1;
+}
+
+/**
+ *  Ends the polyline, passing on the rest of the vertices kept
+ */
+void sp_end(Simplify sp) {
+    flush_window(sp);
+    sp->n = 0;
+}
+
+/**
+ *  Frees the simplifier
+ */
+void sp_free(Simplify sp) {
+    free(sp->xs);
+    free(sp->ys);
+    free(sp->keep);
+    free(sp->stack);
+    free(sp);
+}
@@ -0,0 +1,624 @@
+/*
+ *  svg.c
+ *  Backend for generating SVG output
+ *
+ *  Draws the same page as the postscript backend, in a group flipped to
+ *  postscript's y axis. Path data is relative and written with as few
+ *  digits as it needs. Loop bodies that draw the same on every iteration
+ *  go into <defs> once and each iteration is a <use> of them, so nested
+ *  loops cost about as much as the program rather than what it draws.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <float.h>  /* DBL_MAX_10_EXP */
+#include <math.h>   /* for following the turtle */
+#include <stdio.h>
+#include <stdlib.h> /* malloc */
+#include <string.h> /* for reading lines of the program */
+#include <interpreter.h>
+#include "svg.h"
+
+#define NUM_LENGTH      32      /* enough for any number written */
+#define FAR_LENGTH      (DBL_MAX_10_EXP + 6)    /* enough for any double as "%.2f" */
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Writes v / 10^places with no trailing zeros and no leading 0 before the
+ *  point, after a space if the last thing written was a number and this
+ *  one does not start with "-"
+ */
+static void put_num(Backend b, OutBuf out, long long v, int places) {
+    char num[NUM_LENGTH];
+    unsigned long long u = (v < 0) ? -(unsigned long long) v : (unsigned long long) v;
+    unsigned long long scale = 1, ip, fp;
+    int i, n;
+    for (i=0; i<places; i++) {
+        scale = scale * 10;
+    }
+    ip = u / scale;
+    fp = u % scale;
+    if (b->sep && v >= 0) {
+        ob_puts(out, " ");
+    }
+    if (v < 0) {
+        ob_puts(out, "-");
+    }
+    if (ip != 0 || fp == 0) {
+        n = snprintf(num, NUM_LENGTH, "%llu", ip);
+        ob_write(out, num, n);
+    }
+    if (fp != 0) {
+        while (fp % 10 == 0) {
+            fp = fp / 10;
+            places = places - 1;
+        }
+        n = snprintf(num, NUM_LENGTH, ".%0*llu", places, fp);
+        ob_write(out, num, n);
+    }
+    b->sep = 1;
+}
+
+/**
+ *  Writes v like put_num() would, but as "%.2f", for a number too far to
+ *  round into hundredths
+ */
+static void put_far(Backend b, OutBuf out, double v) {
+    char num[FAR_LENGTH];
+    int n;
+    if (b->sep && v >= 0) {
+        ob_puts(out, " ");
+    }
+    n = snprintf(num, FAR_LENGTH, "%.2f", v);
+    ob_write(out, num, n);
+    b->sep = 1;
+}
+
+/**
+ *  Writes s with the characters that are special in XML escaped
+ */
+static void put_text(OutBuf out, const char *s) {
+    for (; *s != '\0'; s++) {
+        if (*s == '&') {
+            ob_puts(out, "&amp;");
+        } else if (*s == '<') {
+            ob_puts(out, "&lt;");
+        } else if (*s == '>') {
+            ob_puts(out, "&gt;");
+        } else {
+            ob_write(out, s, 1);
+        }
+    }
+}
+
+/**
+ *  Puts the page point (x, y) into the frame being written
+ */
+static void in_frame(Backend b, double x, double y, double *fx, double *fy) {
+    SvgFrame *f = &b->frames[b->num_frames - 1];
+    double r = -f->h * SVG_TO_RADS, dx = x - f->x, dy = y - f->y;
+    *fx = dx * cos(r) - dy * sin(r);
+    *fy = dx * sin(r) + dy * cos(r);
+}
+
+/**
+ *  Puts the page point (x, y) into the frame being written, in hundredths.
+ *  Returns -1 if it is SVG_FAR or further, leaving fx and fy as they were,
+ *  else 0
+ */
+static int to_frame(Backend b, double x, double y, long long *fx, long long *fy) {
+    double px, py;
+    in_frame(b, x, y, &px, &py);
+    if (!(fabs(px) < SVG_FAR && fabs(py) < SVG_FAR)) {
+        return -1;
+    }
+    *fx = (long long) floor(px * 100 + 0.5);
+    *fy = (long long) floor(py * 100 + 0.5);
+    return 0;
+}
+
+/**
+ *  Writes the path command cmd, unless the numbers written go to it already
+ */
+static void put_cmd(Logo input, char cmd) {
+    Backend b = input->backend;
+    if (b->cmd != cmd) {
+        ob_write(input->out, &cmd, 1);
+        b->cmd = cmd;
+        b->sep = 0;
+    }
+}
+
+/**
+ *  Writes the page point (x, y) in the frame being written to the path
+ *  command cmd, as the last point of the path. Returns -1 if it is too far
+ *  to round into hundredths, and is written as "%.2f", else 0
+ */
+static int put_point(Logo input, double x, double y, char cmd) {
+    Backend b = input->backend;
+    double px, py;
+    put_cmd(input, cmd);
+    if (to_frame(b, x, y, &b->cur_x, &b->cur_y) < 0) {
+        in_frame(b, x, y, &px, &py);
+        put_far(b, input->out, px);
+        put_far(b, input->out, py);
+        return -1;
+    }
+    put_num(b, input->out, b->cur_x, 2);
+    put_num(b, input->out, b->cur_y, 2);
+    return 0;
+}
+
+/**
+ *  Ends the open <path>, if any
+ */
+static void close_path(Logo input) {
+    if (input->backend->in_path) {
+        ob_puts(input->out, "\"/>\n");
+        input->backend->in_path = 0;
+    }
+}
+
+/**
+ *  Writes a <use> of the definition of loop l, placed where its iteration
+ *  started
+ */
+static void write_use(Logo input, SvgLoop *l) {
+    Backend b = input->backend;
+    SvgFrame *f = &b->frames[b->num_frames - 1];
+    long long tx = 0, ty = 0, rot;
+    double h = fmod(l->h - f->h, SVG_FULL_CIRCLE), px, py;
+    int far;
+    close_path(input);
+    /* ten thousandths of a degree are well inside a hundredth over the page */
+    if (h > SVG_FULL_CIRCLE / 2) {
+        h = h - SVG_FULL_CIRCLE;
+    } else if (h <= -SVG_FULL_CIRCLE / 2) {
+        h = h + SVG_FULL_CIRCLE;
+    }
+    rot = (long long) floor(h * 10000 + 0.5);
+    far = to_frame(b, l->x, l->y, &tx, &ty) < 0;
+    ob_puts(input->out, "<use xlink:href=\"#d");
+    ob_int(input->out, l->def);
+    ob_puts(input->out, "\"");
+    if (far || tx != 0 || ty != 0 || rot != 0) {
+        ob_puts(input->out, " transform=\"");
+        if (far || tx != 0 || ty != 0) {
+            ob_puts(input->out, "translate(");
+            b->sep = 0;
+            if (far) {
+                in_frame(b, l->x, l->y, &px, &py);
+                put_far(b, input->out, px);
+                put_far(b, input->out, py);
+            } else {
+                put_num(b, input->out, tx, 2);
+                put_num(b, input->out, ty, 2);
+            }
+            ob_puts(input->out, (rot != 0) ? ") " : ")");
+        }
+        if (rot != 0) {
+            ob_puts(input->out, "rotate(");
+            b->sep = 0;
+            put_num(b, input->out, rot, 4);
+            ob_puts(input->out, ")");
+        }
+        ob_puts(input->out, "\"");
+    }
+    ob_puts(input->out, "/>\n");
+    b->uses = b->uses + 1;
+}
+
+/**
+ *  Ends the definition being written for loop l, then draws it where its
+ *  first iteration started
+ */
+static void end_def(Logo input, SvgLoop *l) {
+    Backend b = input->backend;
+    close_path(input);
+    ob_puts(input->out, "</g></defs>\n");
+    b->num_frames = b->num_frames - 1;
+    l->recording = 0;
+    write_use(input, l);
+}
+
+/**
+ *  Notes a variable read by a loop body, which leaves it variant if the
+ *  variable is the loop's own. bound counts the loops inside the body that
+ *  set each variable.
+ */
+static void body_reads(SvgBody *body, char *tok, int own, int *bound) {
+    int v;
+    if (!is_var(tok)) {
+        return;
+    }
+    v = tok[0] - 'A';
+    if (bound[v] > 0) {
+        return;
+    } else if (v == own) {
+        body->invariant = 0;
+    } else {
+        body->vars = body->vars | (1L << v);
+    }
+}
+
+/**
+ *  Works out whether the loop body starting on line pos draws the same on
+ *  every iteration, which it does when it sets no variable with SET and
+ *  reads none that it changes. Loops inside it set their own variable, so
+ *  reading that inside them is fine, but not outside them.
+ */
+static void analyse(Logo input, int pos) {
+    SvgBody *body = &input->backend->bodies[pos];
+    char inst[INSTRUCT_LENGTH+1], operand[LINE_LENGTH];
+    char var[LINE_LENGTH], from[LINE_LENGTH], to[LINE_LENGTH];
+    int bound[VARARY_SIZE] = { 0 }, stack[SVG_MAX_LOOPS];
+    int i, depth = 0, own = -1;
+    long set = 0;
+    if (body->known) {
+        return;
+    }
+    body->known = 1;
+    body->invariant = 1;
+    body->vars = 0;
+    body->size = 0;
+    if (pos > 0 && sscanf(input->lines[pos - 1], "%*s %s", var) == 1 && is_var(var)) {
+        own = var[0] - 'A';
+    }
+    for (i=pos; i<input->num_lines && body->invariant; i++) {
+        if (sscanf(input->lines[i], "%3s %s", inst, operand) < 1) {
+            continue;
+        }
+        if (strsame(inst, "}")) {
+            if (depth == 0) {
+                break;
+            }
+            depth = depth - 1;
+            bound[stack[depth]] = bound[stack[depth]] - 1;
+        } else if (strsame(inst, FD) || strsame(inst, LT) || strsame(inst, RT)) {
+            body_reads(body, operand, own, bound);
+            body->size = body->size + strsame(inst, FD);
+        } else if (strsame(inst, DO)) {
+            if (sscanf(input->lines[i], "%*s %s %*s %s %*s %s", var, from, to) != 3 ||
+                !is_var(var) || depth == SVG_MAX_LOOPS) {
+                body->invariant = 0;
+                break;
+            }
+            body_reads(body, from, own, bound);
+            body_reads(body, to, own, bound);
+            stack[depth] = var[0] - 'A';
+            bound[stack[depth]] = bound[stack[depth]] + 1;
+            set = set | (1L << stack[depth]);
+            depth = depth + 1;
+            body->size = body->size + SVG_MIN_BODY;
+        } else {
+            /* SET changes a variable on every iteration, or may */
+            body->invariant = 0;
+        }
+    }
+    /* a loop inside leaves its variable changed for the next iteration */
+    if (body->vars & set) {
+        body->invariant = 0;
+    }
+}
+
+/**
+ *  Returns the index of the definition of the body on line pos for the
+ *  values the variables it reads have now, adding it if there is none yet
+ *  and setting *found. Returns -1 when out of memory.
+ */
+static int find_def(Logo input, int pos, int *found) {
+    Backend b = input->backend;
+    long vars = b->bodies[pos].vars;
+    SvgDef *defs;
+    int i, v;
+    for (i=0; i<b->num_defs; i++) {
+        if (b->defs[i].pos != pos) {
+            continue;
+        }
+        for (v=0; v<VARARY_SIZE; v++) {
+            if ((vars & (1L << v)) && b->defs[i].vals[v] != input->vars[v].data) {
+                break;
+            }
+        }
+        if (v == VARARY_SIZE) {
+            *found = 1;
+            return i;
+        }
+    }
+    if (b->num_defs == b->max_defs) {
+        defs = (SvgDef *) realloc (b->defs, 2 * b->max_defs * sizeof(SvgDef));
+        if (defs == NULL) {
+            return -1;
+        }
+        b->defs = defs;
+        b->max_defs = 2 * b->max_defs;
+    }
+    b->defs[i].pos = pos;
+    for (v=0; v<VARARY_SIZE; v++) {
+        b->defs[i].vals[v] = input->vars[v].data;
+    }
+    b->num_defs = b->num_defs + 1;
+    *found = 0;
+    return i;
+}
+
+/**
+ *  Puts the turtle back at the start, for a new output file
+ */
+static void reset(Backend b) {
+    b->num_defs = 0;
+    b->depth = 0;
+    b->num_frames = 1;
+    b->frames[0].x = 0;
+    b->frames[0].y = 0;
+    b->frames[0].h = 0;
+    b->hidden = 0;
+    b->x = 0;
+    b->y = 0;
+    b->h = 0;
+    b->in_path = 0;
+    b->cur_x = 0;
+    b->cur_y = 0;
+    b->far = 0;
+    b->cmd = 0;
+    b->sep = 0;
+}
+
+/********************************************
+ Backend Handling
+ ********************************************/
+
+/**
+ *  Sets up the backend in input for opts. Returns 0 on success, MEM_ERR
+ *  when out of memory and ARGS_ERR for --multi=pages, as an svg has one
+ *  page, or for an option of another backend.
+ */
+int svg_backend(Logo input, Options *opts) {
+    Backend b;
+    if (backend_takes(opts, 0, "svg") < 0) {
+        return ARGS_ERR;
+    }
+    if (opts->multi == MULTI_PAGES) {
+        fprintf(stderr, "Error: an svg has one page, use --multi=files\n");
+        return ARGS_ERR;
+    }
+    b = (Backend) malloc (sizeof(*b));
+    if (b == NULL) {
+        return MEM_ERR;
+    }
+    b->bodies = (SvgBody *) calloc (input->num_lines + 1, sizeof(SvgBody));
+    b->defs = (SvgDef *) malloc (SVG_MIN_DEFS * sizeof(SvgDef));
+    if (b->bodies == NULL || b->defs == NULL) {
+        svg_free(b);
+        return MEM_ERR;
+    }
+    b->max_defs = SVG_MIN_DEFS;
+    b->segments = 0;
+    b->uses = 0;
+    reset(b);
+    input->backend = b;
+    return 0;
+}
+
+/**
+ *  Frees the backend, which may be NULL
+ */
+void svg_free(Backend backend) {
+    if (backend == NULL) {
+        return;
+    }
+    free(backend->bodies);
+    free(backend->defs);
+    free(backend);
+}
+
+/**
+ *  Reports how much of the drawing was instanced
+ */
+void svg_report(Logo input) {
+    Backend b = input->backend;
+    if (b == NULL) {
+        return;
+    }
+    printf("Wrote %ld segments and %ld uses of loop bodies\n", b->segments, b->uses);
+}
+
+/********************************************
+ Interpreting Functions
+ ********************************************/
+
+/**
+ *  Starts the svg, with the page flipped so that y goes up as in
+ *  postscript and the turtle starts where it does there
+ */
+void svg_header(Logo input, char *in_filename) {
+    OutBuf out = input->out;
+    ob_puts(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                 "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+                 "xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"");
+    ob_int(out, SVG_WIDTH);
+    ob_puts(out, "\" height=\"");
+    ob_int(out, SVG_HEIGHT);
+    ob_puts(out, "\">\n<title>");
+    put_text(out, in_filename);
+    ob_puts(out, "</title>\n<g transform=\"matrix(1 0 0 -1 ");
+    ob_int(out, SVG_START_X);
+    ob_puts(out, " ");
+    ob_int(out, SVG_HEIGHT - SVG_START_Y);
+    ob_puts(out, ")\" fill=\"none\" stroke=\"black\">\n");
+    if (input->backend != NULL) {
+        reset(input->backend);
+    }
+}
+
+/**
+ *  Ends the page
+ */
+void svg_footer(Logo input) {
+    if (input->backend != NULL) {
+        close_path(input);
+    }
+    ob_puts(input->out, "</g>\n");
+}
+
+/**
+ *  Ends the svg
+ */
+void svg_trailer(Logo input) {
+    ob_puts(input->out, "</svg>\n");
+}
+
+/**
+ *  Starts a loop whose body starts on line pos. It is instanced if its body
+ *  draws the same on every iteration, is big enough for a <use> to be
+ *  shorter than drawing it again and is not inside a loop that is
+ *  instanced already.
+ */
+void svg_loop(Logo input, int pos) {
+    Backend b = input->backend;
+    SvgLoop *l;
+    int found;
+    if (b == NULL) {
+        return;
+    }
+    b->depth = b->depth + 1;
+    if (b->depth > SVG_MAX_LOOPS) {
+        return;
+    }
+    l = &b->loops[b->depth - 1];
+    l->inst = 0;
+    l->fresh = 0;
+    l->recording = 0;
+    l->iter = 0;
+    if (b->hidden > 0 || pos >= input->num_lines) {
+        return;
+    }
+    analyse(input, pos);
+    if (!b->bodies[pos].invariant || b->bodies[pos].size < SVG_MIN_BODY) {
+        return;
+    }
+    l->def = find_def(input, pos, &found);
+    if (l->def < 0) {
+        /* out of memory, so just draw it */
+        return;
+    }
+    l->inst = 1;
+    l->fresh = !found;
+}
+
+/**
+ *  Starts an iteration of the innermost loop. The first iteration of an
+ *  instanced loop with no definition yet is written into one, and any
+ *  other is a <use> of it, with the body drawing nothing.
+ */
+void svg_iteration(Logo input) {
+    Backend b = input->backend;
+    SvgLoop *l;
+    SvgFrame *f;
+    if (b == NULL || b->depth > SVG_MAX_LOOPS) {
+        return;
+    }
+    l = &b->loops[b->depth - 1];
+    if (!l->inst) {
+        return;
+    }
+    if (l->recording) {
+        end_def(input, l);
+    }
+    l->x = b->x;
+    l->y = b->y;
+    l->h = b->h;
+    l->iter = l->iter + 1;
+    if (l->fresh) {
+        close_path(input);
+        ob_puts(input->out, "<defs><g id=\"d");
+        ob_int(input->out, l->def);
+        ob_puts(input->out, "\">\n");
+        f = &b->frames[b->num_frames];
+        f->x = b->x;
+        f->y = b->y;
+        f->h = b->h;
+        b->num_frames = b->num_frames + 1;
+        l->recording = 1;
+        l->fresh = 0;
+        return;
+    }
+    write_use(input, l);
+    if (b->hidden == 0) {
+        b->hidden = b->depth;
+    }
+}
+
+/**
+ *  Ends the innermost loop
+ */
+void svg_loop_end(Logo input) {
+    Backend b = input->backend;
+    SvgLoop *l;
+    if (b == NULL) {
+        return;
+    }
+    if (b->depth <= SVG_MAX_LOOPS) {
+        l = &b->loops[b->depth - 1];
+        if (l->recording) {
+            end_def(input, l);
+        }
+        if (b->hidden == b->depth) {
+            b->hidden = 0;
+        }
+    }
+    b->depth = b->depth - 1;
+}
+
+/**
+ *  Moves the turtle op forward, adding the segment to the path unless the
+ *  loop it is in is drawn by <use>
+ */
+void svg_ipt_fd(Logo input, float op) {
+    Backend b = input->backend;
+    double rad = b->h * SVG_TO_RADS;
+    double x = b->x + op * cos(rad), y = b->y + op * sin(rad);
+    long long fx, fy;
+    if (b->hidden == 0) {
+        if (!b->in_path) {
+            ob_puts(input->out, "<path d=\"");
+            b->cmd = 0;
+            b->far = put_point(input, b->x, b->y, 'M') < 0;
+            b->in_path = 1;
+        }
+        if (b->far || to_frame(b, x, y, &fx, &fy) < 0) {
+            /* an end too far to round into hundredths, so the point is
+               written where it is rather than from the last one */
+            b->far = put_point(input, x, y, 'L') < 0;
+        } else {
+            /* relative to the last point as written, so rounding does not add up */
+            put_cmd(input, 'l');
+            put_num(b, input->out, fx - b->cur_x, 2);
+            put_num(b, input->out, fy - b->cur_y, 2);
+            b->cur_x = fx;
+            b->cur_y = fy;
+        }
+        b->segments = b->segments + 1;
+    }
+    b->x = x;
+    b->y = y;
+}
+
+/**
+ *  Turns the turtle op degrees anticlockwise
+ */
+void svg_ipt_lt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h + op, SVG_FULL_CIRCLE);
+}
+
+/**
+ *  Turns the turtle op degrees clockwise
+ */
+void svg_ipt_rt(Logo input, float op) {
+    input->backend->h = fmod(input->backend->h - op, SVG_FULL_CIRCLE);
+}
@@ -0,0 +1,321 @@
+/*
+ *  tokens.c
+ *  Free-form tokenising of LOGO programs
+ *
+ *  Programs may have any whitespace between tokens, several instructions on
+ *  a line or an instruction over several lines. "{" and "}" are tokens on
+ *  their own even without whitespace around them. tok_normalise() rewrites
+ *  a program with one instruction per line and single spaces between
+ *  tokens, which is the form the parser functions check, and remembers the
+ *  line each instruction started on for error messages. tok_next() reads
+ *  the same instructions one at a time without copying the program, for
+ *  whoever only needs to look at each once.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "linescan.h" /* for skipping whitespace */
+#include "tokens.h"
+
+/* what a token is to the grouping */
+#define TK_OTHER        0
+#define TK_OPEN         1       /* "{" */
+#define TK_CLOSE        2       /* "}" */
+#define TK_INST         3       /* FD, LT or RT, taking one operand */
+#define TK_DO           4
+#define TK_SET          5
+#define TK_SEMI         6       /* ";" */
+
+#define DO_TOKENS       6       /* DO <VAR> FROM <VARNUM> TO <VARNUM> { */
+
+/* a token in the input */
+struct _token {
+    const char *start;
+    int len;
+    int line;       /* line number it is on */
+    int kind;       /* TK_FOO */
+};
+typedef struct _token Token;
+
+/* the normalised program being written */
+struct _output {
+    char *text;
+    size_t size;
+    size_t cap;
+    int *line_nums;
+    int num_lines;
+    int cap_lines;
+};
+typedef struct _output Output;
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Returns the TK_FOO of the token [p, p+len)
+ */
+static int token_kind(const char *p, int len) {
+    if (len == 1) {
+        switch (*p) {
+            case '{':
+                return TK_OPEN;
+            case '}':
+                return TK_CLOSE;
+            case ';':
+                return TK_SEMI;
+        }
+    } else if (len == 2 && (memcmp(p, "FD", 2) == 0 || memcmp(p, "LT", 2) == 0 ||
+                            memcmp(p, "RT", 2) == 0)) {
+        return TK_INST;
+    } else if (len == 2 && memcmp(p, "DO", 2) == 0) {
+        return TK_DO;
+    } else if (len == 3 && memcmp(p, "SET", 3) == 0) {
+        return TK_SET;
+    }
+    return TK_OTHER;
+}
+
+/**
+ *  Reads the token at or after *p into tok, counting the newlines skipped on
+ *  the way into *line. Returns 0 if there are no more tokens.
+ */
+static int next_token(const char **p, const char *end, int *line, Token *tok) {
+    const char *q = ls_skip_space(*p, end);
+    const char *s;
+    /* tokens never have whitespace in them, so newlines are all in here */
+    for (s=*p; s<q; s++) {
+        if (*s == '\n') {
+            *line = *line + 1;
+        }
+    }
+    *p = q;
+    if (q == end) {
+        return 0;
+    }
+    tok->start = q;
+    tok->line = *line;
+    if (*q == '{' || *q == '}') {
+        q = q + 1;
+    } else {
+        while (q < end && *q != '{' && *q != '}' &&
+               !(*q == ' ' || (unsigned char) (*q - '\t') <= '\r' - '\t')) {
+            q = q + 1;
+        }
+    }
+    tok->len = q - tok->start;
+    tok->kind = token_kind(tok->start, tok->len);
+    *p = q;
+    return 1;
+}
+
+/**
+ *  Adds the token to the instruction being read. While the instruction is
+ *  in the input as it is written out, single spaces between its tokens, it
+ *  is left there, and only copied into r->text once it is not. Returns
+ *  TOK_TOO_LONG if it no longer fits in a line with its newline, as fgets()
+ *  reads it, else 0.
+ */
+static int add_token(TokReader *r, Token *tok) {
+    int space = (r->len > 0) ? 1 : 0;
+    if (r->len + space + tok->len > TOK_LINE_LENGTH - 2) {
+        return TOK_TOO_LONG;
+    }
+    if (r->len == 0) {
+        r->inst = tok->start;
+    } else if (r->inst == r->text || tok->start != r->inst + r->len + 1 || r->inst[r->len] != ' ') {
+        if (r->inst != r->text) {
+            memcpy(r->text, r->inst, r->len);
+            r->inst = r->text;
+        }
+        r->text[r->len] = ' ';
+        memcpy(r->text + r->len + 1, tok->start, tok->len);
+    }
+    r->len = r->len + space + tok->len;
+    return 0;
+}
+
+/**
+ *  Makes room for n more bytes of text. Returns -1 when out of memory.
+ */
+static int reserve(Output *out, size_t n) {
+    char *text;
+    if (out->size + n <= out->cap) {
+        return 0;
+    }
+    while (out->size + n > out->cap) {
+        out->cap = out->cap * 2;
+    }
+    text = (char *) realloc (out->text, out->cap);
+    if (text == NULL) {
+        return -1;
+    }
+    out->text = text;
+    return 0;
+}
+
+/**
+ *  Ends the current line, which started on source line number line.
+ *  Returns -1 when out of memory.
+ */
+static int end_line(Output *out, int line) {
+    int *nums;
+    if (reserve(out, 1) < 0) {
+        return -1;
+    }
+    if (out->num_lines + 1 >= out->cap_lines) {
+        out->cap_lines = out->cap_lines * 2;
+        nums = (int *) realloc (out->line_nums, out->cap_lines * sizeof(int));
+        if (nums == NULL) {
+            return -1;
+        }
+        out->line_nums = nums;
+    }
+    out->text[out->size] = '\n';
+    out->size = out->size + 1;
+    out->line_nums[out->num_lines] = line;
+    out->num_lines = out->num_lines + 1;
+    return 0;
+}
+
+/********************************************
+ Tokenising
+ ********************************************/
+
+/**
+ *  Gets r ready to read the program in buf, which must outlive it
+ */
+void tok_start(TokReader *r, const char *buf, size_t size) {
+    r->p = buf;
+    r->end = buf + size;
+    r->line = 1;
+    r->tail = (size > 0 && buf[size-1] != '\n') ? 1 : 0;
+    r->quiet = 0;
+    r->inst = r->text;
+    r->len = 0;
+    r->first = 1;
+}
+
+/**
+ *  Reads the next instruction, its tokens grouped as follows:
+ *      FD, LT and RT take the next token
+ *      DO takes the next 6 tokens, or up to a "{" if there is one before
+ *      SET takes tokens up to a ";", stopping before a "{", "}" or keyword
+ *      anything else is an instruction of its own
+ *  The instruction is left in r->inst, r->len characters long with single
+ *  spaces between its tokens and not NUL terminated, and r->first is the
+ *  line it starts on. It points into buf where it is written that way,
+ *  else into r->text, and is good until the next call. Returns 1 if an
+ *  instruction was read, 0 at the end of the program, with r->first the
+ *  line number of the empty line scan_file() adds after it, or
+ *  TOK_TOO_LONG when an instruction is too long for a line, which is
+ *  reported unless r->quiet is set.
+ */
+int tok_next(TokReader *r) {
+    const char *save;
+    Token tok;
+    int save_line, n, ret;
+
+    r->len = 0;
+    if (next_token(&r->p, r->end, &r->line, &tok) == 0) {
+        /* the empty line at the end is one after the last line */
+        r->inst = r->text;
+        r->first = r->line + r->tail;
+        return 0;
+    }
+    r->first = tok.line;
+    ret = add_token(r, &tok);
+    switch (tok.kind) {
+        case TK_INST:
+            /* the operand, whatever it is */
+            if (ret == 0 && next_token(&r->p, r->end, &r->line, &tok)) {
+                ret = add_token(r, &tok);
+            }
+            break;
+        case TK_DO:
+            for (n=0; ret == 0 && n<DO_TOKENS && next_token(&r->p, r->end, &r->line, &tok); n++) {
+                ret = add_token(r, &tok);
+                if (tok.kind == TK_OPEN) {
+                    break;
+                }
+            }
+            break;
+        case TK_SET:
+            while (ret == 0) {
+                save = r->p;
+                save_line = r->line;
+                if (next_token(&r->p, r->end, &r->line, &tok) == 0) {
+                    break;
+                }
+                if (tok.kind != TK_OTHER && tok.kind != TK_SEMI) {
+                    /* leave it for the next instruction */
+                    r->p = save;
+                    r->line = save_line;
+                    break;
+                }
+                ret = add_token(r, &tok);
+                if (tok.kind == TK_SEMI) {
+                    break;
+                }
+            }
+            break;
+    }
+    if (ret < 0 && !r->quiet) {
+        fprintf(stderr, "Error: instruction longer than %d characters on line %d\n",
+                TOK_LINE_LENGTH - 2, r->first);
+    }
+    if (ret < 0) {
+        return TOK_TOO_LONG;
+    }
+    return 1;
+}
+
+/**
+ *  Rewrites the program in buf with one instruction per line, as read by
+ *  tok_next(), each line ending in a newline. Returns the text and its
+ *  size in *out_size, and in *line_nums the line number in buf of each of
+ *  its *num_lines lines. *line_nums has one more entry for the empty line
+ *  scan_file() adds at the end. Returns NULL when out of memory, or when an
+ *  instruction is too long for a line, which is reported and *num_lines
+ *  set to TOK_TOO_LONG.
+ */
+char * tok_normalise(const char *buf, size_t size, size_t *out_size,
+                     int **line_nums, int *num_lines) {
+    TokReader r;
+    Output out;
+    int ok, ret = 0;
+
+    out.cap = size + size / 4 + TOK_LINE_LENGTH;
+    out.text = (char *) malloc (out.cap);
+    out.cap_lines = 64;
+    out.line_nums = (int *) malloc (out.cap_lines * sizeof(int));
+    out.size = 0;
+    out.num_lines = 0;
+    ok = (out.text != NULL && out.line_nums != NULL);
+
+    tok_start(&r, buf, size);
+    while (ok && (ret = tok_next(&r)) > 0) {
+        ok = (reserve(&out, r.len) == 0);
+        if (ok) {
+            memcpy(out.text + out.size, r.inst, r.len);
+            out.size = out.size + r.len;
+            ok = (end_line(&out, r.first) == 0);
+        }
+    }
+    if (!ok || ret < 0) {
+        free(out.text);
+        free(out.line_nums);
+        *num_lines = (ret == TOK_TOO_LONG) ? TOK_TOO_LONG : 0;
+        return NULL;
+    }
+    out.line_nums[out.num_lines] = r.first;
+    *out_size = out.size;
+    *line_nums = out.line_nums;
+    *num_lines = out.num_lines;
+    return out.text;
+}
@@ -0,0 +1,275 @@
+/*
+ *  turtle.c
+ *  Runs a program a few segments at a time, for whoever wants them
+ *
+ *  The parser of interpreter.c runs a program from start to end in one
+ *  go, recursing into each DO and calling the backend with everything it
+ *  draws. Here the same grammar is run one line at a time with the DO
+ *  loops kept on a stack of frames instead, so turtle_next() can stop
+ *  once it has the segments it was asked for and carry on from the same
+ *  line when next called. Whoever is reading the drawing decides how fast
+ *  the program runs, can give other work a turn in between, and can stop
+ *  it for good by freeing it.
+ *
+ *  Each line is checked with the helpers of interpreter.c, so a program
+ *  is accepted, and its errors reported, just as interp would, and held
+ *  to the same limits if input has a budget.
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interpreter.h"
+#include "turtle.h"
+
+#define DEBUG_DATA  input->lines[input->counter], line_num(input)
+
+/********************************************
+ Static Functions
+ ********************************************/
+
+/**
+ *  Moves on to the line after the one just run, as instrctlst() does.
+ *  Returns 0 on success, PARSE_ERR if the program ends without its '}'
+ */
+static int next_line(Logo input) {
+    input->counter = input->counter + 1;
+    if (input->counter > input->num_lines-1) {
+        fprintf(stderr, "Error: expected '}' on line %d\n", line_num(input));
+        return PARSE_ERR;
+    }
+    return 0;
+}
+
+/**
+ *  Returns 1 if the DO of frame f is to go round again with its <VAR> at
+ *  f->loop, else 0
+ */
+static int goes_round(TtFrame *f) {
+    return (f->step > 0) ? f->loop <= f->to : f->loop >= f->to;
+}
+
+/**
+ *  Runs the DO on the current line, leaving the counter on the first line
+ *  of its body. Returns 0 on success, or an error code
+ */
+static int run_do(TurtleCtx ctx) {
+    Logo input = ctx->input;
+    TtFrame *f;
+    float from, to;
+    if (ctx->num_frames == ctx->max_frames) {
+        f = (TtFrame *) realloc (ctx->frames, 2 * ctx->max_frames * sizeof(TtFrame));
+        if (f == NULL) {
+            fprintf(stderr, "Error: cannot allocate memory for DO frames\n");
+            return MEM_ERR;
+        }
+        ctx->frames = f;
+        ctx->max_frames = 2 * ctx->max_frames;
+    }
+    f = &ctx->frames[ctx->num_frames];
+    if (do_header(input, f->var, &from, &to) < 0) {
+        return PARSE_ERR;
+    }
+    if (next_line(input) < 0) {
+        return PARSE_ERR;
+    }
+    /* counted as dologo() counts, from and to being floats */
+    f->loop = from;
+    f->to = to;
+    f->step = (from < to) ? 1 : -1;
+    f->pos = input->counter;
+    if (goes_round(f)) {
+        set_var(f->var, input->vars, f->loop);
+        ctx->num_frames = ctx->num_frames + 1;
+        return spend(input, 0);
+    }
+    /* a DO that never goes round carries on from the line after its
+       first, as dologo() does */
+    return next_line(input);
+}
+
+/**
+ *  Runs the '}' on the current line, going round the innermost DO again
+ *  or leaving it, or ending the program. Returns 0 on success, PARSE_ERR
+ *  or LIMIT_ERR on error
+ */
+static int run_close(TurtleCtx ctx) {
+    Logo input = ctx->input;
+    TtFrame *f;
+    int i;
+    if (ctx->num_frames == 0) {
+        /* the end of <MAIN>, everything that follows must be empty */
+        input->counter = input->counter + 1;
+        for (i=input->counter; i<input->num_lines; i++) {
+            if (strlen(input->lines[i]) > 0) {
+                input->counter = i;
+                fprintf(stderr, "Error: %s found after closing bracket on line %d\n", DEBUG_DATA);
+                return PARSE_ERR;
+            }
+        }
+        ctx->done = 1;
+        return 0;
+    }
+    f = &ctx->frames[ctx->num_frames - 1];
+    f->loop = f->loop + f->step;
+    if (goes_round(f)) {
+        set_var(f->var, input->vars, f->loop);
+        input->counter = f->pos;
+        return spend(input, 0);
+    }
+    ctx->num_frames = ctx->num_frames - 1;
+    return next_line(input);
+}
+
+/**
+ *  Runs the instruction on the current line and moves on from it, putting
+ *  what an FD draws in seg and adding it to *drawn. Returns 0 on success,
+ *  or an error code
+ */
+static int run_line(TurtleCtx ctx, TurtleSeg *seg, int *drawn) {
+    Logo input = ctx->input;
+    char inst[INSTRUCT_LENGTH+1];
+    float op;
+    int ret;
+    if (sscanf(input->lines[input->counter], "%3s", inst) != 1) {
+        fprintf(stderr, "Error: expected <INSTRUCTION> but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    if (spend(input, strsame(inst, FD)) < 0) {
+        return LIMIT_ERR;
+    }
+    if (strsame(inst, FD)) {
+        if (move_operand(input, FD, &op) < 0) {
+            return PARSE_ERR;
+        }
+        seg->x0 = TT_START_X + ctx->x;
+        seg->y0 = TT_START_Y + ctx->y;
+        ctx->x = ctx->x + op * cos(ctx->h * TT_TO_RADS);
+        ctx->y = ctx->y + op * sin(ctx->h * TT_TO_RADS);
+        seg->x1 = TT_START_X + ctx->x;
+        seg->y1 = TT_START_Y + ctx->y;
+        seg->line = line_num(input);
+        *drawn = *drawn + 1;
+    } else if (strsame(inst, LT) || strsame(inst, RT)) {
+        if (move_operand(input, inst, &op) < 0) {
+            return PARSE_ERR;
+        }
+        op = strsame(inst, LT) ? op : -op;
+        ctx->h = fmod(ctx->h + op, TT_FULL_CIRCLE);
+    } else if (strsame(inst, SET)) {
+        if ((ret = set(input)) < 0) {
+            return ret;
+        }
+    } else if (strsame(inst, DO)) {
+        return run_do(ctx);
+    } else {
+        fprintf(stderr, "Error: expected <INSTRUCTION> but got '%s' on line %d\n", DEBUG_DATA);
+        return PARSE_ERR;
+    }
+    return next_line(input);
+}
+
+/********************************************
+ Turtle Handling
+ ********************************************/
+
+/**
+ *  Gets ready to run the program starting on the current line of input,
+ *  with all its variables unset. input must outlive the turtle, and is
+ *  left for the caller to free. Returns NULL when out of memory.
+ */
+TurtleCtx turtle_new(Logo input) {
+    TurtleCtx ctx = (TurtleCtx) malloc (sizeof(*ctx));
+    int i;
+    if (ctx == NULL) {
+        fprintf(stderr, "Error: cannot allocate memory for turtle\n");
+        return NULL;
+    }
+    free(input->vars);
+    input->vars = (VarStack) malloc (VARARY_SIZE * sizeof(*(input->vars)));
+    ctx->frames = (TtFrame *) malloc (TT_FRAMES * sizeof(TtFrame));
+    if (input->vars == NULL || ctx->frames == NULL) {
+        fprintf(stderr, "Error: cannot allocate memory for turtle\n");
+        free(ctx->frames);
+        free(ctx);
+        return NULL;
+    }
+    for (i=0; i<VARARY_SIZE; i++) {
+        input->vars[i].data = 0;
+        input->vars[i].used = 0;
+    }
+    ctx->input = input;
+    ctx->num_frames = 0;
+    ctx->max_frames = TT_FRAMES;
+    ctx->x = 0;
+    ctx->y = 0;
+    ctx->h = 0;
+    ctx->done = 0;
+    ctx->error = 0;
+    /* starts with a curly bracket, as program() checks */
+    if (input->counter > input->num_lines-1) {
+        fprintf(stderr, "Error: expected '{' but got nothing\n");
+        ctx->error = PARSE_ERR;
+    } else if (strsame(input->lines[input->counter], "{") != 1) {
+        fprintf(stderr, "Error: expected '{' but got '%s' on line %d\n", DEBUG_DATA);
+        ctx->error = PARSE_ERR;
+    } else if (next_line(input) < 0) {
+        ctx->error = PARSE_ERR;
+    }
+    return ctx;
+}
+
+/**
+ *  Frees the turtle, whether or not its program has finished, which is
+ *  how a program is cancelled. The ctx may be NULL.
+ */
+void turtle_free(TurtleCtx ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    free(ctx->frames);
+    free(ctx);
+}
+
+/********************************************
+ Running
+ ********************************************/
+
+/**
+ *  Runs the program on until it has drawn max segments into buf, it ends,
+ *  or TT_MAX_STEPS lines have been run, so a long stretch drawing nothing
+ *  still hands back control. Returns the number of segments drawn, which
+ *  is 0 once the program has finished. On an error the segments drawn
+ *  before it are returned, and the error code from then on.
+ */
+int turtle_next(TurtleCtx ctx, TurtleSeg *buf, int max) {
+    Logo input = ctx->input;
+    int drawn = 0, steps, ret;
+    if (ctx->error < 0) {
+        return ctx->error;
+    }
+    for (steps=0; !ctx->done && drawn<max && steps<TT_MAX_STEPS; steps++) {
+        if (strsame(input->lines[input->counter], "}")) {
+            ret = run_close(ctx);
+        } else {
+            ret = run_line(ctx, buf + drawn, &drawn);
+        }
+        if (ret < 0) {
+            ctx->error = ret;
+            return (drawn > 0) ? drawn : ret;
+        }
+    }
+    return drawn;
+}
+
+/**
+ *  Returns 1 once the program has run to its end, else 0
+ */
+int turtle_done(TurtleCtx ctx) {
+    return ctx->done;
+}
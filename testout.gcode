@@ -0,0 +1,27 @@
+G21
+G90
+G0 Z5
+G0 X45.61 Y45.61
+G1 Z0 F3000
+G1 X70.56 Y70.56
+G1 X105.83 Y70.56
+G0 Z5
+G0 X95.50 Y95.50
+G1 Z0 F3000
+G1 X70.56 Y70.56
+G1 X70.56 Y105.83
+G0 Z5
+G0 X45.61 Y95.50
+G1 Z0 F3000
+G1 X70.56 Y70.56
+G1 X35.28 Y70.56
+G0 Z5
+G0 X70.56 Y70.56
+G1 Z0 F3000
+G1 X70.56 Y35.28
+G0 Z5
+G0 X95.50 Y45.61
+G1 Z0 F3000
+G1 X70.56 Y70.56
+G0 Z5
+M2
@@ -0,0 +1,169 @@
+/*
+ *  bench_raster.c
+ *  Benchmark for the tiled drawing in raster.c
+ *
+ *  Generates the lines of a poster through the raster backend, as the
+ *  interpreter would, then draws them on 1 to 32 threads and reports how
+ *  the drawing scales. There are two workloads: rosettes of circles, which
+ *  ink every tile about the same, and a random walk of long and short
+ *  lines, which does not. See 'make bench-raster'.
+ *
+ *  Usage: ./bench_raster [scale] [thousands of lines]
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for clock_gettime */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "interpreter.h"
+#include "raster.h"
+
+#define DEFAULT_SCALE   26.8    /* 16402x21226 pixels */
+#define DEFAULT_LINES   250     /* thousands of lines */
+#define RUNS            3       /* best of */
+#define CENTRE_X        106     /* the middle of the page, from where the turtle starts */
+#define CENTRE_Y        196
+#define PI              3.14159265358979323846
+
+/* threads to draw on */
+static const int threads[] = { 1, 2, 4, 8, 16, 32 };
+
+/**
+ *  Returns a random number from a simple LCG, so every run is the same
+ */
+static unsigned rnd(unsigned *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) & 0x7fff;
+}
+
+/**
+ *  Returns the time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *  Draws circles of random sizes from the middle of the page until there
+ *  are n lines
+ */
+static void rosettes(Logo input, long n) {
+    Backend b = input->backend;
+    unsigned seed = 1;
+    double r;
+    long i;
+    while (b->num_segs < n) {
+        b->x = CENTRE_X;
+        b->y = CENTRE_Y;
+        b->h = rnd(&seed) % 360;
+        r = 10 + rnd(&seed) % 290;
+        for (i=0; i<360 && b->num_segs < n; i++) {
+            raster_ipt_fd(input, 2 * PI * r / 360);
+            raster_ipt_lt(input, 1);
+        }
+    }
+}
+
+/**
+ *  Walks at random until there are n lines, going back to the middle of
+ *  the page whenever the turtle leaves it
+ */
+static void walk(Logo input, long n) {
+    Backend b = input->backend;
+    unsigned seed = 2;
+    b->x = CENTRE_X;
+    b->y = CENTRE_Y;
+    while (b->num_segs < n) {
+        raster_ipt_fd(input, (rnd(&seed) % 8 == 0) ? rnd(&seed) % 400 : rnd(&seed) % 20);
+        raster_ipt_rt(input, rnd(&seed) % 360);
+        if (fabs(b->x - CENTRE_X) > 300 || fabs(b->y - CENTRE_Y) > 390) {
+            b->x = CENTRE_X;
+            b->y = CENTRE_Y;
+        }
+    }
+}
+
+/**
+ *  Draws the lines kept on each number of threads and prints the best
+ *  time of each, against one thread
+ */
+static int run(Backend b, const char *name) {
+    double start, t, best, one = 0;
+    unsigned long sum;
+    size_t i, pixels = (size_t) b->width * b->height;
+    int k, r;
+    printf("%s: %ld lines into %dx%d pixels, %d tiles\n", name, b->num_segs,
+           b->width, b->height, b->tiles_x * b->tiles_y);
+    printf("threads  seconds  speedup  checksum\n");
+    for (k=0; k<(int) (sizeof(threads) / sizeof(threads[0])); k++) {
+        b->threads = threads[k];
+        best = 0;
+        for (r=0; r<RUNS; r++) {
+            start = now();
+            if (raster_draw(b) < 0) {
+                fprintf(stderr, "Error: cannot allocate memory for drawing\n");
+                return MEM_ERR;
+            }
+            t = now() - start;
+            if (r == 0 || t < best) {
+                best = t;
+            }
+        }
+        if (k == 0) {
+            one = best;
+        }
+        /* the same whatever the number of threads */
+        sum = 0;
+        for (i=0; i<pixels; i++) {
+            sum = sum * 31 + b->cov[i];
+        }
+        printf("%7d  %7.3f  %7.2f  %08lx\n", threads[k], best, one / best, sum & 0xffffffffUL);
+    }
+    printf("binned in %.3fs a run\n\n", b->bin_time / (RUNS * k));
+    b->bin_time = 0;
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    struct logo logo;
+    Options opts;
+    long n;
+    int ret;
+
+    memset(&logo, 0, sizeof(logo));
+    memset(&opts, 0, sizeof(opts));
+    opts.scale = (argc > 1) ? atof(argv[1]) : DEFAULT_SCALE;
+    opts.image = IMAGE_PNG;
+    n = 1000 * ((argc > 2) ? atol(argv[2]) : DEFAULT_LINES);
+    /* failing to keep a line fails the output, which there is none of */
+    logo.out = ob_new(stdout);
+    if (logo.out == NULL || raster_backend(&logo, &opts) < 0) {
+        fprintf(stderr, "Error: cannot allocate memory for a %gx image\n", opts.scale);
+        return EXIT_FAILURE;
+    }
+
+    raster_header(&logo, "rosettes");
+    rosettes(&logo, n);
+    ret = run(logo.backend, "rosettes");
+    raster_header(&logo, "walk");
+    walk(&logo, n);
+    if (ret == 0) {
+        ret = run(logo.backend, "walk");
+    }
+    if (logo.out->error) {
+        fprintf(stderr, "Error: cannot allocate memory for the lines\n");
+        ret = MEM_ERR;
+    }
+    ob_close(logo.out);
+    raster_free(logo.backend);
+    return (ret < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/*
+ *  bench_scan.c
+ *  Benchmark for the line splitting in linescan.c
+ *
+ *  Generates a large Logo program in memory and splits it into trimmed
+ *  lines. Build it with and without -DLS_SCALAR or -mavx2 to compare, see
+ *  'make bench'.
+ *
+ *  Usage: ./bench_scan [megabytes]
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "linescan.h"
+
+#define DEFAULT_MB      1024    /* 1GB of Logo */
+#define MAX_LINE        127     /* like scan_file() */
+#define RUNS            3       /* best of */
+
+/* lines to generate the program from, indented at random */
+static const char *lines[] = {
+    "FD 30", "LT 45", "RT A", "SET A := A 1.5 + ;", "SET B := A 2 * C / ;",
+    "DO A FROM 1 TO 100 {", "}", "FD -12.25", ""
+};
+
+/**
+ *  Returns a random number from a simple LCG, so every run is the same
+ */
+static unsigned rnd(unsigned *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) & 0x7fff;
+}
+
+/**
+ *  Fills buf with size bytes of generated Logo
+ */
+static void generate(char *buf, size_t size) {
+    const char *ws = " \t";
+    unsigned seed = 1;
+    size_t n = 0, len;
+    int i, indent;
+    while (n < size) {
+        indent = rnd(&seed) % 24;
+        for (i=0; i<indent && n < size; i++) {
+            buf[n++] = ws[rnd(&seed) % 2];
+        }
+        i = rnd(&seed) % (sizeof(lines) / sizeof(lines[0]));
+        len = strlen(lines[i]);
+        if (len > size - n) {
+            len = size - n;
+        }
+        memcpy(buf + n, lines[i], len);
+        n = n + len;
+        /* the odd trailing whitespace */
+        if (n < size && rnd(&seed) % 4 == 0) {
+            buf[n++] = ' ';
+        }
+        if (n < size) {
+            buf[n++] = '\n';
+        }
+    }
+}
+
+/**
+ *  Returns the time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char * argv[]) {
+    char *buf;
+    const char *p, *end;
+    LineView view;
+    size_t size, count, sum;
+    double start, best = 0;
+    int run;
+
+    size = (size_t) (argc > 1 ? atoi(argv[1]) : DEFAULT_MB) << 20;
+    buf = (char *) malloc (size);
+    if (buf == NULL) {
+        fprintf(stderr, "Error: cannot allocate %lu bytes\n", (unsigned long) size);
+        return EXIT_FAILURE;
+    }
+    generate(buf, size);
+
+    for (run=0; run<RUNS; run++) {
+        count = 0;
+        sum = 0;
+        start = now();
+        p = buf;
+        end = buf + size;
+        while (p < end) {
+            p = ls_next_line(p, end, MAX_LINE, &view);
+            /* make sure the views are used */
+            sum = sum + view.len + (view.len > 0 ? (unsigned char) view.start[0] : 0);
+            count = count + 1;
+        }
+        start = now() - start;
+        if (run == 0 || start < best) {
+            best = start;
+        }
+    }
+    printf("%d byte vectors: %lu MB in %.3fs, %.0f MB/s (%lu lines, checksum %lu)\n",
+           ls_width(), (unsigned long) (size >> 20), best, (size >> 20) / best,
+           (unsigned long) count, (unsigned long) sum);
+    free(buf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/*
+ *  bench_seg.c
+ *  Benchmark for reading binary segment files
+ *
+ *  Reads the same drawing back from a segment file, through segfile.c, and
+ *  from absolute postscript, as a downstream tool would parse it for its
+ *  coordinates, and reports the size of each and how fast each decodes.
+ *  The segment file is read both in order and by blocks in a shuffled
+ *  order. See 'make bench-seg'.
+ *
+ *  Usage: ./bench_seg <segment file> <absolute postscript file>
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "errors.h"
+#include "segfile.h"
+
+#define RUNS            5       /* best of */
+
+/**
+ *  Returns a random number from a simple LCG, so every run is the same
+ */
+static unsigned rnd(unsigned *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) & 0x7fff;
+}
+
+/**
+ *  Returns the time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *  Returns the size of the file, or -1 if it cannot be opened
+ */
+static long file_size(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    long size;
+    if (fp == NULL) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+/**
+ *  Decodes every block of the segment file, in order or shuffled, adding
+ *  the ends of the segments into sum. Returns the segments decoded, or -1
+ *  on error.
+ */
+static long long read_seg(const char *filename, int shuffled, double *sum) {
+    SegReader sr = sf_open(filename);
+    SfSeg *segs;
+    long *order, i, j, k, n, page;
+    long long total = 0;
+    unsigned seed = 1;
+    if (sr == NULL) {
+        return -1;
+    }
+    segs = (SfSeg *) malloc (sr->block_segs * sizeof(SfSeg));
+    order = (long *) malloc ((sr->num_blocks + 1) * sizeof(long));
+    if (segs == NULL || order == NULL) {
+        free(segs);
+        free(order);
+        sf_close(sr);
+        return -1;
+    }
+    for (i=0; i<sr->num_blocks; i++) {
+        order[i] = i;
+    }
+    for (i=sr->num_blocks-1; shuffled && i>0; i--) {
+        j = (long) (((unsigned long) rnd(&seed) << 15 | rnd(&seed)) % (i + 1));
+        k = order[i];
+        order[i] = order[j];
+        order[j] = k;
+    }
+    for (i=0; i<sr->num_blocks && total>=0; i++) {
+        n = sf_read_block(sr, order[i], segs, &page);
+        for (j=0; j<n; j++) {
+            *sum = *sum + segs[j].x1 + segs[j].y1;
+        }
+        total = (n < 0) ? -1 : total + n;
+    }
+    free(segs);
+    free(order);
+    sf_close(sr);
+    return total;
+}
+
+/**
+ *  Parses the points out of absolute postscript, adding those drawn to
+ *  into sum. Returns the segments found, or -1 on error.
+ */
+static long long read_ps(const char *filename, double *sum) {
+    FILE *fp = fopen(filename, "rb");
+    char *buf, *p, *end, *line;
+    long size;
+    long long total = 0;
+    double x, y;
+    if (fp == NULL) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    rewind(fp);
+    buf = (char *) malloc (size + 1);
+    if (buf == NULL || fread(buf, 1, size, fp) != (size_t) size) {
+        free(buf);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    buf[size] = '\0';
+    for (line=buf; line<buf+size; line=p+1) {
+        p = strchr(line, '\n');
+        p = (p == NULL) ? buf + size : p;
+        if (p - line > 7 && strncmp(p - 7, " lineto", 7) == 0) {
+            x = strtod(line, &end);
+            y = strtod(end, &end);
+            *sum = *sum + x + y;
+            total = total + 1;
+        }
+    }
+    free(buf);
+    return total;
+}
+
+int main(int argc, char *argv[]) {
+    long long segs[3];
+    double best[3], sum[3], start, t;
+    long seg_size, ps_size;
+    int i, r;
+    if (argc != 3) {
+        fprintf(stderr, "Usage: ./bench_seg <segment file> <absolute postscript file>\n");
+        return EXIT_FAILURE;
+    }
+    seg_size = file_size(argv[1]);
+    ps_size = file_size(argv[2]);
+    for (i=0; i<3; i++) {
+        best[i] = 0;
+        for (r=0; r<RUNS; r++) {
+            sum[i] = 0;
+            start = now();
+            segs[i] = (i == 2) ? read_ps(argv[2], &sum[i]) : read_seg(argv[1], i == 1, &sum[i]);
+            t = now() - start;
+            best[i] = (r == 0 || t < best[i]) ? t : best[i];
+        }
+        if (segs[i] < 0) {
+            fprintf(stderr, "Error: failed to read %s\n", (i == 2) ? argv[2] : argv[1]);
+            return EXIT_FAILURE;
+        }
+    }
+    printf("%-20s %12s %10s %10s %12s\n", "", "bytes", "segments", "bytes/seg", "Msegs/s");
+    printf("%-20s %12ld %10lld %10.2f %12.1f\n", "segments, in order", seg_size, segs[0],
+           (double) seg_size / segs[0], segs[0] / best[0] / 1e6);
+    printf("%-20s %12ld %10lld %10.2f %12.1f\n", "segments, shuffled", seg_size, segs[1],
+           (double) seg_size / segs[1], segs[1] / best[1] / 1e6);
+    printf("%-20s %12ld %10lld %10.2f %12.1f\n", "absolute postscript", ps_size, segs[2],
+           (double) ps_size / segs[2], segs[2] / best[2] / 1e6);
+    printf("%.1fx smaller, %.1fx faster to decode, checksums %.2f %.2f %.2f\n",
+           (double) ps_size / seg_size, best[2] / best[0], sum[0], sum[1], sum[2]);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/*
+ *  bench_uring.c
+ *  Benchmark for writing output through an io_uring
+ *
+ *  Writes the same postscript-like lines to several output files in turn,
+ *  as --multi=files does, once with the buffer written by write() and once
+ *  through an io_uring, and reports the throughput and the longest and
+ *  mean time a buffer took to hand over, which is how long the
+ *  interpreter would have stalled. See 'make bench-uring'.
+ *
+ *  Usage: ./bench_uring <directory> [files] [MB per file]
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* for clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "outbuf.h"
+
+#define RUNS            3       /* best of */
+#define FILES           8
+#define MB              64
+#define CHUNK           4096    /* bytes written at a time */
+#define PATH_LENGTH     4096
+
+/**
+ *  Returns the time in seconds
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *  Writes files files of mb megabytes each into dir, through an io_uring if
+ *  uring is set. Returns the seconds taken, with the longest and the total
+ *  time of a write that handed over a buffer in *worst and *stalls, or -1
+ *  on error.
+ */
+static double run(const char *dir, int files, long mb, int uring, const char *chunk,
+                  double *worst, double *stalls, int *mode) {
+    char filename[PATH_LENGTH];
+    FILE *fp;
+    OutBuf out;
+    long long bytes = (long long) mb << 20;
+    double start = now(), t, took;
+    int f;
+    *worst = 0;
+    *stalls = 0;
+    *mode = -1;
+    for (f=0; f<files; f++) {
+        snprintf(filename, PATH_LENGTH, "%s/bench-%d.ps", dir, f);
+        fp = fopen(filename, "w");
+        if (fp == NULL || (out = ob_new(fp)) == NULL) {
+            return -1;
+        }
+        if (uring) {
+            *mode = ob_uring(out);
+        }
+        while (ob_tell(out) < bytes) {
+            t = now();
+            ob_write(out, chunk, CHUNK);
+            took = now() - t;
+            if (ob_tell(out) % OB_SIZE == CHUNK) {
+                *stalls = *stalls + took;
+                *worst = (took > *worst) ? took : *worst;
+            }
+        }
+        if (ob_close(out) < 0) {
+            return -1;
+        }
+        fclose(fp);
+        remove(filename);
+    }
+    return now() - start;
+}
+
+int main(int argc, char *argv[]) {
+    char chunk[CHUNK];
+    int files = (argc > 2) ? atoi(argv[2]) : FILES;
+    long mb = (argc > 3) ? atol(argv[3]) : MB;
+    double best[2], worst[2], stalls[2], w, s, t;
+    int i, r, n, mode;
+    if (argc < 2 || files <= 0 || mb <= 0) {
+        fprintf(stderr, "Usage: ./bench_uring <directory> [files] [MB per file]\n");
+        return EXIT_FAILURE;
+    }
+    for (i=0; i<CHUNK; i=i+n) {
+        n = snprintf(chunk + i, CHUNK - i, "%d.%02d 0 rlineto\n-%d.00 rotate\n",
+                     i % 97, i % 100, i % 360);
+        n = (n >= CHUNK - i) ? CHUNK - i : n;
+    }
+    for (i=0; i<2; i++) {
+        for (r=0; r<RUNS; r++) {
+            t = run(argv[1], files, mb, i, chunk, &w, &s, &mode);
+            if (t < 0) {
+                fprintf(stderr, "Error: failed to write to %s\n", argv[1]);
+                return EXIT_FAILURE;
+            }
+            if (r == 0 || t < best[i]) {
+                best[i] = t;
+                worst[i] = w;
+                stalls[i] = s;
+            }
+        }
+    }
+    printf("%d files of %ldMB in %s\n", files, mb, argv[1]);
+    printf("%-10s %10s %14s %14s\n", "", "MB/s", "worst stall ms", "mean stall ms");
+    n = (int) (files * ((mb << 20) / OB_SIZE));
+    printf("%-10s %10.0f %14.3f %14.3f\n", "write", files * mb / best[0],
+           worst[0] * 1e3, stalls[0] * 1e3 / n);
+    printf("%-10s %10.0f %14.3f %14.3f\n", (mode == 0) ? "io_uring" : "pwrite", files * mb / best[1],
+           worst[1] * 1e3, stalls[1] * 1e3 / n);
+    return EXIT_SUCCESS;
+}
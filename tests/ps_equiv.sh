@@ -0,0 +1,45 @@
+#!/bin/bash
+#
+#  ps_equiv.sh
+#  Checks that --ps-mode=program draws the same as the unrolled output by
+#  rasterising both with Ghostscript. Skipped when gs is not installed.
+#
+#  Usage: tests/ps_equiv.sh [input files]
+#
+
+if ! command -v gs > /dev/null; then
+    echo "gs not found, skipping"
+    exit 0
+fi
+
+files=("$@")
+if [ ${#files[@]} -eq 0 ]; then
+    # testzero*.txt have a DO that goes round no times, which dologo()
+    # carries on into and a postscript for loop would skip
+    files=(data/testdata*.txt data/testzero*.txt)
+fi
+tmp=$(mktemp -d)
+quit=0
+
+for f in "${files[@]}"
+do
+    ./interp "$f" "$tmp/unrolled.ps" > /dev/null || { echo "$f: interp failed"; quit=1; continue; }
+    ./interp --ps-mode=program "$f" "$tmp/program.ps" > /dev/null || { echo "$f: interp failed"; quit=1; continue; }
+    for m in unrolled program
+    do
+        gs -q -dSAFER -dBATCH -dNOPAUSE -sDEVICE=pgmraw -r72 \
+           -sOutputFile="$tmp/$m.pgm" "$tmp/$m.ps" < /dev/null
+    done
+    # the unrolled output rounds every move, so allow a few pixels
+    diff=$(cmp -l "$tmp/unrolled.pgm" "$tmp/program.pgm" | wc -l)
+    size=$(stat -c %s "$tmp/unrolled.pgm")
+    if [ "$diff" -gt $((size / 1000)) ]; then
+        echo "$f: $diff pixels differ"
+        quit=1
+    else
+        echo "$f: OK"
+    fi
+done
+
+rm -rf "$tmp"
+exit $quit
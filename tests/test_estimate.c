@@ -0,0 +1,280 @@
+/*
+ *  test_estimate.c
+ *  Tests estimating what running a program costs
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interpreter.h"
+#include "estimate.h"
+#include "turtle.h"
+#include "minunit.h"
+
+#define TEST_FILE2      "data/testdata2.txt"
+#define TEST_IN         "testin.txt"            /* written for the programs below */
+#define TEST_JSON       "testout.json"
+#define NUM_FILES       4
+#define NUM_BAD         6
+#define CHUNK           1024                    /* segments pulled at a time */
+#define STR_LENGTH      1000
+
+/* used by minunit.h */
+int tests_run = 0;
+
+/* helper functions */
+Logo load(char *filename);
+int write_program(char *program);
+int run_counts(char *filename, double *insts, double *segs);
+int in_range(Range r, double v);
+
+/**
+ *  tests that programs with known loops are estimated exactly, as running
+ *  them with limits counts them
+ */
+static char * test_exact() {
+    char *files[NUM_FILES] = { "data/testdata1.txt", TEST_FILE2, "data/testdata3.txt", "data/testmini.txt" };
+    Logo input;
+    Cost cost;
+    double insts, segs;
+    int i, programs;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    for (i=0; i<NUM_FILES; i++) {
+        input = load(files[i]);
+        mu_assert("error, not loaded", input != NULL);
+        mu_assert("error, not estimated", estimate(input, &cost, &programs) == 0);
+        mu_assert("error, wrong programs", programs == 1);
+        mu_assert("error, not exact", cost_exact(&cost));
+        free_logo(input);
+        mu_assert("error, not run", run_counts(files[i], &insts, &segs) == 0);
+        mu_assert("error, wrong instructions", cost.insts.lo == insts);
+        mu_assert("error, wrong segments", cost.segs.lo == segs);
+    }
+    /* testdata2.txt, 50 times FD and RT, 400 times SET, FD and RT */
+    mu_assert("error, wrong turns", cost.turns.lo == 450);
+
+    /* an inner loop going round A times is gone round one by one */
+    mu_assert("error, input not written", write_program("{\nSET C := 0 ;\nDO A FROM 1 TO 20 {\n"
+              "SET C := C 2 + ;\nDO B FROM 1 TO C {\nRT 1\n}\n}\nDO A FROM 3 TO 1 {\nFD A\n}\n}\n") == 0);
+    input = load(TEST_IN);
+    mu_assert("error, not estimated", estimate(input, &cost, &programs) == 0);
+    mu_assert("error, not exact", cost_exact(&cost));
+    mu_assert("error, wrong turns", cost.turns.lo == 420 && cost.segs.lo == 3);
+    free_logo(input);
+    mu_assert("error, not run", run_counts(TEST_IN, &insts, &segs) == 0);
+    mu_assert("error, wrong instructions", cost.insts.lo == insts);
+    return 0;
+}
+
+/**
+ *  tests that a loop too long to go round one by one is still estimated at
+ *  once, exactly if what it does is the same each time round, else in
+ *  bounds that hold what running it counts
+ */
+static char * test_bounds() {
+    char program[STR_LENGTH];
+    Logo input;
+    Cost cost;
+    double insts, segs;
+    int programs;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    mu_assert("error, input not written", write_program("{\nDO A FROM 1 TO 100000000 {\nFD 1\n"
+              "DO B FROM 1 TO 1000000 {\n}\n}\n}\n") == 0);
+    input = load(TEST_IN);
+    mu_assert("error, not estimated", estimate(input, &cost, &programs) == 0);
+    mu_assert("error, not exact", cost_exact(&cost));
+    mu_assert("error, wrong instructions", cost.insts.lo == 1 + 1e8 * (1 + 1 + 1 + 1e6));
+    mu_assert("error, wrong segments", cost.segs.lo == 1e8);
+    free_logo(input);
+
+    sprintf(program, "{\nDO A FROM 1 TO %d {\nSET C := A 2 / ;\nDO B FROM C TO 1 {\nFD B\n}\n}\n}\n",
+            2 * EST_UNROLL);
+    mu_assert("error, input not written", write_program(program) == 0);
+    input = load(TEST_IN);
+    mu_assert("error, not estimated", estimate(input, &cost, &programs) == 0);
+    mu_assert("error, exact", !cost_exact(&cost));
+    free_logo(input);
+    mu_assert("error, not run", run_counts(TEST_IN, &insts, &segs) == 0);
+    mu_assert("error, instructions out of bounds", in_range(cost.insts, insts));
+    mu_assert("error, segments out of bounds", in_range(cost.segs, segs));
+
+    /* no telling how far a variable set in the loop goes */
+    mu_assert("error, input not written", write_program("{\nSET C := 1 ;\nDO A FROM 1 TO 5000 {\n"
+              "SET C := C 2 * ;\n}\nDO B FROM 1 TO C {\nFD 1\n}\n}\n") == 0);
+    input = load(TEST_IN);
+    mu_assert("error, not estimated", estimate(input, &cost, &programs) == 0);
+    mu_assert("error, wrong bounds", cost.segs.lo == 0 && cost.segs.hi == HUGE_VAL);
+    free_logo(input);
+
+    /* a body setting its own loop variable leaves it where the body did */
+    mu_assert("error, input not written", write_program("{\nDO A FROM 1 TO 2 {\nDO A FROM 1 TO 5 {\n}\n}\n"
+              "DO B FROM 1 TO A {\nFD 1\n}\nDO C FROM 1 TO 3 {\nSET C := 2 ;\n}\nDO D FROM 1 TO C {\nFD 1\n}\n}\n") == 0);
+    input = load(TEST_IN);
+    mu_assert("error, not estimated", estimate(input, &cost, &programs) == 0);
+    mu_assert("error, not exact", cost_exact(&cost));
+    free_logo(input);
+    mu_assert("error, not run", run_counts(TEST_IN, &insts, &segs) == 0);
+    mu_assert("error, wrong instructions", cost.insts.lo == insts);
+    mu_assert("error, wrong segments", cost.segs.lo == segs && segs == 7);
+    return 0;
+}
+
+/**
+ *  tests that a program certain to fail is, and that a DO that never goes
+ *  round carries on from the line after its first as the parser does
+ */
+static char * test_errors() {
+    char *files[NUM_BAD] = { "data/testb_do.txt", "data/testb_inst.txt", "data/testb_polish.txt",
+                             "data/testb_set.txt", "data/testb_var.txt", "data/testb_varnum.txt" };
+    Logo input;
+    Cost cost;
+    double insts, segs;
+    int i, programs;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    for (i=0; i<NUM_BAD; i++) {
+        input = load(files[i]);
+        mu_assert("error, not loaded", input != NULL);
+        mu_assert("error, no error", estimate(input, &cost, &programs) < 0);
+        free_logo(input);
+    }
+    mu_assert("error, input not written", write_program("{\nDO A FROM 1.5 TO 1.2 {\nFD 1\nFD 2\n}\n") == 0);
+    input = load(TEST_IN);
+    mu_assert("error, not estimated", estimate(input, &cost, &programs) == 0);
+    mu_assert("error, wrong count", cost.insts.lo == 2 && cost.segs.lo == 1 && cost_exact(&cost));
+    free_logo(input);
+    mu_assert("error, not run", run_counts(TEST_IN, &insts, &segs) == 0);
+    mu_assert("error, wrong count", insts == 2 && segs == 1);
+    return 0;
+}
+
+/**
+ *  tests the JSON printed, and --estimate taking only the input
+ */
+static char * test_json() {
+    char *argv[] = { "interp", "--estimate", TEST_FILE2, NULL };
+    char buffer[STR_LENGTH];
+    Logo input;
+    Cost cost;
+    FILE *fp;
+    int programs;
+    size_t len;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    input = load(TEST_FILE2);
+    mu_assert("error, not estimated", estimate(input, &cost, &programs) == 0);
+    free_logo(input);
+    cost.segs.hi = HUGE_VAL;
+    fp = fopen(TEST_JSON, "w");
+    print_estimate(fp, "a \"b\".txt", &cost, programs);
+    fclose(fp);
+    fp = fopen(TEST_JSON, "r");
+    len = fread(buffer, 1, STR_LENGTH - 1, fp);
+    buffer[len] = '\0';
+    fclose(fp);
+    mu_assert("error, wrong JSON", strcmp(buffer, "{\n  \"input\": \"a \\\"b\\\".txt\",\n"
+              "  \"programs\": 1,\n  \"exact\": false,\n"
+              "  \"instructions\": { \"min\": 1801, \"max\": 1801 },\n"
+              "  \"segments\": { \"min\": 450, \"max\": null },\n"
+              "  \"turns\": { \"min\": 450, \"max\": 450 }\n}\n") == 0);
+    mu_assert("error, ret != EXIT_SUCCESS", interp_main(3, argv) == EXIT_SUCCESS);
+    argv[2] = "data/testb_var.txt";
+    mu_assert("error, ret != EXIT_FAILURE", interp_main(3, argv) == EXIT_FAILURE);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_exact);
+    mu_run_test(test_bounds);
+    mu_run_test(test_errors);
+    mu_run_test(test_json);
+    return 0;
+}
+
+/**
+ *  Boilerplate for minunit.h
+ */
+int main(int argc, const char * argv[]) {
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+        return 1;
+    }
+    else {
+        printf("All tests passed\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return 0;
+}
+
+/********************************************
+ Helper Functions
+ ********************************************/
+
+/**
+ *  Scans the file into a Logo, or returns NULL
+ */
+Logo load(char *filename) {
+    FILE *fp = fopen(filename, "r");
+    Logo input;
+    if (fp == NULL) {
+        return NULL;
+    }
+    input = scan_file(fp);
+    fclose(fp);
+    return input;
+}
+
+/**
+ *  Writes the program to TEST_IN
+ */
+int write_program(char *program) {
+    FILE *fp = fopen(TEST_IN, "w");
+    if (fp == NULL) {
+        return -1;
+    }
+    fputs(program, fp);
+    fclose(fp);
+    return 0;
+}
+
+/**
+ *  Runs the program in the file, giving the instructions and segments the
+ *  limits of a run count. Returns 0 on success, -1 on error
+ */
+int run_counts(char *filename, double *insts, double *segs) {
+    char *argv[] = { "interp", "--max-insts=1000000000", NULL };
+    TurtleSeg *buf;
+    TurtleCtx ctx;
+    Options opts;
+    Logo input = load(filename);
+    int ret = 0;
+    buf = (TurtleSeg *) malloc (CHUNK * sizeof(TurtleSeg));
+    if (input == NULL || buf == NULL || get_options(2, argv, &opts) != 1 ||
+        set_budget(input, &opts) < 0 || (ctx = turtle_new(input)) == NULL) {
+        return -1;
+    }
+    while (!turtle_done(ctx) && ret >= 0) {
+        ret = turtle_next(ctx, buf, CHUNK);
+    }
+    *insts = input->budget->insts;
+    *segs = input->budget->segs;
+    turtle_free(ctx);
+    free_logo(input);
+    free(buf);
+    return (ret < 0) ? -1 : 0;
+}
+
+/**
+ *  Returns 1 if v is in the range r, else 0
+ */
+int in_range(Range r, double v) {
+    return r.lo <= v && v <= r.hi;
+}
@@ -190,6 +190,7 @@ Logo create_logo(int count) {
         exit(EXIT_FAILURE);
     }
     input->ofile = ofile;
+    input->out = ob_new(ofile);
     return input;
 }
 
@@ -205,6 +206,7 @@ void insert_line(Logo input, char * line) {
  *  Frees everything
  */
 void tear_down(Logo input) {
+    ob_close(input->out);
     fclose(input->ofile);
     free_logo(input);
 }
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h> /* for access() */
+#include <zlib.h>   /* for reading gzipped output */
 #include "interpreter.h"
 #include "postscript.h"
 #include "minunit.h"
@@ -24,12 +25,19 @@
 #define TEST_EXPECT2    "data/testdata2.ps"     /* these files are used for regression */
 #define TEST_EXPECT3    "data/testdata3.ps"     
 #define TEST_OUT        "testout.ps"            /* out_file used to test the interpreter */
+#define TEST_GZ         "testout.ps.gz"         /* gzipped as it is named .gz */
+#define TEST_OUT2       "testout-2.ps"          /* written without the pipeline to compare */
+#define TEST_IN         "testin.txt"            /* written for a long program */
+#define MANY_OPS        200000                  /* FD and RT in TEST_IN, more than a ring holds */
 #define TEST_BAD_INST   "data/testb_inst.txt"   /* test file with bad instruction */
 #define TEST_BAD_VAR    "data/testb_var.txt"    /* test file with bad var */
 #define TEST_BAD_VRNM   "data/testb_varnum.txt" /* test file with bad varnum */
 #define TEST_BAD_DO     "data/testb_do.txt"     /* test file with bad do */
 #define TEST_BAD_SET    "data/testb_set.txt"    /* test file with bad set */
 #define TEST_BAD_POL    "data/testb_polish.txt" /* test file with division by zero */
+#define TEST_MULTI      "data/testmulti.txt"    /* test file with three programs */
+#define TEST_MINIFIED   "data/testmini.txt"     /* testdata2.txt on one line */
+#define TEST_ZERO       "data/testzero1.txt"    /* test file with a DO going round no times */
 #define STR_LENGTH      5000                    /* used to store expected values to test against TEST_OUT */
 
 /* TODO: main function */
@@ -42,6 +50,7 @@ Logo setup(int count, char * line);
 Logo create_logo(int count);
 void insert_line(Logo input, char * line);
 char * get_content(char * filename);
+char * get_gzipped(char * filename);
 void tear_down(Logo input);
 
 /********************************************
@@ -102,6 +111,17 @@ static char * test_main() {
     free(buffer);
     free(expect);    
 
+    /* free-form programs draw the same, after the header */
+    strcpy(argv[1], TEST_MINIFIED);
+    ret = interp_main(argc, argv);
+    mu_assert("error, ret != 0", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    expect = get_content(TEST_EXPECT2);
+    mu_assert("error, TEST_OUT is not as expected", 
+              strcmp(strchr(buffer, '\n'), strchr(expect, '\n')) == 0);
+    free(buffer);
+    free(expect);    
+
     /* test bad files */
     strcpy(argv[1], TEST_BAD_INST);
     ret = interp_main(argc, argv);
@@ -1007,6 +1027,35 @@ static char * test_stack_funcs() {
     return 0;
 }
 
+/**
+ *  tests scan_mt() against scan_file()
+ */
+static char * test_scan_mt() {
+    Logo expect, input;
+    FILE *file;
+    int i;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    file = fopen(TEST_FILE2, "r");
+    mu_assert("error, cannot open test file", file != NULL);
+    expect = scan_file(file);
+    rewind(file);
+    input = scan_mt(file);
+    fclose(file);
+    mu_assert("error, input->num_lines != expect->num_lines",
+              input->num_lines == expect->num_lines);
+    mu_assert("error, input->counter != 0", input->counter == 0);
+    for (i=0; i<input->num_lines; i++) {
+        mu_assert("error, line differs from scan_file()",
+                  strsame(input->lines[i], expect->lines[i]));
+    }
+    input->vars = NULL;
+    expect->vars = NULL;
+    free_logo(input);
+    free_logo(expect);
+    return 0;
+}
+
 static char * test_get_filename() {
     char **argv;
     char filename[FILENAME_MAX];
@@ -1052,6 +1101,708 @@ static char * test_get_filename() {
     return 0;
 }
 
+/**
+ *  Tests get_options(), numbered_filename() and the --multi modes
+ */
+static char * test_multi() {
+    char *argv[] = { "interp", "--multi", TEST_MULTI, TEST_OUT, NULL };
+    char filename[FILENAME_LENGTH];
+    char *buffer, *p;
+    Options opts;
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* options */
+    ret = get_options(4, argv, &opts);
+    mu_assert("error, ret != 1", ret == 1);
+    mu_assert("error, opts.multi != MULTI_PAGES", opts.multi == MULTI_PAGES);
+    ret = get_options(3, argv + 1, &opts);
+    mu_assert("error, ret != 0", ret == 0);
+    mu_assert("error, opts.multi != MULTI_NONE", opts.multi == MULTI_NONE);
+    argv[1] = "--multi=nope";
+    ret = get_options(4, argv, &opts);
+    mu_assert("error, ret != ARGS_ERR", ret == ARGS_ERR);
+    
+    /* numbered files */
+    numbered_filename("out.ps", 2, filename);
+    mu_assert("error, filename != out-2.ps", strsame(filename, "out-2.ps"));
+    numbered_filename("dir.d/out", 12, filename);
+    mu_assert("error, filename != dir.d/out-12", strsame(filename, "dir.d/out-12"));
+    numbered_filename(".ps", 1, filename);
+    mu_assert("error, filename != .ps-1", strsame(filename, ".ps-1"));
+    
+    /* one page per program */
+    argv[1] = "--multi=pages";
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    for (i=0, p=buffer; (p = strstr(p, "showpage")) != NULL; i++, p++);
+    mu_assert("error, not 3 pages", i == 3);
+    mu_assert("error, page not started",
+              strstr(buffer, "showpage\nnewpath\n200 200 moveto\n90.00 rotate\n") != NULL);
+    free(buffer);
+    
+    /* one file per program */
+    argv[1] = "--multi=files";
+    remove(TEST_OUT);
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    mu_assert("error, TEST_OUT exists", access(TEST_OUT, F_OK) == -1);
+    for (i=1; i<=3; i++) {
+        numbered_filename(TEST_OUT, i, filename);
+        mu_assert("error, numbered output missing", access(filename, F_OK) == 0);
+        buffer = get_content(filename);
+        mu_assert("error, no header", strncmp(buffer, "%!PS-", 5) == 0);
+        mu_assert("error, showpage in file", strstr(buffer, "showpage") == NULL);
+        free(buffer);
+        remove(filename);
+    }
+    
+    /* a single program file still works, and a bad one is removed */
+    argv[2] = TEST_FILE1;
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    numbered_filename(TEST_OUT, 1, filename);
+    remove(filename);
+    argv[1] = "--multi";
+    argv[2] = TEST_BAD_VAR;
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+    mu_assert("error, TEST_OUT exists", access(TEST_OUT, F_OK) == -1);
+    return 0;
+}
+
+/**
+ *  tests merging of drawing operators
+ */
+static char * test_compact() {
+    char *argv[] = { "interp", "--compact", TEST_FILE1, TEST_OUT, NULL };
+    Logo input;
+    Options opts;
+    char *buffer;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = get_options(4, argv, &opts);
+    mu_assert("error, ret != 1", ret == 1);
+    mu_assert("error, opts.compact != 1", opts.compact == 1);
+    
+    input = create_logo(0);
+    ret = ps_backend(input, &opts);
+    mu_assert("error, ret != 0", ret == 0);
+    /* same direction, zero length, turns cancelling and whole turns */
+    ps_ipt_fd(input, 10);
+    ps_ipt_fd(input, 0.004);
+    ps_ipt_fd(input, 5.5);
+    ps_ipt_lt(input, 90);
+    ps_ipt_rt(input, 90);
+    ps_ipt_fd(input, 1);
+    ps_ipt_rt(input, 45);
+    ps_ipt_rt(input, 315);
+    ps_ipt_fd(input, 2);
+    /* going back, then a turn */
+    ps_ipt_fd(input, -3);
+    ps_ipt_lt(input, 30);
+    ps_ipt_lt(input, 200);
+    ps_ipt_fd(input, 4);
+    ps_ipt_rt(input, 10);
+    ps_footer(input);
+    mu_assert("error, ops_in != 14", input->backend->ops_in == 14);
+    mu_assert("error, ops_out != 4", input->backend->ops_out == 4);
+    tear_down(input);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strsame(buffer,
+              "18.50 0 rlineto\n-3.00 0 rlineto\n-130.00 rotate\n"
+              "4.00 0 rlineto\nstroke\n"));
+    free(buffer);
+    
+    /* a whole program gets shorter, TEST_EXPECT1 is 39053 bytes */
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, no header", strncmp(buffer, "%!PS-", 5) == 0);
+    mu_assert("error, not compacted", strlen(buffer) < 30000);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  collects the vertices passed on by the simplifier in test_simplify()
+ */
+static void collect(void *data, double x, double y) {
+    double *pts = (double *) data;
+    int n = (int) pts[0];
+    pts[2 * n + 1] = x;
+    pts[2 * n + 2] = y;
+    pts[0] = n + 1;
+}
+
+/**
+ *  tests simplifying the path
+ */
+static char * test_simplify() {
+    char *argv[] = { "interp", "--simplify=0.5", TEST_FILE1, TEST_OUT, NULL };
+    double pts[2 * (2 * SP_WINDOW + 2) + 1];
+    Simplify sp;
+    Options opts;
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = get_options(4, argv, &opts);
+    mu_assert("error, ret != 1", ret == 1);
+    mu_assert("error, opts.simplify != 0.5", opts.simplify == 0.5);
+    argv[1] = "--simplify=-2";
+    mu_assert("error, ret != ARGS_ERR", get_options(4, argv, &opts) == ARGS_ERR);
+    argv[1] = "--simplify=";
+    mu_assert("error, ret != ARGS_ERR", get_options(4, argv, &opts) == ARGS_ERR);
+    
+    /* wobbles within the tolerance go, corners stay */
+    pts[0] = 0;
+    sp = sp_new(0.5, collect, pts);
+    mu_assert("error, sp == NULL", sp != NULL);
+    sp_start(sp, 0, 0);
+    sp_add(sp, 10, 0.4);
+    sp_add(sp, 20, 0);
+    sp_add(sp, 30, -0.3);
+    sp_add(sp, 40, 0);
+    sp_add(sp, 40, 10);
+    sp_add(sp, 40.4, 20);
+    sp_add(sp, 40, 30);
+    /* going back over the line is kept */
+    sp_add(sp, 40, 25);
+    sp_end(sp);
+    mu_assert("error, not 3 vertices", pts[0] == 3);
+    mu_assert("error, wrong vertex", pts[1] == 40 && pts[2] == 0);
+    mu_assert("error, wrong vertex", pts[3] == 40 && pts[4] == 30);
+    mu_assert("error, wrong vertex", pts[5] == 40 && pts[6] == 25);
+    mu_assert("error, in != 9", sp->in == 9);
+    mu_assert("error, out != 4", sp->out == 4);
+    
+    /* a line longer than the window keeps its end and a vertex per window */
+    pts[0] = 0;
+    sp_start(sp, 0, 0);
+    for (i=1; i<=2 * SP_WINDOW; i++) {
+        sp_add(sp, i, 0);
+    }
+    sp_end(sp);
+    mu_assert("error, too many vertices", pts[0] <= 3);
+    mu_assert("error, wrong end", pts[2 * (int) pts[0] - 1] == 2 * SP_WINDOW);
+    sp_free(sp);
+    
+    /* a whole program */
+    argv[1] = "--simplify=0.5";
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    return 0;
+}
+
+/**
+ *  tests dropping segments drawn before
+ */
+static char * test_dedup() {
+    char *argv[] = { "interp", "--dedup", TEST_FILE1, TEST_OUT, NULL };
+    Dedup dd;
+    Options opts;
+    char *buffer;
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = get_options(4, argv, &opts);
+    mu_assert("error, ret != 1", ret == 1);
+    mu_assert("error, opts.dedup != 1", opts.dedup == 1);
+    
+    dd = dd_new(DD_MAX_BYTES);
+    mu_assert("error, dd == NULL", dd != NULL);
+    mu_assert("error, new segment seen", dd_seen(dd, 0, 0, 100, 0) == 0);
+    mu_assert("error, same segment not seen", dd_seen(dd, 0, 0, 100, 0) == 1);
+    mu_assert("error, reversed segment not seen", dd_seen(dd, 100, 0, 0, 0) == 1);
+    mu_assert("error, -0 not the same as 0", dd_seen(dd, -0.0, 0, 100, -0.0) == 1);
+    mu_assert("error, touching segment seen", dd_seen(dd, 100, 0, 200, 0) == 0);
+    /* growing keeps what is there */
+    for (i=0; i<DD_MIN_SLOTS * 4; i++) {
+        dd_seen(dd, i, 1, i + 1, 1);
+    }
+    mu_assert("error, lost after growing", dd_seen(dd, 0, 0, 100, 0) == 1);
+    mu_assert("error, lost after growing", dd_seen(dd, 7, 1, 8, 1) == 1);
+    dd_clear(dd);
+    mu_assert("error, seen after clearing", dd_seen(dd, 7, 1, 8, 1) == 0);
+    dd_free(dd);
+    
+    /* a table that cannot grow still finds what it has */
+    dd = dd_new(0);
+    for (i=0; i<DD_MIN_SLOTS; i++) {
+        dd_seen(dd, i, 1, i + 1, 1);
+    }
+    mu_assert("error, not full", dd->full == 1);
+    mu_assert("error, lost when full", dd_seen(dd, 0, 1, 1, 1) == 1);
+    mu_assert("error, added when full", dd_seen(dd, DD_MIN_SLOTS - 1, 1, DD_MIN_SLOTS, 1) == 0);
+    dd_free(dd);
+    
+    /* the squares of TEST_FILE1 are mostly drawn over each other */
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, no rmoveto", strstr(buffer, " rmoveto\n") != NULL);
+    mu_assert("error, duplicates not dropped", strlen(buffer) < 1024);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests writing the program itself as postscript
+ */
+static char * test_ps_program() {
+    char *argv[] = { "interp", "--ps-mode=program", TEST_FILE2, TEST_OUT, NULL };
+    Options opts;
+    char *buffer;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = get_options(4, argv, &opts);
+    mu_assert("error, ret != 1", ret == 1);
+    mu_assert("error, opts.mode != MODE_PROGRAM", opts.mode == MODE_PROGRAM);
+    argv[1] = "--ps-mode=nope";
+    mu_assert("error, ret != ARGS_ERR", get_options(4, argv, &opts) == ARGS_ERR);
+    
+    /* loops and variables are written, not unrolled */
+    argv[1] = "--ps-mode=program";
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strsame(buffer,
+              "%!PS-" TEST_FILE2 "\nnewpath\n200 200 moveto\n"
+              "1 1 50 {\n/A exch def\nA 0 rlineto\n-30 rotate\n"
+              "1 1 8 {\n/B exch def\n/C A 5 div def\nC 0 rlineto\n-45 rotate\n"
+              "} for\n} for\nstroke\n"));
+    free(buffer);
+    
+    /* loops over variables go either way, RT of a variable is negated */
+    argv[2] = TEST_FILE1;
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, no range", strstr(buffer, "/range {") != NULL);
+    mu_assert("error, no backwards loop", strstr(buffer, "\n10 -1 -10 {\n") != NULL);
+    mu_assert("error, no loop over variable", strstr(buffer, "\nA 10 range {\n") != NULL);
+    free(buffer);
+    
+    /* a DO that may go round no times is carried on into, so unrolled */
+    argv[2] = TEST_ZERO;
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strsame(buffer,
+              "%!PS-" TEST_ZERO "\nnewpath\n200 200 moveto\n"
+              "-90.00 rotate\n10.00 0 rlineto\n-90.00 rotate\nstroke\n"));
+    free(buffer);
+    
+    /* a program that fails to run writes nothing */
+    argv[2] = TEST_BAD_VAR;
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+    mu_assert("error, TEST_OUT exists", access(TEST_OUT, F_OK) == -1);
+    return 0;
+}
+
+/**
+ *  tests writing the path in page coordinates with its bounding box
+ */
+static char * test_ps_absolute() {
+    char *argv[] = { "interp", "--ps-mode=absolute", TEST_FILE2, TEST_OUT, NULL };
+    char *pages[] = { "interp", "--ps-mode=absolute", "--multi=pages", TEST_MULTI, TEST_OUT, NULL };
+    char *start = "%!PS-" TEST_FILE2 "\n%%BoundingBox: (atend)\nnewpath\n200 200 moveto\n"
+                  "201.00 200.00 lineto\n201.17 199.90 lineto\n";
+    Options opts;
+    char *buffer, *trailer;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = get_options(4, argv, &opts);
+    mu_assert("error, ret != 1", ret == 1);
+    mu_assert("error, opts.mode != MODE_ABSOLUTE", opts.mode == MODE_ABSOLUTE);
+    
+    /* the bounding box is given at the end, once it is known */
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT does not start as expected",
+              strncmp(buffer, start, strlen(start)) == 0);
+    mu_assert("error, relative operator written",
+              strstr(buffer, "rlineto") == NULL && strstr(buffer, "rotate") == NULL);
+    trailer = strstr(buffer, "stroke\n%%Trailer\n");
+    mu_assert("error, no trailer", trailer != NULL);
+    mu_assert("error, bounding box is not as expected",
+              strsame(trailer, "stroke\n%%Trailer\n%%BoundingBox: 105 112 279 295\n"));
+    free(buffer);
+    
+    /* one bounding box for all pages */
+    ret = interp_main(5, pages);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    trailer = strstr(buffer, "%%Trailer\n");
+    mu_assert("error, no trailer", trailer != NULL);
+    mu_assert("error, trailer before last page", strstr(trailer, "showpage") == NULL);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests stroking long paths in pieces
+ */
+static char * test_max_path() {
+    char *argv[] = { "interp", "--max-path=3", TEST_FILE2, TEST_OUT, NULL };
+    char *program[] = { "interp", "--ps-mode=program", "--max-path=3", TEST_FILE2, TEST_OUT, NULL };
+    Options opts;
+    char *buffer, *p;
+    int ret, splits;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = get_options(4, argv, &opts);
+    mu_assert("error, ret != 1", ret == 1);
+    mu_assert("error, opts.max_path != 3", opts.max_path == 3);
+    argv[1] = "--max-path=0";
+    mu_assert("error, ret != ARGS_ERR", get_options(4, argv, &opts) == ARGS_ERR);
+    argv[1] = "--max-path=3x";
+    mu_assert("error, ret != ARGS_ERR", get_options(4, argv, &opts) == ARGS_ERR);
+    
+    /* the 450 rlineto of TEST_FILE2 go in 150 paths, each going on from
+       the end of the last */
+    argv[1] = "--max-path=3";
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, first path is not as expected", strstr(buffer,
+              "200 200 moveto\n1.00 0 rlineto\n-30.00 rotate\n0.20 0 rlineto\n"
+              "-45.00 rotate\n0.20 0 rlineto\ncurrentpoint stroke moveto\n") != NULL);
+    splits = 0;
+    for (p=strstr(buffer, "currentpoint"); p!=NULL; p=strstr(p + 1, "currentpoint")) {
+        splits = splits + 1;
+    }
+    mu_assert("error, splits != 150", splits == 150);
+    free(buffer);
+    
+    /* a program counts its segments as it runs */
+    ret = interp_main(5, program);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, no seg", strstr(buffer, "/seg {") != NULL);
+    mu_assert("error, rlineto not replaced", strstr(buffer, "\nA 0 seg\n") != NULL);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests the buffered writer against fprintf
+ */
+static char * test_outbuf() {
+    float nums[] = { 0, -0.0, 0.005, 0.015, 1.125, -1.125, 2.675, -0.001,
+                     99.995, 1e7, -123456.789, 3e20, 1e-30, 1e30, -3.4e38 };
+    int n = sizeof(nums) / sizeof(*nums);
+    char *expect, *buffer;
+    FILE *ofile;
+    OutBuf out;
+    float f;
+    int i, r;
+    size_t len;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    expect = (char *) malloc (OB_SIZE * 4);
+    len = 0;
+    ofile = fopen(TEST_OUT, "w");
+    out = ob_new(ofile);
+    mu_assert("error, out == NULL", out != NULL);
+    /* chosen values, then enough random ones to flush several times */
+    for (i=0; i<n; i++) {
+        ob_fixed2(out, nums[i]);
+        ob_puts(out, "\n");
+        len = len + sprintf(expect + len, "%.2f\n", nums[i]);
+    }
+    ob_fixed2(out, -1e300);
+    ob_puts(out, "\n");
+    len = len + sprintf(expect + len, "%.2f\n", -1e300);
+    srand(1);
+    while (len < OB_SIZE * 3) {
+        f = (rand() - RAND_MAX / 2) / (float) (1 << (rand() % 24));
+        r = rand() - RAND_MAX / 2;
+        ob_fixed2(out, f);
+        ob_puts(out, " ");
+        ob_int(out, r);
+        ob_puts(out, "\n");
+        len = len + sprintf(expect + len, "%.2f %d\n", f, r);
+    }
+    mu_assert("error, ob_close failed", ob_close(out) == 0);
+    fclose(ofile);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strcmp(buffer, expect) == 0);
+    free(buffer);
+    free(expect);
+    return 0;
+}
+
+/**
+ *  tests that output named .gz, or written with --compress, is gzipped and
+ *  the same once inflated, however many buffers it takes
+ */
+static char * test_compress() {
+    char *argv[] = { "interp", TEST_FILE2, TEST_GZ, NULL };
+    char *argv_level[] = { "interp", "--compress=9", TEST_FILE2, TEST_OUT, NULL };
+    char *expect, *buffer;
+    FILE *ofile;
+    OutBuf out;
+    int ret, i;
+    size_t len;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    expect = get_content(TEST_EXPECT2);
+    ret = interp_main(3, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_GZ);
+    mu_assert("error, not gzipped", (unsigned char) buffer[0] == 0x1f &&
+                                    (unsigned char) buffer[1] == 0x8b);
+    free(buffer);
+    buffer = get_gzipped(TEST_GZ);
+    mu_assert("error, TEST_GZ is not as expected", strcmp(buffer, expect) == 0);
+    free(buffer);
+    ret = interp_main(4, argv_level);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_gzipped(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strcmp(buffer, expect) == 0);
+    free(buffer);
+    free(expect);
+    
+    /* several buffers handed to the compressor, counted as written */
+    expect = (char *) malloc (OB_SIZE * 4);
+    len = 0;
+    ofile = fopen(TEST_OUT, "w");
+    out = ob_new(ofile);
+    mu_assert("error, out == NULL", out != NULL);
+    mu_assert("error, ob_compress failed", ob_compress(out, OB_LEVEL) == 0);
+    for (i=0; len<OB_SIZE*3; i++) {
+        ob_int(out, i);
+        ob_puts(out, "\n");
+        len = len + sprintf(expect + len, "%d\n", i);
+    }
+    mu_assert("error, wrong count", ob_tell(out) == (long long) len);
+    mu_assert("error, ob_close failed", ob_close(out) == 0);
+    fclose(ofile);
+    buffer = get_gzipped(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strcmp(buffer, expect) == 0);
+    free(buffer);
+    free(expect);
+    return 0;
+}
+
+/**
+ *  tests that the output is the same when formatted and written on threads
+ *  of their own, past a full ring and several buffers, in every mode
+ */
+static char * test_pipeline() {
+    char *modes[] = { "--compact", "--ps-mode=absolute", "--dedup", "--simplify=0.5",
+                      "--max-path=100", "--multi=pages" };
+    char *argv[] = { "interp", "--threads=3", NULL, TEST_IN, TEST_OUT, NULL };
+    char *threads[] = { "interp", "--threads=3", TEST_IN, TEST_OUT, NULL };
+    char *plain[] = { "interp", TEST_IN, TEST_OUT, NULL };
+    char *expect, *buffer;
+    Logo input;
+    Options opts;
+    FILE *fp;
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* only on threads when asked for, whatever the cores */
+    for (i=0; i<2; i++) {
+        ret = i ? get_options(3, plain, &opts) : get_options(4, threads, &opts);
+        mu_assert("error, wrong options", ret == 1 - i);
+        input = create_logo(0);
+        mu_assert("error, ret != 0", ps_backend(input, &opts) == 0);
+        mu_assert("error, wrong ring", (input->backend->ring != NULL) == (i == 0));
+        tear_down(input);
+    }
+    
+    fp = fopen(TEST_IN, "w");
+    mu_assert("error, input not written", fp != NULL);
+    fprintf(fp, "{\n    DO A FROM 1 TO %d {\n        FD 1\n        RT A\n    }\n}\n", MANY_OPS / 2);
+    fclose(fp);
+    for (i=0; i<(int)(sizeof(modes)/sizeof(*modes)); i++) {
+        argv[1] = "--threads=1";
+        argv[2] = modes[i];
+        argv[4] = TEST_OUT2;
+        ret = interp_main(5, argv);
+        mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+        argv[1] = "--threads=3";
+        argv[4] = TEST_OUT;
+        ret = interp_main(5, argv);
+        mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+        expect = get_content(TEST_OUT2);
+        buffer = get_content(TEST_OUT);
+        mu_assert("error, not several buffers", i > 0 || strlen(buffer) > 2 * OB_SIZE);
+        mu_assert("error, not the same on threads", strcmp(buffer, expect) == 0);
+        free(expect);
+        free(buffer);
+    }
+    
+    /* the plain output, and a bad program removed once the ring is empty */
+    argv[2] = TEST_FILE1;
+    argv[3] = TEST_OUT;
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    expect = get_content(TEST_EXPECT1);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strcmp(buffer, expect) == 0);
+    free(expect);
+    free(buffer);
+    argv[2] = TEST_BAD_VAR;
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+    mu_assert("error, TEST_OUT exists", access(TEST_OUT, F_OK) == -1);
+    return 0;
+}
+
+/**
+ *  tests that output written through an io_uring, or with pwrite() where
+ *  there is none, is the same, after whatever was written before it
+ */
+static char * test_uring() {
+    char *argv[] = { "interp", "--uring", "--multi=files", TEST_MULTI, TEST_OUT, NULL };
+    char filename[FILENAME_LENGTH];
+    char *expect, *buffer;
+    FILE *ofile;
+    OutBuf out;
+    int ret, i;
+    size_t len;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* a file a program, each the same as without */
+    argv[1] = "--multi=files";
+    argv[2] = "--uring";
+    ret = interp_main(5, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    numbered_filename(TEST_OUT, 2, filename);
+    expect = get_content(filename);
+    argv[1] = "--uring";
+    argv[2] = "--multi=files";
+    ret = interp_main(5, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(filename);
+    mu_assert("error, numbered file is not as expected", strcmp(buffer, expect) == 0);
+    free(buffer);
+    free(expect);
+    for (i=1; i<=3; i++) {
+        numbered_filename(TEST_OUT, i, filename);
+        remove(filename);
+    }
+    
+    /* more buffers than the ring has, after a header written by stdio */
+    expect = (char *) malloc (OB_SIZE * (OB_RING_BUFS + 2));
+    ofile = fopen(TEST_OUT, "w");
+    fputs("%!PS\n", ofile);
+    out = ob_new(ofile);
+    mu_assert("error, out == NULL", out != NULL);
+    ob_puts(out, "newpath\n");
+    ret = ob_uring(out);
+    mu_assert("error, no io_uring or pwrite", ret == 0 || ret == 1);
+    len = sprintf(expect, "%%!PS\nnewpath\n");
+    for (i=0; len<OB_SIZE*(OB_RING_BUFS+1); i++) {
+        ob_int(out, i);
+        ob_puts(out, " rotate\n");
+        len = len + sprintf(expect + len, "%d rotate\n", i);
+    }
+    mu_assert("error, wrong count", ob_tell(out) + 5 == (long long) len);
+    mu_assert("error, ob_close failed", ob_close(out) == 0);
+    fputs("showpage\n", ofile);
+    fclose(ofile);
+    strcpy(expect + len, "showpage\n");
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strcmp(buffer, expect) == 0);
+    free(buffer);
+    free(expect);
+    return 0;
+}
+
+/**
+ *  tests that a run going over one of its limits stops with LIMIT_ERR and
+ *  its output removed, and that one within them is as it was
+ */
+static char * test_limits() {
+    char *limits[] = { "--max-insts=1000", "--max-segments=1000", "--max-time=0.001" };
+    char *argv[] = { "interp", NULL, TEST_IN, TEST_OUT, NULL };
+    char *expect, *buffer;
+    Options opts;
+    Logo input;
+    FILE *fp;
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* an empty loop is counted too */
+    fp = fopen(TEST_IN, "w");
+    mu_assert("error, input not written", fp != NULL);
+    fprintf(fp, "{\n    DO A FROM 1 TO 100000000 {\n        FD 1\n        DO B FROM 1 TO 1000000 {\n"
+                "        }\n    }\n}\n");
+    fclose(fp);
+    for (i=0; i<(int)(sizeof(limits)/sizeof(*limits)); i++) {
+        argv[1] = limits[i];
+        ret = interp_main(4, argv);
+        mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+        mu_assert("error, TEST_OUT exists", access(TEST_OUT, F_OK) == -1);
+    }
+    
+    /* the error code, and the line it stopped on */
+    fp = fopen(TEST_IN, "r");
+    input = scan_file(fp);
+    fclose(fp);
+    input->ofile = fopen(TEST_OUT, "w");
+    input->out = ob_new(input->ofile);
+    argv[1] = "--max-insts=5";
+    mu_assert("error, options not read", get_options(2, argv, &opts) == 1);
+    mu_assert("error, no budget", set_budget(input, &opts) == 0 && input->budget != NULL);
+    mu_assert("error, ret != LIMIT_ERR", parse(input) == LIMIT_ERR);
+    mu_assert("error, wrong count", input->budget->insts == 6 && input->budget->segs == 1);
+    /* going round the empty DO B for the second time */
+    mu_assert("error, wrong line", line_num(input) == 5);
+    ob_close(input->out);
+    fclose(input->ofile);
+    free_logo(input);
+    
+    /* within the limits */
+    argv[1] = "--max-insts=10000";
+    argv[2] = TEST_FILE1;
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    expect = get_content(TEST_EXPECT1);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strcmp(buffer, expect) == 0);
+    free(expect);
+    free(buffer);
+    argv[1] = "--max-memory=0";
+    mu_assert("error, bad limit taken", get_options(2, argv, &opts) == ARGS_ERR);
+    return 0;
+}
+
+/**
+ *  Tests that postscript refuses the options of the other backends
+ */
+static char * test_other_options() {
+    char *argv[] = { "interp", NULL, TEST_FILE1, TEST_OUT, NULL };
+    char *other[] = { "--pyramid", "--plot=gcode", "--scale=4", "--image=png" };
+    Options opts;
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    for (i=0; i<4; i++) {
+        argv[1] = other[i];
+        remove(TEST_OUT);
+        ret = interp_main(4, argv);
+        mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+        mu_assert("error, TEST_OUT exists", access(TEST_OUT, F_OK) == -1);
+    }
+    argv[1] = "--scale=4";
+    mu_assert("error, ret != 1", get_options(4, argv, &opts) == 1);
+    mu_assert("error, --scale not given", opts.given == OPT_SCALE);
+    mu_assert("error, scale taken", backend_takes(&opts, OPT_POSTSCRIPT, "postscript") == ARGS_ERR);
+    mu_assert("error, scale refused", backend_takes(&opts, OPT_RASTER, "raster") == 0);
+    return 0;
+}
+
 static char * all_tests() {
     mu_run_test(test_main);
     mu_run_test(test_parse);
@@ -1068,8 +1819,22 @@ static char * all_tests() {
     mu_run_test(test_operate);
     mu_run_test(test_helpers);
     mu_run_test(test_scan_file);
+    mu_run_test(test_scan_mt);
     mu_run_test(test_stack_funcs);
     mu_run_test(test_get_filename);
+    mu_run_test(test_multi);
+    mu_run_test(test_outbuf);
+    mu_run_test(test_compress);
+    mu_run_test(test_pipeline);
+    mu_run_test(test_uring);
+    mu_run_test(test_limits);
+    mu_run_test(test_compact);
+    mu_run_test(test_simplify);
+    mu_run_test(test_dedup);
+    mu_run_test(test_ps_program);
+    mu_run_test(test_ps_absolute);
+    mu_run_test(test_max_path);
+    mu_run_test(test_other_options);
     return 0;
 }
 
@@ -1116,6 +1881,9 @@ Logo create_logo(int count) {
         input->lines[i] = (char *) malloc (LINE_LENGTH * sizeof(char));
     }
     input->counter = 0;
+    input->line_nums = NULL;
+    input->backend = NULL;
+    input->budget = NULL;
     input->num_lines = 0;
     /* set the varstack */
     input->vars = (VarStack) malloc (VARARY_SIZE * sizeof(struct _varstack));
@@ -1130,6 +1898,7 @@ Logo create_logo(int count) {
         exit(EXIT_FAILURE);
     }
     input->ofile = ofile;
+    input->out = ob_new(ofile);
     return input;
 }
 
@@ -1166,10 +1935,35 @@ char * get_content(char * filename) {
     return buffer;
 }
 
+/**
+ *  Reads a gzipped file into a string and returns it
+ */
+char * get_gzipped(char * filename) {
+    size_t cap = OB_SIZE, len = 0;
+    char *buffer = (char *) malloc (cap + 1);
+    gzFile file = gzopen(filename, "rb");
+    int n;
+    if (file == NULL) {
+        fprintf(stderr, "Error: cannot open file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    while ((n = gzread(file, buffer + len, (unsigned) (cap - len))) > 0) {
+        len = len + n;
+        if (len == cap) {
+            cap = 2 * cap;
+            buffer = (char *) realloc (buffer, cap + 1);
+        }
+    }
+    gzclose(file);
+    buffer[len] = '\0';
+    return buffer;
+}
+
 /*
  *  Frees everything
  */
 void tear_down(Logo input) {
+    ob_close(input->out);
     fclose(input->ofile);
     free_logo(input);
 }
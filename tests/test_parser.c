@@ -12,6 +12,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include "parser.h"
+#include "mtscan.h"
+#include "dfa.h"
+#include "linescan.h"
+#include "tokens.h"
 #include "minunit.h"
 
 #define TEST_FILE1      "data/testdata1.txt"    /* file used to test scan_file() */
@@ -23,6 +27,7 @@
 #define TEST_BAD_VRNM   "data/testb_varnum.txt" /* test file with bad instruction */
 #define TEST_BAD_DO     "data/testb_do.txt"     /* test file with bad do */
 #define TEST_BAD_SET    "data/testb_set.txt"    /* test file with bad instruction */
+#define TEST_THREADS    4                       /* threads used to test mt_scan() and dfa_validate() */
 
 /* used by minunit.h */
 int tests_run = 0;
@@ -664,6 +669,277 @@ static char * test_scan_file() {
     return 0;
 }
 
+/**
+ *  Tests mt_scan() against tok_normalise()
+ */
+static char * test_mt_scan() {
+    char *buffer, *text, *p, **lines;
+    int *line_nums, *expect_nums;
+    int i, num_lines, expect_lines;
+    size_t size, text_size;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* free-form instructions over many threads, some running on past where
+       a chunk is split and some not, without a newline at the end */
+    buffer = (char *) calloc (40 * 64, sizeof(char));
+    strcat(buffer, "{");
+    for (i=0; i<40; i++) {
+        strcat(buffer, (i % 3 == 0) ? "\n  FD 30\t\nDO A FROM 1 TO\n8 {\n" : "\nSET A := 1\n2 + ;\n}  RT\n4");
+        strcat(buffer, (i % 3 == 0) ? "}" : "\n");
+    }
+    strcat(buffer, "}");
+    size = strlen(buffer);
+    text = tok_normalise(buffer, size, &text_size, &expect_nums, &expect_lines);
+    lines = mt_scan(buffer, size, TEST_THREADS, &num_lines, &line_nums);
+    mu_assert("error, lines == NULL", lines != NULL);
+    mu_assert("error, num_lines != tok_normalise() lines + 1", num_lines == expect_lines + 1);
+    for (i=0, p=text; i<expect_lines; i++) {
+        mu_assert("error, line differs from tok_normalise()",
+                  strncmp(lines[i], p, strlen(lines[i])) == 0 && p[strlen(lines[i])] == '\n');
+        mu_assert("error, wrong line number", line_nums[i] == expect_nums[i]);
+        p = p + strlen(lines[i]) + 1;
+    }
+    /* and the empty line at the end */
+    mu_assert("error, last line not empty", lines[i][0] == '\0');
+    mu_assert("error, wrong last line number", line_nums[i] == expect_nums[i]);
+    free_lines(lines, num_lines);
+    free(line_nums);
+    free(text);
+    free(expect_nums);
+    
+    /* an instruction too long for a line in the middle */
+    strcpy(buffer + size / 2, " SET A :=");
+    for (i=0; i<LINE_LENGTH / 2; i++) {
+        strcat(buffer, " 1");
+    }
+    strcat(buffer, " ;\n}\n");
+    lines = mt_scan(buffer, strlen(buffer), TEST_THREADS, &num_lines, &line_nums);
+    mu_assert("error, long instruction broken up", lines == NULL && num_lines == TOK_TOO_LONG);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  Tests tok_normalise()
+ */
+static char * test_tok_normalise() {
+    char *buffer, *text, *expect;
+    TokReader reader;
+    int *line_nums;
+    int num_lines;
+    size_t size;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* a minified program */
+    buffer = "{FD 30 LT\t45 DO A FROM 1 TO 8{RT A}SET B := 1 2\n+ ; }";
+    text = tok_normalise(buffer, strlen(buffer), &size, &line_nums, &num_lines);
+    mu_assert("error, text == NULL", text != NULL);
+    expect = "{\nFD 30\nLT 45\nDO A FROM 1 TO 8 {\nRT A\n}\nSET B := 1 2 + ;\n}\n";
+    mu_assert("error, wrong text", size == strlen(expect) && strncmp(text, expect, size) == 0);
+    mu_assert("error, num_lines != 8", num_lines == 8);
+    mu_assert("error, wrong line numbers", line_nums[6] == 1 && line_nums[7] == 2);
+    /* the empty line after the end */
+    mu_assert("error, wrong last line number", line_nums[8] == 3);
+    free(text);
+    free(line_nums);
+    
+    /* a <POLISH> without ";" stops at the next instruction */
+    buffer = "{\nSET A := 1 2 +\nFD 30\n}\n";
+    text = tok_normalise(buffer, strlen(buffer), &size, &line_nums, &num_lines);
+    mu_assert("error, wrong text", size == strlen(buffer) && strncmp(text, buffer, size) == 0);
+    mu_assert("error, wrong last line number", line_nums[num_lines] == 5);
+    free(text);
+    free(line_nums);
+    
+    /* nothing at all */
+    text = tok_normalise("", 0, &size, &line_nums, &num_lines);
+    mu_assert("error, not empty", size == 0 && num_lines == 0 && line_nums[0] == 1);
+    free(text);
+    free(line_nums);
+    
+    /* an instruction fits with its newline in what fgets() reads, and is
+       an error rather than broken up if longer */
+    buffer = (char *) calloc (LINE_LENGTH * 2, sizeof(char));
+    strcpy(buffer, "{\nSET A :=");
+    while (strlen(buffer) < LINE_LENGTH - 2) {
+        strcat(buffer, " 1");
+    }
+    strcat(buffer, " ;\n}\n");
+    text = tok_normalise(buffer, strlen(buffer), &size, &line_nums, &num_lines);
+    mu_assert("error, text == NULL", text != NULL && num_lines == 3);
+    free(text);
+    free(line_nums);
+    strcpy(buffer + strlen(buffer) - 5, " 1 ;\n}\n");
+    text = tok_normalise(buffer, strlen(buffer), &size, &line_nums, &num_lines);
+    mu_assert("error, long instruction broken up", text == NULL && num_lines == TOK_TOO_LONG);
+    free(buffer);
+    
+    /* tok_next() leaves an instruction written out as usual in the input */
+    buffer = "{\nDO A FROM 1 TO 8 {\nRT  A\n}";
+    tok_start(&reader, buffer, strlen(buffer));
+    mu_assert("error, no instruction", tok_next(&reader) == 1 && tok_next(&reader) == 1);
+    mu_assert("error, copied", reader.inst == buffer + 2 && reader.len == 18 && reader.first == 2);
+    mu_assert("error, no instruction", tok_next(&reader) == 1);
+    mu_assert("error, not copied", reader.inst == reader.text && strncmp(reader.text, "RT A", 4) == 0);
+    mu_assert("error, wrong end", tok_next(&reader) == 1 && tok_next(&reader) == 0 && reader.first == 5);
+    return 0;
+}
+
+/**
+ *  Tests the vectorised scanning in linescan.c against the ctype functions
+ */
+static char * test_linescan() {
+    char buffer[200];
+    const char *p, *q;
+    LineView view;
+    int i, j;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* every whitespace char, and some that are nearly */
+    for (i=0; i<(int) sizeof(buffer); i++) {
+        buffer[i] = " \t\n\v\f\r\b\x0e\x1f!x\x80"[(i * 7 + i / 13) % 12];
+    }
+    /* from every start to every end */
+    for (i=0; i<(int) sizeof(buffer); i++) {
+        for (j=i; j<=(int) sizeof(buffer); j++) {
+            p = buffer + i;
+            while (p < buffer + j && *p != '\n') {
+                p = p + 1;
+            }
+            mu_assert("error, wrong newline", ls_find_newline(buffer + i, buffer + j) == p);
+            p = buffer + i;
+            while (p < buffer + j && isspace((unsigned char) *p)) {
+                p = p + 1;
+            }
+            mu_assert("error, wrong skip", ls_skip_space(buffer + i, buffer + j) == p);
+            q = buffer + j;
+            while (q > buffer + i && isspace((unsigned char) *(q-1))) {
+                q = q - 1;
+            }
+            mu_assert("error, wrong trim", ls_trim_end(buffer + i, buffer + j) == q);
+        }
+    }
+    
+    /* trimmed line views, split like fgets() */
+    strcpy(buffer, "  \tFD 30 \r\n\nSET A := 1 ;");
+    p = ls_next_line(buffer, buffer + strlen(buffer), 127, &view);
+    mu_assert("error, wrong line", view.len == 5 && strncmp(view.start, "FD 30", 5) == 0);
+    p = ls_next_line(p, buffer + strlen(buffer), 127, &view);
+    mu_assert("error, line not empty", view.len == 0);
+    p = ls_next_line(p, buffer + strlen(buffer), 4, &view);
+    mu_assert("error, line not split", view.len == 3 && strncmp(view.start, "SET", 3) == 0);
+    mu_assert("error, wrong next line", p == strstr(buffer, "A :="));
+    return 0;
+}
+
+/**
+ *  Returns the class of the string line according to dfa_line()
+ */
+static int dfa_class(char * line, DfaError *err) {
+    return dfa_line(line, line + strlen(line), err);
+}
+
+/**
+ *  Tests dfa_line()
+ */
+static char * test_dfa_line() {
+    DfaError err;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    dfa_init();
+    mu_assert("error, not CLS_EMPTY", dfa_class(" \t\n", &err) == CLS_EMPTY);
+    mu_assert("error, not CLS_OPEN", dfa_class("  {\n", &err) == CLS_OPEN);
+    mu_assert("error, not CLS_CLOSE", dfa_class("}", &err) == CLS_CLOSE);
+    mu_assert("error, not CLS_INST", dfa_class("FD 30", &err) == CLS_INST);
+    mu_assert("error, not CLS_INST", dfa_class("LT A", &err) == CLS_INST);
+    mu_assert("error, not CLS_INST", dfa_class("RT -2.5 junk", &err) == CLS_INST);
+    mu_assert("error, not CLS_INST", dfa_class("SET A := 3 2 + ;", &err) == CLS_INST);
+    mu_assert("error, not CLS_BLOCK", dfa_class("DO A FROM 1 TO B {", &err) == CLS_BLOCK);
+    mu_assert("error, not CLS_BLOCK", dfa_class("DO A FROM 1 TO B {{", &err) == CLS_BLOCK);
+    
+    /* each error is the one parser.c would report */
+    mu_assert("error, not DFA_E_OPERAND",
+              dfa_class("FD", &err) == CLS_BAD && err.kind == DFA_E_OPERAND);
+    mu_assert("error, not DFA_E_VARNUM",
+              dfa_class("FD ABC", &err) == CLS_BAD && err.kind == DFA_E_VARNUM);
+    mu_assert("error, wrong token", err.tok_len == 3 && strncmp(err.tok, "ABC", 3) == 0);
+    mu_assert("error, not DFA_E_INST",
+              dfa_class("FDX 30", &err) == CLS_BAD && err.kind == DFA_E_INST);
+    mu_assert("error, not DFA_E_SET",
+              dfa_class("SET A =: 3 ;", &err) == CLS_BAD && err.kind == DFA_E_SET);
+    mu_assert("error, not DFA_E_SET",
+              dfa_class("SETA A := 3 ;", &err) == CLS_BAD && err.kind == DFA_E_SET);
+    mu_assert("error, not DFA_E_VAR",
+              dfa_class("SET AB := 3 ;", &err) == CLS_BAD && err.kind == DFA_E_VAR);
+    mu_assert("error, not DFA_E_POLISH",
+              dfa_class("SET A := 3 2 +", &err) == CLS_BAD && err.kind == DFA_E_POLISH);
+    mu_assert("error, not DFA_E_VARNUM",
+              dfa_class("SET A := 3 2 % ;", &err) == CLS_BAD && err.kind == DFA_E_VARNUM);
+    mu_assert("error, not DFA_E_DO",
+              dfa_class("DO A FROM 1 TO 8", &err) == CLS_BAD && err.kind == DFA_E_DO);
+    mu_assert("error, not DFA_E_VAR",
+              dfa_class("DO AB FROM 1 TO 8 {", &err) == CLS_BAD && err.kind == DFA_E_VAR);
+    mu_assert("error, not DFA_E_VARNUM",
+              dfa_class("DO A FROM 1 TO X8 {", &err) == CLS_BAD && err.kind == DFA_E_VARNUM);
+    return 0;
+}
+
+/**
+ *  Tests dfa_validate()
+ */
+static char * test_dfa_validate() {
+    char *files[] = { TEST_FILE1, TEST_FILE2, TEST_FILE3 };
+    char *bad_files[] = { TEST_BAD_INST, TEST_BAD_VAR, TEST_BAD_VRNM, TEST_BAD_DO, TEST_BAD_SET };
+    char *buffer;
+    FILE *file;
+    size_t size;
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* the good files pass */
+    for (i=0; i<3; i++) {
+        file = fopen(files[i], "r");
+        mu_assert("error, cannot open test file\n", file != NULL);
+        buffer = map_file(file, &size);
+        fclose(file);
+        mu_assert("error, cannot map test file\n", buffer != NULL);
+        ret = dfa_validate(buffer, size, TEST_THREADS);
+        mu_assert("error, ret != 0", ret == 0);
+        unmap_file(buffer, size);
+    }
+    /* and the bad ones fail */
+    for (i=0; i<5; i++) {
+        file = fopen(bad_files[i], "r");
+        mu_assert("error, cannot open test file\n", file != NULL);
+        buffer = map_file(file, &size);
+        fclose(file);
+        mu_assert("error, cannot map test file\n", buffer != NULL);
+        ret = dfa_validate(buffer, size, TEST_THREADS);
+        mu_assert("error, ret != PARSE_ERR", ret == PARSE_ERR);
+        unmap_file(buffer, size);
+    }
+    
+    /* unbalanced brackets */
+    buffer = "{\nDO A FROM 1 TO 8 {\nFD 30\n}\n";
+    ret = dfa_validate(buffer, strlen(buffer), TEST_THREADS);
+    mu_assert("error, ret != PARSE_ERR", ret == PARSE_ERR);
+    buffer = "{\nDO A FROM 1 TO 8 {\nFD 30\n}\n}\n";
+    ret = dfa_validate(buffer, strlen(buffer), TEST_THREADS);
+    mu_assert("error, ret != 0", ret == 0);
+    /* junk after the closing bracket */
+    buffer = "{\nFD 30\n}\n\nFD 30\n";
+    ret = dfa_validate(buffer, strlen(buffer), TEST_THREADS);
+    mu_assert("error, ret != PARSE_ERR", ret == PARSE_ERR);
+    /* free-form programs, read in place */
+    buffer = "{FD 30 DO A FROM 1 TO 8{RT A}SET B := 1\n2 + ;\n}";
+    ret = dfa_validate(buffer, strlen(buffer), TEST_THREADS);
+    mu_assert("error, ret != 0", ret == 0);
+    buffer = "{\nFD 30\n}\n}";
+    ret = dfa_validate(buffer, strlen(buffer), TEST_THREADS);
+    mu_assert("error, ret != PARSE_ERR", ret == PARSE_ERR);
+    return 0;
+}
+
 static char * test_get_filename() {
     char **argv;
     char filename[FILENAME_MAX];
@@ -716,6 +992,11 @@ static char * all_tests() {
     mu_run_test(test_polish);
     mu_run_test(test_helpers);
     mu_run_test(test_scan_file);
+    mu_run_test(test_mt_scan);
+    mu_run_test(test_linescan);
+    mu_run_test(test_tok_normalise);
+    mu_run_test(test_dfa_line);
+    mu_run_test(test_dfa_validate);
     mu_run_test(test_get_filename);
     return 0;
 }
@@ -762,6 +1043,7 @@ Logo create_logo(int count) {
         input->lines[i] = (char *) malloc (LINE_LENGTH * sizeof(char));
     }
     input->counter = 0;
+    input->line_nums = NULL;
     input->num_lines = 0;
     return input;
 }
@@ -0,0 +1,221 @@
+/*
+ *  test_pdf.c
+ *  Tests the pdf backend
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interpreter.h"
+#include "pdf.h"
+#include "minunit.h"
+
+#define TEST_FILE1      "data/testdata1.txt"
+#define TEST_MULTI      "data/testmulti.txt"    /* test file with three programs */
+#define TEST_OUT        "testout.pdf"           /* out_file used to test the backend */
+#define TEST_INFLATED   (1 << 16)               /* room for an inflated content stream */
+#define TEST_IN         "testin.txt"            /* written for the program below */
+
+/* used by minunit.h */
+int tests_run = 0;
+
+/* helper functions */
+char * get_content(char * filename, long *size);
+char * find(char *buf, long size, char *s);
+int check_xref(char *buf, long size);
+char * inflate_stream(char *buf, long size, int page);
+
+/**
+ *  tests a single page, its content and that the objects are where the
+ *  cross-reference table says they are
+ */
+static char * test_single() {
+    char *argv[] = { "interp", TEST_FILE1, TEST_OUT, NULL };
+    char *buffer, *content;
+    long size;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(3, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT, &size);
+    mu_assert("error, no header", strncmp(buffer, "%PDF-1.4\n", 9) == 0);
+    mu_assert("error, no end", strcmp(buffer + size - 6, "%%EOF\n") == 0);
+    mu_assert("error, objects are not where expected", check_xref(buffer, size) == 6);
+    mu_assert("error, not one page", find(buffer, size, "/Kids [3 0 R] /Count 1 >>") != NULL);
+    content = inflate_stream(buffer, size, 0);
+    mu_assert("error, content not inflated", content != NULL);
+    mu_assert("error, content does not start as expected", strncmp(content,
+              "1 0 0 1 200 200 cm\n0 0 m\n30 0 l\n51.21 21.21 l\n81.21 21.21 l\n", 59) == 0);
+    mu_assert("error, path not stroked", strcmp(content + strlen(content) - 2, "S\n") == 0);
+    free(content);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that each program of a multi-program input is a page
+ */
+static char * test_pages() {
+    char *argv[] = { "interp", "--multi", TEST_MULTI, TEST_OUT, NULL };
+    char *buffer, *content;
+    long size;
+    int ret, i;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT, &size);
+    mu_assert("error, objects are not where expected", check_xref(buffer, size) == 12);
+    mu_assert("error, not three pages",
+              find(buffer, size, "/Kids [3 0 R 6 0 R 9 0 R] /Count 3 >>") != NULL);
+    for (i=0; i<3; i++) {
+        content = inflate_stream(buffer, size, i);
+        mu_assert("error, content not inflated", content != NULL);
+        mu_assert("error, page does not start at the turtle",
+                  strncmp(content, "1 0 0 1 200 200 cm\n0 0 m\n", 25) == 0);
+        free(content);
+    }
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that points too far to round into hundredths are written in full
+ */
+static char * test_far() {
+    char *argv[] = { "interp", TEST_IN, TEST_OUT, NULL };
+    char *buffer, *content;
+    long size;
+    FILE *fp;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    fp = fopen(TEST_IN, "w");
+    mu_assert("error, input not written", fp != NULL);
+    fputs("{\nSET A := 10000000000 10000000000 * 10000000000 * ;\nFD A\nLT 90\nFD A\n}\n", fp);
+    fclose(fp);
+    mu_assert("error, ret != EXIT_SUCCESS", interp_main(3, argv) == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT, &size);
+    mu_assert("error, objects are not where expected", check_xref(buffer, size) == 6);
+    content = inflate_stream(buffer, size, 0);
+    mu_assert("error, content not inflated", content != NULL);
+    mu_assert("error, far points not written in full", strcmp(content,
+              "1 0 0 1 200 200 cm\n0 0 m\n1000000015047466219876688855040.00 0.00 l\n"
+              "1000000015047466219876688855040.00 1000000015047466219876688855040.00 l\nS\n") == 0);
+    free(content);
+    free(buffer);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_single);
+    mu_run_test(test_pages);
+    mu_run_test(test_far);
+    return 0;
+}
+
+/**
+ *  Boilerplate for minunit.h
+ */
+int main(int argc, const char * argv[]) {
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+        return 1;
+    }
+    else {
+        printf("All tests passed\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return 0;
+}
+
+/********************************************
+ Helper Functions
+ ********************************************/
+
+/**
+ *  Returns the content of filename and its size in *size. It must be freed.
+ */
+char * get_content(char * filename, long *size) {
+    char * buffer;
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: cannot open file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    fseek (file, 0, SEEK_END);
+    *size = ftell (file);
+    rewind(file);
+    buffer = (char *) calloc (*size + 1, sizeof(char));
+    fread(buffer, 1, *size, file);
+    fclose(file);
+    return buffer;
+}
+
+/**
+ *  Returns the first s in the size bytes of buf, which may hold zeros, or
+ *  NULL if there is none
+ */
+char * find(char *buf, long size, char *s) {
+    long i, n = strlen(s);
+    for (i=0; i+n<=size; i++) {
+        if (memcmp(buf + i, s, n) == 0) {
+            return buf + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ *  Returns the number of entries in the cross-reference table if every
+ *  object starts where it says, else -1
+ */
+int check_xref(char *buf, long size) {
+    char obj[32];
+    char *xref = find(buf, size, "startxref\n");
+    long long pos, off;
+    int n, i;
+    if (xref == NULL || sscanf(xref, "startxref\n%lld", &pos) != 1 ||
+        strncmp(buf + pos, "xref\n0 ", 7) != 0 || sscanf(buf + pos + 7, "%d", &n) != 1) {
+        return -1;
+    }
+    xref = strchr(buf + pos + 7, '\n') + 1;
+    for (i=1; i<n; i++) {
+        sscanf(xref + 20 * i, "%lld", &off);
+        sprintf(obj, "%d 0 obj\n", i);
+        if (strncmp(buf + off, obj, strlen(obj)) != 0) {
+            return -1;
+        }
+    }
+    return n;
+}
+
+/**
+ *  Returns the inflated content stream of the page, or NULL if it cannot be
+ *  found or inflated. It must be freed.
+ */
+char * inflate_stream(char *buf, long size, int page) {
+    char obj[64], *p, *len;
+    uLongf out_size = TEST_INFLATED;
+    char *out;
+    long n;
+    sprintf(obj, "%d 0 obj\n<< /Length %d 0 R", 4 + 3 * page, 5 + 3 * page);
+    p = find(buf, size, obj);
+    sprintf(obj, "\n%d 0 obj\n", 5 + 3 * page);
+    len = find(buf, size, obj);
+    if (p == NULL || len == NULL || sscanf(len + strlen(obj), "%ld", &n) != 1) {
+        return NULL;
+    }
+    p = strstr(p, "stream\n") + 7;
+    out = (char *) calloc (TEST_INFLATED + 1, 1);
+    if (uncompress((Bytef *) out, &out_size, (Bytef *) p, n) != Z_OK) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
@@ -0,0 +1,185 @@
+/*
+ *  test_plot.c
+ *  Tests the plot backend
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interpreter.h"
+#include "plot.h"
+#include "minunit.h"
+
+#define TEST_FILE1      "data/testdata1.txt"
+#define TEST_PLOT       "data/testplot.txt"     /* spokes drawn out and back, twice over */
+#define TEST_MULTI      "data/testmulti.txt"    /* test file with three programs */
+#define TEST_HPGL       "testout.hpgl"          /* out_files used to test the backend */
+#define TEST_GCODE      "testout.gcode"
+#define SPOKES          8
+#define SPOKE_LENGTH    100
+
+/* used by minunit.h */
+int tests_run = 0;
+
+/* helper functions */
+char * get_content(char * filename);
+double hpgl_travel(char *hpgl, long *segments);
+
+/**
+ *  tests that the hpgl starts where the turtle starts and ends with the pen
+ *  put away
+ */
+static char * test_hpgl() {
+    char *argv[] = { "interp", TEST_FILE1, TEST_HPGL, NULL };
+    char *buffer;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(3, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_HPGL);
+    /* 200 points is 2822.2 plotter units, and FD 30 another 423.3 */
+    mu_assert("error, wrong start", strncmp(buffer, "IN;SP1;\nPU2822,2822;\nPD3246,2822,", 33) == 0);
+    mu_assert("error, pen not put away", strcmp(buffer + strlen(buffer) - 8, "PU;SP0;\n") == 0);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that each spoke is plotted once, and in an order with much less
+ *  pen up travel than going back to the middle after each
+ */
+static char * test_order() {
+    char *argv[] = { "interp", "--plot=hpgl", TEST_PLOT, TEST_HPGL, NULL };
+    char *buffer;
+    double drawn, travel;
+    long segments;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_HPGL);
+    travel = hpgl_travel(buffer, &segments);
+    mu_assert("error, spokes not plotted once", segments == SPOKES);
+    /* to the middle, then back to it from the end of each spoke but the last */
+    drawn = (PLOT_START_X * sqrt(2) + (SPOKES - 1) * SPOKE_LENGTH) * PLOT_HPGL_UNIT;
+    mu_assert("error, travel not halved", travel * 2 < drawn);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests the g-code of the same spokes
+ */
+static char * test_gcode() {
+    char *argv[] = { "interp", "--plot=gcode", TEST_PLOT, TEST_GCODE, NULL };
+    char *buffer, *p;
+    int ret, lines;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_GCODE);
+    mu_assert("error, not in mm", strncmp(buffer, "G21\nG90\nG0 Z" PLOT_Z_UP "\n", 13) == 0);
+    mu_assert("error, no end", strcmp(buffer + strlen(buffer) - 3, "M2\n") == 0);
+    for (p=buffer, lines=0; (p = strstr(p, "G1 X")) != NULL; p++, lines++);
+    mu_assert("error, spokes not plotted once", lines == SPOKES);
+    /* the middle of the spokes, at 200 points */
+    mu_assert("error, wrong middle", strstr(buffer, "X70.56 Y70.56\n") != NULL);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that a plot is refused more than one page
+ */
+static char * test_pages() {
+    char *argv[] = { "interp", "--multi=pages", TEST_MULTI, TEST_HPGL, NULL };
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_hpgl);
+    mu_run_test(test_order);
+    mu_run_test(test_gcode);
+    mu_run_test(test_pages);
+    return 0;
+}
+
+/**
+ *  Boilerplate for minunit.h
+ */
+int main(int argc, const char * argv[]) {
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+        return 1;
+    }
+    else {
+        printf("All tests passed\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return 0;
+}
+
+/********************************************
+ Helper Functions
+ ********************************************/
+
+/**
+ *  Returns the whole content of the file as a string
+ */
+char * get_content(char * filename) {
+    long lSize;
+    char * buffer;
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: cannot open file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    fseek (file, 0, SEEK_END);
+    lSize = ftell (file);
+    rewind(file);
+    buffer = (char *) calloc (lSize + 1, sizeof(char));
+    fread(buffer, 1, lSize, file);
+    fclose(file);
+    return buffer;
+}
+
+/**
+ *  Returns the distance the pen moves up in the hpgl, from the corner of
+ *  the page, and counts the segments it draws into segments
+ */
+double hpgl_travel(char *hpgl, long *segments) {
+    double travel = 0, cx = 0, cy = 0, x, y;
+    char *p = hpgl, *end;
+    int down;
+    *segments = 0;
+    while ((p = strstr(p, "P")) != NULL) {
+        down = (p[1] == 'D');
+        p = p + 2;
+        while ((x = strtod(p, &end)), end != p && *end == ',') {
+            y = strtod(end + 1, &end);
+            if (down) {
+                *segments = *segments + 1;
+            } else {
+                travel = travel + sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
+            }
+            cx = x;
+            cy = y;
+            p = (*end == ',') ? end + 1 : end;
+        }
+    }
+    return travel;
+}
@@ -0,0 +1,261 @@
+/*
+ *  test_raster.c
+ *  Tests the raster backend
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interpreter.h"
+#include "raster.h"
+#include "minunit.h"
+
+#define TEST_FILE1      "data/testdata1.txt"
+#define TEST_FILE2      "data/testdata2.txt"
+#define TEST_MULTI      "data/testmulti.txt"    /* test file with three programs */
+#define TEST_PPM        "testout.ppm"           /* out_files used to test the backend */
+#define TEST_PNG        "testout.png"
+#define TEST_PPM2       "testout-2.ppm"
+#define TEST_JSON       "testout.json"          /* manifest of a pyramid */
+#define TEST_TILES      "testout_files"         /* and its tiles */
+#define PPM_HEADER      "P6\n612 792\n255\n"
+#define PIXELS          (RASTER_WIDTH * RASTER_HEIGHT)
+
+/* used by minunit.h */
+int tests_run = 0;
+
+/* helper functions */
+unsigned char * get_content(char * filename, long *size);
+unsigned long get_word(unsigned char *p);
+unsigned char * png_pixels(unsigned char *png, long size);
+
+/**
+ *  tests the ppm of the first line drawn, which lies between two rows of
+ *  pixels and so is shared between them
+ */
+static char * test_ppm() {
+    char *argv[] = { "interp", "--image=ppm", TEST_FILE1, TEST_PPM, NULL };
+    unsigned char *buffer, *grey;
+    long size;
+    int ret, row;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_PPM, &size);
+    mu_assert("error, no ppm header", strncmp((char *) buffer, PPM_HEADER, strlen(PPM_HEADER)) == 0);
+    mu_assert("error, not a pixel per byte", size == strlen(PPM_HEADER) + 3 * PIXELS);
+    grey = buffer + strlen(PPM_HEADER);
+    /* FD 30 from the start, along the line between rows 591 and 592 */
+    row = RASTER_HEIGHT - RASTER_START_Y;
+    mu_assert("error, not grey", grey[3 * (row * RASTER_WIDTH + 200)] == 127);
+    mu_assert("error, not grey", grey[3 * (row * RASTER_WIDTH + 215)] == 127);
+    mu_assert("error, not grey", grey[3 * ((row - 1) * RASTER_WIDTH + 215)] == 128);
+    mu_assert("error, not grey", grey[3 * ((row - 1) * RASTER_WIDTH + 215) + 2] == 128);
+    mu_assert("error, not white before the line", grey[3 * (row * RASTER_WIDTH + 199)] == 255);
+    mu_assert("error, not white", grey[3 * ((row + 1) * RASTER_WIDTH + 215)] == 255);
+    mu_assert("error, not white", grey[0] == 255);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that the png is well formed and holds the same image as the ppm
+ */
+static char * test_png() {
+    char *ppm[] = { "interp", "--image=ppm", TEST_FILE1, TEST_PPM, NULL };
+    char *png[] = { "interp", TEST_FILE1, TEST_PNG, NULL };
+    unsigned char *buffer, *expect, *pixels;
+    long size, expect_size;
+    int ret, i;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(4, ppm);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    ret = interp_main(3, png);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_PNG, &size);
+    expect = get_content(TEST_PPM, &expect_size);
+    mu_assert("error, no png signature", memcmp(buffer, "\x89PNG\r\n\x1a\n", 8) == 0);
+    mu_assert("error, no IHDR", memcmp(buffer + 12, "IHDR", 4) == 0);
+    mu_assert("error, wrong size", get_word(buffer + 16) == RASTER_WIDTH &&
+                                   get_word(buffer + 20) == RASTER_HEIGHT);
+    mu_assert("error, no IEND", memcmp(buffer + size - 12, "\0\0\0\0IEND\xae\x42\x60\x82", 12) == 0);
+    pixels = png_pixels(buffer, size);
+    mu_assert("error, image data not inflated", pixels != NULL);
+    for (i=0; i<PIXELS && pixels[i] == expect[strlen(PPM_HEADER) + 3 * i]; i++);
+    mu_assert("error, png differs from ppm", i == PIXELS);
+    free(pixels);
+    free(expect);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that a scaled image is drawn the same whatever the number of
+ *  threads drawing its tiles
+ */
+static char * test_tiles() {
+    char *one[] = { "interp", "--image=ppm", "--scale=3", "--threads=1", TEST_FILE2, TEST_PPM, NULL };
+    char *many[] = { "interp", "--image=ppm", "--scale=3", "--threads=7", TEST_FILE2, TEST_PPM2, NULL };
+    unsigned char *buffer, *expect;
+    long size, expect_size;
+    int ret, inked, i;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(6, one);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    ret = interp_main(6, many);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    expect = get_content(TEST_PPM, &expect_size);
+    buffer = get_content(TEST_PPM2, &size);
+    mu_assert("error, not scaled", strncmp((char *) expect, "P6\n1836 2376\n255\n", 17) == 0);
+    mu_assert("error, images differ", size == expect_size && memcmp(buffer, expect, size) == 0);
+    /* lines cross tiles, so some are inked on both sides of a border */
+    for (i=0, inked=0; i<2376; i++) {
+        inked = inked + (expect[17 + 3 * (i * 1836 + 2 * RASTER_TILE - 1)] < 255 &&
+                         expect[17 + 3 * (i * 1836 + 2 * RASTER_TILE)] < 255);
+    }
+    mu_assert("error, nothing drawn across a tile border", inked > 0);
+    free(buffer);
+    free(expect);
+    return 0;
+}
+
+/**
+ *  tests the manifest of a pyramid, and that only the tiles with ink on
+ *  them are written
+ */
+static char * test_pyramid() {
+    char *argv[] = { "interp", "--pyramid", "--scale=4", TEST_FILE1, TEST_JSON, NULL };
+    unsigned char *buffer;
+    long size;
+    int ret;
+    FILE *fp;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(5, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_JSON, &size);
+    mu_assert("error, wrong depth", strstr((char *) buffer, "\"max_zoom\": 2,") != NULL);
+    mu_assert("error, wrong tiles", strstr((char *) buffer, "\"" TEST_TILES "/{z}/{x}/{y}.png\"") != NULL);
+    mu_assert("error, wrong bounds", strstr((char *) buffer,
+              "\"bounds\": [200, 87.65286945, 281.2132034, 221.2132034]") != NULL);
+    mu_assert("error, wrong tiles written", strstr((char *) buffer, "\"written\": [1, 4, 10]") != NULL);
+    free(buffer);
+    buffer = get_content(TEST_TILES "/2/1/2.png", &size);
+    mu_assert("error, no png signature", memcmp(buffer, "\x89PNG\r\n\x1a\n", 8) == 0);
+    free(buffer);
+    fp = fopen(TEST_TILES "/2/0/1.png", "rb");
+    mu_assert("error, blank tile written", fp == NULL);
+    return 0;
+}
+
+/**
+ *  tests that an image is refused more than one page
+ */
+static char * test_pages() {
+    char *argv[] = { "interp", "--multi=pages", TEST_MULTI, TEST_PNG, NULL };
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_ppm);
+    mu_run_test(test_png);
+    mu_run_test(test_tiles);
+    mu_run_test(test_pyramid);
+    mu_run_test(test_pages);
+    return 0;
+}
+
+/**
+ *  Boilerplate for minunit.h
+ */
+int main(int argc, const char * argv[]) {
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+        return 1;
+    }
+    else {
+        printf("All tests passed\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return 0;
+}
+
+/********************************************
+ Helper Functions
+ ********************************************/
+
+/**
+ *  Returns the content of filename and its size in *size. It must be freed.
+ */
+unsigned char * get_content(char * filename, long *size) {
+    unsigned char * buffer;
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: cannot open file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    fseek (file, 0, SEEK_END);
+    *size = ftell (file);
+    rewind(file);
+    buffer = (unsigned char *) calloc (*size + 1, sizeof(char));
+    fread(buffer, 1, *size, file);
+    fclose(file);
+    return buffer;
+}
+
+/**
+ *  Returns the big endian word at p
+ */
+unsigned long get_word(unsigned char *p) {
+    return ((unsigned long) p[0] << 24) | ((unsigned long) p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+ *  Returns the pixels of the png, its IDAT chunks joined and inflated with
+ *  the filter byte of each row dropped, or NULL if they cannot be. Every
+ *  chunk's checksum is checked. It must be freed.
+ */
+unsigned char * png_pixels(unsigned char *png, long size) {
+    unsigned char *data = (unsigned char *) malloc (size), *raw, *pixels;
+    uLongf raw_size = (RASTER_WIDTH + 1) * RASTER_HEIGHT;
+    long pos = 8, n, len = 0;
+    int i;
+    while (pos + 12 <= size) {
+        n = get_word(png + pos);
+        if (get_word(png + pos + 8 + n) != crc32(crc32(0L, png + pos + 4, 4), png + pos + 8, n)) {
+            free(data);
+            return NULL;
+        }
+        if (memcmp(png + pos + 4, "IDAT", 4) == 0) {
+            memcpy(data + len, png + pos + 8, n);
+            len = len + n;
+        }
+        pos = pos + 12 + n;
+    }
+    raw = (unsigned char *) malloc (raw_size);
+    if (uncompress(raw, &raw_size, data, len) != Z_OK || raw_size != (RASTER_WIDTH + 1) * RASTER_HEIGHT) {
+        free(data);
+        free(raw);
+        return NULL;
+    }
+    pixels = (unsigned char *) malloc (PIXELS);
+    for (i=0; i<RASTER_HEIGHT; i++) {
+        memcpy(pixels + i * RASTER_WIDTH, raw + i * (RASTER_WIDTH + 1) + 1, RASTER_WIDTH);
+    }
+    free(data);
+    free(raw);
+    return pixels;
+}
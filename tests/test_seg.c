@@ -0,0 +1,234 @@
+/*
+ *  test_seg.c
+ *  Tests the seg backend and reading segment files back
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interpreter.h"
+#include "seg.h"
+#include "minunit.h"
+
+#define TEST_FILE2      "data/testdata2.txt"
+#define TEST_MULTI      "data/testmulti.txt"    /* test file with three programs */
+#define TEST_IN         "testin.txt"            /* written for a drawing of many blocks */
+#define TEST_SEG        "testout.seg"           /* out_files used to test the backend */
+#define TEST_CUT        "testout-cut.seg"
+#define MANY_SEGS       10000
+#define MANY_LINE       3                       /* line of the FD in TEST_IN */
+
+/* used by minunit.h */
+int tests_run = 0;
+
+/* helper functions */
+int write_many(void);
+long copy_file(char *from, char *to, long bytes, long flip);
+int near(double a, double b);
+
+/**
+ *  tests that the segments read back are where the absolute postscript
+ *  puts them, follow on from each other and know their source lines
+ */
+static char * test_roundtrip() {
+    char *argv[] = { "interp", TEST_FILE2, TEST_SEG, NULL };
+    SegReader sr;
+    SfSeg segs[SF_BLOCK_SEGS];
+    long n, page, i;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(3, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    sr = sf_open(TEST_SEG);
+    mu_assert("error, not opened", sr != NULL);
+    mu_assert("error, not finished", sr->finished);
+    mu_assert("error, wrong count", sr->num_blocks == 1 && sr->num_segs == 450);
+    n = sf_read_block(sr, 0, segs, &page);
+    mu_assert("error, block not read", n == 450 && page == 0);
+    /* FD 1 then FD 0.2 after RT 30, as in --ps-mode=absolute */
+    mu_assert("error, wrong start", segs[0].x0 == 200 && segs[0].y0 == 200);
+    mu_assert("error, wrong point", near(segs[0].x1, 201.00) && near(segs[0].y1, 200.00));
+    mu_assert("error, wrong point", near(segs[1].x1, 201.17) && near(segs[1].y1, 199.90));
+    mu_assert("error, wrong line", segs[0].line == 3 && segs[1].line == 7 && segs[9].line == 3);
+    for (i=1; i<n && segs[i].x0 == segs[i - 1].x1 && segs[i].y0 == segs[i - 1].y1; i++);
+    mu_assert("error, segments do not follow on", i == n);
+    mu_assert("error, no block 1", sf_read_block(sr, 1, segs, &page) == ARGS_ERR);
+    sf_close(sr);
+    return 0;
+}
+
+/**
+ *  tests that blocks can be read in any order, each on its own
+ */
+static char * test_blocks() {
+    char *argv[] = { "interp", TEST_IN, TEST_SEG, NULL };
+    SegReader sr;
+    SfSeg *last, *first;
+    long n, page;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    mu_assert("error, input not written", write_many() == 0);
+    ret = interp_main(3, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    sr = sf_open(TEST_SEG);
+    mu_assert("error, not opened", sr != NULL);
+    mu_assert("error, wrong count", sr->num_blocks == 3 && sr->num_segs == MANY_SEGS);
+    mu_assert("error, wrong index", sr->index[2].first_seg == 2 * SF_BLOCK_SEGS);
+    last = (SfSeg *) malloc (SF_BLOCK_SEGS * sizeof(SfSeg));
+    first = (SfSeg *) malloc (SF_BLOCK_SEGS * sizeof(SfSeg));
+    n = sf_read_block(sr, 2, last, &page);
+    mu_assert("error, last block not read", n == MANY_SEGS - 2 * SF_BLOCK_SEGS);
+    mu_assert("error, wrong line", last[n - 1].line == MANY_LINE);
+    n = sf_read_block(sr, 1, first, &page);
+    mu_assert("error, block not read", n == SF_BLOCK_SEGS);
+    mu_assert("error, blocks do not follow on", first[n - 1].x1 == last[0].x0 &&
+                                                first[n - 1].y1 == last[0].y0);
+    free(last);
+    free(first);
+    sf_close(sr);
+    return 0;
+}
+
+/**
+ *  tests that a file cut short is read up to its last whole block, and that
+ *  a damaged block is found by its crc
+ */
+static char * test_damaged() {
+    SegReader sr;
+    SfSeg *segs;
+    long n, page, size;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    /* the file of test_blocks, cut in its last block */
+    sr = sf_open(TEST_SEG);
+    mu_assert("error, not opened", sr != NULL);
+    size = (long) sr->index[2].offset + SF_BLOCK_HEADER + 100;
+    sf_close(sr);
+    mu_assert("error, not copied", copy_file(TEST_SEG, TEST_CUT, size, -1) == size);
+    sr = sf_open(TEST_CUT);
+    mu_assert("error, not opened", sr != NULL);
+    mu_assert("error, finished", !sr->finished);
+    mu_assert("error, wrong count", sr->num_blocks == 2 && sr->num_segs == 2 * SF_BLOCK_SEGS);
+    sf_close(sr);
+
+    /* a byte of the records of block 1 changed */
+    sr = sf_open(TEST_SEG);
+    mu_assert("error, not opened", sr != NULL);
+    size = (long) sr->index[1].offset + SF_BLOCK_HEADER + 10;
+    sf_close(sr);
+    copy_file(TEST_SEG, TEST_CUT, -1, size);
+    sr = sf_open(TEST_CUT);
+    mu_assert("error, not opened", sr != NULL);
+    segs = (SfSeg *) malloc (SF_BLOCK_SEGS * sizeof(SfSeg));
+    mu_assert("error, damage not found", sf_read_block(sr, 1, segs, &page) == PARSE_ERR);
+    mu_assert("error, first block not read", sf_read_block(sr, 0, segs, &page) == SF_BLOCK_SEGS);
+    n = sf_read_block(sr, 2, segs, &page);
+    mu_assert("error, last block not read", n == MANY_SEGS - 2 * SF_BLOCK_SEGS);
+    free(segs);
+    sf_close(sr);
+    return 0;
+}
+
+/**
+ *  tests that each page starts a block of its own, from where the turtle
+ *  starts
+ */
+static char * test_pages() {
+    char *argv[] = { "interp", "--multi=pages", TEST_MULTI, TEST_SEG, NULL };
+    SegReader sr;
+    SfSeg segs[SF_BLOCK_SEGS];
+    long n, page, i;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(4, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    sr = sf_open(TEST_SEG);
+    mu_assert("error, not opened", sr != NULL);
+    mu_assert("error, not a block a page", sr->num_blocks == 3);
+    for (i=0; i<3; i++) {
+        n = sf_read_block(sr, i, segs, &page);
+        mu_assert("error, wrong page", n == 1 && page == i);
+        mu_assert("error, wrong start", segs[0].x0 == 200 && segs[0].y0 == 200);
+    }
+    /* FD 10 on the third page, and LT 90 FD 20 on the second */
+    mu_assert("error, wrong point", near(segs[0].x1, 210) && near(segs[0].y1, 200));
+    sf_read_block(sr, 1, segs, &page);
+    mu_assert("error, wrong point", near(segs[0].x1, 200) && near(segs[0].y1, 220));
+    mu_assert("error, wrong line", segs[0].line == 11);
+    sf_close(sr);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_roundtrip);
+    mu_run_test(test_blocks);
+    mu_run_test(test_damaged);
+    mu_run_test(test_pages);
+    return 0;
+}
+
+/**
+ *  Boilerplate for minunit.h
+ */
+int main(int argc, const char * argv[]) {
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+        return 1;
+    }
+    else {
+        printf("All tests passed\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return 0;
+}
+
+/********************************************
+ Helper Functions
+ ********************************************/
+
+/**
+ *  Writes a program drawing MANY_SEGS segments, with its FD on MANY_LINE
+ */
+int write_many(void) {
+    FILE *fp = fopen(TEST_IN, "w");
+    if (fp == NULL) {
+        return -1;
+    }
+    fprintf(fp, "{\n    DO A FROM 1 TO %d {\n        FD 1\n        RT A\n    }\n}\n", MANY_SEGS);
+    fclose(fp);
+    return 0;
+}
+
+/**
+ *  Copies the first bytes of a file, or all of it if bytes is -1, with the
+ *  byte at flip changed unless it is -1. Returns the bytes copied.
+ */
+long copy_file(char *from, char *to, long bytes, long flip) {
+    FILE *in = fopen(from, "rb"), *out = fopen(to, "wb");
+    long n = 0;
+    int c;
+    while ((bytes < 0 || n < bytes) && (c = fgetc(in)) != EOF) {
+        fputc((n == flip) ? c ^ 0x40 : c, out);
+        n++;
+    }
+    fclose(in);
+    fclose(out);
+    return n;
+}
+
+/**
+ *  Returns 1 if a and b are the same to within the hundredth of a point
+ *  they are rounded to
+ */
+int near(double a, double b) {
+    return fabs(a - b) < 0.006;
+}
@@ -0,0 +1,210 @@
+/*
+ *  test_svg.c
+ *  Tests the svg backend
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "interpreter.h"
+#include "svg.h"
+#include "minunit.h"
+
+#define TEST_FILE1      "data/testdata1.txt"
+#define TEST_FILE2      "data/testdata2.txt"
+#define TEST_EXPECT1    "data/testdata1.ps"     /* postscript of TEST_FILE1 */
+#define TEST_SVG        "data/testsvg.txt"      /* nested loops that draw the same */
+#define TEST_MULTI      "data/testmulti.txt"    /* test file with three programs */
+#define TEST_OUT        "testout.svg"           /* out_file used to test the backend */
+#define TEST_IN         "testin.txt"            /* written for the program below */
+
+/* used by minunit.h */
+int tests_run = 0;
+
+/* helper functions */
+char * get_content(char * filename);
+
+/**
+ *  tests that nested loops which draw the same every time are instanced
+ */
+static char * test_instanced() {
+    char *argv[] = { "interp", TEST_SVG, TEST_OUT, NULL };
+    char *buffer;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(3, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, TEST_OUT is not as expected", strsame(buffer,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+        "xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"612\" height=\"792\">\n"
+        "<title>" TEST_SVG "</title>\n"
+        "<g transform=\"matrix(1 0 0 -1 200 592)\" fill=\"none\" stroke=\"black\">\n"
+        "<defs><g id=\"d0\">\n"
+        "<defs><g id=\"d1\">\n"
+        "<path d=\"M0 0l10 0 0-10-5 0 0 5\"/>\n"
+        "</g></defs>\n"
+        "<use xlink:href=\"#d1\"/>\n"
+        "<use xlink:href=\"#d1\" transform=\"translate(5-5) rotate(150)\"/>\n"
+        "<use xlink:href=\"#d1\" transform=\"translate(3.17 1.83) rotate(-60)\"/>\n"
+        "<path d=\"M1.34-5l4.33 2.5\"/>\n"
+        "</g></defs>\n"
+        "<use xlink:href=\"#d0\"/>\n"
+        "<use xlink:href=\"#d0\" transform=\"translate(5.67-2.5) rotate(30)\"/>\n"
+        "<use xlink:href=\"#d0\" transform=\"translate(11.83-1.83) rotate(60)\"/>\n"
+        "<use xlink:href=\"#d0\" transform=\"translate(16.83 1.83) rotate(90)\"/>\n"
+        "<use xlink:href=\"#d0\" transform=\"translate(19.33 7.5) rotate(120)\"/>\n"
+        "<use xlink:href=\"#d0\" transform=\"translate(18.66 13.66) rotate(150)\"/>\n"
+        "<path d=\"M15 18.66l-20 0\"/>\n"
+        "</g>\n"
+        "</svg>\n"));
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that loops reading their own variable, or setting one, are drawn
+ */
+static char * test_variant() {
+    char *argv[] = { "interp", TEST_FILE2, TEST_OUT, NULL };
+    char *buffer;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(3, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, loop instanced", strstr(buffer, "<use") == NULL);
+    mu_assert("error, path does not start as expected",
+              strstr(buffer, "<path d=\"M0 0l1 0 .17-.1 .05-.19") != NULL);
+    mu_assert("error, not ended", strstr(buffer, "\"/>\n</g>\n</svg>\n") != NULL);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that the svg is much smaller than the postscript, and that there is
+ *  only one page
+ */
+static char * test_size() {
+    char *argv[] = { "interp", TEST_FILE1, TEST_OUT, NULL };
+    char *pages[] = { "interp", "--multi=pages", TEST_MULTI, TEST_OUT, NULL };
+    char *buffer, *expect;
+    int ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    ret = interp_main(3, argv);
+    mu_assert("error, ret != EXIT_SUCCESS", ret == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    expect = get_content(TEST_EXPECT1);
+    mu_assert("error, no use", strstr(buffer, "<use") != NULL);
+    mu_assert("error, svg not smaller", strlen(buffer) * 10 < strlen(expect));
+    free(buffer);
+    free(expect);
+    
+    ret = interp_main(4, pages);
+    mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+    mu_assert("error, TEST_OUT exists", access(TEST_OUT, F_OK) == -1);
+    return 0;
+}
+
+/**
+ *  tests that points too far to round into hundredths are written where
+ *  they are, and the path carries on relative once back in reach
+ */
+static char * test_far() {
+    char *argv[] = { "interp", TEST_IN, TEST_OUT, NULL };
+    char *buffer;
+    FILE *fp;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    fp = fopen(TEST_IN, "w");
+    mu_assert("error, input not written", fp != NULL);
+    fputs("{\nSET A := 10000000000 10000000000 * 10000000000 * ;\nFD 10\nFD A\nLT 90\nFD 5\n"
+          "LT 90\nFD A\nFD 10\n}\n", fp);
+    fclose(fp);
+    mu_assert("error, ret != EXIT_SUCCESS", interp_main(3, argv) == EXIT_SUCCESS);
+    buffer = get_content(TEST_OUT);
+    mu_assert("error, far points not written in full", strstr(buffer, "<path d=\"M0 0l10 0"
+              "L1000000015047466219876688855040.00 0.00 1000000015047466219876688855040.00 5.00 0 ")
+              != NULL);
+    /* back from 1e30 off only by what sin(180) leaves, so in reach again */
+    mu_assert("error, not relative again", strstr(buffer, "l-10 0\"/>\n") != NULL);
+    free(buffer);
+    return 0;
+}
+
+/**
+ *  tests that an svg is refused the postscript options
+ */
+static char * test_options() {
+    char *argv[] = { "interp", NULL, TEST_FILE1, TEST_OUT, NULL };
+    char *ps[] = { "--compact", "--simplify=1", "--dedup", "--ps-mode=absolute",
+                   "--max-path=3", "--threads=2" };
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    for (i=0; i<6; i++) {
+        argv[1] = ps[i];
+        ret = interp_main(4, argv);
+        mu_assert("error, ret != EXIT_FAILURE", ret == EXIT_FAILURE);
+        mu_assert("error, TEST_OUT exists", access(TEST_OUT, F_OK) == -1);
+    }
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_instanced);
+    mu_run_test(test_variant);
+    mu_run_test(test_size);
+    mu_run_test(test_far);
+    mu_run_test(test_options);
+    return 0;
+}
+
+/**
+ *  Boilerplate for minunit.h
+ */
+int main(int argc, const char * argv[]) {
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+        return 1;
+    }
+    else {
+        printf("All tests passed\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return 0;
+}
+
+/********************************************
+ Helper Functions
+ ********************************************/
+
+/**
+ *  Returns the content of filename, which must be freed
+ */
+char * get_content(char * filename) {
+    long lSize;
+    char * buffer;
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: cannot open file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    fseek (file, 0, SEEK_END);
+    lSize = ftell (file);
+    rewind(file);
+    buffer = (char *) calloc (lSize + 1, sizeof(char));
+    fread(buffer, 1, lSize, file);
+    fclose(file);
+    return buffer;
+}
@@ -0,0 +1,255 @@
+/*
+ *  test_turtle.c
+ *  Tests running a program a few segments at a time
+ *
+ *  Author: Kenneth Kam <kk4053@bris.ac.uk>
+ *  Username: kk4053
+ *  Declaration: This code for COMSM1201 is the original work of Kenneth Kam.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interpreter.h"
+#include "turtle.h"
+#include "minunit.h"
+
+#define TEST_FILE2      "data/testdata2.txt"
+#define TEST_MINIFIED   "data/testmini.txt"     /* testdata2.txt on one line */
+#define TEST_IN         "testin.txt"            /* written for the programs below */
+#define NUM_BAD         6
+#define MAX_SEGS        1000
+#define CHUNK           7                       /* segments pulled at a time */
+#define MANY_SEGS       10000
+
+/* used by minunit.h */
+int tests_run = 0;
+
+/* helper functions */
+Logo load(char *filename);
+int write_program(char *program);
+int pull_all(TurtleCtx ctx, TurtleSeg *buf, int max, int chunk);
+int near(double a, double b);
+
+/**
+ *  tests that the segments are where the seg backend puts them, follow on
+ *  from each other and know their source lines
+ */
+static char * test_segments() {
+    Logo input = load(TEST_FILE2);
+    TurtleCtx ctx;
+    TurtleSeg segs[MAX_SEGS];
+    int n, i;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    mu_assert("error, not loaded", input != NULL);
+    ctx = turtle_new(input);
+    mu_assert("error, no turtle", ctx != NULL);
+    n = turtle_next(ctx, segs, MAX_SEGS);
+    mu_assert("error, wrong count", n == 450);
+    mu_assert("error, not done", turtle_done(ctx));
+    mu_assert("error, more after done", turtle_next(ctx, segs, MAX_SEGS) == 0);
+    /* FD 1 then FD 0.2 after RT 30 */
+    mu_assert("error, wrong start", segs[0].x0 == 200 && segs[0].y0 == 200);
+    mu_assert("error, wrong point", near(segs[0].x1, 201.00) && near(segs[0].y1, 200.00));
+    mu_assert("error, wrong point", near(segs[1].x1, 201.17) && near(segs[1].y1, 199.90));
+    mu_assert("error, wrong line", segs[0].line == 3 && segs[1].line == 7 && segs[9].line == 3);
+    for (i=1; i<n && segs[i].x0 == segs[i - 1].x1 && segs[i].y0 == segs[i - 1].y1; i++);
+    mu_assert("error, segments do not follow on", i == n);
+    turtle_free(ctx);
+    free_logo(input);
+    return 0;
+}
+
+/**
+ *  tests that pulling a few segments at a time draws the same as pulling
+ *  them all at once, for the same program laid out either way
+ */
+static char * test_chunks() {
+    char *files[] = { TEST_FILE2, TEST_MINIFIED };
+    Logo input;
+    TurtleCtx ctx;
+    TurtleSeg all[MAX_SEGS], some[MAX_SEGS];
+    int i, n;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    for (i=0; i<2; i++) {
+        input = load(files[i]);
+        mu_assert("error, not loaded", input != NULL);
+        ctx = turtle_new(input);
+        n = pull_all(ctx, all, MAX_SEGS, MAX_SEGS);
+        turtle_free(ctx);
+        mu_assert("error, wrong count", n == 450);
+        input->counter = 0;
+        ctx = turtle_new(input);
+        mu_assert("error, wrong chunk", turtle_next(ctx, some, CHUNK) == CHUNK);
+        mu_assert("error, done early", !turtle_done(ctx));
+        n = pull_all(ctx, some + CHUNK, MAX_SEGS - CHUNK, CHUNK);
+        mu_assert("error, wrong count", n == 450 - CHUNK);
+        mu_assert("error, chunks differ", memcmp(all, some, 450 * sizeof(TurtleSeg)) == 0);
+        turtle_free(ctx);
+        free_logo(input);
+    }
+    return 0;
+}
+
+/**
+ *  tests that bad programs give an error, and keep giving it, as interp
+ *  would
+ */
+static char * test_errors() {
+    char *files[NUM_BAD] = { "data/testb_do.txt", "data/testb_inst.txt", "data/testb_polish.txt",
+                             "data/testb_set.txt", "data/testb_var.txt", "data/testb_varnum.txt" };
+    Logo input;
+    TurtleCtx ctx;
+    TurtleSeg segs[MAX_SEGS];
+    int i, ret;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    for (i=0; i<NUM_BAD; i++) {
+        input = load(files[i]);
+        mu_assert("error, not loaded", input != NULL);
+        ctx = turtle_new(input);
+        ret = turtle_next(ctx, segs, MAX_SEGS);
+        mu_assert("error, no error", ret < 0 && !turtle_done(ctx));
+        mu_assert("error, error not kept", turtle_next(ctx, segs, MAX_SEGS) == ret);
+        turtle_free(ctx);
+        free_logo(input);
+    }
+    /* no closing bracket, after drawing one segment */
+    mu_assert("error, input not written", write_program("{\nFD 10\n") == 0);
+    input = load(TEST_IN);
+    ctx = turtle_new(input);
+    mu_assert("error, segment lost", turtle_next(ctx, segs, MAX_SEGS) == 1);
+    mu_assert("error, no error", turtle_next(ctx, segs, MAX_SEGS) == PARSE_ERR);
+    turtle_free(ctx);
+    free_logo(input);
+    /* no opening bracket */
+    mu_assert("error, input not written", write_program("FD 10\n}\n") == 0);
+    input = load(TEST_IN);
+    ctx = turtle_new(input);
+    mu_assert("error, no error", turtle_next(ctx, segs, MAX_SEGS) == PARSE_ERR);
+    turtle_free(ctx);
+    free_logo(input);
+    return 0;
+}
+
+/**
+ *  tests that a long program can be stopped part way and freed, and that
+ *  a long stretch drawing nothing still hands back control
+ */
+static char * test_cancel() {
+    char program[LINE_LENGTH * 4];
+    Logo input;
+    TurtleCtx ctx;
+    TurtleSeg segs[MAX_SEGS];
+    int n, calls;
+    printf("Testing %s\n", __FUNCTION__);
+    
+    sprintf(program, "{\nDO A FROM 1 TO %d {\nFD 1\nRT A\n}\n}\n", MANY_SEGS);
+    mu_assert("error, input not written", write_program(program) == 0);
+    input = load(TEST_IN);
+    ctx = turtle_new(input);
+    mu_assert("error, wrong chunk", turtle_next(ctx, segs, 100) == 100);
+    mu_assert("error, done early", !turtle_done(ctx));
+    mu_assert("error, A not where it was left", input->vars[0].data == 100);
+    turtle_free(ctx);
+    free_logo(input);
+
+    /* TT_MAX_STEPS lines turning, one FD at the end */
+    sprintf(program, "{\nDO A FROM 1 TO %d {\nLT 1\n}\nFD 1\n}\n", 2 * TT_MAX_STEPS);
+    mu_assert("error, input not written", write_program(program) == 0);
+    input = load(TEST_IN);
+    ctx = turtle_new(input);
+    mu_assert("error, did not hand back", turtle_next(ctx, segs, MAX_SEGS) == 0);
+    mu_assert("error, done early", !turtle_done(ctx));
+    for (n=0, calls=1; n == 0 && calls < 10; calls++) {
+        n = turtle_next(ctx, segs, MAX_SEGS);
+    }
+    mu_assert("error, FD not reached", n == 1 && turtle_done(ctx) && calls > 2);
+    /* turned 2 * TT_MAX_STEPS degrees, 200000 = 200 mod 360 */
+    mu_assert("error, wrong heading", near(segs[0].x1, 200 + cos(200 * TT_TO_RADS)) &&
+                                      near(segs[0].y1, 200 + sin(200 * TT_TO_RADS)));
+    turtle_free(ctx);
+    free_logo(input);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_segments);
+    mu_run_test(test_chunks);
+    mu_run_test(test_errors);
+    mu_run_test(test_cancel);
+    return 0;
+}
+
+/**
+ *  Boilerplate for minunit.h
+ */
+int main(int argc, const char * argv[]) {
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+        return 1;
+    }
+    else {
+        printf("All tests passed\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return 0;
+}
+
+/********************************************
+ Helper Functions
+ ********************************************/
+
+/**
+ *  Scans the file into a Logo, or returns NULL
+ */
+Logo load(char *filename) {
+    FILE *fp = fopen(filename, "r");
+    Logo input;
+    if (fp == NULL) {
+        return NULL;
+    }
+    input = scan_file(fp);
+    fclose(fp);
+    return input;
+}
+
+/**
+ *  Writes the program to TEST_IN
+ */
+int write_program(char *program) {
+    FILE *fp = fopen(TEST_IN, "w");
+    if (fp == NULL) {
+        return -1;
+    }
+    fputs(program, fp);
+    fclose(fp);
+    return 0;
+}
+
+/**
+ *  Pulls chunk segments at a time into buf until the program is done.
+ *  Returns the segments pulled, or the error
+ */
+int pull_all(TurtleCtx ctx, TurtleSeg *buf, int max, int chunk) {
+    int n = 0, ret;
+    while (!turtle_done(ctx) && n + chunk <= max) {
+        if ((ret = turtle_next(ctx, buf + n, chunk)) < 0) {
+            return ret;
+        }
+        n = n + ret;
+    }
+    return n;
+}
+
+/**
+ *  Returns 1 if a and b are the same to within the hundredth of a point
+ *  the postscript is rounded to
+ */
+int near(double a, double b) {
+    return fabs(a - b) < 0.006;
+}